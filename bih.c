@@ -3,7 +3,13 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "bih.h"
+#include "sys.h"
+
+#ifdef SSE2_PRESENT
+#include <emmintrin.h>
+#endif
 
 static int BIH_BuildNode(bih_t *bih, int numchildren, int *leaflist, float *totalmins, float *totalmaxs)
 {
@@ -152,6 +158,417 @@ int BIH_Build(bih_t *bih, int numleafs, bih_leaf_t *leafs, int maxnodes, bih_nod
 	return bih->error;
 }
 
+/*
+===============================================================================
+
+WIDE HIERARCHY
+
+4 children per node, each split found by binning the leaf centers and taking
+the cheapest split by surface area heuristic, a node is built by splitting the
+largest of its child groups until there are 4.
+
+===============================================================================
+*/
+
+#define BIH_SAHBINS 16
+
+static float BIH_BoxArea(const float *mins, const float *maxs)
+{
+	float x = maxs[0] - mins[0], y = maxs[1] - mins[1], z = maxs[2] - mins[2];
+	return x * y + y * z + z * x;
+}
+
+static void BIH_LeafListBounds(const bih_t *bih, int numleafs, const int *leaflist, float *mins, float *maxs)
+{
+	int i, k;
+	const bih_leaf_t *leaf = bih->leafs + leaflist[0];
+	for (k = 0;k < 3;k++)
+	{
+		mins[k] = leaf->mins[k];
+		maxs[k] = leaf->maxs[k];
+	}
+	for (i = 1;i < numleafs;i++)
+	{
+		leaf = bih->leafs + leaflist[i];
+		for (k = 0;k < 3;k++)
+		{
+			if (mins[k] > leaf->mins[k]) mins[k] = leaf->mins[k];
+			if (maxs[k] < leaf->maxs[k]) maxs[k] = leaf->maxs[k];
+		}
+	}
+}
+
+// reorders leaflist so the first (returned count) leafs are on the cheaper
+// side of the best binned split
+static int BIH_SAHSplit(bih_t *bih, int numleafs, int *leaflist)
+{
+	int i, k, b, axis, bestaxis = -1, bestbin = 0, front, back;
+	int bincount[BIH_SAHBINS];
+	float binmins[BIH_SAHBINS][3], binmaxs[BIH_SAHBINS][3];
+	float rightarea[BIH_SAHBINS];
+	int rightcount[BIH_SAHBINS];
+	float cmins[3], cmaxs[3], c, scale, cost, bestcost = 0;
+	float mins[3], maxs[3];
+	const bih_leaf_t *leaf;
+
+	// bounds of the leaf centers
+	for (i = 0;i < numleafs;i++)
+	{
+		leaf = bih->leafs + leaflist[i];
+		for (k = 0;k < 3;k++)
+		{
+			c = (leaf->mins[k] + leaf->maxs[k]) * 0.5f;
+			if (i == 0 || cmins[k] > c) cmins[k] = c;
+			if (i == 0 || cmaxs[k] < c) cmaxs[k] = c;
+		}
+	}
+
+	for (axis = 0;axis < 3;axis++)
+	{
+		if (cmaxs[axis] <= cmins[axis])
+			continue;
+		scale = BIH_SAHBINS / (cmaxs[axis] - cmins[axis]);
+		memset(bincount, 0, sizeof(bincount));
+		for (i = 0;i < numleafs;i++)
+		{
+			leaf = bih->leafs + leaflist[i];
+			b = (int)(((leaf->mins[axis] + leaf->maxs[axis]) * 0.5f - cmins[axis]) * scale);
+			b = b < 0 ? 0 : b >= BIH_SAHBINS ? BIH_SAHBINS - 1 : b;
+			for (k = 0;k < 3;k++)
+			{
+				if (!bincount[b] || binmins[b][k] > leaf->mins[k]) binmins[b][k] = leaf->mins[k];
+				if (!bincount[b] || binmaxs[b][k] < leaf->maxs[k]) binmaxs[b][k] = leaf->maxs[k];
+			}
+			bincount[b]++;
+		}
+		// sweep from the right to get the area and count behind each split
+		rightcount[BIH_SAHBINS - 1] = 0;
+		rightarea[BIH_SAHBINS - 1] = 0;
+		front = 0;
+		for (b = BIH_SAHBINS - 1;b > 0;b--)
+		{
+			if (bincount[b])
+			{
+				for (k = 0;k < 3;k++)
+				{
+					if (!front || mins[k] > binmins[b][k]) mins[k] = binmins[b][k];
+					if (!front || maxs[k] < binmaxs[b][k]) maxs[k] = binmaxs[b][k];
+				}
+				front += bincount[b];
+			}
+			rightcount[b - 1] = front;
+			rightarea[b - 1] = front ? BIH_BoxArea(mins, maxs) : 0;
+		}
+		// sweep from the left and evaluate the split after each bin
+		back = 0;
+		for (b = 0;b < BIH_SAHBINS - 1;b++)
+		{
+			if (bincount[b])
+			{
+				for (k = 0;k < 3;k++)
+				{
+					if (!back || mins[k] > binmins[b][k]) mins[k] = binmins[b][k];
+					if (!back || maxs[k] < binmaxs[b][k]) maxs[k] = binmaxs[b][k];
+				}
+				back += bincount[b];
+			}
+			if (!back || !rightcount[b])
+				continue;
+			cost = back * BIH_BoxArea(mins, maxs) + rightcount[b] * rightarea[b];
+			if (bestaxis < 0 || bestcost > cost)
+			{
+				bestcost = cost;
+				bestaxis = axis;
+				bestbin = b;
+			}
+		}
+	}
+
+	// all centers in one spot, split the list in half
+	if (bestaxis < 0)
+		return numleafs >> 1;
+
+	scale = BIH_SAHBINS / (cmaxs[bestaxis] - cmins[bestaxis]);
+	front = back = 0;
+	for (i = 0;i < numleafs;i++)
+	{
+		leaf = bih->leafs + leaflist[i];
+		b = (int)(((leaf->mins[bestaxis] + leaf->maxs[bestaxis]) * 0.5f - cmins[bestaxis]) * scale);
+		b = b < 0 ? 0 : b >= BIH_SAHBINS ? BIH_SAHBINS - 1 : b;
+		if (b <= bestbin)
+			leaflist[front++] = leaflist[i];
+		else
+			bih->leafsortscratch[back++] = leaflist[i];
+	}
+	memcpy(leaflist + front, bih->leafsortscratch, back * sizeof(leaflist[0]));
+	return front;
+}
+
+static int BIH_BuildWideNode(bih_t *bih, int numleafs, int *leaflist)
+{
+	int i, j, k, q, nodenum, numgroups, biggest, count;
+	int groupstart[BIH_WIDECHILDREN], groupcount[BIH_WIDECHILDREN];
+	float groupmins[BIH_WIDECHILDREN][3], groupmaxs[BIH_WIDECHILDREN][3];
+	float mins[3], maxs[3], area, biggestarea;
+	bih_widenode_t *node;
+
+	// if we run out of nodes it's the caller's fault, but don't crash
+	if (bih->numwidenodes == bih->maxwidenodes)
+	{
+		if (!bih->error)
+			bih->error = BIHERROR_OUT_OF_NODES;
+		return 0;
+	}
+	nodenum = bih->numwidenodes++;
+
+	// split the largest group that is too big for a leaf child until there
+	// are enough children
+	numgroups = 1;
+	groupstart[0] = 0;
+	groupcount[0] = numleafs;
+	BIH_LeafListBounds(bih, numleafs, leaflist, groupmins[0], groupmaxs[0]);
+	while (numgroups < BIH_WIDECHILDREN)
+	{
+		biggest = -1;
+		biggestarea = 0;
+		for (i = 0;i < numgroups;i++)
+		{
+			if (groupcount[i] <= BIH_WIDEMAXLEAFS)
+				continue;
+			area = BIH_BoxArea(groupmins[i], groupmaxs[i]);
+			if (biggest < 0 || biggestarea < area)
+			{
+				biggest = i;
+				biggestarea = area;
+			}
+		}
+		if (biggest < 0)
+			break;
+		count = BIH_SAHSplit(bih, groupcount[biggest], leaflist + groupstart[biggest]);
+		groupstart[numgroups] = groupstart[biggest] + count;
+		groupcount[numgroups] = groupcount[biggest] - count;
+		groupcount[biggest] = count;
+		BIH_LeafListBounds(bih, groupcount[biggest], leaflist + groupstart[biggest], groupmins[biggest], groupmaxs[biggest]);
+		BIH_LeafListBounds(bih, groupcount[numgroups], leaflist + groupstart[numgroups], groupmins[numgroups], groupmaxs[numgroups]);
+		numgroups++;
+	}
+
+	// quantize the child bounds within the node bounds, one step of slack
+	// on each side covers any rounding in the reconstruction
+	BIH_LeafListBounds(bih, numleafs, leaflist, mins, maxs);
+	node = bih->widenodes + nodenum;
+	memset(node, 0, sizeof(*node));
+	for (k = 0;k < 3;k++)
+	{
+		node->origin[k] = mins[k];
+		node->scale[k] = (maxs[k] - mins[k]) * (1.0f / 253.0f);
+	}
+	node->numchildren = numgroups;
+	for (j = 0;j < numgroups;j++)
+	{
+		for (k = 0;k < 3;k++)
+		{
+			if (node->scale[k] > 0)
+			{
+				q = (int)floor((groupmins[j][k] - node->origin[k]) / node->scale[k]) - 1;
+				node->childmins[k][j] = q < 0 ? 0 : q > 255 ? 255 : q;
+				q = (int)ceil((groupmaxs[j][k] - node->origin[k]) / node->scale[k]) + 1;
+				node->childmaxs[k][j] = q < 0 ? 0 : q > 255 ? 255 : q;
+			}
+			else
+			{
+				node->childmins[k][j] = 0;
+				node->childmaxs[k][j] = 0;
+			}
+		}
+	}
+
+	// small groups become leaf children, the rest get their own nodes
+	for (j = 0;j < numgroups;j++)
+	{
+		if (groupcount[j] <= BIH_WIDEMAXLEAFS)
+		{
+			node->children[j] = -1 - (int)(leaflist + groupstart[j] - bih->wideleafs);
+			node->childnumleafs[j] = groupcount[j];
+		}
+		else
+			node->children[j] = BIH_BuildWideNode(bih, groupcount[j], leaflist + groupstart[j]);
+	}
+	return nodenum;
+}
+
+int BIH_BuildWide(bih_t *bih, int maxwidenodes, bih_widenode_t *widenodes, int *wideleafs, int *temp_leafsortscratch)
+{
+	int i;
+
+	bih->numwidenodes = 0;
+	bih->maxwidenodes = maxwidenodes;
+	bih->widenodes = widenodes;
+	bih->wideleafs = wideleafs;
+	bih->leafsortscratch = temp_leafsortscratch;
+	bih->error = BIHERROR_OK;
+	if (bih->numleafs < 1)
+		return bih->error;
+	for (i = 0;i < bih->numleafs;i++)
+		wideleafs[i] = i;
+	BIH_BuildWideNode(bih, bih->numleafs, wideleafs);
+	if (bih->error)
+		bih->numwidenodes = 0;
+	return bih->error;
+}
+
+// returns a bit for each child of the node whose quantized bounds touch the box
+static int BIH_WideNodeOverlap(const bih_widenode_t *node, const float *mins, const float *maxs)
+{
+#ifdef SSE2_PRESENT
+	__m128i zero = _mm_setzero_si128();
+	__m128 cmin, cmax, m = _mm_castsi128_ps(_mm_set1_epi32(-1));
+	int k, qmins, qmaxs;
+	for (k = 0;k < 3;k++)
+	{
+		memcpy(&qmins, node->childmins[k], sizeof(qmins));
+		memcpy(&qmaxs, node->childmaxs[k], sizeof(qmaxs));
+		cmin = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(qmins), zero), zero));
+		cmax = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(qmaxs), zero), zero));
+		cmin = _mm_add_ps(_mm_set1_ps(node->origin[k]), _mm_mul_ps(cmin, _mm_set1_ps(node->scale[k])));
+		cmax = _mm_add_ps(_mm_set1_ps(node->origin[k]), _mm_mul_ps(cmax, _mm_set1_ps(node->scale[k])));
+		m = _mm_and_ps(m, _mm_cmple_ps(_mm_set1_ps(mins[k]), cmax));
+		m = _mm_and_ps(m, _mm_cmpge_ps(_mm_set1_ps(maxs[k]), cmin));
+	}
+	return _mm_movemask_ps(m) & ((1 << node->numchildren) - 1);
+#else
+	int j, k, bits = 0;
+	for (j = 0;j < node->numchildren;j++)
+	{
+		for (k = 0;k < 3;k++)
+			if (mins[k] > node->origin[k] + node->childmaxs[k][j] * node->scale[k] || maxs[k] < node->origin[k] + node->childmins[k][j] * node->scale[k])
+				break;
+		if (k == 3)
+			bits |= 1 << j;
+	}
+	return bits;
+#endif
+}
+
+// a full node stack is continued by recursing into the subtree, so deep
+// trees are slower to query but never lose leafs
+#define BIH_NODESTACKSIZE 1024
+
+static void BIH_ForEachLeafInBox_Wide(const bih_t *bih, int startnode, const float *mins, const float *maxs, void (*callback)(void *context, const bih_leaf_t *leaf), void *context)
+{
+	int i, j, bits, first;
+	int nodestack[BIH_NODESTACKSIZE];
+	int nodestackpos = 0;
+	const bih_widenode_t *node;
+	const bih_leaf_t *leaf;
+
+	nodestack[nodestackpos++] = startnode;
+	while (nodestackpos)
+	{
+		node = bih->widenodes + nodestack[--nodestackpos];
+		for (bits = BIH_WideNodeOverlap(node, mins, maxs), j = 0;bits;bits >>= 1, j++)
+		{
+			if (!(bits & 1))
+				continue;
+			if (!node->childnumleafs[j])
+			{
+				if (nodestackpos < BIH_NODESTACKSIZE)
+					nodestack[nodestackpos++] = node->children[j];
+				else
+					BIH_ForEachLeafInBox_Wide(bih, node->children[j], mins, maxs, callback, context);
+				continue;
+			}
+			first = -1 - node->children[j];
+			for (i = 0;i < node->childnumleafs[j];i++)
+			{
+				leaf = bih->leafs + bih->wideleafs[first + i];
+				if (mins[0] > leaf->maxs[0] || maxs[0] < leaf->mins[0]
+				 || mins[1] > leaf->maxs[1] || maxs[1] < leaf->mins[1]
+				 || mins[2] > leaf->maxs[2] || maxs[2] < leaf->mins[2])
+					continue;
+				callback(context, leaf);
+			}
+		}
+	}
+}
+
+static void BIH_ForEachLeafInBox_Node(const bih_t *bih, int startnode, const float *mins, const float *maxs, void (*callback)(void *context, const bih_leaf_t *leaf), void *context)
+{
+	int j, nodenum;
+	int nodestack[BIH_NODESTACKSIZE];
+	int nodestackpos = 0;
+	const bih_node_t *bnode;
+	const bih_leaf_t *leaf;
+
+	nodestack[nodestackpos++] = startnode;
+	while (nodestackpos)
+	{
+		nodenum = nodestack[--nodestackpos];
+		bnode = bih->nodes + nodenum;
+		if (bnode->type == BIH_UNORDERED)
+		{
+			for (j = 0;j < BIH_MAXUNORDEREDCHILDREN && bnode->children[j] >= 0;j++)
+			{
+				leaf = bih->leafs + bnode->children[j];
+				if (mins[0] > leaf->maxs[0] || maxs[0] < leaf->mins[0]
+				 || mins[1] > leaf->maxs[1] || maxs[1] < leaf->mins[1]
+				 || mins[2] > leaf->maxs[2] || maxs[2] < leaf->mins[2])
+					continue;
+				callback(context, leaf);
+			}
+			continue;
+		}
+		j = bnode->type - BIH_SPLITX;
+		if (mins[j] <= bnode->backmax)
+		{
+			if (nodestackpos < BIH_NODESTACKSIZE)
+				nodestack[nodestackpos++] = bnode->back;
+			else
+				BIH_ForEachLeafInBox_Node(bih, bnode->back, mins, maxs, callback, context);
+		}
+		if (maxs[j] >= bnode->frontmin)
+		{
+			if (nodestackpos < BIH_NODESTACKSIZE)
+				nodestack[nodestackpos++] = bnode->front;
+			else
+				BIH_ForEachLeafInBox_Node(bih, bnode->front, mins, maxs, callback, context);
+		}
+	}
+}
+
+void BIH_ForEachLeafInBox(const bih_t *bih, const float *mins, const float *maxs, void (*callback)(void *context, const bih_leaf_t *leaf), void *context)
+{
+	if (bih->numwidenodes > 0)
+		BIH_ForEachLeafInBox_Wide(bih, 0, mins, maxs, callback, context);
+	else if (bih->numnodes > 0)
+		BIH_ForEachLeafInBox_Node(bih, bih->rootnode, mins, maxs, callback, context);
+}
+
+typedef struct bih_trianglelist_s
+{
+	int maxtriangles;
+	int numtriangles;
+	int *trianglelist_idx;
+	int *trianglelist_surf;
+}
+bih_trianglelist_t;
+
+static void BIH_GetTriangleListForBox_Leaf(void *context, const bih_leaf_t *leaf)
+{
+	bih_trianglelist_t *list = (bih_trianglelist_t *)context;
+	if (leaf->type != BIH_RENDERTRIANGLE)
+		return;
+	if (list->numtriangles >= list->maxtriangles)
+	{
+		list->numtriangles++; // so the caller can detect overflow
+		return;
+	}
+	if (list->trianglelist_surf)
+		list->trianglelist_surf[list->numtriangles] = leaf->surfaceindex;
+	list->trianglelist_idx[list->numtriangles] = leaf->itemindex;
+	list->numtriangles++;
+}
+
 static void BIH_GetTriangleListForBox_Node(const bih_t *bih, int nodenum, int maxtriangles, int *trianglelist_idx, int *trianglelist_surf, int *numtrianglespointer, const float *mins, const float *maxs)
 {
 	int axis;
@@ -211,6 +628,16 @@ static void BIH_GetTriangleListForBox_Node(const bih_t *bih, int nodenum, int ma
 int BIH_GetTriangleListForBox(const bih_t *bih, int maxtriangles, int *trianglelist_idx, int *trianglelist_surf, const float *mins, const float *maxs)
 {
 	int numtriangles = 0;
+	if (bih->numwidenodes > 0)
+	{
+		bih_trianglelist_t list;
+		list.maxtriangles = maxtriangles;
+		list.numtriangles = 0;
+		list.trianglelist_idx = trianglelist_idx;
+		list.trianglelist_surf = trianglelist_surf;
+		BIH_ForEachLeafInBox(bih, mins, maxs, BIH_GetTriangleListForBox_Leaf, &list);
+		return list.numtriangles;
+	}
 	BIH_GetTriangleListForBox_Node(bih, bih->rootnode, maxtriangles, trianglelist_idx, trianglelist_surf, &numtriangles, mins, maxs);
 	return numtriangles;
 }
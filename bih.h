@@ -7,6 +7,10 @@
 #define BIH_H
 
 #define BIH_MAXUNORDEREDCHILDREN 8
+// children per node of the optional wide hierarchy
+#define BIH_WIDECHILDREN 4
+// maximum leafs referenced directly by one child of a wide node
+#define BIH_WIDEMAXLEAFS 4
 
 typedef enum biherror_e
 {
@@ -66,6 +70,23 @@ typedef struct bih_leaf_s
 }
 bih_leaf_t;
 
+// node of the optional 4-wide hierarchy built by BIH_BuildWide, the child
+// bounds are quantized to bytes within the node bounds to keep nodes small
+typedef struct bih_widenode_s
+{
+	// child bounds are origin + q * scale (rounded outwards when quantizing)
+	float origin[3];
+	float scale[3];
+	unsigned char childmins[3][BIH_WIDECHILDREN];
+	unsigned char childmaxs[3][BIH_WIDECHILDREN];
+	// >= 0 is a wide node index, < 0 is -1 - first index in wideleafs
+	int children[BIH_WIDECHILDREN];
+	// number of leafs for leaf children, 0 for node children
+	unsigned char childnumleafs[BIH_WIDECHILDREN];
+	unsigned char numchildren;
+}
+bih_widenode_t;
+
 typedef struct bih_s
 {
 	// permanent fields
@@ -79,9 +100,15 @@ typedef struct bih_s
 	// bounds calculated by BIH_Build
 	float mins[3];
 	float maxs[3];
+	// optional wide hierarchy over the same leafs, constructed by
+	// BIH_BuildWide, queries use it instead of nodes if numwidenodes > 0
+	int numwidenodes;
+	bih_widenode_t *widenodes;
+	int *wideleafs;
 
-	// fields used only during BIH_Build:
+	// fields used only during BIH_Build and BIH_BuildWide:
 	int maxnodes;
+	int maxwidenodes;
 	int error; // set to a value if an error occurs in building (such as numnodes == maxnodes)
 	int *leafsort;
 	int *leafsortscratch;
@@ -90,6 +117,13 @@ bih_t;
 
 int BIH_Build(bih_t *bih, int numleafs, bih_leaf_t *leafs, int maxnodes, bih_node_t *nodes, int *temp_leafsort, int *temp_leafsortscratch);
 
+// builds the wide hierarchy after BIH_Build, maxwidenodes should be numleafs,
+// wideleafs receives numleafs leaf indexes and must be kept with the nodes
+int BIH_BuildWide(bih_t *bih, int maxwidenodes, bih_widenode_t *widenodes, int *wideleafs, int *temp_leafsortscratch);
+
+// calls callback for each leaf whose bounds touch the box
+void BIH_ForEachLeafInBox(const bih_t *bih, const float *mins, const float *maxs, void (*callback)(void *context, const bih_leaf_t *leaf), void *context);
+
 int BIH_GetTriangleListForBox(const bih_t *bih, int maxtriangles, int *trianglelist_idx, int *trianglelist_surf, const float *mins, const float *maxs);
 
 #endif
@@ -643,6 +643,168 @@ finished:
 	return cliptrace;
 }
 
+/*
+==================
+CL_TraceLineBatch
+
+The same as CL_TraceLine (without hitsurfaces) for many lines that share
+type and masks, for callers that only hit the world and network brush
+models (players and csqc entities are not supported).  The lines are clipped
+to the world together with Collision_ClipLinesToWorld, and the brush models
+touching the whole batch are gathered once and then culled for each line
+with Collision_BoxListOverlap.  As the candidates are in batch order, a tie
+between two brush models at the same fraction may pick the other entity.
+==================
+*/
+#define CL_TRACEBATCH_SIZE 64
+void CL_TraceLineBatch(int numtraces, const vec3_t *starts, const vec3_t *ends, int type, int hitsupercontentsmask, int skipsupercontentsmask, int skipmaterialflagsmask, float extend, qbool hitnetworkbrushmodels, int *hitnetworkentities, trace_t *traces)
+{
+	prvm_prog_t *prog = CLVM_prog;
+	int i, j, k;
+	trace_t trace;
+	// bounding box of each move and of the entire batch
+	vec3_t clipboxmins[CL_TRACEBATCH_SIZE], clipboxmaxs[CL_TRACEBATCH_SIZE];
+	vec3_t batchmins, batchmaxs;
+	// traces that are already complete (point traces)
+	qbool done[CL_TRACEBATCH_SIZE];
+	// the line traces, clipped to world together
+	vec3_t linestarts[CL_TRACEBATCH_SIZE], lineends[CL_TRACEBATCH_SIZE];
+	trace_t linetraces[CL_TRACEBATCH_SIZE];
+	int numlines;
+	// brush models touching the batch, their boxes for culling, and the culling results
+	entity_render_t *ent;
+	float *boxes;
+	int numcandidates, stride, numhits;
+	static int candidates[MAX_EDICTS];
+	static int hits[MAX_EDICTS];
+
+	// split big batches so the per trace arrays can stay on the stack
+	while (numtraces > CL_TRACEBATCH_SIZE)
+	{
+		CL_TraceLineBatch(CL_TRACEBATCH_SIZE, starts, ends, type, hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask, extend, hitnetworkbrushmodels, hitnetworkentities, traces);
+		starts += CL_TRACEBATCH_SIZE;
+		ends += CL_TRACEBATCH_SIZE;
+		traces += CL_TRACEBATCH_SIZE;
+		if (hitnetworkentities)
+			hitnetworkentities += CL_TRACEBATCH_SIZE;
+		numtraces -= CL_TRACEBATCH_SIZE;
+	}
+	if (numtraces <= 0)
+		return;
+
+	// point traces go the usual way, the lines are clipped to world together
+	numlines = 0;
+	for (j = 0;j < numtraces;j++)
+	{
+		done[j] = VectorCompare(starts[j], ends[j]);
+		if (done[j])
+			traces[j] = CL_TracePoint(starts[j], type, NULL, hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask, hitnetworkbrushmodels, false, hitnetworkentities ? hitnetworkentities + j : NULL, false);
+		else
+		{
+			VectorCopy(starts[j], linestarts[numlines]);
+			VectorCopy(ends[j], lineends[numlines]);
+			numlines++;
+		}
+	}
+	if (numlines == 0)
+		return;
+	Collision_ClipLinesToWorld(numlines, linetraces, cl.worldmodel, (const vec3_t *)linestarts, (const vec3_t *)lineends, hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask, extend);
+
+	VectorClear(batchmins);
+	VectorClear(batchmaxs);
+	for (j = 0, k = 0;j < numtraces;j++)
+	{
+		if (done[j])
+			continue;
+		if (hitnetworkentities)
+			hitnetworkentities[j] = 0;
+		traces[j] = linetraces[k++];
+		traces[j].worldstartsolid = traces[j].bmodelstartsolid = traces[j].startsolid;
+		if (traces[j].startsolid || traces[j].fraction < 1)
+			traces[j].ent = prog ? prog->edicts : NULL;
+
+		// create the bounding box of the entire move
+		for (i = 0;i < 3;i++)
+		{
+			clipboxmins[j][i] = min(starts[j][i], traces[j].endpos[i]) - 1;
+			clipboxmaxs[j][i] = max(starts[j][i], traces[j].endpos[i]) + 1;
+		}
+
+		if (k == 1)
+		{
+			VectorCopy(clipboxmins[j], batchmins);
+			VectorCopy(clipboxmaxs[j], batchmaxs);
+		}
+		else
+		{
+			for (i = 0;i < 3;i++)
+			{
+				batchmins[i] = min(batchmins[i], clipboxmins[j][i]);
+				batchmaxs[i] = max(batchmaxs[i], clipboxmaxs[j][i]);
+			}
+		}
+	}
+	if (type == MOVE_WORLDONLY || !hitnetworkbrushmodels)
+		return;
+
+	// gather the network brush models touching any of the moves
+	numcandidates = 0;
+	for (i = 0;i < cl.num_brushmodel_entities;i++)
+	{
+		ent = &cl.entities[cl.brushmodel_entities[i]].render;
+		if (BoxesOverlap(batchmins, batchmaxs, ent->mins, ent->maxs))
+			candidates[numcandidates++] = i;
+	}
+	if (numcandidates == 0)
+		return;
+
+	// lay out their boxes as one array per axis, padded with boxes that
+	// never overlap anything
+	stride = (numcandidates + 3) & ~3;
+	boxes = (float *)Mem_Alloc(tempmempool, 6 * stride * sizeof(float));
+	for (k = 0;k < stride;k++)
+	{
+		if (k < numcandidates)
+		{
+			ent = &cl.entities[cl.brushmodel_entities[candidates[k]]].render;
+			for (i = 0;i < 3;i++)
+			{
+				boxes[i * stride + k] = ent->mins[i];
+				boxes[(i + 3) * stride + k] = ent->maxs[i];
+			}
+		}
+		else
+		{
+			for (i = 0;i < 3;i++)
+			{
+				boxes[i * stride + k] = 1e30f;
+				boxes[(i + 3) * stride + k] = -1e30f;
+			}
+		}
+	}
+
+	// clip each move to the brush models its own box touches, in the same
+	// order as CL_TraceLine
+	for (j = 0;j < numtraces;j++)
+	{
+		if (done[j])
+			continue;
+		numhits = Collision_BoxListOverlap(clipboxmins[j], clipboxmaxs[j], boxes, numcandidates, stride, hits);
+		for (k = 0;k < numhits;k++)
+		{
+			i = cl.brushmodel_entities[candidates[hits[k]]];
+			ent = &cl.entities[i].render;
+			Collision_ClipLineToGenericEntity(&trace, ent->model, ent->frameblend, ent->skeleton, vec3_origin, vec3_origin, 0, &ent->matrix, &ent->inversematrix, starts[j], ends[j], hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask, extend, false);
+			if (traces[j].fraction > trace.fraction && hitnetworkentities)
+				hitnetworkentities[j] = i;
+			Collision_CombineTraces(&traces[j], &trace, NULL, true);
+		}
+	}
+
+	Mem_Free(boxes);
+}
+
+
 /*
 ==================
 CL_Move
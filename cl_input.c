@@ -376,6 +376,8 @@ cvar_t cl_anglespeedkey = {CF_CLIENT | CF_ARCHIVE, "cl_anglespeedkey","1.5","how
 
 cvar_t cl_movement = {CF_CLIENT | CF_ARCHIVE, "cl_movement", "0", "enables clientside prediction of your player movement on DP servers (use cl_nopred for QWSV servers)"};
 cvar_t cl_movement_replay = {CF_CLIENT, "cl_movement_replay", "1", "use engine prediction"};
+cvar_t cl_movement_replay_incremental = {CF_CLIENT | CF_ARCHIVE, "cl_movement_replay_incremental", "1", "reuse the predicted results of moves that were already replayed as long as the server agrees with them, so only new or corrected moves are simulated each frame"};
+cvar_t cl_movement_replay_tolerance = {CF_CLIENT, "cl_movement_replay_tolerance", "0.125", "how far (in units, or units per second for velocity) the server state may differ from the cached prediction before all moves are replayed again"};
 cvar_t cl_movement_nettimeout = {CF_CLIENT | CF_ARCHIVE, "cl_movement_nettimeout", "0.3", "stops predicting moves when server is lagging badly (avoids major performance problems), timeout in seconds"};
 cvar_t cl_movement_minping = {CF_CLIENT | CF_ARCHIVE, "cl_movement_minping", "0", "whether to use prediction when ping is lower than this value in milliseconds"};
 cvar_t cl_movement_track_canjump = {CF_CLIENT | CF_ARCHIVE, "cl_movement_track_canjump", "1", "track if the player released the jump key between two jumps to decide if he is able to jump or not; when off, this causes some \"sliding\" slightly above the floor when the jump key is held too long; if the mod allows repeated jumping by holding space all the time, this has to be set to zero too"};
@@ -1604,10 +1606,54 @@ void CL_ClientMovement_PlayerMove_Frame(cl_clientmovement_state_t *s)
 	}
 }
 
+// predicted state after each sent move, indexed by sequence modulo
+// CL_MAX_USERCMDS, so that CL_ClientMovement_Replay only has to simulate the
+// moves that are new (or follow a correction) instead of the whole queue
+typedef struct cl_movement_cache_s
+{
+	unsigned int sequence;
+	// input the move was simulated with (including the propagated canjump)
+	usercmd_t cmd;
+	// resulting state
+	cl_clientmovement_state_t state;
+}
+cl_movement_cache_t;
+
+static cl_movement_cache_t cl_movement_cache[CL_MAX_USERCMDS];
+
+void CL_ClientMovement_ClearCache(void)
+{
+	memset(cl_movement_cache, 0, sizeof(cl_movement_cache));
+}
+
+/*
+==============
+CL_ClientMovement_CacheMatchesServer
+
+returns true if the cached prediction for the move the server last
+acknowledged agrees with the state the server sent back, in which case the
+cached results of the later moves are still valid
+==============
+*/
+static cl_movement_cache_t *CL_ClientMovement_CacheMatchesServer(const vec3_t origin, const vec3_t velocity)
+{
+	int i;
+	float tolerance = cl_movement_replay_tolerance.value;
+	cl_movement_cache_t *c = &cl_movement_cache[cls.servermovesequence % CL_MAX_USERCMDS];
+	if (!cl_movement_replay_incremental.integer || !cls.servermovesequence || c->sequence != cls.servermovesequence)
+		return NULL;
+	for (i = 0;i < 3;i++)
+		if (fabs(c->state.origin[i] - origin[i]) > tolerance || fabs(c->state.velocity[i] - velocity[i]) > tolerance)
+			return NULL;
+	return c;
+}
+
 void CL_ClientMovement_Replay(void)
 {
 	int i;
 	double totalmovemsec;
+	qbool cached;
+	cl_movement_cache_t *c;
 	cl_clientmovement_state_t s;
 
 	VectorCopy(cl.mvelocity[0], cl.movement_velocity);
@@ -1642,6 +1688,15 @@ void CL_ClientMovement_Replay(void)
 		for (i = 0;i < CL_MAX_USERCMDS;i++)
 			if (cl.movecmd[i].sequence <= cls.servermovesequence)
 				break;
+		// if the server still agrees with what we predicted for the move it
+		// last acknowledged, continue from that prediction and reuse the
+		// results of every later move that has not changed since it was
+		// simulated; as soon as one move has to be simulated again all
+		// following moves have to be as well
+		c = CL_ClientMovement_CacheMatchesServer(s.origin, s.velocity);
+		cached = c != NULL;
+		if (cached)
+			s = c->state;
 		// now walk them in oldest to newest order
 		for (i--;i >= 0;i--)
 		{
@@ -1649,7 +1704,22 @@ void CL_ClientMovement_Replay(void)
 			if (i < CL_MAX_USERCMDS - 1)
 				s.cmd.canjump = cl.movecmd[i+1].canjump;
 
-			CL_ClientMovement_PlayerMove_Frame(&s);
+			// cl.movecmd[0] is still accumulating input and is never cached
+			c = &cl_movement_cache[cl.movecmd[i].sequence % CL_MAX_USERCMDS];
+			if (cached && i > 0 && c->sequence == cl.movecmd[i].sequence && !memcmp(&c->cmd, &s.cmd, sizeof(s.cmd)))
+				s = c->state;
+			else
+			{
+				cached = false;
+				if (i > 0)
+					c->cmd = s.cmd;
+				CL_ClientMovement_PlayerMove_Frame(&s);
+				if (i > 0)
+				{
+					c->sequence = cl.movecmd[i].sequence;
+					c->state = s;
+				}
+			}
 
 			cl.movecmd[i].canjump = s.cmd.canjump;
 		}
@@ -1760,6 +1830,8 @@ void CL_RotateMoves(const matrix4x4_t *m)
 			AnglesFromVectors(c->viewangles, f, u, false);
 		}
 	}
+	// the predicted results no longer match the rotated moves
+	CL_ClientMovement_ClearCache();
 }
 
 /*
@@ -2281,6 +2353,8 @@ void CL_InitInput (void)
 	Cvar_RegisterVariable(&cl_movecliptokeyboard);
 	Cvar_RegisterVariable(&cl_movement);
 	Cvar_RegisterVariable(&cl_movement_replay);
+	Cvar_RegisterVariable(&cl_movement_replay_incremental);
+	Cvar_RegisterVariable(&cl_movement_replay_tolerance);
 	Cvar_RegisterVariable(&cl_movement_nettimeout);
 	Cvar_RegisterVariable(&cl_movement_minping);
 	Cvar_RegisterVariable(&cl_movement_track_canjump);
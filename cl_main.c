@@ -132,6 +132,8 @@ void CL_ClearState(void)
 // wipe the entire cl structure
 	Mem_EmptyPool(cls.levelmempool);
 	memset (&cl, 0, sizeof(cl));
+	// the cached predictions belong to the old connection's move sequences
+	CL_ClientMovement_ClearCache();
 
 	S_StopAllSounds();
 
@@ -2990,6 +2992,7 @@ void CL_Init (void)
 	if (cls.state == ca_dedicated)
 	{
 		Cmd_AddCommand(CF_SERVER, "disconnect", CL_Disconnect_f, "disconnect from server (or disconnect all clients if running a server)");
+		Cmd_AddCommand(CF_SERVER, "draw2d_benchmark", DrawQ_Benchmark_f, "time recording a synthetic HUD of fills, pics and strings into the 2D batches without drawing it (optional parameters: widgets, frames)");
 	}
 	else
 	{
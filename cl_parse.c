@@ -494,14 +494,14 @@ static void CL_SetupWorldModel(void)
 		Cvar_SetQuick(&cl_worldname, cl.worldname);
 		Cvar_SetQuick(&cl_worldnamenoextension, cl.worldnamenoextension);
 		Cvar_SetQuick(&cl_worldbasename, cl.worldbasename);
-		World_SetSize(&cl.world, cl.worldname, cl.worldmodel->normalmins, cl.worldmodel->normalmaxs, prog);
+		World_SetSize(&cl.world, cl.worldname, cl.worldmodel->normalmins, cl.worldmodel->normalmaxs, prog, sv_areagrid_tree.integer != 0);
 	}
 	else
 	{
 		Cvar_SetQuick(&cl_worldmessage, cl.worldmessage);
 		Cvar_SetQuick(&cl_worldnamenoextension, "");
 		Cvar_SetQuick(&cl_worldbasename, "");
-		World_SetSize(&cl.world, "", defaultmins, defaultmaxs, prog);
+		World_SetSize(&cl.world, "", defaultmins, defaultmaxs, prog, sv_areagrid_tree.integer != 0);
 	}
 	World_Start(&cl.world);
 
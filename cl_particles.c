@@ -299,6 +299,8 @@ cvar_t cl_particles_sparks = {CF_CLIENT | CF_ARCHIVE, "cl_particles_sparks", "1"
 cvar_t cl_particles_bubbles = {CF_CLIENT | CF_ARCHIVE, "cl_particles_bubbles", "1", "enables bubbles (used by multiple effects)"};
 cvar_t cl_particles_visculling = {CF_CLIENT | CF_ARCHIVE, "cl_particles_visculling", "0", "perform a costly check if each particle is visible before drawing"};
 cvar_t cl_particles_collisions = {CF_CLIENT | CF_ARCHIVE, "cl_particles_collisions", "1", "allow costly collision detection on particles (sparks that bounce, particles not going through walls, blood hitting surfaces, etc)"};
+cvar_t cl_particles_collisions_grid = {CF_CLIENT | CF_ARCHIVE, "cl_particles_collisions_grid", "64", "size of the cells of a coarse grid of the world that lets particles far from any brush or liquid skip their collision checks, 0 disables"};
+cvar_t cl_particles_threaded = {CF_CLIENT | CF_ARCHIVE, "cl_particles_threaded", "1", "update particles that do not need collision checks using taskqueue_maxthreads"};
 cvar_t cl_particles_forcetraileffects = {CF_CLIENT, "cl_particles_forcetraileffects", "0", "force trails to be displayed even if a non-trail draw primitive was used (debug/compat feature)"};
 cvar_t cl_decals = {CF_CLIENT | CF_ARCHIVE, "cl_decals", "1", "enables decals (bullet holes, blood, etc)"};
 cvar_t cl_decals_time = {CF_CLIENT | CF_ARCHIVE, "cl_decals_time", "20", "how long before decals start to fade away"};
@@ -611,6 +613,8 @@ void CL_Particles_Init (void)
 	Cvar_RegisterVariable (&cl_particles_bubbles);
 	Cvar_RegisterVariable (&cl_particles_visculling);
 	Cvar_RegisterVariable (&cl_particles_collisions);
+	Cvar_RegisterVariable (&cl_particles_collisions_grid);
+	Cvar_RegisterVariable (&cl_particles_threaded);
 	Cvar_RegisterVariable (&cl_particles_forcetraileffects);
 	Cvar_RegisterVariable (&cl_decals);
 	Cvar_RegisterVariable (&cl_decals_time);
@@ -2584,13 +2588,17 @@ static void r_part_start(void)
 	CL_Particles_LoadEffectInfo(NULL);
 }
 
+static void R_DrawParticles_FreeGrid(void);
+
 static void r_part_shutdown(void)
 {
+	R_DrawParticles_FreeGrid();
 	R_FreeTexturePool(&particletexturepool);
 }
 
 static void r_part_newmap(void)
 {
+	R_DrawParticles_FreeGrid();
 	if (decalskinframe)
 		R_SkinFrame_MarkUsed(decalskinframe);
 	CL_Particles_LoadEffectInfo(NULL);
@@ -2904,6 +2912,452 @@ static void R_DrawParticle_TransparentCallback(const entity_render_t *ent, const
 	}
 }
 
+#define PARTICLEGRID_UNKNOWN 0
+#define PARTICLEGRID_EMPTY 1
+#define PARTICLEGRID_OCCUPIED 2
+#define PARTICLEGRID_MAXCELLS (1<<22)
+#define PARTICLEGRID_MAXQUERYCELLS 27
+
+// coarse grid of the world model, a cell is empty if no brush, liquid or
+// other contents of the world are within a unit of it, cells are classified
+// the first time a particle needs them and stay valid until the next map
+static struct particlegrid_s
+{
+	model_t *model;
+	float requestedcellsize;
+	float cellsize;
+	float icellsize;
+	vec3_t mins;
+	int size[3];
+	unsigned char *cells;
+}
+particlegrid;
+
+static void R_DrawParticles_FreeGrid(void)
+{
+	if (particlegrid.cells)
+		Mem_Free(particlegrid.cells);
+	memset(&particlegrid, 0, sizeof(particlegrid));
+}
+
+static void R_DrawParticles_SetupGrid(void)
+{
+	int i;
+	model_t *model = cl.worldmodel;
+	float cellsize = cl_particles_collisions_grid.value;
+
+	if (!model || cellsize <= 0 || !model->brush.data_nodes || (model->type != mod_brushq1 && model->type != mod_brushq3))
+	{
+		R_DrawParticles_FreeGrid();
+		return;
+	}
+	if (particlegrid.cells && particlegrid.model == model && particlegrid.requestedcellsize == cellsize)
+		return;
+
+	R_DrawParticles_FreeGrid();
+	particlegrid.model = model;
+	particlegrid.requestedcellsize = cellsize;
+	// huge maps get bigger cells rather than a huge grid
+	cellsize = max(cellsize, 8);
+	for (;;)
+	{
+		for (i = 0;i < 3;i++)
+			particlegrid.size[i] = (int)ceil((model->normalmaxs[i] - model->normalmins[i]) / cellsize) + 1;
+		if ((double)particlegrid.size[0] * particlegrid.size[1] * particlegrid.size[2] <= PARTICLEGRID_MAXCELLS)
+			break;
+		cellsize *= 2;
+	}
+	particlegrid.cellsize = cellsize;
+	particlegrid.icellsize = 1.0f / cellsize;
+	VectorCopy(model->normalmins, particlegrid.mins);
+	particlegrid.cells = (unsigned char *)Mem_Alloc(r_main_mempool, particlegrid.size[0] * particlegrid.size[1] * particlegrid.size[2]);
+}
+
+static qbool R_DrawParticles_GridBoxOccupied_r(mnode_t *node, const vec3_t mins, const vec3_t maxs)
+{
+	int sides;
+	qbool q1bsp = particlegrid.model->type == mod_brushq1;
+
+	for (;;)
+	{
+		// q3bsp nodes know what their brushes and patches contain
+		if (!q1bsp && !node->combinedsupercontents)
+			return false;
+		if (!node->plane)
+			break;
+		sides = BoxOnPlaneSide(mins, maxs, node->plane);
+		if (sides == 3)
+		{
+			if (R_DrawParticles_GridBoxOccupied_r(node->children[0], mins, maxs))
+				return true;
+			node = node->children[1];
+		}
+		else
+			node = node->children[sides - 1];
+	}
+	// q1bsp leafs are either empty or entirely solid, liquid or sky
+	return !q1bsp || ((mleaf_t *)node)->contents != CONTENTS_EMPTY;
+}
+
+static unsigned char R_DrawParticles_GridClassifyCell(int x, int y, int z)
+{
+	vec3_t mins, maxs;
+	model_t *model = particlegrid.model;
+	mnode_t *root = model->brush.data_nodes;
+
+	if (model->type == mod_brushq1)
+		root += model->brushq1.hulls[0].firstclipnode;
+	mins[0] = particlegrid.mins[0] + x * particlegrid.cellsize - 1;
+	mins[1] = particlegrid.mins[1] + y * particlegrid.cellsize - 1;
+	mins[2] = particlegrid.mins[2] + z * particlegrid.cellsize - 1;
+	maxs[0] = mins[0] + particlegrid.cellsize + 2;
+	maxs[1] = mins[1] + particlegrid.cellsize + 2;
+	maxs[2] = mins[2] + particlegrid.cellsize + 2;
+	return R_DrawParticles_GridBoxOccupied_r(root, mins, maxs) ? PARTICLEGRID_OCCUPIED : PARTICLEGRID_EMPTY;
+}
+
+/*
+===============
+R_DrawParticles_GridBoxIsEmpty
+
+returns true if neither the world nor a network brush model can touch the
+box, so a collision trace or contents check inside it would find nothing.
+Unknown cells fail the test unless classify is set, which only the main
+thread may do.
+===============
+*/
+static qbool R_DrawParticles_GridBoxIsEmpty(const vec3_t mins, const vec3_t maxs, qbool classify)
+{
+	int i, x, y, z, c[6];
+	float f[6];
+	unsigned char *cell;
+	entity_render_t *ent;
+
+	for (i = 0;i < 3;i++)
+	{
+		f[i] = (mins[i] - particlegrid.mins[i]) * particlegrid.icellsize;
+		f[i+3] = (maxs[i] - particlegrid.mins[i]) * particlegrid.icellsize;
+		// this also rejects NaN
+		if (!(f[i] >= 0 && f[i+3] < particlegrid.size[i]))
+			return false;
+		c[i] = (int)f[i];
+		c[i+3] = (int)f[i+3];
+	}
+	if ((c[3] - c[0] + 1) * (c[4] - c[1] + 1) * (c[5] - c[2] + 1) > PARTICLEGRID_MAXQUERYCELLS)
+		return false;
+	for (z = c[2];z <= c[5];z++)
+	{
+		for (y = c[1];y <= c[4];y++)
+		{
+			cell = particlegrid.cells + (z * particlegrid.size[1] + y) * particlegrid.size[0];
+			for (x = c[0];x <= c[3];x++)
+			{
+				if (cell[x] == PARTICLEGRID_UNKNOWN)
+				{
+					if (!classify)
+						return false;
+					cell[x] = R_DrawParticles_GridClassifyCell(x, y, z);
+				}
+				if (cell[x] != PARTICLEGRID_EMPTY)
+					return false;
+			}
+		}
+	}
+	// doors, plats and other brush models move, so they are not in the grid
+	for (i = 0;i < cl.num_brushmodel_entities;i++)
+	{
+		ent = &cl.entities[cl.brushmodel_entities[i]].render;
+		if (BoxesOverlap(mins, maxs, ent->mins, ent->maxs))
+			return false;
+	}
+	return true;
+}
+
+#define PARTICLEUPDATE_PERTASK 2048
+#define PARTICLEUPDATE_MAXTASKS 64
+
+// what R_DrawParticles_UpdateParticle did with each particle
+typedef enum particleupdate_e
+{
+	PARTICLEUPDATE_SERIAL, ///< free, killed or needs world queries, left to R_DrawParticles
+	PARTICLEUPDATE_ALIVE, ///< updated, only needs to be drawn
+	PARTICLEUPDATE_DELAYED ///< not spawned yet
+}
+particleupdate_t;
+
+static struct particleupdate_s
+{
+	float frametime;
+	float gravity;
+	float pt_explode_frame_interval;
+	float pt_explode2_frame_interval;
+	float extend;
+	qbool collisions;
+	int numparticles;
+	unsigned char *state;
+	// filled by R_DrawParticles_PrepareCollisions for the serial update
+	int *contents; ///< CL_PointSuperContents of the particle origin, or -1
+	int *traceindex; ///< index of the particle in traces, or -1
+	int numtraces;
+	vec3_t *tracestarts;
+	vec3_t *traceends;
+	trace_t *traces;
+	int *tracehitents;
+	taskqueue_task_t tasks[PARTICLEUPDATE_MAXTASKS];
+	taskqueue_task_t done_task;
+}
+particleupdate;
+
+/*
+===============
+R_DrawParticles_UpdateParticle
+
+the part of the R_DrawParticles update that needs no collision checks or
+other world queries (and no random numbers, so the sequence stays the same),
+particles that would query the world are only updated here when the grid
+says there is nothing to find, can run on any thread unless classify is set
+
+this works on particle_t in place, there is no structure of arrays copy or
+SIMD kernel: CL_NewParticle and the CSQC particle builtins hand out particle_t
+pointers, and every particle branches on its type and orientation here
+===============
+*/
+static particleupdate_t R_DrawParticles_UpdateParticle(particle_t *p, qbool classify)
+{
+	int i, color;
+	float f, frametime = particleupdate.frametime;
+	float size, alpha;
+	vec3_t vel, org, mins, maxs;
+	qbool move, worldcheck;
+
+	if (!p->typeindex)
+		return PARTICLEUPDATE_SERIAL;
+	if (p->delayedspawn > cl.time)
+		return PARTICLEUPDATE_DELAYED;
+	if (p->typeindex == pt_snow)
+		return PARTICLEUPDATE_SERIAL;
+	move = p->orientation != PARTICLE_VBEAM && p->orientation != PARTICLE_HBEAM && frametime > 0;
+	worldcheck = p->typeindex == pt_blood || p->typeindex == pt_bubble || p->typeindex == pt_rain || (move && particleupdate.collisions && (p->liquidfriction || p->bounce));
+	if (worldcheck && !particlegrid.cells)
+		return PARTICLEUPDATE_SERIAL;
+
+	size = p->size + p->sizeincrease * frametime;
+	alpha = p->alpha - p->alphafade * frametime;
+
+	if (alpha <= 0 || p->die <= cl.time)
+		goto killparticle;
+
+	VectorCopy(p->vel, vel);
+	VectorCopy(p->org, org);
+	if (move)
+	{
+		vel[2] -= p->gravity * particleupdate.gravity;
+		if (p->airfriction)
+		{
+			f = 1.0f - min(p->airfriction * frametime, 1);
+			VectorScale(vel, f, vel);
+		}
+		VectorMA(org, frametime, vel, org);
+	}
+
+	if (worldcheck)
+	{
+		// the liquid check, the collision trace and the contents checks of
+		// the serial update all stay within the box of the move
+		for (i = 0;i < 3;i++)
+		{
+			mins[i] = min(p->org[i], org[i]) - particleupdate.extend;
+			maxs[i] = max(p->org[i], org[i]) + particleupdate.extend;
+		}
+		if (!R_DrawParticles_GridBoxIsEmpty(mins, maxs, classify))
+			return PARTICLEUPDATE_SERIAL;
+		// bubbles only live in water
+		if (p->typeindex == pt_bubble)
+			goto killparticle;
+	}
+
+	p->size = size;
+	p->alpha = alpha;
+	VectorCopy(vel, p->vel);
+	VectorCopy(org, p->org);
+
+	if (move && VectorLength2(p->vel) < 0.03)
+	{
+		if(p->orientation == PARTICLE_SPARK) // sparks are virtually invisible if very slow, so rather let them go off
+			goto killparticle;
+		VectorClear(p->vel);
+	}
+
+	switch (p->typeindex)
+	{
+	case pt_entityparticle:
+		// particle that removes itself after one rendered frame
+		if (p->time2)
+			goto killparticle;
+		else
+			p->time2 = 1;
+		break;
+	case pt_explode:
+		// Progress the particle colour up the ramp
+		p->time2 += particleupdate.pt_explode_frame_interval;
+		if (p->time2 >= 8)
+			p->die = -1;
+		else
+		{
+			color = particlepalette[ramp1[(int)p->time2]];
+			p->color[0] = color >> 16;
+			p->color[1] = color >>  8;
+			p->color[2] = color >>  0;
+		}
+		break;
+	case pt_explode2:
+		// Progress the particle colour up the ramp
+		p->time2 += particleupdate.pt_explode2_frame_interval;
+		if (p->time2 >= 8)
+			p->die = -1;
+		else
+		{
+			color = particlepalette[ramp2[(int)p->time2]];
+			p->color[0] = color >> 16;
+			p->color[1] = color >>  8;
+			p->color[2] = color >>  0;
+		}
+		break;
+	default:
+		break;
+	}
+	return PARTICLEUPDATE_ALIVE;
+
+killparticle:
+	// R_DrawParticles sees the free slot and updates cl.free_particle
+	p->typeindex = 0;
+	return PARTICLEUPDATE_SERIAL;
+}
+
+static void R_DrawParticles_UpdateTask(taskqueue_task_t *t)
+{
+	int i;
+	int end = (int)t->i[1];
+	for (i = (int)t->i[0];i < end;i++)
+		particleupdate.state[i] = R_DrawParticles_UpdateParticle(cl.particles + i, false);
+	t->done = 1;
+}
+
+/*
+===============
+R_DrawParticles_UpdateThreaded
+
+runs R_DrawParticles_UpdateParticle on all current particles using the
+taskqueue, particles it can not handle are updated by R_DrawParticles as usual
+===============
+*/
+static void R_DrawParticles_UpdateThreaded(void)
+{
+	int i, numtasks, pertask;
+
+	if (!cl_particles_threaded.integer || cl.num_particles <= PARTICLEUPDATE_PERTASK)
+	{
+		TaskQueue_Setup(particleupdate.tasks, NULL, R_DrawParticles_UpdateTask, 0, cl.num_particles, NULL, NULL);
+		R_DrawParticles_UpdateTask(particleupdate.tasks);
+		return;
+	}
+	pertask = max(PARTICLEUPDATE_PERTASK, (cl.num_particles + PARTICLEUPDATE_MAXTASKS - 1) / PARTICLEUPDATE_MAXTASKS);
+	for (i = 0, numtasks = 0;i < cl.num_particles;i += pertask, numtasks++)
+		TaskQueue_Setup(particleupdate.tasks + numtasks, NULL, R_DrawParticles_UpdateTask, i, min(i + pertask, cl.num_particles), NULL, NULL);
+	TaskQueue_Setup(&particleupdate.done_task, NULL, TaskQueue_Task_CheckTasksDone, numtasks, 0, particleupdate.tasks, NULL);
+	TaskQueue_Enqueue(numtasks, particleupdate.tasks);
+	TaskQueue_Enqueue(1, &particleupdate.done_task);
+	TaskQueue_WaitForTaskDone(&particleupdate.done_task);
+}
+
+/*
+===============
+R_DrawParticles_PrepareCollisions
+
+gives the particles left to the serial update a second chance with the grid
+(classifying the cells they need), then predicts the moves of the bouncing
+ones exactly like the serial update will and traces them all as one batch,
+the serial update takes these results when its move matches the prediction
+===============
+*/
+static void R_DrawParticles_PrepareCollisions(void)
+{
+	int i;
+	float f, frametime = particleupdate.frametime;
+	vec3_t vel;
+	particle_t *p;
+
+	particleupdate.contents = (int *)R_FrameData_Alloc(particleupdate.numparticles * sizeof(int));
+	particleupdate.traceindex = (int *)R_FrameData_Alloc(particleupdate.numparticles * sizeof(int));
+	particleupdate.tracestarts = (vec3_t *)R_FrameData_Alloc(particleupdate.numparticles * sizeof(vec3_t));
+	particleupdate.traceends = (vec3_t *)R_FrameData_Alloc(particleupdate.numparticles * sizeof(vec3_t));
+	particleupdate.numtraces = 0;
+	for (i = 0, p = cl.particles;i < particleupdate.numparticles;i++, p++)
+	{
+		particleupdate.contents[i] = -1;
+		particleupdate.traceindex[i] = -1;
+		if (particleupdate.state[i] != PARTICLEUPDATE_SERIAL || !p->typeindex)
+			continue;
+		if (particlegrid.cells)
+		{
+			particleupdate.state[i] = R_DrawParticles_UpdateParticle(p, true);
+			if (particleupdate.state[i] != PARTICLEUPDATE_SERIAL || !p->typeindex)
+				continue;
+		}
+		if (!particleupdate.collisions || p->orientation == PARTICLE_VBEAM || p->orientation == PARTICLE_HBEAM || (!p->liquidfriction && !p->bounce))
+			continue;
+		if (p->alpha - p->alphafade * frametime <= 0 || p->die <= cl.time)
+			continue;
+		VectorCopy(p->vel, vel);
+		if (p->liquidfriction && ((particleupdate.contents[i] = CL_PointSuperContents(p->org)) & SUPERCONTENTS_LIQUIDSMASK))
+		{
+			if (p->typeindex != pt_blood)
+				vel[2] -= p->gravity * particleupdate.gravity;
+			f = 1.0f - min(p->liquidfriction * frametime, 1);
+			VectorScale(vel, f, vel);
+		}
+		else
+		{
+			vel[2] -= p->gravity * particleupdate.gravity;
+			if (p->airfriction)
+			{
+				f = 1.0f - min(p->airfriction * frametime, 1);
+				VectorScale(vel, f, vel);
+			}
+		}
+		// rain and snow also hit liquids, they keep tracing one at a time
+		if (!p->bounce || !VectorLength(vel) || p->typeindex == pt_rain || p->typeindex == pt_snow)
+			continue;
+		particleupdate.traceindex[i] = particleupdate.numtraces;
+		VectorCopy(p->org, particleupdate.tracestarts[particleupdate.numtraces]);
+		VectorMA(p->org, frametime, vel, particleupdate.traceends[particleupdate.numtraces]);
+		particleupdate.numtraces++;
+	}
+	if (!particleupdate.numtraces)
+		return;
+	particleupdate.traces = (trace_t *)R_FrameData_Alloc(particleupdate.numtraces * sizeof(trace_t));
+	particleupdate.tracehitents = (int *)R_FrameData_Alloc(particleupdate.numtraces * sizeof(int));
+	CL_TraceLineBatch(particleupdate.numtraces, (const vec3_t *)particleupdate.tracestarts, (const vec3_t *)particleupdate.traceends, MOVE_NORMAL, SUPERCONTENTS_SOLID, 0, 0, collision_extendmovelength.value, true, particleupdate.tracehitents, particleupdate.traces);
+}
+
+static int R_DrawParticles_PointSuperContents(int i, const vec3_t org)
+{
+	if (i < particleupdate.numparticles && particleupdate.contents[i] >= 0)
+		return particleupdate.contents[i];
+	return CL_PointSuperContents(org);
+}
+
+static trace_t R_DrawParticles_TraceLine(int i, const vec3_t start, const vec3_t end, int hitsupercontentsmask, int *hitent)
+{
+	int j;
+	if (i < particleupdate.numparticles && (j = particleupdate.traceindex[i]) >= 0 && hitsupercontentsmask == SUPERCONTENTS_SOLID && VectorCompare(start, particleupdate.tracestarts[j]) && VectorCompare(end, particleupdate.traceends[j]))
+	{
+		*hitent = particleupdate.tracehitents[j];
+		return particleupdate.traces[j];
+	}
+	return CL_TraceLine(start, end, MOVE_NORMAL, NULL, hitsupercontentsmask, 0, 0, collision_extendmovelength.value, true, false, hitent, false, false);
+}
+
 void R_DrawParticles (void)
 {
 	int i, a;
@@ -2935,6 +3389,26 @@ void R_DrawParticles (void)
 	drawdist2 = r_drawparticles_drawdistance.value * r_refdef.view.quality;
 	drawdist2 = drawdist2*drawdist2;
 
+	// update the particles that need no collision checks first, and batch
+	// the collision traces of the rest, a new particle spawned into a free
+	// slot below (by a blood splat for example) is then still updated here
+	// like before
+	particleupdate.numparticles = 0;
+	if (update)
+	{
+		particleupdate.frametime = frametime;
+		particleupdate.gravity = gravity;
+		particleupdate.pt_explode_frame_interval = pt_explode_frame_interval;
+		particleupdate.pt_explode2_frame_interval = pt_explode2_frame_interval;
+		particleupdate.extend = collision_extendmovelength.value + 1;
+		particleupdate.collisions = cl_particles_collisions.integer != 0;
+		particleupdate.numparticles = cl.num_particles;
+		particleupdate.state = (unsigned char *)R_FrameData_Alloc(cl.num_particles);
+		R_DrawParticles_SetupGrid();
+		R_DrawParticles_UpdateThreaded();
+		R_DrawParticles_PrepareCollisions();
+	}
+
 	for (i = 0, p = cl.particles;i < cl.num_particles;i++, p++)
 	{
 		if (!p->typeindex)
@@ -2944,7 +3418,12 @@ void R_DrawParticles (void)
 			continue;
 		}
 
-		if (update)
+		if (update && i < particleupdate.numparticles && particleupdate.state[i] != PARTICLEUPDATE_SERIAL)
+		{
+			if (particleupdate.state[i] == PARTICLEUPDATE_DELAYED)
+				continue;
+		}
+		else if (update)
 		{
 			if (p->delayedspawn > cl.time)
 				continue;
@@ -2957,7 +3436,7 @@ void R_DrawParticles (void)
 
 			if (p->orientation != PARTICLE_VBEAM && p->orientation != PARTICLE_HBEAM && frametime > 0)
 			{
-				if (p->liquidfriction && cl_particles_collisions.integer && (CL_PointSuperContents(p->org) & SUPERCONTENTS_LIQUIDSMASK))
+				if (p->liquidfriction && cl_particles_collisions.integer && (R_DrawParticles_PointSuperContents(i, p->org) & SUPERCONTENTS_LIQUIDSMASK))
 				{
 					if (p->typeindex == pt_blood)
 						p->size += frametime * 8;
@@ -2981,7 +3460,7 @@ void R_DrawParticles (void)
 //				if (p->bounce && cl.time >= p->delayedcollisions)
 				if (p->bounce && cl_particles_collisions.integer && VectorLength(p->vel))
 				{
-					trace = CL_TraceLine(oldorg, p->org, MOVE_NORMAL, NULL, SUPERCONTENTS_SOLID | ((p->typeindex == pt_rain || p->typeindex == pt_snow) ? SUPERCONTENTS_LIQUIDSMASK : 0), 0, 0, collision_extendmovelength.value, true, false, &hitent, false, false);
+					trace = R_DrawParticles_TraceLine(i, oldorg, p->org, SUPERCONTENTS_SOLID | ((p->typeindex == pt_rain || p->typeindex == pt_snow) ? SUPERCONTENTS_LIQUIDSMASK : 0), &hitent);
 					// if the trace started in or hit something of SUPERCONTENTS_NODROP
 					// or if the trace hit something flagged as NOIMPACT
 					// then remove the particle
@@ -226,6 +226,14 @@ typedef struct rtlight_s
 	int bouncegrid_hits;
 	int bouncegrid_traces;
 	float bouncegrid_effectiveradius;
+	/// bouncegrid photons shot from this light in the previous update, these
+	/// are reused while the light does not change (see r_shadow_bouncegrid_dynamic_incremental)
+	unsigned int bouncegrid_cachedupdate;
+	int bouncegrid_cachedfirstphoton;
+	int bouncegrid_cachednumphotons;
+	vec3_t bouncegrid_cachedorigin;
+	vec3_t bouncegrid_cachedcolor;
+	float bouncegrid_cachedradius;
 }
 rtlight_t;
 
@@ -1262,6 +1270,7 @@ void CL_NewBeam (int ent, vec3_t start, vec3_t end, model_t *m, int lightning);
 void CL_RelinkBeams (void);
 void CL_Beam_CalculatePositions (const beam_t *b, vec3_t start, vec3_t end);
 void CL_ClientMovement_Replay(void);
+void CL_ClientMovement_ClearCache(void);
 
 void CL_ClearTempEntities (void);
 entity_render_t *CL_NewTempEntity (double shadertime);
@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "quakedef.h"
 #include "thread.h"
+#include "sv_demo.h"
 
 cmd_state_t *cmd_local;
 cmd_state_t *cmd_serverfromclient;
@@ -183,6 +184,7 @@ static void Cbuf_LinkString(cmd_state_t *cmd, llist_t *head, cmd_input_t *existi
 	if(node != existing)
 	{
 		node->source = cmd;
+		node->fromserverprogs = cbuf->fromserverprogs;
 		List_Move_Tail(&node->list, head);
 	}
 
@@ -321,6 +323,7 @@ static void Cbuf_Execute_Deferred (cmd_buf_t *cbuf)
 {
 	cmd_input_t *current, *n;
 	vec_t eat;
+	qbool oldfromserverprogs;
 
 	if (host.realtime - cbuf->deferred_oldtime < 0 || host.realtime - cbuf->deferred_oldtime > 1800)
 		cbuf->deferred_oldtime = host.realtime;
@@ -334,7 +337,10 @@ static void Cbuf_Execute_Deferred (cmd_buf_t *cbuf)
 		current->delay -= eat;
 		if(current->delay <= 0)
 		{
+			oldfromserverprogs = cbuf->fromserverprogs;
+			cbuf->fromserverprogs = current->fromserverprogs;
 			Cbuf_AddText(current->source, current->text); // parse deferred string and append its cmdstring(s)
+			cbuf->fromserverprogs = oldfromserverprogs;
 			List_Entry(cbuf->start.prev, cmd_input_t, list)->pending = false; // faster than div0-stable's Cbuf_AddText(";\n");
 			List_Move_Tail(&current->list, &cbuf->free); // make deferred string memory available for reuse
 			cbuf->size -= current->length;
@@ -352,6 +358,7 @@ void Cbuf_Execute (cmd_buf_t *cbuf)
 {
 	cmd_input_t *current;
 	unsigned int i = 0;
+	qbool oldfromserverprogs = cbuf->fromserverprogs;
 
 	// LadyHavoc: making sure the tokenizebuffer doesn't get filled up by repeated crashes
 	cbuf->tokenizebufferpos = 0;
@@ -372,7 +379,10 @@ void Cbuf_Execute (cmd_buf_t *cbuf)
 		 */
 		current->pending = false;
 
+		// anything this command queues (aliases, exec, defer) inherits where it came from
+		cbuf->fromserverprogs = current->fromserverprogs;
 		Cmd_PreprocessAndExecuteString(current->source, current->text, current->length, src_local, false);
+		cbuf->fromserverprogs = oldfromserverprogs;
 		cbuf->size -= current->length;
 		// Recycle memory so using WASD doesn't cause a malloc and free
 		List_Move_Tail(&current->list, &cbuf->free);
@@ -426,6 +436,7 @@ void Cbuf_Frame(cmd_buf_t *cbuf)
 	if (cbuf->size)
 	{
 		SV_LockThreadMutex();
+		cbuf->fromserverprogs = false; // a Host_Error may have left it set
 		Cbuf_Execute(cbuf);
 		SV_UnlockThreadMutex();
 	}
@@ -2082,6 +2093,11 @@ void Cmd_ExecuteString(cmd_state_t *cmd, const char *text, size_t textlen, cmd_s
 	if (!Cmd_Argc(cmd))
 		goto done; // no tokens
 
+	// server recordings need the console commands that change server state,
+	// but not the ones the server progs queued as the replay queues them again
+	if (src == src_local && !cmd->cbuf->fromserverprogs)
+		SV_Record_Command(cmd, text);
+
 // check functions
 	for (func = cmd->userdefined->qc_functions; func; func = func->next)
 		if (!strcasecmp(cmd->argv[0], func->name))
@@ -119,6 +119,7 @@ typedef struct cmd_buf_s
 	char tokenizebuffer[CMD_TOKENIZELENGTH];
 	int tokenizebufferpos;
 	double deferred_oldtime;
+	qbool fromserverprogs; ///< text linked now was queued by the server progs
 	void *lock;
 } cmd_buf_t;
 
@@ -161,6 +162,7 @@ typedef struct cmd_input_s
 	size_t length; ///< excludes \0 terminator
 	char *text;
 	qbool pending;
+	qbool fromserverprogs; ///< server recordings leave it out, a replay runs the QC that queues it again
 } cmd_input_t;
 
 extern cmd_userdefined_t cmd_userdefined_all;  ///< aliases and csqc functions
@@ -2,6 +2,9 @@
 #include "quakedef.h"
 #include "polygon.h"
 #include "collision.h"
+#ifdef SSE_PRESENT
+#include <xmmintrin.h>
+#endif
 
 #define COLLISION_EDGEDIR_DOT_EPSILON (0.999f)
 #define COLLISION_EDGECROSS_MINLENGTH2 (1.0f / 4194304.0f)
@@ -16,12 +19,15 @@ cvar_t collision_extendtraceboxlength = {CF_CLIENT | CF_SERVER, "collision_exten
 cvar_t collision_extendtracelinelength = {CF_CLIENT | CF_SERVER, "collision_extendtracelinelength", "1", "internal bias for traceline() qc builtin to account for collision_impactnudge (this does not alter the final trace length)"};
 cvar_t collision_debug_tracelineasbox = {CF_CLIENT | CF_SERVER, "collision_debug_tracelineasbox", "0", "workaround for any bugs in Collision_TraceLineBrushFloat by using Collision_TraceBrushBrushFloat"};
 cvar_t collision_cache = {CF_CLIENT | CF_SERVER, "collision_cache", "1", "store results of collision traces for next frame to reuse if possible (optimization)"};
+cvar_t collision_cache_world = {CF_CLIENT | CF_SERVER, "collision_cache_world", "4096", "how many traces against the world surfaces collision_cache keeps across frames, the least recently used are dropped first (0 = only reuse within a frame)"};
 cvar_t collision_triangle_bevelsides = {CF_CLIENT | CF_SERVER, "collision_triangle_bevelsides", "0", "generate sloped edge planes on triangles - if 0, see axialedgeplanes"};
 cvar_t collision_triangle_axialsides = {CF_CLIENT | CF_SERVER, "collision_triangle_axialsides", "1", "generate axially-aligned edge planes on triangles - otherwise use perpendicular edge planes"};
 cvar_t collision_bih_fullrecursion = {CF_CLIENT | CF_SERVER, "collision_bih_fullrecursion", "0", "debugging option to disable the bih recursion optimizations by iterating the entire tree"};
 
 mempool_t *collision_mempool;
 
+static void Collision_Cache_Stats_f(cmd_state_t *cmd);
+
 void Collision_Init (void)
 {
 	Cvar_RegisterVariable(&collision_impactnudge);
@@ -30,11 +36,13 @@ void Collision_Init (void)
 	Cvar_RegisterVariable(&collision_extendtraceboxlength);
 	Cvar_RegisterVariable(&collision_debug_tracelineasbox);
 	Cvar_RegisterVariable(&collision_cache);
+	Cvar_RegisterVariable(&collision_cache_world);
 	Cvar_RegisterVariable(&collision_triangle_bevelsides);
 	Cvar_RegisterVariable(&collision_triangle_axialsides);
 	Cvar_RegisterVariable(&collision_bih_fullrecursion);
 	collision_mempool = Mem_AllocPool("collision cache", 0, NULL);
 	Collision_Cache_Init(collision_mempool);
+	Cmd_AddCommand(CF_SHARED, "collision_cache_stats", Collision_Cache_Stats_f, "prints hit rate of the persistent world trace cache (collision_cache_world)");
 }
 
 
@@ -1477,6 +1485,154 @@ static unsigned int *collision_cachedtrace_arraynext;
 static unsigned char *collision_cachedtrace_arrayused;
 static qbool collision_cachedtrace_rebuildhash;
 
+/*
+the world surfaces never change while a map is loaded, so traces against them
+are also kept across frames in a second cache, bounded by
+collision_cache_world and emptied by Collision_Cache_Reset(true) on map changes
+*/
+typedef struct collision_worldtrace_s
+{
+	model_t *model;
+	vec3_t start;
+	vec3_t end;
+	int hitsupercontentsmask;
+	int skipsupercontentsmask;
+	int skipmaterialflagsmask;
+	float extend;
+	unsigned int fullhashindex;
+	// hash chain and least recently used list, index 0 is the list head
+	int hashnext;
+	int lruprev;
+	int lrunext;
+	trace_t result;
+}
+collision_worldtrace_t;
+
+static collision_worldtrace_t *collision_worldtrace_array;
+static int collision_worldtrace_max;
+static int collision_worldtrace_num;
+static int collision_worldtrace_hashsize;
+static int *collision_worldtrace_hash;
+static unsigned int collision_worldtrace_hits;
+static unsigned int collision_worldtrace_misses;
+static unsigned int collision_worldtrace_evictions;
+
+static void Collision_Cache_World_Reset(void)
+{
+	if (collision_worldtrace_array)
+		Mem_Free(collision_worldtrace_array);
+	if (collision_worldtrace_hash)
+		Mem_Free(collision_worldtrace_hash);
+	collision_worldtrace_array = NULL;
+	collision_worldtrace_hash = NULL;
+	collision_worldtrace_max = 0;
+	collision_worldtrace_num = 0;
+	collision_worldtrace_hashsize = 0;
+}
+
+static void Collision_Cache_Stats_f(cmd_state_t *cmd)
+{
+	unsigned int total = collision_worldtrace_hits + collision_worldtrace_misses;
+	Con_Printf("world trace cache: %i of %i entries used, %u hits %u misses (%.1f%% hit rate), %u evictions\n", collision_worldtrace_num, collision_worldtrace_max, collision_worldtrace_hits, collision_worldtrace_misses, total ? 100.0 * collision_worldtrace_hits / total : 0.0, collision_worldtrace_evictions);
+	if (Cmd_Argc(cmd) > 1 && !strcmp(Cmd_Argv(cmd, 1), "reset"))
+		collision_worldtrace_hits = collision_worldtrace_misses = collision_worldtrace_evictions = 0;
+}
+
+static void Collision_Cache_World_Unlink(int index)
+{
+	collision_worldtrace_t *array = collision_worldtrace_array;
+	array[array[index].lruprev].lrunext = array[index].lrunext;
+	array[array[index].lrunext].lruprev = array[index].lruprev;
+}
+
+static void Collision_Cache_World_LinkFront(int index)
+{
+	collision_worldtrace_t *array = collision_worldtrace_array;
+	array[index].lruprev = 0;
+	array[index].lrunext = array[0].lrunext;
+	array[array[0].lrunext].lruprev = index;
+	array[0].lrunext = index;
+}
+
+/*
+returns the cached result of the trace, or NULL after setting *newentry to
+the entry the result should be stored in (which may be NULL if the cache is
+disabled)
+*/
+static const trace_t *Collision_Cache_World_Lookup(model_t *model, const vec3_t start, const vec3_t end, int hitsupercontentsmask, int skipsupercontentsmask, int skipmaterialflagsmask, float extend, trace_t **newentry)
+{
+	collision_worldtrace_t *array, *entry;
+	unsigned int fullhashindex;
+	int index, *link, max = min(collision_cache_world.integer, 1 << 20);
+
+	*newentry = NULL;
+	if (max < 1)
+	{
+		if (collision_worldtrace_array)
+			Collision_Cache_World_Reset();
+		return NULL;
+	}
+	if (collision_worldtrace_max != max)
+	{
+		// (re)allocate, the hash has about twice as many buckets as entries
+		Collision_Cache_World_Reset();
+		collision_worldtrace_max = max;
+		for (collision_worldtrace_hashsize = 64;collision_worldtrace_hashsize < max * 2;collision_worldtrace_hashsize *= 2)
+			;
+		collision_worldtrace_array = (collision_worldtrace_t *)Mem_Alloc(collision_cachedtrace_mempool, (max + 1) * sizeof(collision_worldtrace_t));
+		collision_worldtrace_hash = (int *)Mem_Alloc(collision_cachedtrace_mempool, collision_worldtrace_hashsize * sizeof(int));
+	}
+	array = collision_worldtrace_array;
+
+	fullhashindex = CRC_Block((const unsigned char *)start, sizeof(vec3_t)) ^ (CRC_Block((const unsigned char *)end, sizeof(vec3_t)) << 16);
+	fullhashindex += hitsupercontentsmask * 3 + skipsupercontentsmask * 5 + skipmaterialflagsmask * 7;
+	for (index = collision_worldtrace_hash[fullhashindex & (collision_worldtrace_hashsize - 1)];index;index = array[index].hashnext)
+	{
+		entry = array + index;
+		if (entry->fullhashindex != fullhashindex
+		 || entry->model != model
+		 || !VectorCompare(entry->start, start)
+		 || !VectorCompare(entry->end, end)
+		 || entry->hitsupercontentsmask != hitsupercontentsmask
+		 || entry->skipsupercontentsmask != skipsupercontentsmask
+		 || entry->skipmaterialflagsmask != skipmaterialflagsmask
+		 || entry->extend != extend)
+			continue;
+		collision_worldtrace_hits++;
+		Collision_Cache_World_Unlink(index);
+		Collision_Cache_World_LinkFront(index);
+		return &entry->result;
+	}
+	collision_worldtrace_misses++;
+
+	if (collision_worldtrace_num < collision_worldtrace_max)
+		index = ++collision_worldtrace_num;
+	else
+	{
+		// reuse the least recently used entry
+		index = array[0].lruprev;
+		collision_worldtrace_evictions++;
+		Collision_Cache_World_Unlink(index);
+		for (link = &collision_worldtrace_hash[array[index].fullhashindex & (collision_worldtrace_hashsize - 1)];*link != index;link = &array[*link].hashnext)
+			;
+		*link = array[index].hashnext;
+	}
+	entry = array + index;
+	entry->model = model;
+	VectorCopy(start, entry->start);
+	VectorCopy(end, entry->end);
+	entry->hitsupercontentsmask = hitsupercontentsmask;
+	entry->skipsupercontentsmask = skipsupercontentsmask;
+	entry->skipmaterialflagsmask = skipmaterialflagsmask;
+	entry->extend = extend;
+	entry->fullhashindex = fullhashindex;
+	entry->hashnext = collision_worldtrace_hash[fullhashindex & (collision_worldtrace_hashsize - 1)];
+	collision_worldtrace_hash[fullhashindex & (collision_worldtrace_hashsize - 1)] = index;
+	Collision_Cache_World_LinkFront(index);
+	*newentry = &entry->result;
+	return NULL;
+}
+
 void Collision_Cache_Reset(qbool resetlimits)
 {
 	if (collision_cachedtrace_hash)
@@ -1504,6 +1660,9 @@ void Collision_Cache_Reset(qbool resetlimits)
 	collision_cachedtrace_arrayused = (unsigned char *)Mem_Alloc(collision_cachedtrace_mempool, collision_cachedtrace_max * sizeof(unsigned char));
 	collision_cachedtrace_sequence = 1;
 	collision_cachedtrace_rebuildhash = false;
+	// growing the per frame cache keeps the world traces
+	if (resetlimits)
+		Collision_Cache_World_Reset();
 }
 
 void Collision_Cache_Init(mempool_t *mempool)
@@ -1704,6 +1863,8 @@ void Collision_Cache_ClipLineToGenericEntitySurfaces(trace_t *trace, model_t *mo
 
 void Collision_Cache_ClipLineToWorldSurfaces(trace_t *trace, model_t *model, const vec3_t start, const vec3_t end, int hitsupercontentsmask, int skipsupercontentsmask, int skipmaterialflagsmask)
 {
+	const trace_t *worldcached;
+	trace_t *worldentry = NULL;
 	collision_cachedtrace_t *cached = Collision_Cache_Lookup(model, &identitymatrix, &identitymatrix, start, end, hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask);
 	if (cached->valid)
 	{
@@ -1711,9 +1872,23 @@ void Collision_Cache_ClipLineToWorldSurfaces(trace_t *trace, model_t *model, con
 		return;
 	}
 
+	// try the traces kept from earlier frames
+	if (collision_cache.integer)
+	{
+		worldcached = Collision_Cache_World_Lookup(model, start, end, hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask, collision_extendmovelength.value, &worldentry);
+		if (worldcached)
+		{
+			*trace = *worldcached;
+			cached->result = *trace;
+			return;
+		}
+	}
+
 	Collision_ClipLineToWorld(trace, model, start, end, hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask, collision_extendmovelength.value, true);
 
 	cached->result = *trace;
+	if (worldentry)
+		*worldentry = *trace;
 }
 
 typedef struct extendtraceinfo_s
@@ -1880,6 +2055,34 @@ void Collision_ClipLineToWorld(trace_t *trace, model_t *model, const vec3_t tsta
 	Collision_ClipExtendFinish(&extendtraceinfo);
 }
 
+void Collision_ClipLinesToWorld(int numlines, trace_t *traces, model_t *model, const vec3_t *tstarts, const vec3_t *tends, int hitsupercontentsmask, int skipsupercontentsmask, int skipmaterialflagsmask, float extend)
+{
+	extendtraceinfo_t extendtraceinfo[64];
+	vec3_t starts[64], ends[64];
+	int i, n;
+
+	if (!model || !model->TraceLines)
+	{
+		for (i = 0;i < numlines;i++)
+			Collision_ClipLineToWorld(traces + i, model, tstarts[i], tends[i], hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask, extend, false);
+		return;
+	}
+
+	for (;numlines > 0;numlines -= n, traces += n, tstarts += n, tends += n)
+	{
+		n = min(numlines, 64);
+		for (i = 0;i < n;i++)
+		{
+			Collision_ClipExtendPrepare(extendtraceinfo + i, traces + i, tstarts[i], tends[i], extend);
+			VectorCopy(extendtraceinfo[i].extendstart, starts[i]);
+			VectorCopy(extendtraceinfo[i].extendend, ends[i]);
+		}
+		model->TraceLines(model, n, traces, (const vec3_t *)starts, (const vec3_t *)ends, hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask);
+		for (i = 0;i < n;i++)
+			Collision_ClipExtendFinish(extendtraceinfo + i);
+	}
+}
+
 void Collision_ClipPointToGenericEntity(trace_t *trace, model_t *model, const frameblend_t *frameblend, const skeleton_t *skeleton, const vec3_t bodymins, const vec3_t bodymaxs, int bodysupercontents, matrix4x4_t *matrix, matrix4x4_t *inversematrix, const vec3_t start, int hitsupercontentsmask, int skipsupercontentsmask, int skipmaterialflagsmask)
 {
 	float starttransformed[3];
@@ -1948,3 +2151,46 @@ void Collision_CombineTraces(trace_t *cliptrace, const trace_t *trace, void *tou
 	}
 	cliptrace->startsupercontents |= trace->startsupercontents;
 }
+
+/*
+==================
+Collision_BoxListOverlap
+
+Tests one box against a list of boxes stored as six float arrays (minx, miny,
+minz, maxx, maxy, maxz), each stride floats apart, and writes the indices of
+the boxes that overlap (with the same inclusive test as BoxesOverlap) to
+indices, returns the number of overlapping boxes.  stride must be a multiple
+of 4 and the unused entries up to it must hold empty boxes (mins > maxs).
+==================
+*/
+int Collision_BoxListOverlap(const vec3_t mins, const vec3_t maxs, const float *boxes, int numboxes, int stride, int *indices)
+{
+	int i, numindices = 0;
+#ifdef SSE_PRESENT
+	int bits;
+	__m128 m;
+	__m128 minx = _mm_set1_ps(mins[0]), miny = _mm_set1_ps(mins[1]), minz = _mm_set1_ps(mins[2]);
+	__m128 maxx = _mm_set1_ps(maxs[0]), maxy = _mm_set1_ps(maxs[1]), maxz = _mm_set1_ps(maxs[2]);
+	for (i = 0;i < numboxes;i += 4)
+	{
+		m =            _mm_cmple_ps(minx, _mm_loadu_ps(boxes + 3 * stride + i));
+		m = _mm_and_ps(_mm_cmpge_ps(maxx, _mm_loadu_ps(boxes + 0 * stride + i)), m);
+		m = _mm_and_ps(_mm_cmple_ps(miny, _mm_loadu_ps(boxes + 4 * stride + i)), m);
+		m = _mm_and_ps(_mm_cmpge_ps(maxy, _mm_loadu_ps(boxes + 1 * stride + i)), m);
+		m = _mm_and_ps(_mm_cmple_ps(minz, _mm_loadu_ps(boxes + 5 * stride + i)), m);
+		m = _mm_and_ps(_mm_cmpge_ps(maxz, _mm_loadu_ps(boxes + 2 * stride + i)), m);
+		for (bits = _mm_movemask_ps(m);bits;bits &= bits - 1)
+		{
+			// the padding boxes never match, so this stays below numboxes
+			indices[numindices++] = i + (bits & 1 ? 0 : bits & 2 ? 1 : bits & 4 ? 2 : 3);
+		}
+	}
+#else
+	for (i = 0;i < numboxes;i++)
+		if (mins[0] <= boxes[3 * stride + i] && maxs[0] >= boxes[i]
+		 && mins[1] <= boxes[4 * stride + i] && maxs[1] >= boxes[1 * stride + i]
+		 && mins[2] <= boxes[5 * stride + i] && maxs[2] >= boxes[2 * stride + i])
+			indices[numindices++] = i;
+#endif
+	return numindices;
+}
@@ -177,6 +177,8 @@ void Collision_ClipPointToGenericEntity(trace_t *trace, struct model_s *model, c
 // like above but does not do a transform and does nothing if model is NULL
 void Collision_ClipToWorld(trace_t *trace, struct model_s *model, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int hitsupercontentsmask, int skipsupercontentsmask, int skipmaterialflagsmask, float extend);
 void Collision_ClipLineToWorld(trace_t *trace, struct model_s *model, const vec3_t start, const vec3_t end, int hitsupercontentsmask, int skipsupercontentsmask, int skipmaterialflagsmask, float extend, qbool hitsurfaces);
+// same as Collision_ClipLineToWorld (without hitsurfaces) for many lines, using the model's TraceLines if it has one
+void Collision_ClipLinesToWorld(int numlines, trace_t *traces, struct model_s *model, const vec3_t *starts, const vec3_t *ends, int hitsupercontentsmask, int skipsupercontentsmask, int skipmaterialflagsmask, float extend);
 void Collision_ClipPointToWorld(trace_t *trace, struct model_s *model, const vec3_t start, int hitsupercontentsmask, int skipsupercontentsmask, int skipmaterialflagsmask);
 // caching surface trace for renderer (NOT THREAD SAFE)
 void Collision_Cache_ClipLineToGenericEntitySurfaces(trace_t *trace, struct model_s *model, matrix4x4_t *matrix, matrix4x4_t *inversematrix, const vec3_t start, const vec3_t end, int hitsupercontentsmask, int skipsupercontentsmask, int skipmaterialflagsmask);
@@ -185,6 +187,8 @@ void Collision_Cache_ClipLineToWorldSurfaces(trace_t *trace, struct model_s *mod
 // merges contents flags, startsolid, allsolid, inwater
 // updates fraction, endpos, plane and surface info if new fraction is shorter
 void Collision_CombineTraces(trace_t *cliptrace, const trace_t *trace, void *touch, qbool isbmodel);
+// tests a box against many boxes at once, see collision.c for the layout
+int Collision_BoxListOverlap(const vec3_t mins, const vec3_t maxs, const float *boxes, int numboxes, int stride, int *indices);
 
 // this enables rather large debugging spew!
 // settings:
@@ -152,6 +152,8 @@ void DrawQ_Finish(void);
 void DrawQ_FlushUI(void);
 // use this when changing r_refdef.view.* from e.g. csqc
 void DrawQ_RecalcView(void);
+// draw2d_benchmark command, also registered by dedicated servers which have no video context
+void DrawQ_Benchmark_f(struct cmd_state_s *cmd);
 
 // draw an image (or a filled rectangle if pic == NULL)
 void DrawQ_Pic(float x, float y, cachepic_t *pic, float width, float height, float red, float green, float blue, float alpha, int flags);
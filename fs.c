@@ -433,6 +433,9 @@ VARIABLES
 
 mempool_t *fs_mempool;
 void *fs_mutex = NULL;
+// the handles of files in a package share their file position, so the seek
+// and read of one file must not interleave with those of another thread
+static void *fs_readmutex = NULL;
 
 searchpath_t *fs_searchpaths = NULL;
 const char *const fs_checkgamedir_missing = "missing";
@@ -909,29 +912,41 @@ static qbool PK3_GetTrueFileOffset (packfile_t *pfile, pack_t *pack)
 {
 	unsigned char buffer [ZIP_LOCAL_CHUNK_BASE_SIZE];
 	fs_offset_t count;
+	qbool ok = true;
+
+	// the texture prefetch threads open files too, so the check and the
+	// update of the offset must not be split by another thread doing the same
+	if (fs_readmutex) Thread_LockMutex(fs_readmutex);
 
 	// Already found?
 	if (pfile->flags & PACKFILE_FLAG_TRUEOFFS)
+	{
+		if (fs_readmutex) Thread_UnlockMutex(fs_readmutex);
 		return true;
+	}
 
 	// Load the local file description
 	if (FILEDESC_SEEK (pack->handle, pfile->offset, SEEK_SET) == -1)
 	{
+		if (fs_readmutex) Thread_UnlockMutex(fs_readmutex);
 		Con_Printf ("Can't seek in package %s\n", pack->filename);
 		return false;
 	}
 	count = FILEDESC_READ (pack->handle, buffer, ZIP_LOCAL_CHUNK_BASE_SIZE);
 	if (count != ZIP_LOCAL_CHUNK_BASE_SIZE || BuffBigLong (buffer) != ZIP_DATA_HEADER)
+		ok = false;
+	else
 	{
-		Con_Printf ("Can't retrieve file %s in package %s\n", pfile->name, pack->filename);
-		return false;
-	}
+		// Skip name and extra field
+		pfile->offset += BuffLittleShort (&buffer[26]) + BuffLittleShort (&buffer[28]) + ZIP_LOCAL_CHUNK_BASE_SIZE;
 
-	// Skip name and extra field
-	pfile->offset += BuffLittleShort (&buffer[26]) + BuffLittleShort (&buffer[28]) + ZIP_LOCAL_CHUNK_BASE_SIZE;
+		pfile->flags |= PACKFILE_FLAG_TRUEOFFS;
+	}
+	if (fs_readmutex) Thread_UnlockMutex(fs_readmutex);
 
-	pfile->flags |= PACKFILE_FLAG_TRUEOFFS;
-	return true;
+	if (!ok)
+		Con_Printf ("Can't retrieve file %s in package %s\n", pfile->name, pack->filename);
+	return ok;
 }
 
 
@@ -2288,7 +2303,10 @@ static void FS_Init_Dir (void)
 	FS_Rescan();
 
 	if (Thread_HasThreads())
+	{
 		fs_mutex = Thread_CreateMutex();
+		fs_readmutex = Thread_CreateMutex();
+	}
 }
 
 /*
@@ -2378,6 +2396,9 @@ void FS_Shutdown (void)
 
 	if (fs_mutex)
 		Thread_DestroyMutex(fs_mutex);
+	if (fs_readmutex)
+		Thread_DestroyMutex(fs_readmutex);
+	fs_mutex = fs_readmutex = NULL;
 }
 
 static filedesc_t FS_SysOpenFiledesc(const char *filepath, const char *mode, qbool nonblocking)
@@ -2524,9 +2545,8 @@ static qfile_t *FS_OpenPackedFile (pack_t* pack, int pack_ind)
 	pfile = &pack->files[pack_ind];
 
 	// If we don't have the true offset, get it now
-	if (! (pfile->flags & PACKFILE_FLAG_TRUEOFFS))
-		if (!PK3_GetTrueFileOffset (pfile, pack))
-			return NULL;
+	if (!PK3_GetTrueFileOffset (pfile, pack))
+		return NULL;
 
 #ifndef LINK_TO_ZLIB
 	// No Zlib DLL = no compressed files
@@ -3056,6 +3076,31 @@ fs_offset_t FS_Write (qfile_t* file, const void* data, size_t datasize)
 }
 
 
+/*
+====================
+FS_SysReadAt
+
+Read up to "count" bytes of the underlying file at an absolute offset
+====================
+*/
+static fs_offset_t FS_SysReadAt (qfile_t* file, fs_offset_t offset, void* buffer, fs_offset_t count)
+{
+	fs_offset_t nb;
+	qbool lock = fs_readmutex && (file->flags & QFILE_FLAG_PACKED);
+
+	if (lock) Thread_LockMutex(fs_readmutex);
+	if (FILEDESC_SEEK (file->handle, offset, SEEK_SET) == -1)
+	{
+		// Seek failed. When reading from a pipe, and
+		// the caller never called FS_Seek, this still
+		// works fine.  So no reporting this error.
+	}
+	nb = FILEDESC_READ (file->handle, buffer, count);
+	if (lock) Thread_UnlockMutex(fs_readmutex);
+	return nb;
+}
+
+
 /*
 ====================
 FS_Read
@@ -3120,13 +3165,7 @@ fs_offset_t FS_Read (qfile_t* file, void* buffer, size_t buffersize)
 		{
 			if (count > (fs_offset_t)buffersize)
 				count = (fs_offset_t)buffersize;
-			if (FILEDESC_SEEK (file->handle, file->offset + file->position, SEEK_SET) == -1)
-			{
-				// Seek failed. When reading from a pipe, and
-				// the caller never called FS_Seek, this still
-				// works fine.  So no reporting this error.
-			}
-			nb = FILEDESC_READ (file->handle, &((unsigned char*)buffer)[done], count);
+			nb = FS_SysReadAt (file, file->offset + file->position, &((unsigned char*)buffer)[done], count);
 			if (nb > 0)
 			{
 				done += nb;
@@ -3140,13 +3179,7 @@ fs_offset_t FS_Read (qfile_t* file, void* buffer, size_t buffersize)
 		{
 			if (count > (fs_offset_t)sizeof (file->buff))
 				count = (fs_offset_t)sizeof (file->buff);
-			if (FILEDESC_SEEK (file->handle, file->offset + file->position, SEEK_SET) == -1)
-			{
-				// Seek failed. When reading from a pipe, and
-				// the caller never called FS_Seek, this still
-				// works fine.  So no reporting this error.
-			}
-			nb = FILEDESC_READ (file->handle, file->buff, count);
+			nb = FS_SysReadAt (file, file->offset + file->position, file->buff, count);
 			if (nb > 0)
 			{
 				file->buff_len = nb;
@@ -3182,8 +3215,7 @@ fs_offset_t FS_Read (qfile_t* file, void* buffer, size_t buffersize)
 			count = (fs_offset_t)(ztk->comp_length - ztk->in_position);
 			if (count > (fs_offset_t)sizeof (ztk->input))
 				count = (fs_offset_t)sizeof (ztk->input);
-			FILEDESC_SEEK (file->handle, file->offset + (fs_offset_t)ztk->in_position, SEEK_SET);
-			if (FILEDESC_READ (file->handle, ztk->input, count) != count)
+			if (FS_SysReadAt (file, file->offset + (fs_offset_t)ztk->in_position, ztk->input, count) != count)
 			{
 				Con_Printf ("FS_Read: unexpected end of file\n");
 				break;
@@ -55,12 +55,13 @@ CVars introduced with the freetype extension
 cvar_t r_font_disable_freetype = {CF_CLIENT | CF_ARCHIVE, "r_font_disable_freetype", "0", "disable freetype support for fonts entirely"};
 cvar_t r_font_size_snapping = {CF_CLIENT | CF_ARCHIVE, "r_font_size_snapping", "1", "stick to good looking font sizes whenever possible - bad when the mod doesn't support it!"};
 cvar_t r_font_kerning = {CF_CLIENT | CF_ARCHIVE, "r_font_kerning", "1", "Use kerning if available"};
-cvar_t r_font_diskcache = {CF_CLIENT | CF_ARCHIVE, "r_font_diskcache", "0", "[deprecated, not effective] save font textures to disk for future loading rather than generating them every time"};
+cvar_t r_font_diskcache = {CF_CLIENT | CF_ARCHIVE, "r_font_diskcache", "1", "save glyph maps in fontcache/, named after a checksum of the font files and settings, and load them from there instead of rendering them with FreeType again"};
 cvar_t r_font_compress = {CF_CLIENT | CF_ARCHIVE, "r_font_compress", "0", "use texture compression on font textures to save video memory"};
 cvar_t r_font_nonpoweroftwo = {CF_CLIENT | CF_ARCHIVE, "r_font_nonpoweroftwo", "1", "use nonpoweroftwo textures for font (saves memory, potentially slower)"};
 cvar_t developer_font = {CF_CLIENT | CF_ARCHIVE, "developer_font", "0", "prints debug messages about fonts"};
 
 cvar_t r_font_disable_incmaps = {CF_CLIENT | CF_ARCHIVE, "r_font_disable_incmaps", "0", "always to load a full glyph map for individual unmapped character, even when it will mean extreme resources waste"};
+cvar_t r_font_threaded = {CF_CLIENT | CF_ARCHIVE, "r_font_threaded", "1", "render glyph maps on a separate thread, drawing the missing glyph in place of their characters until they are ready"};
 
 #ifndef DP_FREETYPE_STATIC
 
@@ -254,7 +255,7 @@ typedef struct
 	unsigned char gausstable[2*POSTPROCESS_MAXRADIUS+1];
 }
 font_postprocess_t;
-static font_postprocess_t pp;
+static font_postprocess_t font_pp;
 
 typedef struct fontfilecache_s
 {
@@ -262,6 +263,9 @@ typedef struct fontfilecache_s
 	fs_offset_t len;
 	int refcount;
 	char path[MAX_QPATH];
+	// md4 of the file for the names of cached glyph maps, computed when first needed
+	qbool hasdigest;
+	unsigned char digest[16];
 }
 fontfilecache_t;
 #define MAX_FONTFILES 8
@@ -292,6 +296,7 @@ static const unsigned char *fontfilecache_LoadFile(const char *path, qbool quiet
 				fontfiles[i].len = *filesizepointer;
 				fontfiles[i].buf = buf;
 				fontfiles[i].refcount = 1;
+				fontfiles[i].hasdigest = false;
 				return buf;
 			}
 	}
@@ -317,6 +322,26 @@ static void fontfilecache_Free(const unsigned char *buf)
 	// if we get here, it used regular allocation
 	Mem_Free((void *) buf);
 }
+static void fontfilecache_Checksum(const unsigned char *buf, fs_offset_t len, unsigned char *digest)
+{
+	int i;
+	for(i = 0; i < MAX_FONTFILES; ++i)
+	{
+		if(fontfiles[i].refcount > 0)
+			if(fontfiles[i].buf == buf)
+			{
+				if(!fontfiles[i].hasdigest)
+				{
+					Com_BlockFullChecksum((void *) buf, (int) len, fontfiles[i].digest);
+					fontfiles[i].hasdigest = true;
+				}
+				memcpy(digest, fontfiles[i].digest, 16);
+				return;
+			}
+	}
+	// if we get here, it used regular allocation
+	Com_BlockFullChecksum((void *) buf, (int) len, digest);
+}
 static void fontfilecache_FreeAll(void)
 {
 	int i;
@@ -329,6 +354,52 @@ static void fontfilecache_FreeAll(void)
 	}
 }
 
+typedef enum fontjobstate_e
+{
+	FONTJOB_QUEUED,
+	FONTJOB_RUNNING,
+	FONTJOB_DONE
+}
+fontjobstate_t;
+
+/// a glyph map for the glyph thread to render, see Font_QueueMap
+typedef struct fontjob_s
+{
+	struct fontjob_s *next;
+	fontjobstate_t state;
+	ft2_font_t *font;
+	ft2_font_map_t *mapstart;
+	// not linked into the map chain until it is picked up
+	ft2_font_map_t *map;
+	// first character of the map, or the character of an incremental map
+	Uchar ch;
+	qbool use_incmap;
+	char cachename[MAX_QPATH];
+	// the rendered map, NULL if that failed
+	unsigned char *data;
+}
+fontjob_t;
+
+typedef struct fontthread_s
+{
+	void *thread;
+	void *mutex;
+	void *cond;
+	qbool quit;
+	qbool failed;
+	// FreeType objects must not be used by two threads at once, so the
+	// glyph thread has its own library and copies of the faces
+	FT_Library ft2lib;
+	font_postprocess_t pp;
+	// in the order they were queued, the done ones stay until they are picked up
+	fontjob_t *jobs;
+}
+fontthread_t;
+static fontthread_t font_thread;
+
+static void Font_StopThread(void);
+static void Font_DropJobs(ft2_font_t *font);
+
 /*
 ====================
 Font_CloseLibrary
@@ -338,6 +409,7 @@ Unload the FreeType2 DLL
 */
 void Font_CloseLibrary (void)
 {
+	Font_StopThread();
 	fontfilecache_FreeAll();
 	if (font_mempool)
 		Mem_FreePool(&font_mempool);
@@ -349,7 +421,7 @@ void Font_CloseLibrary (void)
 #ifndef DP_FREETYPE_STATIC
 	Sys_FreeLibrary (&ft2_dll);
 #endif
-	pp.buf = NULL;
+	font_pp.buf = NULL;
 }
 
 /*
@@ -451,6 +523,7 @@ void Font_Init(void)
 	Cvar_RegisterVariable(&developer_font);
 
 	Cvar_RegisterVariable(&r_font_disable_incmaps);
+	Cvar_RegisterVariable(&r_font_threaded);
 
 	// let's open it at startup already
 	Font_OpenLibrary();
@@ -625,12 +698,27 @@ qbool Font_LoadFont(const char *name, dp_font_t *dpfnt)
 	return true;
 }
 
+// add the attachments to the face
+static void Font_AttachStreams(ft2_font_t *font)
+{
+	size_t i;
+	for (i = 0; i < font->attachmentcount; ++i)
+	{
+		FT_Open_Args args;
+		memset(&args, 0, sizeof(args));
+		args.flags = FT_OPEN_MEMORY;
+		args.memory_base = (const FT_Byte*)font->attachments[i].data;
+		args.memory_size = font->attachments[i].size;
+		if (qFT_Attach_Stream((FT_Face)font->face, &args))
+			Con_Printf(CON_ERROR "Failed to add attachment %u to %s\n", (unsigned)i, font->name);
+	}
+}
+
 static qbool Font_LoadFile(const char *name, int _face, ft2_settings_t *settings, ft2_font_t *font)
 {
 	size_t namelen;
 	char filename[MAX_QPATH];
 	int status;
-	size_t i;
 	const unsigned char *data;
 	fs_offset_t datasize;
 
@@ -703,6 +791,13 @@ static qbool Font_LoadFile(const char *name, int _face, ft2_settings_t *settings
 		status = qFT_New_Memory_Face(font_ft2lib, (FT_Bytes)data, datasize, _face, (FT_Face*)&font->face);
 	}
 	font->data = data;
+	font->datasize = datasize;
+	// hash the file now rather than on the first glyph cache miss mid-frame
+	if (r_font_diskcache.integer)
+	{
+		fontfilecache_Checksum(data, datasize, font->digest);
+		font->hasdigest = true;
+	}
 	if (status)
 	{
 		Con_Printf(CON_ERROR "ERROR: can't create face for %s\n"
@@ -712,17 +807,7 @@ static qbool Font_LoadFile(const char *name, int _face, ft2_settings_t *settings
 		return false;
 	}
 
-	// add the attachments
-	for (i = 0; i < font->attachmentcount; ++i)
-	{
-		FT_Open_Args args;
-		memset(&args, 0, sizeof(args));
-		args.flags = FT_OPEN_MEMORY;
-		args.memory_base = (const FT_Byte*)font->attachments[i].data;
-		args.memory_size = font->attachments[i].size;
-		if (qFT_Attach_Stream((FT_Face)font->face, &args))
-			Con_Printf(CON_ERROR "Failed to add attachment %u to %s\n", (unsigned)i, font->name);
-	}
+	Font_AttachStreams(font);
 
 	dp_strlcpy(font->name, name, sizeof(font->name));
 	font->image_font = false;
@@ -730,134 +815,134 @@ static qbool Font_LoadFile(const char *name, int _face, ft2_settings_t *settings
 	return true;
 }
 
-static void Font_Postprocess_Update(ft2_font_t *fnt, int bpp, int w, int h)
+static void Font_Postprocess_Update(ft2_font_t *fnt, font_postprocess_t *pp, int bpp, int w, int h)
 {
 	int needed, x, y;
 	float gausstable[2*POSTPROCESS_MAXRADIUS+1];
-	qbool need_gauss  = (!pp.buf || pp.blur != fnt->settings->blur || pp.shadowz != fnt->settings->shadowz);
-	qbool need_circle = (!pp.buf || pp.outline != fnt->settings->outline || pp.shadowx != fnt->settings->shadowx || pp.shadowy != fnt->settings->shadowy);
-	pp.blur = fnt->settings->blur;
-	pp.outline = fnt->settings->outline;
-	pp.shadowx = fnt->settings->shadowx;
-	pp.shadowy = fnt->settings->shadowy;
-	pp.shadowz = fnt->settings->shadowz;
-	pp.outlinepadding_l = bound(0, ceil(pp.outline - pp.shadowx), POSTPROCESS_MAXRADIUS);
-	pp.outlinepadding_r = bound(0, ceil(pp.outline + pp.shadowx), POSTPROCESS_MAXRADIUS);
-	pp.outlinepadding_t = bound(0, ceil(pp.outline - pp.shadowy), POSTPROCESS_MAXRADIUS);
-	pp.outlinepadding_b = bound(0, ceil(pp.outline + pp.shadowy), POSTPROCESS_MAXRADIUS);
-	pp.blurpadding_lt = bound(0, ceil(pp.blur - pp.shadowz), POSTPROCESS_MAXRADIUS);
-	pp.blurpadding_rb = bound(0, ceil(pp.blur + pp.shadowz), POSTPROCESS_MAXRADIUS);
-	pp.padding_l = pp.blurpadding_lt + pp.outlinepadding_l;
-	pp.padding_r = pp.blurpadding_rb + pp.outlinepadding_r;
-	pp.padding_t = pp.blurpadding_lt + pp.outlinepadding_t;
-	pp.padding_b = pp.blurpadding_rb + pp.outlinepadding_b;
+	qbool need_gauss  = (!pp->buf || pp->blur != fnt->settings->blur || pp->shadowz != fnt->settings->shadowz);
+	qbool need_circle = (!pp->buf || pp->outline != fnt->settings->outline || pp->shadowx != fnt->settings->shadowx || pp->shadowy != fnt->settings->shadowy);
+	pp->blur = fnt->settings->blur;
+	pp->outline = fnt->settings->outline;
+	pp->shadowx = fnt->settings->shadowx;
+	pp->shadowy = fnt->settings->shadowy;
+	pp->shadowz = fnt->settings->shadowz;
+	pp->outlinepadding_l = bound(0, ceil(pp->outline - pp->shadowx), POSTPROCESS_MAXRADIUS);
+	pp->outlinepadding_r = bound(0, ceil(pp->outline + pp->shadowx), POSTPROCESS_MAXRADIUS);
+	pp->outlinepadding_t = bound(0, ceil(pp->outline - pp->shadowy), POSTPROCESS_MAXRADIUS);
+	pp->outlinepadding_b = bound(0, ceil(pp->outline + pp->shadowy), POSTPROCESS_MAXRADIUS);
+	pp->blurpadding_lt = bound(0, ceil(pp->blur - pp->shadowz), POSTPROCESS_MAXRADIUS);
+	pp->blurpadding_rb = bound(0, ceil(pp->blur + pp->shadowz), POSTPROCESS_MAXRADIUS);
+	pp->padding_l = pp->blurpadding_lt + pp->outlinepadding_l;
+	pp->padding_r = pp->blurpadding_rb + pp->outlinepadding_r;
+	pp->padding_t = pp->blurpadding_lt + pp->outlinepadding_t;
+	pp->padding_b = pp->blurpadding_rb + pp->outlinepadding_b;
 	if(need_gauss)
 	{
 		float sum = 0;
 		for(x = -POSTPROCESS_MAXRADIUS; x <= POSTPROCESS_MAXRADIUS; ++x)
-			gausstable[POSTPROCESS_MAXRADIUS+x] = (pp.blur > 0 ? exp(-(pow(x + pp.shadowz, 2))/(pp.blur*pp.blur * 2)) : (floor(x + pp.shadowz + 0.5) == 0));
-		for(x = -pp.blurpadding_rb; x <= pp.blurpadding_lt; ++x)
+			gausstable[POSTPROCESS_MAXRADIUS+x] = (pp->blur > 0 ? exp(-(pow(x + pp->shadowz, 2))/(pp->blur*pp->blur * 2)) : (floor(x + pp->shadowz + 0.5) == 0));
+		for(x = -pp->blurpadding_rb; x <= pp->blurpadding_lt; ++x)
 			sum += gausstable[POSTPROCESS_MAXRADIUS+x];
 		for(x = -POSTPROCESS_MAXRADIUS; x <= POSTPROCESS_MAXRADIUS; ++x)
-			pp.gausstable[POSTPROCESS_MAXRADIUS+x] = floor(gausstable[POSTPROCESS_MAXRADIUS+x] / sum * 255 + 0.5);
+			pp->gausstable[POSTPROCESS_MAXRADIUS+x] = floor(gausstable[POSTPROCESS_MAXRADIUS+x] / sum * 255 + 0.5);
 	}
 	if(need_circle)
 	{
 		for(y = -POSTPROCESS_MAXRADIUS; y <= POSTPROCESS_MAXRADIUS; ++y)
 			for(x = -POSTPROCESS_MAXRADIUS; x <= POSTPROCESS_MAXRADIUS; ++x)
 			{
-				float d = pp.outline + 1 - sqrt(pow(x + pp.shadowx, 2) + pow(y + pp.shadowy, 2));
-				pp.circlematrix[POSTPROCESS_MAXRADIUS+y][POSTPROCESS_MAXRADIUS+x] = (d >= 1) ? 255 : (d <= 0) ? 0 : floor(d * 255 + 0.5);
+				float d = pp->outline + 1 - sqrt(pow(x + pp->shadowx, 2) + pow(y + pp->shadowy, 2));
+				pp->circlematrix[POSTPROCESS_MAXRADIUS+y][POSTPROCESS_MAXRADIUS+x] = (d >= 1) ? 255 : (d <= 0) ? 0 : floor(d * 255 + 0.5);
 			}
 	}
-	pp.bufwidth = w + pp.padding_l + pp.padding_r;
-	pp.bufheight = h + pp.padding_t + pp.padding_b;
-	pp.bufpitch = pp.bufwidth;
-	needed = pp.bufwidth * pp.bufheight;
-	if(!pp.buf || pp.bufsize < needed * 2)
+	pp->bufwidth = w + pp->padding_l + pp->padding_r;
+	pp->bufheight = h + pp->padding_t + pp->padding_b;
+	pp->bufpitch = pp->bufwidth;
+	needed = pp->bufwidth * pp->bufheight;
+	if(!pp->buf || pp->bufsize < needed * 2)
 	{
-		if(pp.buf)
-			Mem_Free(pp.buf);
-		pp.bufsize = needed * 4;
-		pp.buf = (unsigned char *)Mem_Alloc(font_mempool, pp.bufsize);
-		pp.buf2 = pp.buf + needed;
+		if(pp->buf)
+			Mem_Free(pp->buf);
+		pp->bufsize = needed * 4;
+		pp->buf = (unsigned char *)Mem_Alloc(font_mempool, pp->bufsize);
+		pp->buf2 = pp->buf + needed;
 	}
 }
 
-static void Font_Postprocess(ft2_font_t *fnt, unsigned char *imagedata, int pitch, int bpp, int w, int h, int *pad_l, int *pad_r, int *pad_t, int *pad_b)
+static void Font_Postprocess(ft2_font_t *fnt, font_postprocess_t *pp, unsigned char *imagedata, int pitch, int bpp, int w, int h, int *pad_l, int *pad_r, int *pad_t, int *pad_b)
 {
 	int x, y;
 
 	// calculate gauss table
-	Font_Postprocess_Update(fnt, bpp, w, h);
+	Font_Postprocess_Update(fnt, pp, bpp, w, h);
 
 	if(imagedata)
 	{
 		// enlarge buffer
 		// perform operation, not exceeding the passed padding values,
 		// but possibly reducing them
-		*pad_l = min(*pad_l, pp.padding_l);
-		*pad_r = min(*pad_r, pp.padding_r);
-		*pad_t = min(*pad_t, pp.padding_t);
-		*pad_b = min(*pad_b, pp.padding_b);
+		*pad_l = min(*pad_l, pp->padding_l);
+		*pad_r = min(*pad_r, pp->padding_r);
+		*pad_t = min(*pad_t, pp->padding_t);
+		*pad_b = min(*pad_b, pp->padding_b);
 
 		// outline the font (RGBA only)
-		if(bpp == 4 && (pp.outline > 0 || pp.blur > 0 || pp.shadowx != 0 || pp.shadowy != 0 || pp.shadowz != 0)) // we can only do this in BGRA
+		if(bpp == 4 && (pp->outline > 0 || pp->blur > 0 || pp->shadowx != 0 || pp->shadowy != 0 || pp->shadowz != 0)) // we can only do this in BGRA
 		{
 			// this is like mplayer subtitle rendering
 			// bbuffer, bitmap buffer: this is our font
-			// abuffer, alpha buffer: this is pp.buf
-			// tmp: this is pp.buf2
+			// abuffer, alpha buffer: this is pp->buf
+			// tmp: this is pp->buf2
 
 			// create outline buffer
-			memset(pp.buf, 0, pp.bufwidth * pp.bufheight);
+			memset(pp->buf, 0, pp->bufwidth * pp->bufheight);
 			for(y = -*pad_t; y < h + *pad_b; ++y)
 				for(x = -*pad_l; x < w + *pad_r; ++x)
 				{
-					int x1 = max(-x, -pp.outlinepadding_r);
-					int y1 = max(-y, -pp.outlinepadding_b);
-					int x2 = min(pp.outlinepadding_l, w-1-x);
-					int y2 = min(pp.outlinepadding_t, h-1-y);
+					int x1 = max(-x, -pp->outlinepadding_r);
+					int y1 = max(-y, -pp->outlinepadding_b);
+					int x2 = min(pp->outlinepadding_l, w-1-x);
+					int y2 = min(pp->outlinepadding_t, h-1-y);
 					int mx, my;
 					int cur = 0;
 					int highest = 0;
 					for(my = y1; my <= y2; ++my)
 						for(mx = x1; mx <= x2; ++mx)
 						{
-							cur = pp.circlematrix[POSTPROCESS_MAXRADIUS+my][POSTPROCESS_MAXRADIUS+mx] * (int)imagedata[(x+mx) * bpp + pitch * (y+my) + (bpp - 1)];
+							cur = pp->circlematrix[POSTPROCESS_MAXRADIUS+my][POSTPROCESS_MAXRADIUS+mx] * (int)imagedata[(x+mx) * bpp + pitch * (y+my) + (bpp - 1)];
 							if(cur > highest)
 								highest = cur;
 						}
-					pp.buf[((x + pp.padding_l) + pp.bufpitch * (y + pp.padding_t))] = (highest + 128) / 255;
+					pp->buf[((x + pp->padding_l) + pp->bufpitch * (y + pp->padding_t))] = (highest + 128) / 255;
 				}
 
 			// blur the outline buffer
-			if(pp.blur > 0 || pp.shadowz != 0)
+			if(pp->blur > 0 || pp->shadowz != 0)
 			{
 				// horizontal blur
-				for(y = 0; y < pp.bufheight; ++y)
-					for(x = 0; x < pp.bufwidth; ++x)
+				for(y = 0; y < pp->bufheight; ++y)
+					for(x = 0; x < pp->bufwidth; ++x)
 					{
-						int x1 = max(-x, -pp.blurpadding_rb);
-						int x2 = min(pp.blurpadding_lt, pp.bufwidth-1-x);
+						int x1 = max(-x, -pp->blurpadding_rb);
+						int x2 = min(pp->blurpadding_lt, pp->bufwidth-1-x);
 						int mx;
 						int blurred = 0;
 						for(mx = x1; mx <= x2; ++mx)
-							blurred += pp.gausstable[POSTPROCESS_MAXRADIUS+mx] * (int)pp.buf[(x+mx) + pp.bufpitch * y];
-						pp.buf2[x + pp.bufpitch * y] = bound(0, blurred, 65025) / 255;
+							blurred += pp->gausstable[POSTPROCESS_MAXRADIUS+mx] * (int)pp->buf[(x+mx) + pp->bufpitch * y];
+						pp->buf2[x + pp->bufpitch * y] = bound(0, blurred, 65025) / 255;
 					}
 
 				// vertical blur
-				for(y = 0; y < pp.bufheight; ++y)
-					for(x = 0; x < pp.bufwidth; ++x)
+				for(y = 0; y < pp->bufheight; ++y)
+					for(x = 0; x < pp->bufwidth; ++x)
 					{
-						int y1 = max(-y, -pp.blurpadding_rb);
-						int y2 = min(pp.blurpadding_lt, pp.bufheight-1-y);
+						int y1 = max(-y, -pp->blurpadding_rb);
+						int y2 = min(pp->blurpadding_lt, pp->bufheight-1-y);
 						int my;
 						int blurred = 0;
 						for(my = y1; my <= y2; ++my)
-							blurred += pp.gausstable[POSTPROCESS_MAXRADIUS+my] * (int)pp.buf2[x + pp.bufpitch * (y+my)];
-						pp.buf[x + pp.bufpitch * y] = bound(0, blurred, 65025) / 255;
+							blurred += pp->gausstable[POSTPROCESS_MAXRADIUS+my] * (int)pp->buf2[x + pp->bufpitch * (y+my)];
+						pp->buf[x + pp->bufpitch * y] = bound(0, blurred, 65025) / 255;
 					}
 			}
 
@@ -865,7 +950,7 @@ static void Font_Postprocess(ft2_font_t *fnt, unsigned char *imagedata, int pitc
 			for(y = -*pad_t; y < h + *pad_b; ++y)
 				for(x = -*pad_l; x < w + *pad_r; ++x)
 				{
-					unsigned char outlinealpha = pp.buf[(x + pp.padding_l) + pp.bufpitch * (y + pp.padding_t)];
+					unsigned char outlinealpha = pp->buf[(x + pp->padding_l) + pp->bufpitch * (y + pp->padding_t)];
 					if(outlinealpha > 0)
 					{
 						unsigned char oldalpha = imagedata[x * bpp + pitch * y + (bpp - 1)];
@@ -891,18 +976,18 @@ static void Font_Postprocess(ft2_font_t *fnt, unsigned char *imagedata, int pitc
 	{
 		// perform operation, not exceeding the passed padding values,
 		// but possibly reducing them
-		*pad_l = min(*pad_l, pp.padding_l);
-		*pad_r = min(*pad_r, pp.padding_r);
-		*pad_t = min(*pad_t, pp.padding_t);
-		*pad_b = min(*pad_b, pp.padding_b);
+		*pad_l = min(*pad_l, pp->padding_l);
+		*pad_r = min(*pad_r, pp->padding_r);
+		*pad_t = min(*pad_t, pp->padding_t);
+		*pad_b = min(*pad_b, pp->padding_b);
 	}
 	else
 	{
 		// just calculate parameters
-		*pad_l = pp.padding_l;
-		*pad_r = pp.padding_r;
-		*pad_t = pp.padding_t;
-		*pad_b = pp.padding_b;
+		*pad_l = pp->padding_l;
+		*pad_r = pp->padding_r;
+		*pad_t = pp->padding_t;
+		*pad_b = pp->padding_b;
 	}
 }
 
@@ -944,7 +1029,7 @@ static qbool Font_LoadSize(ft2_font_t *font, float size, qbool check_only)
 		return (Font_SearchSize(font, fontface, size) > 0);
 	}
 
-	Font_Postprocess(font, NULL, 0, 4, size*2, size*2, &gpad_l, &gpad_r, &gpad_t, &gpad_b);
+	Font_Postprocess(font, &font_pp, NULL, 0, 4, size*2, size*2, &gpad_l, &gpad_r, &gpad_t, &gpad_b);
 
 	memset(&temp, 0, sizeof(temp));
 	temp.size = size;
@@ -1185,6 +1270,9 @@ void Font_UnloadFont(ft2_font_t *font)
 {
 	int i;
 
+	// before the fallbacks, the glyph thread may use them for this font
+	Font_DropJobs(font);
+
 	// unload fallbacks
 	if(font->next)
 		Font_UnloadFont(font->next);
@@ -1382,53 +1470,15 @@ static inline void incmap_post_process(font_incmap_t *incmap, Uchar ch,
 	#undef N
 }
 
-static qbool Font_LoadMap(ft2_font_t *font, ft2_font_map_t *mapstart, Uchar _ch,
-		ft2_font_map_t **outmap, int *outmapch, qbool use_incmap)
+// FreeType load flags for the antialias and hinting settings of a font
+static FT_Int32 Font_LoadFlags(const ft2_settings_t *settings)
 {
-	#define bytes_per_pixel 4
-
-	char map_identifier[MAX_QPATH];
-	unsigned long map_startglyph = _ch / FONT_CHARS_PER_MAP * FONT_CHARS_PER_MAP;
-	unsigned char *data = NULL;
-	FT_ULong ch = 0, mapch = 0;
-	int status;
-	int tp;
 	FT_Int32 load_flags;
-	int gpad_l, gpad_r, gpad_t, gpad_b;
-
-	int pitch;
-	int width, height, datasize;
-	int glyph_row, glyph_column;
-
-	int chars_per_line = FONT_CHARS_PER_LINE;
-	int char_lines = FONT_CHAR_LINES;
-	int chars_per_map = FONT_CHARS_PER_MAP;
-
-	ft2_font_t *usefont;
-	ft2_font_map_t *map, *next;
-	font_incmap_t *incmap;
-
-	FT_Face fontface;
-
-	incmap = mapstart->incmap;
-	if (use_incmap)
-	{
-		// only render one character in this map;
-		// such small maps will be merged together later in `incmap_post_process`
-		chars_per_line = char_lines = chars_per_map = 1;
-		// and the index is incremental
-		map_startglyph = incmap ? incmap->newmap_start : INCMAP_START;
-	}
-
-	if (font->image_font)
-		fontface = (FT_Face)font->next->face;
-	else
-		fontface = (FT_Face)font->face;
 
-	switch(font->settings->antialias)
+	switch(settings->antialias)
 	{
 		case 0:
-			switch(font->settings->hinting)
+			switch(settings->hinting)
 			{
 				case 0:
 					load_flags = FT_LOAD_NO_HINTING | FT_LOAD_NO_AUTOHINT | FT_LOAD_TARGET_MONO | FT_LOAD_MONOCHROME;
@@ -1445,7 +1495,7 @@ static qbool Font_LoadMap(ft2_font_t *font, ft2_font_map_t *mapstart, Uchar _ch,
 			break;
 		default:
 		case 1:
-			switch(font->settings->hinting)
+			switch(settings->hinting)
 			{
 				case 0:
 					load_flags = FT_LOAD_NO_HINTING | FT_LOAD_NO_AUTOHINT | FT_LOAD_TARGET_NORMAL;
@@ -1463,6 +1513,27 @@ static qbool Font_LoadMap(ft2_font_t *font, ft2_font_map_t *mapstart, Uchar _ch,
 			}
 			break;
 	}
+	return load_flags;
+}
+
+/*
+====================
+Font_AllocMap
+
+Sets up a map in the size of the startmap for the characters from _ch on,
+or for just _ch when it goes into the incremental map.  Font_RenderMap
+fills in its glyphs and Font_LinkMap adds it to the startmap.
+====================
+*/
+static ft2_font_map_t *Font_AllocMap(ft2_font_t *font, ft2_font_map_t *mapstart, Uchar _ch, qbool use_incmap)
+{
+	ft2_font_map_t *map;
+	FT_Face fontface;
+
+	if (font->image_font)
+		fontface = (FT_Face)font->next->face;
+	else
+		fontface = (FT_Face)font->face;
 
 	//status = qFT_Set_Pixel_Sizes((FT_Face)font->face, /*size*/0, mapstart->size);
 	//if (status)
@@ -1477,70 +1548,32 @@ static qbool Font_LoadMap(ft2_font_t *font, ft2_font_map_t *mapstart, Uchar _ch,
 			if (!Font_SetSize(font, mapstart->intSize, mapstart->intSize))
 			{
 				Con_Printf("ERROR: can't set size for font %s: %f ((%f))\n", font->name, mapstart->size, mapstart->intSize);
-				return false;
+				return NULL;
 			}
 			if ((fontface->size->metrics.height>>6) <= mapstart->size)
 				break;
 			if (mapstart->intSize < 2)
 			{
 				Con_Printf("ERROR: no appropriate size found for font %s: %f\n", font->name, mapstart->size);
-				return false;
+				return NULL;
 			}
 			--mapstart->intSize;
 		}
 		*/
 		if ((mapstart->intSize = Font_SearchSize(font, fontface, mapstart->size)) <= 0)
-			return false;
+			return NULL;
 		Con_DPrintf("Using size: %f for requested size %f\n", mapstart->intSize, mapstart->size);
 	}
 
-	if (!font->image_font && !Font_SetSize(font, mapstart->intSize, mapstart->intSize))
-	{
-		Con_Printf(CON_ERROR "ERROR: can't set sizes for font %s: %f\n", font->name, mapstart->size);
-		return false;
-	}
-
 	map = (ft2_font_map_t *)Mem_Alloc(font_mempool, sizeof(ft2_font_map_t));
 	if (!map)
 	{
 		Con_Printf(CON_ERROR "ERROR: Out of memory when allocating fontmap for %s\n", font->name);
-		return false;
+		return NULL;
 	}
 
-	map->start = map_startglyph;
-
-	// create a unique name for this map, then we will use it to make a unique cachepic_t to avoid redundant textures
-	/*
-	dpsnprintf(map_identifier, sizeof(map_identifier),
-		"%s_cache_%g_%d_%g_%g_%g_%g_%g_%u_%lx",
-		font->name,
-		(double) mapstart->intSize,
-		(int) load_flags,
-		(double) font->settings->blur,
-		(double) font->settings->outline,
-		(double) font->settings->shadowx,
-		(double) font->settings->shadowy,
-		(double) font->settings->shadowz,
-		(unsigned) map_startglyph,
-		// add pointer as a unique part to avoid earlier incmaps' state being trashed
-		use_incmap ? (unsigned long)mapstart : 0x0);
-	*/
-	/*
-	 * note 1: it appears that different font instances may have the same metrics, causing this pic being overwritten
-	 *         will use startmap's pointer as a unique part to avoid earlier incmaps' dynamic pics being trashed
-	 * note 2: if this identifier is made too long, significient performance drop will take place
-	 * note 3: blur/outline/shadow are per-font settings, so a pointer to startmap & map size
-	 *         already made these unique, hence they are omitted
-	 * note 4: font_diskcache is removed, this name can be less meaningful
-	 */
-	dpsnprintf(map_identifier, sizeof(map_identifier), "%s_%g_%p_%u",
-			font->name, mapstart->intSize, mapstart, (unsigned) map_startglyph);
-
-	// create a cachepic_t from the data now, or reuse an existing one
-	if (developer_font.integer)
-		Con_Printf("Generating font map %s (size: %.1f MB)\n", map_identifier, mapstart->glyphSize * (256 * 4 / 1048576.0) * mapstart->glyphSize);
-
-	Font_Postprocess(font, NULL, 0, bytes_per_pixel, mapstart->size*2, mapstart->size*2, &gpad_l, &gpad_r, &gpad_t, &gpad_b);
+	// incremental maps get their start when they are linked in
+	map->start = use_incmap ? 0 : _ch / FONT_CHARS_PER_MAP * FONT_CHARS_PER_MAP;
 
 	// copy over the information
 	map->size = mapstart->size;
@@ -1548,6 +1581,55 @@ static qbool Font_LoadMap(ft2_font_t *font, ft2_font_map_t *mapstart, Uchar _ch,
 	map->glyphSize = mapstart->glyphSize;
 	map->sfx = mapstart->sfx;
 	map->sfy = mapstart->sfy;
+	return map;
+}
+
+/*
+====================
+Font_RasterizeMap
+
+Renders the glyphs of a map with FreeType into a new BGRA image.  Only the
+map and the faces of the font are used, so the glyph thread can do this
+with its copy of the font.
+====================
+*/
+static qbool Font_RasterizeMap(ft2_font_t *font, ft2_font_map_t *map, font_postprocess_t *pp, Uchar _ch, qbool use_incmap, unsigned char **outdata)
+{
+	#define bytes_per_pixel 4
+
+	unsigned char *data = NULL;
+	FT_ULong ch = 0, mapch = 0;
+	int status;
+	int tp;
+	FT_Int32 load_flags;
+	int gpad_l, gpad_r, gpad_t, gpad_b;
+
+	int pitch;
+	int width, height, datasize;
+	int glyph_row, glyph_column;
+
+	int chars_per_line = FONT_CHARS_PER_LINE;
+	int char_lines = FONT_CHAR_LINES;
+	int chars_per_map = FONT_CHARS_PER_MAP;
+
+	ft2_font_t *usefont;
+
+	if (use_incmap)
+	{
+		// only render one character in this map;
+		// such small maps will be merged together later in `incmap_post_process`
+		chars_per_line = char_lines = chars_per_map = 1;
+	}
+
+	load_flags = Font_LoadFlags(font->settings);
+
+	if (!font->image_font && !Font_SetSize(font, map->intSize, map->intSize))
+	{
+		Con_Printf(CON_ERROR "ERROR: can't set sizes for font %s: %f\n", font->name, map->size);
+		return false;
+	}
+
+	Font_Postprocess(font, pp, NULL, 0, bytes_per_pixel, map->size*2, map->size*2, &gpad_l, &gpad_r, &gpad_t, &gpad_b);
 
 	width = map->glyphSize * chars_per_line;
 	height = map->glyphSize * char_lines;
@@ -1557,44 +1639,9 @@ static qbool Font_LoadMap(ft2_font_t *font, ft2_font_map_t *mapstart, Uchar _ch,
 	if (!data)
 	{
 		Con_Printf(CON_ERROR "ERROR: Failed to allocate memory for font %s size %g\n", font->name, map->size);
-		Mem_Free(map);
 		return false;
 	}
 
-	if (use_incmap)
-	{
-		if (mapstart->incmap == NULL)
-		{
-			// initial incmap
-			incmap = mapstart->incmap = (font_incmap_t *)Mem_Alloc(font_mempool, sizeof(font_incmap_t));
-			if (!incmap)
-			{
-				Con_Printf(CON_ERROR "ERROR: Out of memory when allocating incremental fontmap for %s\n", font->name);
-				return false;
-			}
-			// this will be the startmap of incmap
-			incmap->fontmap = map;
-			incmap->newmap_start = INCMAP_START;
-		}
-		else
-		{
-			// new maps for incmap shall always be the last one
-			next = incmap->fontmap;
-			while (next->next != NULL)
-				next = next->next;
-			next->next = map;
-		}
-	}
-	else
-	{
-		// insert this normal map
-		next = use_incmap ? incmap->fontmap : mapstart;
-		while(next->next && next->next->start < map->start)
-			next = next->next;
-		map->next = next->next;
-		next->next = map;
-	}
-
 	// initialize as white texture with zero alpha
 	tp = 0;
 	while (tp < datasize)
@@ -1608,11 +1655,7 @@ static qbool Font_LoadMap(ft2_font_t *font, ft2_font_map_t *mapstart, Uchar _ch,
 		data[tp++] = 0x00;
 	}
 
-	glyph_row = 0;
-	glyph_column = 0;
-	ch = (FT_ULong)(use_incmap ? _ch : map->start);
-	mapch = 0;
-	while (true)
+	for (mapch = 0, ch = (FT_ULong)(use_incmap ? _ch : map->start);(int)mapch < chars_per_map;++mapch, ++ch)
 	{
 		FT_ULong glyphIndex;
 		int w, h, x, y;
@@ -1623,6 +1666,9 @@ static qbool Font_LoadMap(ft2_font_t *font, ft2_font_map_t *mapstart, Uchar _ch,
 		FT_Face face;
 		int pad_l, pad_r, pad_t, pad_b;
 
+		glyph_row = mapch / chars_per_line;
+		glyph_column = mapch % chars_per_line;
+
 		if (developer_font.integer)
 			Con_DPrint("glyphinfo: ------------- GLYPH INFO -----------------\n");
 
@@ -1649,7 +1695,7 @@ static qbool Font_LoadMap(ft2_font_t *font, ft2_font_map_t *mapstart, Uchar _ch,
 			// try to load from a fallback font
 			for(usefont = font->next; usefont != NULL; usefont = usefont->next)
 			{
-				if (!Font_SetSize(usefont, mapstart->intSize, mapstart->intSize))
+				if (!Font_SetSize(usefont, map->intSize, map->intSize))
 					continue;
 				// try that glyph
 				face = (FT_Face)usefont->face;
@@ -1721,7 +1767,7 @@ static qbool Font_LoadMap(ft2_font_t *font, ft2_font_map_t *mapstart, Uchar _ch,
 				if (developer_font.integer)
 					Con_DPrintf("glyphinfo:   Pixel Mode: Unknown: %i\n", bmp->pixel_mode);
 				Mem_Free(data);
-				Con_Printf(CON_ERROR "ERROR: Unrecognized pixel mode for font %s size %f: %i\n", font->name, mapstart->size, bmp->pixel_mode);
+				Con_Printf(CON_ERROR "ERROR: Unrecognized pixel mode for font %s size %f: %i\n", font->name, map->size, bmp->pixel_mode);
 				return false;
 			}
 			for (y = 0; y < h; ++y)
@@ -1783,7 +1829,7 @@ static qbool Font_LoadMap(ft2_font_t *font, ft2_font_map_t *mapstart, Uchar _ch,
 			pad_r = gpad_r;
 			pad_t = gpad_t;
 			pad_b = gpad_b;
-			Font_Postprocess(font, imagedata, pitch, bytes_per_pixel, w, h, &pad_l, &pad_r, &pad_t, &pad_b);
+			Font_Postprocess(font, pp, imagedata, pitch, bytes_per_pixel, w, h, &pad_l, &pad_r, &pad_t, &pad_b);
 		}
 		else
 		{
@@ -1791,7 +1837,7 @@ static qbool Font_LoadMap(ft2_font_t *font, ft2_font_map_t *mapstart, Uchar _ch,
 			pad_r = gpad_r;
 			pad_t = gpad_t;
 			pad_b = gpad_b;
-			Font_Postprocess(font, NULL, pitch, bytes_per_pixel, w, h, &pad_l, &pad_r, &pad_t, &pad_b);
+			Font_Postprocess(font, pp, NULL, pitch, bytes_per_pixel, w, h, &pad_l, &pad_r, &pad_t, &pad_b);
 		}
 
 
@@ -1842,16 +1888,266 @@ static qbool Font_LoadMap(ft2_font_t *font, ft2_font_map_t *mapstart, Uchar _ch,
 			}
 		}
 		map->glyphs[mapch].image = false;
+	}
 
-		++mapch; ++ch;
-		if ((int)mapch == chars_per_map)
-			break;
-		if (++glyph_column % chars_per_line == 0)
+	*outdata = data;
+	return true;
+}
+
+#define FONTCACHE_VERSION 2
+#define FONTCACHE_MAGIC "DPFONTCACHE"
+#define FONTCACHE_MAGICSIZE 12
+#define FONTCACHE_HEADERSIZE (FONTCACHE_MAGICSIZE + 8)
+#define FONTCACHE_FLAG_DEFLATED 1
+
+/*
+====================
+Font_SetCacheName
+
+Names the cache file of a map after a checksum of the font files it can
+take glyphs from and of everything else that goes into the glyphs, or
+clears the name if the map is not to be cached.  Incremental maps hold one
+character each before they are merged, so they are cached per character.
+====================
+*/
+static void Font_SetCacheName(ft2_font_t *font, const ft2_font_map_t *map, Uchar _ch, qbool use_incmap, char *cachename, size_t cachenamesize)
+{
+	int i, params[14];
+	size_t keysize;
+	unsigned char key[sizeof(params) + (1 + MAX_FONT_FALLBACKS) * 20], digest[16];
+	ft2_font_t *f;
+
+	cachename[0] = 0;
+	if (!r_font_diskcache.integer)
+		return;
+
+	params[0] = FONTCACHE_VERSION;
+	params[1] = Font_LoadFlags(font->settings);
+	params[2] = use_incmap ? (int)_ch : map->start;
+	params[3] = map->glyphSize;
+	params[4] = (int)(map->size * 64.0f);
+	params[5] = (int)(map->intSize * 64.0f);
+	params[6] = (int)(font->settings->outline * 1000.0f);
+	params[7] = (int)(font->settings->blur * 1000.0f);
+	params[8] = (int)(font->settings->shadowx * 1000.0f);
+	params[9] = (int)(font->settings->shadowy * 1000.0f);
+	params[10] = (int)(font->settings->shadowz * 1000.0f);
+	params[11] = font->image_font;
+	params[12] = sizeof(glyph_slot_t);
+	params[13] = use_incmap;
+	memcpy(key, params, sizeof(params));
+	keysize = sizeof(params);
+	for (f = font; f && keysize + 20 <= sizeof(key); f = f->next)
+	{
+		if (!f->face)
+			continue;
+		// only if r_font_diskcache was off when the font was loaded
+		if (!f->hasdigest)
+		{
+			fontfilecache_Checksum(f->data, f->datasize, f->digest);
+			f->hasdigest = true;
+		}
+		memcpy(key + keysize, f->digest, 16);
+		i = (int)((FT_Face)f->face)->face_index;
+		memcpy(key + keysize + 16, &i, sizeof(i));
+		keysize += 20;
+	}
+	Com_BlockFullChecksum(key, (int)keysize, digest);
+
+	dp_strlcpy(cachename, "fontcache/", cachenamesize);
+	for (i = 0;i < 16;i++)
+		dpsnprintf(cachename + 10 + i * 2, 3, "%02x", digest[i]);
+	dp_strlcat(cachename, ".dat", cachenamesize);
+}
+
+// an incremental map only has its first glyph and a one glyph image
+static void Font_CachedMapSizes(const ft2_font_map_t *map, qbool use_incmap, size_t *glyphssize, size_t *glyphcharssize, size_t *datasize)
+{
+	int numchars = use_incmap ? 1 : FONT_CHARS_PER_MAP;
+	*glyphssize = numchars * sizeof(map->glyphs[0]);
+	*glyphcharssize = numchars * sizeof(map->glyphchars[0]);
+	*datasize = numchars * map->glyphSize * map->glyphSize * 4;
+}
+
+static qbool Font_LoadCachedMap(ft2_font_map_t *map, qbool use_incmap, const char *cachename, unsigned char **outdata)
+{
+	unsigned char *filedata, *payload, *inflated = NULL;
+	fs_offset_t filesize;
+	size_t glyphssize, glyphcharssize, datasize, payloadsize, inflatedsize = 0;
+
+	filedata = FS_LoadFile(cachename, tempmempool, true, &filesize);
+	if (!filedata)
+		return false;
+	Font_CachedMapSizes(map, use_incmap, &glyphssize, &glyphcharssize, &datasize);
+	payloadsize = glyphssize + glyphcharssize + datasize;
+	payload = NULL;
+	if (filesize >= FONTCACHE_HEADERSIZE && !memcmp(filedata, FONTCACHE_MAGIC, FONTCACHE_MAGICSIZE) && (size_t)BuffLittleLong(filedata + FONTCACHE_MAGICSIZE + 4) == payloadsize)
+	{
+		payload = filedata + FONTCACHE_HEADERSIZE;
+		if (BuffLittleLong(filedata + FONTCACHE_MAGICSIZE) & FONTCACHE_FLAG_DEFLATED)
+		{
+			inflated = FS_Inflate(payload, filesize - FONTCACHE_HEADERSIZE, &inflatedsize, tempmempool);
+			payload = inflatedsize == payloadsize ? inflated : NULL;
+		}
+		else if ((size_t)(filesize - FONTCACHE_HEADERSIZE) < payloadsize)
+			payload = NULL;
+	}
+	if (payload)
+	{
+		memcpy(map->glyphs, payload, glyphssize);
+		memcpy(map->glyphchars, payload + glyphssize, glyphcharssize);
+		*outdata = (unsigned char *)Mem_Alloc(font_mempool, datasize);
+		memcpy(*outdata, payload + glyphssize + glyphcharssize, datasize);
+	}
+	else
+		Con_DPrintf("Font cache file %s is broken, rendering it again\n", cachename);
+	if (inflated)
+		Mem_Free(inflated);
+	Mem_Free(filedata);
+	return payload != NULL;
+}
+
+static void Font_SaveCachedMap(const ft2_font_map_t *map, qbool use_incmap, const char *cachename, const unsigned char *data)
+{
+	unsigned char header[FONTCACHE_HEADERSIZE];
+	unsigned char *payload, *deflated;
+	size_t glyphssize, glyphcharssize, datasize, payloadsize, deflatedsize;
+	const void *blocks[2];
+	fs_offset_t sizes[2];
+
+	Font_CachedMapSizes(map, use_incmap, &glyphssize, &glyphcharssize, &datasize);
+	payloadsize = glyphssize + glyphcharssize + datasize;
+	payload = (unsigned char *)Mem_Alloc(tempmempool, payloadsize);
+	memcpy(payload, map->glyphs, glyphssize);
+	memcpy(payload + glyphssize, map->glyphchars, glyphcharssize);
+	memcpy(payload + glyphssize + glyphcharssize, data, datasize);
+	// mostly zero alpha, this shrinks a lot
+	deflated = FS_Deflate(payload, payloadsize, &deflatedsize, -1, tempmempool);
+
+	memset(header, 0, sizeof(header));
+	memcpy(header, FONTCACHE_MAGIC, sizeof(FONTCACHE_MAGIC));
+	StoreLittleLong(header + FONTCACHE_MAGICSIZE, deflated ? FONTCACHE_FLAG_DEFLATED : 0);
+	StoreLittleLong(header + FONTCACHE_MAGICSIZE + 4, (unsigned int)payloadsize);
+	blocks[0] = header;
+	sizes[0] = sizeof(header);
+	blocks[1] = deflated ? deflated : payload;
+	sizes[1] = deflated ? deflatedsize : payloadsize;
+	FS_WriteFileInBlocks(cachename, blocks, sizes, 2);
+
+	if (deflated)
+		Mem_Free(deflated);
+	Mem_Free(payload);
+}
+
+/*
+====================
+Font_RenderMap
+
+Fills in the glyphs and the image of a map, from its cache file if it has
+one.  The glyph thread calls this with its own copy of the font and its
+own postprocessing buffers.
+====================
+*/
+static qbool Font_RenderMap(ft2_font_t *font, ft2_font_map_t *map, font_postprocess_t *pp, Uchar _ch, qbool use_incmap, const char *cachename, unsigned char **outdata)
+{
+	if (cachename[0] && Font_LoadCachedMap(map, use_incmap, cachename, outdata))
+		return true;
+	if (!Font_RasterizeMap(font, map, pp, _ch, use_incmap, outdata))
+		return false;
+	if (cachename[0])
+		Font_SaveCachedMap(map, use_incmap, cachename, *outdata);
+	return true;
+}
+
+/*
+====================
+Font_LinkMap
+
+Adds a rendered map to the map chain of its startmap, or to the incremental
+map, and creates its texture.  data is freed, or kept for merging by the
+incremental map.
+====================
+*/
+static qbool Font_LinkMap(ft2_font_t *font, ft2_font_map_t *mapstart, ft2_font_map_t *map, unsigned char *data, Uchar _ch, qbool use_incmap,
+		ft2_font_map_t **outmap, int *outmapch)
+{
+	char map_identifier[MAX_QPATH];
+	int width, height;
+	ft2_font_map_t *next;
+	font_incmap_t *incmap;
+
+	incmap = mapstart->incmap;
+	if (use_incmap)
+	{
+		// the index is incremental
+		map->start = incmap ? incmap->newmap_start : INCMAP_START;
+		width = height = map->glyphSize;
+		if (incmap == NULL)
 		{
-			glyph_column = 0;
-			++glyph_row;
+			// initial incmap
+			incmap = mapstart->incmap = (font_incmap_t *)Mem_Alloc(font_mempool, sizeof(font_incmap_t));
+			if (!incmap)
+			{
+				Con_Printf(CON_ERROR "ERROR: Out of memory when allocating incremental fontmap for %s\n", font->name);
+				Mem_Free(data);
+				Mem_Free(map);
+				return false;
+			}
+			// this will be the startmap of incmap
+			incmap->fontmap = map;
+			incmap->newmap_start = INCMAP_START;
+		}
+		else
+		{
+			// new maps for incmap shall always be the last one
+			next = incmap->fontmap;
+			while (next->next != NULL)
+				next = next->next;
+			next->next = map;
 		}
 	}
+	else
+	{
+		width = map->glyphSize * FONT_CHARS_PER_LINE;
+		height = map->glyphSize * FONT_CHAR_LINES;
+		// insert this normal map
+		next = mapstart;
+		while(next->next && next->next->start < map->start)
+			next = next->next;
+		map->next = next->next;
+		next->next = map;
+	}
+
+	// create a unique name for this map, then we will use it to make a unique cachepic_t to avoid redundant textures
+	/*
+	dpsnprintf(map_identifier, sizeof(map_identifier),
+		"%s_cache_%g_%d_%g_%g_%g_%g_%g_%u_%lx",
+		font->name,
+		(double) mapstart->intSize,
+		(int) load_flags,
+		(double) font->settings->blur,
+		(double) font->settings->outline,
+		(double) font->settings->shadowx,
+		(double) font->settings->shadowy,
+		(double) font->settings->shadowz,
+		(unsigned) map_startglyph,
+		// add pointer as a unique part to avoid earlier incmaps' state being trashed
+		use_incmap ? (unsigned long)mapstart : 0x0);
+	*/
+	/*
+	 * note 1: it appears that different font instances may have the same metrics, causing this pic being overwritten
+	 *         will use startmap's pointer as a unique part to avoid earlier incmaps' dynamic pics being trashed
+	 * note 2: if this identifier is made too long, significient performance drop will take place
+	 * note 3: blur/outline/shadow are per-font settings, so a pointer to startmap & map size
+	 *         already made these unique, hence they are omitted
+	 * note 4: the disk cache names its files by checksum, this name can be less meaningful
+	 */
+	dpsnprintf(map_identifier, sizeof(map_identifier), "%s_%g_%p_%u",
+			font->name, mapstart->intSize, mapstart, (unsigned) map->start);
+
+	// create a cachepic_t from the data now, or reuse an existing one
+	if (developer_font.integer)
+		Con_Printf("Generating font map %s (size: %.1f MB)\n", map_identifier, map->glyphSize * (256 * 4 / 1048576.0) * map->glyphSize);
 
 	// update the pic returned by Draw_CachePic_Flags earlier to contain our texture
 	update_pic_for_fontmap(map, map_identifier, width, height, data);
@@ -1863,7 +2159,7 @@ static qbool Font_LoadMap(ft2_font_t *font, ft2_font_map_t *mapstart, Uchar _ch,
 		// this would be bad...
 		// only `data' must be freed
 		Con_Printf(CON_ERROR "ERROR: Failed to generate texture for font %s size %f map %lu\n",
-			   font->name, mapstart->size, map_startglyph);
+			   font->name, mapstart->size, (unsigned long)map->start);
 		return false;
 	}
 
@@ -1885,6 +2181,248 @@ static qbool Font_LoadMap(ft2_font_t *font, ft2_font_map_t *mapstart, Uchar _ch,
 	return true;
 }
 
+static qbool Font_LoadMap(ft2_font_t *font, ft2_font_map_t *mapstart, Uchar _ch,
+		ft2_font_map_t **outmap, int *outmapch, qbool use_incmap)
+{
+	char cachename[MAX_QPATH];
+	unsigned char *data = NULL;
+	ft2_font_map_t *map;
+
+	map = Font_AllocMap(font, mapstart, _ch, use_incmap);
+	if (!map)
+		return false;
+	Font_SetCacheName(font, map, _ch, use_incmap, cachename, sizeof(cachename));
+	if (!Font_RenderMap(font, map, &font_pp, _ch, use_incmap, cachename, &data))
+	{
+		Mem_Free(map);
+		return false;
+	}
+	return Font_LinkMap(font, mapstart, map, data, _ch, use_incmap, outmap, outmapch);
+}
+
+/*
+================================================================================
+The glyph thread, renders the maps needed by text drawing so the frame does
+not wait for FreeType.
+================================================================================
+*/
+
+// a copy of the font and its fallbacks with faces from the glyph thread's library
+static ft2_font_t *Font_ThreadFont(ft2_font_t *font)
+{
+	ft2_font_t *copy;
+
+	if (!font)
+		return NULL;
+	if (font->threadfont)
+		return font->threadfont;
+	copy = (ft2_font_t *)Mem_Alloc(font_mempool, sizeof(ft2_font_t));
+	*copy = *font;
+	memset(copy->font_maps, 0, sizeof(copy->font_maps));
+	copy->currentw = copy->currenth = 0;
+	copy->face = NULL;
+	if (font->face)
+	{
+		if (qFT_New_Memory_Face(font_thread.ft2lib, (FT_Bytes)font->data, font->datasize, ((FT_Face)font->face)->face_index, (FT_Face*)&copy->face))
+		{
+			Con_Printf(CON_ERROR "ERROR: can't create face for %s on the glyph thread\n", font->name);
+			Mem_Free(copy);
+			return NULL;
+		}
+		Font_AttachStreams(copy);
+	}
+	copy->next = Font_ThreadFont(font->next);
+	font->threadfont = copy;
+	return copy;
+}
+
+static void Font_FreeJob(fontjob_t *job)
+{
+	if (job->data)
+		Mem_Free(job->data);
+	Mem_Free(job->map);
+	Mem_Free(job);
+}
+
+static int Font_ThreadFunc(void *unused)
+{
+	fontjob_t *job;
+	ft2_font_t *font;
+
+	Thread_LockMutex(font_thread.mutex);
+	while (!font_thread.quit)
+	{
+		for (job = font_thread.jobs;job && job->state != FONTJOB_QUEUED;job = job->next)
+			;
+		if (!job)
+		{
+			Thread_CondWait(font_thread.cond, font_thread.mutex);
+			continue;
+		}
+		job->state = FONTJOB_RUNNING;
+		Thread_UnlockMutex(font_thread.mutex);
+
+		font = Font_ThreadFont(job->font);
+		if (font)
+			Font_RenderMap(font, job->map, &font_thread.pp, job->ch, job->use_incmap, job->cachename, &job->data);
+
+		Thread_LockMutex(font_thread.mutex);
+		job->state = FONTJOB_DONE;
+		Thread_CondBroadcast(font_thread.cond);
+	}
+	Thread_UnlockMutex(font_thread.mutex);
+	return 0;
+}
+
+static qbool Font_StartThread(void)
+{
+	if (font_thread.thread)
+		return true;
+	if (font_thread.failed || !Thread_HasThreads())
+		return false;
+	if (qFT_Init_FreeType(&font_thread.ft2lib))
+	{
+		Con_Print(CON_ERROR "ERROR: Failed to initialize the FreeType2 library for the glyph thread!\n");
+		font_thread.failed = true;
+		return false;
+	}
+	font_thread.mutex = Thread_CreateMutex();
+	font_thread.cond = Thread_CreateCond();
+	font_thread.quit = false;
+	font_thread.thread = Thread_CreateThread(Font_ThreadFunc, NULL);
+	if (!font_thread.thread)
+	{
+		Thread_DestroyCond(font_thread.cond);
+		Thread_DestroyMutex(font_thread.mutex);
+		qFT_Done_FreeType(font_thread.ft2lib);
+		font_thread.failed = true;
+		return false;
+	}
+	return true;
+}
+
+static void Font_StopThread(void)
+{
+	fontjob_t *job;
+
+	if (font_thread.thread)
+	{
+		Thread_LockMutex(font_thread.mutex);
+		font_thread.quit = true;
+		Thread_CondBroadcast(font_thread.cond);
+		Thread_UnlockMutex(font_thread.mutex);
+		Thread_WaitThread(font_thread.thread, 0);
+		// the fonts are unloaded already, which drops their jobs
+		while ((job = font_thread.jobs))
+		{
+			font_thread.jobs = job->next;
+			Font_FreeJob(job);
+		}
+		Thread_DestroyCond(font_thread.cond);
+		Thread_DestroyMutex(font_thread.mutex);
+		qFT_Done_FreeType(font_thread.ft2lib);
+	}
+	memset(&font_thread, 0, sizeof(font_thread));
+}
+
+// drops the jobs of a font that is being unloaded and frees its copy of the
+// font, waiting for the glyph thread to finish what it is rendering
+static void Font_DropJobs(ft2_font_t *font)
+{
+	fontjob_t *job, **link;
+
+	if (!font_thread.thread)
+		return;
+	Thread_LockMutex(font_thread.mutex);
+	for (;;)
+	{
+		for (link = &font_thread.jobs;(job = *link);)
+		{
+			if (job->font == font && job->state != FONTJOB_RUNNING)
+			{
+				*link = job->next;
+				Font_FreeJob(job);
+			}
+			else
+				link = &job->next;
+		}
+		// the faces must not go away while the thread uses the library
+		for (job = font_thread.jobs;job && job->state != FONTJOB_RUNNING;job = job->next)
+			;
+		if (!job)
+			break;
+		Thread_CondWait(font_thread.cond, font_thread.mutex);
+	}
+	if (font->threadfont)
+	{
+		if (font->threadfont->face)
+			qFT_Done_Face((FT_Face)font->threadfont->face);
+		Mem_Free(font->threadfont);
+		font->threadfont = NULL;
+	}
+	Thread_UnlockMutex(font_thread.mutex);
+}
+
+/*
+====================
+Font_QueueMap
+
+Font_LoadMap on the glyph thread.  The map is added to the startmap by the
+first call for one of its characters after it is rendered, until then the
+missing glyph of the startmap is drawn for them.
+====================
+*/
+static qbool Font_QueueMap(ft2_font_t *font, ft2_font_map_t *mapstart, Uchar _ch,
+		ft2_font_map_t **outmap, int *outmapch, qbool use_incmap)
+{
+	qbool done;
+	fontjob_t *job, **link;
+	Uchar start = use_incmap ? _ch : _ch / FONT_CHARS_PER_MAP * FONT_CHARS_PER_MAP;
+
+	Thread_LockMutex(font_thread.mutex);
+	for (link = &font_thread.jobs;(job = *link);link = &job->next)
+		if (job->mapstart == mapstart && job->ch == start && job->use_incmap == use_incmap)
+			break;
+	// failed jobs stay in the list so they are not tried again
+	done = job && job->state == FONTJOB_DONE && job->data;
+	if (done)
+		*link = job->next;
+	Thread_UnlockMutex(font_thread.mutex);
+
+	if (done)
+	{
+		done = Font_LinkMap(font, mapstart, job->map, job->data, _ch, use_incmap, outmap, outmapch);
+		Mem_Free(job);
+		return done;
+	}
+
+	if (!job)
+	{
+		job = (fontjob_t *)Mem_Alloc(font_mempool, sizeof(fontjob_t));
+		job->map = Font_AllocMap(font, mapstart, _ch, use_incmap);
+		if (!job->map)
+		{
+			Mem_Free(job);
+			return false;
+		}
+		job->state = FONTJOB_QUEUED;
+		job->font = font;
+		job->mapstart = mapstart;
+		job->ch = start;
+		job->use_incmap = use_incmap;
+		Font_SetCacheName(font, job->map, _ch, use_incmap, job->cachename, sizeof(job->cachename));
+		// only this thread changes the list, so link still is its end
+		Thread_LockMutex(font_thread.mutex);
+		*link = job;
+		Thread_CondSignal(font_thread.cond);
+		Thread_UnlockMutex(font_thread.mutex);
+	}
+
+	*outmap = mapstart;
+	*outmapch = 0;
+	return true;
+}
+
 static qbool legacy_font_loading_api_alerted = false;
 static inline void alert_legacy_font_api(const char *name)
 {
@@ -2008,5 +2546,7 @@ qbool Font_GetMapForChar(ft2_font_t *font, int map_index, Uchar ch, ft2_font_map
 
 	if (map_index < 0 || map_index >= MAX_FONT_SIZES)
 		return false;
+	if (r_font_threaded.integer && Font_StartThread())
+		return Font_QueueMap(font, font->font_maps[map_index], ch, outmap, outmapch, use_incmap);
 	return Font_LoadMap(font, font->font_maps[map_index], ch, outmap, outmapch, use_incmap);
 }
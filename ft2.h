@@ -50,8 +50,11 @@ typedef struct ft2_font_s
 	// TODO: clean this up and do not expose everything.
 
 	const unsigned char  *data; // FT2 needs it to stay
-	//fs_offset_t     datasize;
+	fs_offset_t           datasize;
 	void                 *face;
+	// checksum of data for the glyph map cache names, see Font_SetCacheName
+	unsigned char         digest[16];
+	qbool                 hasdigest;
 
 	// an unordered array of ordered linked lists of glyph maps for a specific size
 	ft2_font_map_t       *font_maps[MAX_FONT_SIZES];
@@ -65,6 +68,9 @@ typedef struct ft2_font_s
 
 	// fallback mechanism
 	struct ft2_font_s    *next;
+
+	// copy of this font with its own face for the glyph thread
+	struct ft2_font_s    *threadfont;
 } ft2_font_t;
 
 void            Font_CloseLibrary(void);
@@ -744,6 +744,94 @@ static void gl_draw_newmap(void)
 	}
 }
 
+/*
+================
+DrawQ_Benchmark_f
+
+Records a synthetic HUD into the UI mesh the way a busy menu or CSQC HUD
+does, each widget being a fill, an additive pic and a colored string, and
+reports the CPU time per frame and how many batches the calls were merged
+into.  Nothing is drawn, the mesh is reset after every frame.
+
+A dedicated server has no video context, so there it records into a mesh of
+its own with stub pics that never create a texture.
+================
+*/
+void DrawQ_Benchmark_f(cmd_state_t *cmd)
+{
+	int i, frame, widgets, frames;
+	int batches = 0, vertices = 0, triangles = 0;
+	double start, t;
+	float x, y;
+	char text[64];
+	qbool oldforce = r_draw2d_force;
+	qbool headless = cls.state == ca_dedicated;
+	model_t *mod = CL_Mesh_UI();
+	cachepic_t *white;
+	dp_font_t *font;
+	static cachepic_t stubwhite, stubconchars;
+	static dp_font_t stubfont;
+
+	widgets = Cmd_Argc(cmd) > 1 ? atoi(Cmd_Argv(cmd, 1)) : 1000;
+	widgets = max(widgets, 1);
+	frames = Cmd_Argc(cmd) > 2 ? atoi(Cmd_Argv(cmd, 2)) : 100;
+	frames = max(frames, 1);
+
+	if (headless)
+	{
+		// non-autoload pics are never uploaded, Mod_Mesh_GetTexture only
+		// needs their names
+		dp_strlcpy(stubwhite.name, "white", sizeof(stubwhite.name));
+		stubwhite.width = stubwhite.height = 8;
+		dp_strlcpy(stubconchars.name, "gfx/conchars", sizeof(stubconchars.name));
+		stubconchars.width = stubconchars.height = 128;
+		dp_strlcpy(stubfont.texpath, "gfx/conchars", sizeof(stubfont.texpath));
+		stubfont.pic = &stubconchars;
+		stubfont.settings.scale = 1;
+		for (i = 0;i < 256;i++)
+			stubfont.width_of[i] = 1;
+		white = &stubwhite;
+		font = &stubfont;
+		if (!mod->mempool)
+			Mod_Mesh_Create(mod, "MESH_UI");
+	}
+	else
+	{
+		white = Draw_CachePic("white");
+		font = FONT_CONSOLE;
+	}
+
+	r_draw2d_force = true;
+	t = 0;
+	// frame -1 loads the pics and glyphs and is not timed
+	for (frame = -1;frame < frames;frame++)
+	{
+		start = Sys_DirtyTime();
+		for (i = 0;i < widgets;i++)
+		{
+			x = (i % 8) * 80;
+			y = (i / 8 % 60) * 8;
+			DrawQ_Pic(x, y, white, 76, 8, 0, 0, 0, 0.5, 0);
+			DrawQ_Pic(x, y, white, 8, 8, 1, 0.5, 0, 0.5, DRAWFLAG_ADDITIVE);
+			dpsnprintf(text, sizeof(text), "^3%i ^7health ^2%i", i, frame);
+			// scaled from a zero size so the glyphs are not snapped to
+			// pixels, which needs a video mode
+			DrawQ_String_Scale(x + 8, y, text, 0, 0, 0, 8, 8, 1, 1, 1, 1, 0, NULL, false, font);
+		}
+		batches = mod->num_surfaces;
+		vertices = mod->surfmesh.num_vertices;
+		triangles = mod->surfmesh.num_triangles;
+		Mod_Mesh_Reset(mod);
+		if (frame >= 0)
+			t += Sys_DirtyTime() - start;
+	}
+	r_draw2d_force = oldforce;
+	if (headless)
+		Mod_Mesh_Destroy(mod);
+
+	Con_Printf("%i widgets (%i draw calls), %i frames: %.3fms per frame, %i batches, %i vertices, %i triangles\n", widgets, widgets * 3, frames, t * 1000.0 / frames, batches, vertices, triangles);
+}
+
 void GL_Draw_Init (void)
 {
 	int i, j;
@@ -783,6 +871,7 @@ void GL_Draw_Init (void)
 			dpsnprintf(FONT_USER(i)->title, sizeof(FONT_USER(i)->title), "user%d", j++);
 
 	Cmd_AddCommand(CF_CLIENT, "loadfont", LoadFont_f, "loadfont function tganame loads a font; example: loadfont console gfx/veramono; loadfont without arguments lists the available functions");
+	Cmd_AddCommand(CF_CLIENT, "draw2d_benchmark", DrawQ_Benchmark_f, "time recording a synthetic HUD of fills, pics and strings into the 2D batches without drawing it (optional parameters: widgets, frames)");
 	R_RegisterModule("GL_Draw", gl_draw_start, gl_draw_shutdown, gl_draw_newmap, NULL, NULL);
 }
 
@@ -808,10 +897,10 @@ void DrawQ_Pic(float x, float y, cachepic_t *pic, float width, float height, flo
 	if (height == 0)
 		height = pic->height;
 	surf = Mod_Mesh_AddSurface(mod, Mod_Mesh_GetTexture(mod, pic->name, flags, pic->texflags, MATERIALFLAG_WALL | MATERIALFLAG_VERTEXCOLOR | MATERIALFLAG_ALPHAGEN_VERTEX | MATERIALFLAG_ALPHA | MATERIALFLAG_BLENDED | MATERIALFLAG_NOSHADOW), true);
-	e0 = Mod_Mesh_IndexForVertex(mod, surf, x        , y         , 0, 0, 0, -1, 0, 0, 0, 0, red, green, blue, alpha);
-	e1 = Mod_Mesh_IndexForVertex(mod, surf, x + width, y         , 0, 0, 0, -1, 1, 0, 0, 0, red, green, blue, alpha);
-	e2 = Mod_Mesh_IndexForVertex(mod, surf, x + width, y + height, 0, 0, 0, -1, 1, 1, 0, 0, red, green, blue, alpha);
-	e3 = Mod_Mesh_IndexForVertex(mod, surf, x        , y + height, 0, 0, 0, -1, 0, 1, 0, 0, red, green, blue, alpha);
+	e0 = Mod_Mesh_AddVertex(mod, surf, x        , y         , 0, 0, 0, -1, 0, 0, 0, 0, red, green, blue, alpha);
+	e1 = Mod_Mesh_AddVertex(mod, surf, x + width, y         , 0, 0, 0, -1, 1, 0, 0, 0, red, green, blue, alpha);
+	e2 = Mod_Mesh_AddVertex(mod, surf, x + width, y + height, 0, 0, 0, -1, 1, 1, 0, 0, red, green, blue, alpha);
+	e3 = Mod_Mesh_AddVertex(mod, surf, x        , y + height, 0, 0, 0, -1, 0, 1, 0, 0, red, green, blue, alpha);
 	Mod_Mesh_AddTriangle(mod, surf, e0, e1, e2);
 	Mod_Mesh_AddTriangle(mod, surf, e0, e2, e3);
 }
@@ -836,10 +925,10 @@ void DrawQ_RotPic(float x, float y, cachepic_t *pic, float width, float height,
 	if (height == 0)
 		height = pic->height;
 	surf = Mod_Mesh_AddSurface(mod, Mod_Mesh_GetTexture(mod, pic->name, flags, pic->texflags, MATERIALFLAG_WALL | MATERIALFLAG_VERTEXCOLOR | MATERIALFLAG_ALPHAGEN_VERTEX | MATERIALFLAG_ALPHA | MATERIALFLAG_BLENDED | MATERIALFLAG_NOSHADOW), true);
-	e0 = Mod_Mesh_IndexForVertex(mod, surf, x - cosaf *          org_x  - cosar *           org_y , y - sinaf *          org_x  - sinar *           org_y , 0, 0, 0, -1, 0, 0, 0, 0, red, green, blue, alpha);
-	e1 = Mod_Mesh_IndexForVertex(mod, surf, x + cosaf * (width - org_x) - cosar *           org_y , y + sinaf * (width - org_x) - sinar *           org_y , 0, 0, 0, -1, 1, 0, 0, 0, red, green, blue, alpha);
-	e2 = Mod_Mesh_IndexForVertex(mod, surf, x + cosaf * (width - org_x) + cosar * (height - org_y), y + sinaf * (width - org_x) + sinar * (height - org_y), 0, 0, 0, -1, 1, 1, 0, 0, red, green, blue, alpha);
-	e3 = Mod_Mesh_IndexForVertex(mod, surf, x - cosaf *          org_x  + cosar * (height - org_y), y - sinaf *          org_x  + sinar * (height - org_y), 0, 0, 0, -1, 0, 1, 0, 0, red, green, blue, alpha);
+	e0 = Mod_Mesh_AddVertex(mod, surf, x - cosaf *          org_x  - cosar *           org_y , y - sinaf *          org_x  - sinar *           org_y , 0, 0, 0, -1, 0, 0, 0, 0, red, green, blue, alpha);
+	e1 = Mod_Mesh_AddVertex(mod, surf, x + cosaf * (width - org_x) - cosar *           org_y , y + sinaf * (width - org_x) - sinar *           org_y , 0, 0, 0, -1, 1, 0, 0, 0, red, green, blue, alpha);
+	e2 = Mod_Mesh_AddVertex(mod, surf, x + cosaf * (width - org_x) + cosar * (height - org_y), y + sinaf * (width - org_x) + sinar * (height - org_y), 0, 0, 0, -1, 1, 1, 0, 0, red, green, blue, alpha);
+	e3 = Mod_Mesh_AddVertex(mod, surf, x - cosaf *          org_x  + cosar * (height - org_y), y - sinaf *          org_x  + sinar * (height - org_y), 0, 0, 0, -1, 0, 1, 0, 0, red, green, blue, alpha);
 	Mod_Mesh_AddTriangle(mod, surf, e0, e1, e2);
 	Mod_Mesh_AddTriangle(mod, surf, e0, e2, e3);
 }
@@ -1103,6 +1192,8 @@ float DrawQ_String_Scale(float startx, float starty, const char *text, size_t ma
 	const float *width_of;
 	model_t *mod = CL_Mesh_UI();
 	msurface_t *surf = NULL;
+	texture_t *tex = NULL;
+	const char *texname = NULL; // the pic name tex was looked up for
 	int e0, e1, e2, e3;
 	int tw, th;
 	tw = Draw_GetPicWidth(fnt->pic);
@@ -1256,11 +1347,16 @@ float DrawQ_String_Scale(float startx, float starty, const char *text, size_t ma
 					u = 0.0625f * thisw - (1.0f / tw);
 					v = 0.0625f - (1.0f / th);
 				}
-				surf = Mod_Mesh_AddSurface(mod, Mod_Mesh_GetTexture(mod, fnt->pic->name, flags, TEXF_ALPHA | TEXF_CLAMP, MATERIALFLAG_WALL | MATERIALFLAG_VERTEXCOLOR | MATERIALFLAG_ALPHAGEN_VERTEX | MATERIALFLAG_ALPHA | MATERIALFLAG_BLENDED | MATERIALFLAG_NOSHADOW), true);
-				e0 = Mod_Mesh_IndexForVertex(mod, surf, x         , y   , 10, 0, 0, -1, s  , t  , 0, 0, DrawQ_Color[0], DrawQ_Color[1], DrawQ_Color[2], DrawQ_Color[3]);
-				e1 = Mod_Mesh_IndexForVertex(mod, surf, x+dw*thisw, y   , 10, 0, 0, -1, s+u, t  , 0, 0, DrawQ_Color[0], DrawQ_Color[1], DrawQ_Color[2], DrawQ_Color[3]);
-				e2 = Mod_Mesh_IndexForVertex(mod, surf, x+dw*thisw, y+dh, 10, 0, 0, -1, s+u, t+v, 0, 0, DrawQ_Color[0], DrawQ_Color[1], DrawQ_Color[2], DrawQ_Color[3]);
-				e3 = Mod_Mesh_IndexForVertex(mod, surf, x         , y+dh, 10, 0, 0, -1, s  , t+v, 0, 0, DrawQ_Color[0], DrawQ_Color[1], DrawQ_Color[2], DrawQ_Color[3]);
+				if (texname != fnt->pic->name)
+				{
+					texname = fnt->pic->name;
+					tex = Mod_Mesh_GetTexture(mod, texname, flags, TEXF_ALPHA | TEXF_CLAMP, MATERIALFLAG_WALL | MATERIALFLAG_VERTEXCOLOR | MATERIALFLAG_ALPHAGEN_VERTEX | MATERIALFLAG_ALPHA | MATERIALFLAG_BLENDED | MATERIALFLAG_NOSHADOW);
+				}
+				surf = Mod_Mesh_AddSurface(mod, tex, true);
+				e0 = Mod_Mesh_AddVertex(mod, surf, x         , y   , 10, 0, 0, -1, s  , t  , 0, 0, DrawQ_Color[0], DrawQ_Color[1], DrawQ_Color[2], DrawQ_Color[3]);
+				e1 = Mod_Mesh_AddVertex(mod, surf, x+dw*thisw, y   , 10, 0, 0, -1, s+u, t  , 0, 0, DrawQ_Color[0], DrawQ_Color[1], DrawQ_Color[2], DrawQ_Color[3]);
+				e2 = Mod_Mesh_AddVertex(mod, surf, x+dw*thisw, y+dh, 10, 0, 0, -1, s+u, t+v, 0, 0, DrawQ_Color[0], DrawQ_Color[1], DrawQ_Color[2], DrawQ_Color[3]);
+				e3 = Mod_Mesh_AddVertex(mod, surf, x         , y+dh, 10, 0, 0, -1, s  , t+v, 0, 0, DrawQ_Color[0], DrawQ_Color[1], DrawQ_Color[2], DrawQ_Color[3]);
 				Mod_Mesh_AddTriangle(mod, surf, e0, e1, e2);
 				Mod_Mesh_AddTriangle(mod, surf, e0, e2, e3);
 				x += width_of[ch] * dw;
@@ -1286,11 +1382,16 @@ float DrawQ_String_Scale(float startx, float starty, const char *text, size_t ma
 				}
 				else
 					kx = ky = 0;
-				surf = Mod_Mesh_AddSurface(mod, Mod_Mesh_GetTexture(mod, map->pic->name, flags, TEXF_ALPHA | TEXF_CLAMP, MATERIALFLAG_WALL | MATERIALFLAG_VERTEXCOLOR | MATERIALFLAG_ALPHAGEN_VERTEX | MATERIALFLAG_ALPHA | MATERIALFLAG_BLENDED | MATERIALFLAG_NOSHADOW), true);
-				e0 = Mod_Mesh_IndexForVertex(mod, surf, x + dw * map->glyphs[mapch].vxmin, y + dh * map->glyphs[mapch].vymin, 10, 0, 0, -1, map->glyphs[mapch].txmin, map->glyphs[mapch].tymin, 0, 0, DrawQ_Color[0], DrawQ_Color[1], DrawQ_Color[2], DrawQ_Color[3]);
-				e1 = Mod_Mesh_IndexForVertex(mod, surf, x + dw * map->glyphs[mapch].vxmax, y + dh * map->glyphs[mapch].vymin, 10, 0, 0, -1, map->glyphs[mapch].txmax, map->glyphs[mapch].tymin, 0, 0, DrawQ_Color[0], DrawQ_Color[1], DrawQ_Color[2], DrawQ_Color[3]);
-				e2 = Mod_Mesh_IndexForVertex(mod, surf, x + dw * map->glyphs[mapch].vxmax, y + dh * map->glyphs[mapch].vymax, 10, 0, 0, -1, map->glyphs[mapch].txmax, map->glyphs[mapch].tymax, 0, 0, DrawQ_Color[0], DrawQ_Color[1], DrawQ_Color[2], DrawQ_Color[3]);
-				e3 = Mod_Mesh_IndexForVertex(mod, surf, x + dw * map->glyphs[mapch].vxmin, y + dh * map->glyphs[mapch].vymax, 10, 0, 0, -1, map->glyphs[mapch].txmin, map->glyphs[mapch].tymax, 0, 0, DrawQ_Color[0], DrawQ_Color[1], DrawQ_Color[2], DrawQ_Color[3]);
+				if (texname != map->pic->name)
+				{
+					texname = map->pic->name;
+					tex = Mod_Mesh_GetTexture(mod, texname, flags, TEXF_ALPHA | TEXF_CLAMP, MATERIALFLAG_WALL | MATERIALFLAG_VERTEXCOLOR | MATERIALFLAG_ALPHAGEN_VERTEX | MATERIALFLAG_ALPHA | MATERIALFLAG_BLENDED | MATERIALFLAG_NOSHADOW);
+				}
+				surf = Mod_Mesh_AddSurface(mod, tex, true);
+				e0 = Mod_Mesh_AddVertex(mod, surf, x + dw * map->glyphs[mapch].vxmin, y + dh * map->glyphs[mapch].vymin, 10, 0, 0, -1, map->glyphs[mapch].txmin, map->glyphs[mapch].tymin, 0, 0, DrawQ_Color[0], DrawQ_Color[1], DrawQ_Color[2], DrawQ_Color[3]);
+				e1 = Mod_Mesh_AddVertex(mod, surf, x + dw * map->glyphs[mapch].vxmax, y + dh * map->glyphs[mapch].vymin, 10, 0, 0, -1, map->glyphs[mapch].txmax, map->glyphs[mapch].tymin, 0, 0, DrawQ_Color[0], DrawQ_Color[1], DrawQ_Color[2], DrawQ_Color[3]);
+				e2 = Mod_Mesh_AddVertex(mod, surf, x + dw * map->glyphs[mapch].vxmax, y + dh * map->glyphs[mapch].vymax, 10, 0, 0, -1, map->glyphs[mapch].txmax, map->glyphs[mapch].tymax, 0, 0, DrawQ_Color[0], DrawQ_Color[1], DrawQ_Color[2], DrawQ_Color[3]);
+				e3 = Mod_Mesh_AddVertex(mod, surf, x + dw * map->glyphs[mapch].vxmin, y + dh * map->glyphs[mapch].vymax, 10, 0, 0, -1, map->glyphs[mapch].txmin, map->glyphs[mapch].tymax, 0, 0, DrawQ_Color[0], DrawQ_Color[1], DrawQ_Color[2], DrawQ_Color[3]);
 				Mod_Mesh_AddTriangle(mod, surf, e0, e1, e2);
 				Mod_Mesh_AddTriangle(mod, surf, e0, e2, e3);
 				//x -= ftbase_x;
@@ -1391,10 +1492,10 @@ void DrawQ_SuperPic(float x, float y, cachepic_t *pic, float width, float height
 	if (height == 0)
 		height = pic->height;
 	surf = Mod_Mesh_AddSurface(mod, Mod_Mesh_GetTexture(mod, pic->name, flags, pic->texflags, MATERIALFLAG_WALL | MATERIALFLAG_VERTEXCOLOR | MATERIALFLAG_ALPHAGEN_VERTEX | MATERIALFLAG_ALPHA | MATERIALFLAG_BLENDED | MATERIALFLAG_NOSHADOW), true);
-	e0 = Mod_Mesh_IndexForVertex(mod, surf, x        , y         , 0, 0, 0, -1, s1, t1, 0, 0, r1, g1, b1, a1);
-	e1 = Mod_Mesh_IndexForVertex(mod, surf, x + width, y         , 0, 0, 0, -1, s2, t2, 0, 0, r2, g2, b2, a2);
-	e2 = Mod_Mesh_IndexForVertex(mod, surf, x + width, y + height, 0, 0, 0, -1, s4, t4, 0, 0, r4, g4, b4, a4);
-	e3 = Mod_Mesh_IndexForVertex(mod, surf, x        , y + height, 0, 0, 0, -1, s3, t3, 0, 0, r3, g3, b3, a3);
+	e0 = Mod_Mesh_AddVertex(mod, surf, x        , y         , 0, 0, 0, -1, s1, t1, 0, 0, r1, g1, b1, a1);
+	e1 = Mod_Mesh_AddVertex(mod, surf, x + width, y         , 0, 0, 0, -1, s2, t2, 0, 0, r2, g2, b2, a2);
+	e2 = Mod_Mesh_AddVertex(mod, surf, x + width, y + height, 0, 0, 0, -1, s4, t4, 0, 0, r4, g4, b4, a4);
+	e3 = Mod_Mesh_AddVertex(mod, surf, x        , y + height, 0, 0, 0, -1, s3, t3, 0, 0, r3, g3, b3, a3);
 	Mod_Mesh_AddTriangle(mod, surf, e0, e1, e2);
 	Mod_Mesh_AddTriangle(mod, surf, e0, e2, e3);
 }
@@ -1417,10 +1518,10 @@ void DrawQ_Line (float width, float x1, float y1, float x2, float y2, float r, f
 		offsety = 0;
 	}
 	surf = Mod_Mesh_AddSurface(mod, Mod_Mesh_GetTexture(mod, "white", 0, 0, MATERIALFLAG_WALL | MATERIALFLAG_VERTEXCOLOR | MATERIALFLAG_ALPHAGEN_VERTEX | MATERIALFLAG_ALPHA | MATERIALFLAG_BLENDED | MATERIALFLAG_NOSHADOW), true);
-	e0 = Mod_Mesh_IndexForVertex(mod, surf, x1 - offsetx, y1 - offsety, 10, 0, 0, -1, 0, 0, 0, 0, r, g, b, alpha);
-	e1 = Mod_Mesh_IndexForVertex(mod, surf, x2 - offsetx, y2 - offsety, 10, 0, 0, -1, 0, 0, 0, 0, r, g, b, alpha);
-	e2 = Mod_Mesh_IndexForVertex(mod, surf, x2 + offsetx, y2 + offsety, 10, 0, 0, -1, 0, 0, 0, 0, r, g, b, alpha);
-	e3 = Mod_Mesh_IndexForVertex(mod, surf, x1 + offsetx, y1 + offsety, 10, 0, 0, -1, 0, 0, 0, 0, r, g, b, alpha);
+	e0 = Mod_Mesh_AddVertex(mod, surf, x1 - offsetx, y1 - offsety, 10, 0, 0, -1, 0, 0, 0, 0, r, g, b, alpha);
+	e1 = Mod_Mesh_AddVertex(mod, surf, x2 - offsetx, y2 - offsety, 10, 0, 0, -1, 0, 0, 0, 0, r, g, b, alpha);
+	e2 = Mod_Mesh_AddVertex(mod, surf, x2 + offsetx, y2 + offsety, 10, 0, 0, -1, 0, 0, 0, 0, r, g, b, alpha);
+	e3 = Mod_Mesh_AddVertex(mod, surf, x1 + offsetx, y1 + offsety, 10, 0, 0, -1, 0, 0, 0, 0, r, g, b, alpha);
 	Mod_Mesh_AddTriangle(mod, surf, e0, e1, e2);
 	Mod_Mesh_AddTriangle(mod, surf, e0, e2, e3);
 }
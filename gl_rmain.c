@@ -27,6 +27,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "csprogs.h"
 #include "cl_video.h"
 #include "cl_collision.h"
+#include "taskqueue.h"
 
 #ifdef WIN32
 // Enable NVIDIA High Performance Graphics while using Integrated Graphics.
@@ -141,6 +142,7 @@ cvar_t r_transparentdepthmasking = {CF_CLIENT | CF_ARCHIVE, "r_transparentdepthm
 cvar_t r_transparent_sortmindist = {CF_CLIENT | CF_ARCHIVE, "r_transparent_sortmindist", "0", "lower distance limit for transparent sorting"};
 cvar_t r_transparent_sortmaxdist = {CF_CLIENT | CF_ARCHIVE, "r_transparent_sortmaxdist", "32768", "upper distance limit for transparent sorting"};
 cvar_t r_transparent_sortarraysize = {CF_CLIENT | CF_ARCHIVE, "r_transparent_sortarraysize", "4096", "number of distance-sorting layers"};
+cvar_t r_transparent_sortbatches = {CF_CLIENT | CF_ARCHIVE, "r_transparent_sortbatches", "1", "within each distance-sorting layer, draw the surfaces of the same entity, light and renderer together so they need fewer batches"};
 cvar_t r_celshading = {CF_CLIENT | CF_ARCHIVE, "r_celshading", "0", "cartoon-style light shading (OpenGL 2.x only)"}; // FIXME remove OpenGL 2.x only once implemented for DX9
 cvar_t r_celoutlines = {CF_CLIENT | CF_ARCHIVE, "r_celoutlines", "0", "cartoon-style outlines (requires r_shadow_deferred)"};
 
@@ -154,6 +156,9 @@ cvar_t gl_fogend = {CF_CLIENT, "gl_fogend","0", "nehahra fog end distance (for N
 cvar_t gl_skyclip = {CF_CLIENT, "gl_skyclip", "4608", "nehahra farclip distance - the real fog end (for Nehahra compatibility only)"};
 
 cvar_t r_texture_dds_load = {CF_CLIENT | CF_ARCHIVE, "r_texture_dds_load", "0", "load compressed dds/filename.dds texture instead of filename.tga, if the file exists (requires driver support)"};
+cvar_t r_texture_threaded = {CF_CLIENT | CF_ARCHIVE, "r_texture_threaded", "1", "read and decode the external textures of a map on the taskqueue while the textures before them are uploaded"};
+cvar_t r_texture_cache = {CF_CLIENT | CF_ARCHIVE, "r_texture_cache", "1", "save uploaded textures in texturecache/, named after a checksum of the image file, and load them from there instead of decoding the image again (not used with r_texture_dds_load)"};
+cvar_t r_texture_cache_maxsize = {CF_CLIENT | CF_ARCHIVE, "r_texture_cache_maxsize", "512", "size limit of texturecache/ in megabytes, files not used in this session are deleted first when a map is loaded, 0 is unlimited"};
 cvar_t r_texture_dds_save = {CF_CLIENT | CF_ARCHIVE, "r_texture_dds_save", "0", "save compressed dds/filename.dds texture when filename.tga is loaded, so that it can be loaded instead next time"};
 
 cvar_t r_usedepthtextures = {CF_CLIENT | CF_ARCHIVE, "r_usedepthtextures", "1", "use depth texture instead of depth renderbuffer where possible, uses less video memory but may render slower (or faster) depending on hardware"};
@@ -167,6 +172,8 @@ cvar_t r_viewscale_fpsscaling_stepsize = {CF_CLIENT | CF_ARCHIVE, "r_viewscale_f
 cvar_t r_viewscale_fpsscaling_stepmax = {CF_CLIENT | CF_ARCHIVE, "r_viewscale_fpsscaling_stepmax", "1.00", "largest adjustment to hit the target framerate (this value prevents wild overshooting of the estimate)"};
 cvar_t r_viewscale_fpsscaling_target = {CF_CLIENT | CF_ARCHIVE, "r_viewscale_fpsscaling_target", "70", "desired framerate"};
 
+cvar_t r_animcache_share = {CF_CLIENT | CF_ARCHIVE, "r_animcache_share", "1", "entities with the same model, frame blend and skeleton pose share one animated mesh per frame"};
+cvar_t r_animcache_threaded = {CF_CLIENT | CF_ARCHIVE, "r_animcache_threaded", "1", "animate the vertices of all visible models at once using taskqueue_maxthreads"};
 cvar_t r_glsl_skeletal = {CF_CLIENT | CF_ARCHIVE, "r_glsl_skeletal", "1", "render skeletal models faster using a gpu-skinning technique"};
 cvar_t r_glsl_deluxemapping = {CF_CLIENT | CF_ARCHIVE, "r_glsl_deluxemapping", "1", "use per pixel lighting on deluxemap-compiled q3bsp maps (or a value of 2 forces deluxemap shading even without deluxemaps)"};
 cvar_t r_glsl_offsetmapping = {CF_CLIENT | CF_ARCHIVE, "r_glsl_offsetmapping", "0", "offset mapping effect (also known as parallax mapping or virtual displacement mapping)"};
@@ -2311,6 +2318,549 @@ skinframe_t *R_SkinFrame_Find(const char *name, int textureflags, int comparewid
 		skinframe->avgcolor[3] = avgcolor[4] / (255.0 * cnt); \
 	}
 
+// the external images that make up a skinframe
+typedef enum r_skinframe_layer_e
+{
+	SKINFRAME_LAYER_BASE,
+	SKINFRAME_LAYER_NMAP,
+	SKINFRAME_LAYER_GLOW,
+	SKINFRAME_LAYER_GLOSS,
+	SKINFRAME_LAYER_PANTS,
+	SKINFRAME_LAYER_SHIRT,
+	SKINFRAME_LAYER_REFLECT,
+	SKINFRAME_LAYER_COUNT
+}
+r_skinframe_layer_t;
+
+typedef struct r_skinframe_image_s
+{
+	unsigned char *pixels;
+	int width;
+	int height;
+	int miplevel;
+	// decoding was done, pixels is NULL if there was no image file
+	qbool decoded;
+	// texture cache file of the image, only set if the texture cache is in
+	// use and the image file exists
+	unsigned char digest[16];
+	char cachename[MAX_QPATH];
+	// the texture cache file exists, so the image may not need decoding
+	qbool cached;
+}
+r_skinframe_image_t;
+
+// how the layers other than the base are uploaded
+typedef struct r_skinframe_layerinfo_s
+{
+	const char *texturesuffix; // added to the basename for the texture name
+	const char *ddssuffix; // added to the basename for the dds/ file (and the image file)
+	qbool srgb; // uploaded as sRGB if vid.sRGB3D
+	qbool ddshasalpha; // saved with alpha
+}
+r_skinframe_layerinfo_t;
+
+static const r_skinframe_layerinfo_t r_skinframe_layerinfo[SKINFRAME_LAYER_COUNT] =
+{
+	{"", "", true, false},
+	{"_nmap", "_norm", false, true},
+	{"_glow", "_glow", true, true},
+	{"_gloss", "_gloss", true, true},
+	{"_pants", "_pants", true, false},
+	{"_shirt", "_shirt", true, false},
+	{"_reflect", "_reflect", true, true},
+};
+
+// the images of an external skinframe being read and decoded on the taskqueue,
+// R_SkinFrame_LoadExternal_SkinFrame picks them up and only does the upload
+typedef struct r_skinframe_prefetch_s
+{
+	taskqueue_task_t task;
+	struct r_skinframe_prefetch_s *next; // next on hash chain
+	char name[MAX_QPATH];
+	char basename[MAX_QPATH];
+	int textureflags;
+	qbool complain;
+	r_skinframe_image_t images[SKINFRAME_LAYER_COUNT];
+}
+r_skinframe_prefetch_t;
+
+static r_skinframe_prefetch_t *r_skinframe_prefetchhash[SKINFRAME_HASH];
+static int r_skinframe_numprefetches;
+
+// texture cache files loaded or saved this session, pruned last
+static stringlist_t r_texturecache_used;
+
+// bump this when the contents of texture cache files change
+#define R_TEXTURECACHE_VERSION 1
+
+// the texture flags a layer is uploaded with
+static int R_SkinFrame_LayerTextureFlags(r_skinframe_layer_t layer, int textureflags)
+{
+	switch (layer)
+	{
+	case SKINFRAME_LAYER_NMAP:
+		return (TEXF_ALPHA | textureflags) & (r_mipnormalmaps.integer ? ~0 : ~TEXF_MIPMAP) & (gl_texturecompression_normal.integer && gl_texturecompression.integer ? ~0 : ~TEXF_COMPRESS);
+	case SKINFRAME_LAYER_GLOW:
+		return textureflags & (gl_texturecompression_glow.integer && gl_texturecompression.integer ? ~0 : ~TEXF_COMPRESS);
+	case SKINFRAME_LAYER_GLOSS:
+		return (TEXF_ALPHA | textureflags) & (gl_texturecompression_gloss.integer && gl_texturecompression.integer ? ~0 : ~TEXF_COMPRESS);
+	case SKINFRAME_LAYER_REFLECT:
+		return textureflags & (gl_texturecompression_reflectmask.integer && gl_texturecompression.integer ? ~0 : ~TEXF_COMPRESS);
+	default:
+		return textureflags & (gl_texturecompression_color.integer && gl_texturecompression.integer ? ~0 : ~TEXF_COMPRESS);
+	}
+}
+
+static rtexture_t **R_SkinFrame_LayerTexture(skinframe_t *skinframe, r_skinframe_layer_t layer)
+{
+	switch (layer)
+	{
+	case SKINFRAME_LAYER_NMAP:
+		return &skinframe->nmap;
+	case SKINFRAME_LAYER_GLOW:
+		return &skinframe->glow;
+	case SKINFRAME_LAYER_GLOSS:
+		return &skinframe->gloss;
+	case SKINFRAME_LAYER_PANTS:
+		return &skinframe->pants;
+	case SKINFRAME_LAYER_SHIRT:
+		return &skinframe->shirt;
+	case SKINFRAME_LAYER_REFLECT:
+		return &skinframe->reflect;
+	default:
+		return &skinframe->base;
+	}
+}
+
+static qbool R_SkinFrame_UseTextureCache(void)
+{
+#ifdef USE_GLES2
+	// textures can not be read back to save them
+	return false;
+#else
+	return r_texture_cache.integer && !r_loaddds;
+#endif
+}
+
+extern cvar_t gl_max_size;
+/*
+================
+R_SkinFrame_SetCacheName
+
+Names the texture cache file of an image after the checksum of its source
+file and everything else that changes the uploaded texture, so a changed
+file or setting never picks up a stale texture.
+================
+*/
+static void R_SkinFrame_SetCacheName(r_skinframe_image_t *image, const unsigned char *sourcedigest, int layer, int source, int textureflags)
+{
+	int i, params[16];
+	unsigned char key[16 + sizeof(params)];
+
+	params[0] = R_TEXTURECACHE_VERSION;
+	params[1] = layer;
+	params[2] = source;
+	params[3] = textureflags & ~TEXF_FORCE_RELOAD;
+	params[4] = image->miplevel;
+	params[5] = vid.sRGB3D;
+	params[6] = gl_texturecompression.integer;
+	params[7] = gl_texturecompression_color.integer;
+	params[8] = gl_texturecompression_normal.integer;
+	params[9] = gl_texturecompression_gloss.integer;
+	params[10] = gl_texturecompression_glow.integer;
+	params[11] = gl_texturecompression_reflectmask.integer;
+	params[12] = r_mipnormalmaps.integer;
+	params[13] = gl_max_size.integer;
+	params[14] = r_fixtrans_auto.integer;
+	params[15] = (int)(r_shadow_bumpscale_bumpmap.value * 1000.0f) * 65536 + (int)(r_shadow_bumpscale_basetexture.value * 1000.0f);
+	memcpy(key, sourcedigest, 16);
+	memcpy(key + 16, params, sizeof(params));
+	Com_BlockFullChecksum(key, sizeof(key), image->digest);
+
+	dp_strlcpy(image->cachename, "texturecache/", sizeof(image->cachename));
+	for (i = 0;i < 16;i++)
+		dpsnprintf(image->cachename + 13 + i * 2, 3, "%02x", image->digest[i]);
+	dp_strlcat(image->cachename, ".dds", sizeof(image->cachename));
+	image->cached = FS_FileExists(image->cachename) != NULL;
+}
+
+// R_SkinFrame_DecodeExternalImage only falls through to a later image when
+// the earlier ones fail to decode, so once one is found the checksums of the
+// later ones are folded into its digest
+static qbool R_SkinFrame_ChecksumNextDigest(unsigned char *digest, qbool found, const unsigned char *nextdigest)
+{
+	unsigned char data[32];
+	if (found)
+	{
+		memcpy(data, digest, 16);
+		memcpy(data + 16, nextdigest, 16);
+		Com_BlockFullChecksum(data, sizeof(data), digest);
+	}
+	else
+		memcpy(digest, nextdigest, 16);
+	return true;
+}
+
+static qbool R_SkinFrame_ChecksumNextImage(unsigned char *digest, qbool found, const char *name)
+{
+	unsigned char nextdigest[16];
+	if (!Image_ChecksumImageFile(name, nextdigest))
+		return found;
+	return R_SkinFrame_ChecksumNextDigest(digest, found, nextdigest);
+}
+
+/*
+================
+R_SkinFrame_FindExternalImage
+
+Looks for the texture cache file of one of the external images of a
+skinframe.  The source image files are found the same way as
+R_SkinFrame_DecodeExternalImage does and checksummed, but not decoded.
+================
+*/
+static void R_SkinFrame_FindExternalImage(r_skinframe_layer_t layer, const char *name, const char *basename, int textureflags, const r_skinframe_image_t *base, r_skinframe_image_t *image)
+{
+	static const char *glowsuffixes[4] = {"_glow", ".blend", "_blend", "_luma"};
+	unsigned char digest[16];
+	int source = 0;
+	int i;
+	qbool found = false;
+	char vabuf[1024];
+
+	if (!R_SkinFrame_UseTextureCache())
+		return;
+
+	switch (layer)
+	{
+	case SKINFRAME_LAYER_BASE:
+		found = Image_ChecksumImageFile(name, digest);
+		break;
+	case SKINFRAME_LAYER_NMAP:
+		found = R_SkinFrame_ChecksumNextImage(digest, found, va(vabuf, sizeof(vabuf), "%s_norm", basename));
+		if (!found)
+			source = 1;
+		if (r_shadow_bumpscale_bumpmap.value > 0)
+			found = R_SkinFrame_ChecksumNextImage(digest, found, va(vabuf, sizeof(vabuf), "%s_bump", basename));
+		// generated from the base image
+		if (!found)
+			source = 2;
+		if (r_shadow_bumpscale_basetexture.value > 0 && base->cachename[0])
+			found = R_SkinFrame_ChecksumNextDigest(digest, found, base->digest);
+		break;
+	case SKINFRAME_LAYER_GLOW:
+		for (i = 0;i < 4;i++)
+		{
+			if (!found)
+				source = i;
+			found = R_SkinFrame_ChecksumNextImage(digest, found, va(vabuf, sizeof(vabuf), "%s%s", basename, glowsuffixes[i]));
+		}
+		break;
+	default:
+		found = Image_ChecksumImageFile(va(vabuf, sizeof(vabuf), "%s%s", basename, r_skinframe_layerinfo[layer].ddssuffix), digest);
+		break;
+	}
+	if (!found)
+		return;
+	R_SkinFrame_SetCacheName(image, digest, layer, source, textureflags);
+}
+
+/*
+================
+R_SkinFrame_DecodeExternalImage
+
+Reads and decodes one of the external images of a skinframe into
+image->pixels, the miplevel is updated like loadimagepixelsbgra does.  This
+does not touch any textures so it can run on the taskqueue.
+================
+*/
+static void R_SkinFrame_DecodeExternalImage(r_skinframe_layer_t layer, const char *name, const char *basename, qbool complain, r_skinframe_image_t *base, r_skinframe_image_t *image)
+{
+	unsigned char *pixels = NULL;
+	unsigned char *bumppixels;
+	char vabuf[1024];
+
+	image->decoded = true;
+	switch (layer)
+	{
+	case SKINFRAME_LAYER_BASE:
+		pixels = loadimagepixelsbgra(name, complain, true, false, &image->miplevel);
+		break;
+	case SKINFRAME_LAYER_NMAP:
+		// _norm is the name used by tenebrae and has been adopted as standard
+		if ((pixels = loadimagepixelsbgra(va(vabuf, sizeof(vabuf), "%s_norm", basename), false, false, false, &image->miplevel)) != NULL)
+			break;
+		if (r_shadow_bumpscale_bumpmap.value > 0 && (bumppixels = loadimagepixelsbgra(va(vabuf, sizeof(vabuf), "%s_bump", basename), false, false, false, &image->miplevel)) != NULL)
+		{
+			pixels = (unsigned char *)Mem_Alloc(tempmempool, image_width * image_height * 4);
+			Image_HeightmapToNormalmap_BGRA(bumppixels, pixels, image_width, image_height, false, r_shadow_bumpscale_bumpmap.value);
+			Mem_Free(bumppixels);
+			break;
+		}
+		if (r_shadow_bumpscale_basetexture.value > 0)
+		{
+			// the base texture may have come from the texture cache
+			if (!base->decoded)
+				R_SkinFrame_DecodeExternalImage(SKINFRAME_LAYER_BASE, name, basename, false, NULL, base);
+			if (!base->pixels)
+				break;
+			image->pixels = (unsigned char *)Mem_Alloc(tempmempool, base->width * base->height * 4);
+			image->width = base->width;
+			image->height = base->height;
+			Image_HeightmapToNormalmap_BGRA(base->pixels, image->pixels, base->width, base->height, false, r_shadow_bumpscale_basetexture.value);
+			return;
+		}
+		break;
+	case SKINFRAME_LAYER_GLOW:
+		// _luma is supported only for tenebrae compatibility
+		// _blend and .blend are supported only for Q3 & QL compatibility, this hack can be removed if better Q3 shader support is implemented
+		// _glow is the preferred name
+		if (!(pixels = loadimagepixelsbgra(va(vabuf, sizeof(vabuf), "%s_glow", basename), false, false, false, &image->miplevel))
+		 && !(pixels = loadimagepixelsbgra(va(vabuf, sizeof(vabuf), "%s.blend", basename), false, false, false, &image->miplevel))
+		 && !(pixels = loadimagepixelsbgra(va(vabuf, sizeof(vabuf), "%s_blend", basename), false, false, false, &image->miplevel)))
+			pixels = loadimagepixelsbgra(va(vabuf, sizeof(vabuf), "%s_luma", basename), false, false, false, &image->miplevel);
+		break;
+	case SKINFRAME_LAYER_GLOSS:
+	case SKINFRAME_LAYER_PANTS:
+	case SKINFRAME_LAYER_SHIRT:
+	case SKINFRAME_LAYER_REFLECT:
+		pixels = loadimagepixelsbgra(va(vabuf, sizeof(vabuf), "%s%s", basename, r_skinframe_layerinfo[layer].ddssuffix), false, false, false, &image->miplevel);
+		break;
+	default:
+		break;
+	}
+	image->pixels = pixels;
+	image->width = pixels ? image_width : 0;
+	image->height = pixels ? image_height : 0;
+}
+
+// hands the image over from the prefetch, the caller owns the pixels
+static void R_SkinFrame_TakeExternalImage(r_skinframe_prefetch_t *prefetch, r_skinframe_layer_t layer, r_skinframe_image_t *image)
+{
+	*image = prefetch->images[layer];
+	prefetch->images[layer].pixels = NULL;
+}
+
+// loads the texture of an image from the texture cache if it is there
+static rtexture_t *R_SkinFrame_LoadCachedTexture(const r_skinframe_image_t *image, qbool srgb, int flags, qbool *hasalpha, float *avgcolor)
+{
+	rtexture_t *texture;
+	if (!image->cached)
+		return NULL;
+	// the picmip was already applied to the saved texture
+	texture = R_LoadTextureDDSFile(r_main_texturepool, image->cachename, srgb, flags, hasalpha, avgcolor, 0, true);
+	if (texture)
+		stringlistappend(&r_texturecache_used, image->cachename);
+	return texture;
+}
+
+static void R_SkinFrame_SaveCachedTexture(rtexture_t *texture, const r_skinframe_image_t *image, qbool hasalpha)
+{
+	if (!texture || !image->cachename[0])
+		return;
+	if (R_SaveTextureDDSFile(texture, image->cachename, false, hasalpha) > 0)
+		stringlistappend(&r_texturecache_used, image->cachename);
+}
+
+static void R_SkinFrame_Prefetch_Task(taskqueue_task_t *t)
+{
+	r_skinframe_prefetch_t *prefetch = (r_skinframe_prefetch_t *)t->p[0];
+	r_skinframe_image_t *base = &prefetch->images[SKINFRAME_LAYER_BASE];
+	r_skinframe_image_t *image;
+	int layer;
+	image_nokeepalive = true;
+	// images in the texture cache are not decoded at all
+	R_SkinFrame_FindExternalImage(SKINFRAME_LAYER_BASE, prefetch->name, prefetch->basename, prefetch->textureflags, NULL, base);
+	if (!base->cached)
+		R_SkinFrame_DecodeExternalImage(SKINFRAME_LAYER_BASE, prefetch->name, prefetch->basename, prefetch->complain, NULL, base);
+	// without a base image the main thread gives up (or uses the notexture
+	// image and loads the rest itself)
+	if (base->cached || base->pixels)
+	{
+		for (layer = SKINFRAME_LAYER_NMAP;layer < SKINFRAME_LAYER_COUNT;layer++)
+		{
+			if ((layer == SKINFRAME_LAYER_NMAP && !r_loadnormalmap) || (layer == SKINFRAME_LAYER_GLOSS && !r_loadgloss))
+				continue;
+			image = &prefetch->images[layer];
+			R_SkinFrame_FindExternalImage((r_skinframe_layer_t)layer, prefetch->name, prefetch->basename, prefetch->textureflags, base, image);
+			if (!image->cached)
+				R_SkinFrame_DecodeExternalImage((r_skinframe_layer_t)layer, prefetch->name, prefetch->basename, false, base, image);
+		}
+	}
+	image_nokeepalive = false;
+	t->done = 1;
+}
+
+static void R_SkinFrame_FreePrefetch(r_skinframe_prefetch_t *prefetch)
+{
+	int i;
+	if (!prefetch)
+		return;
+	for (i = 0;i < SKINFRAME_LAYER_COUNT;i++)
+		if (prefetch->images[i].pixels)
+			Mem_Free(prefetch->images[i].pixels);
+	Mem_Free(prefetch);
+}
+
+// removes the prefetch for this skinframe from the hash and waits for its images
+static r_skinframe_prefetch_t *R_SkinFrame_TakePrefetch(const char *basename, int textureflags)
+{
+	r_skinframe_prefetch_t **link, *prefetch;
+	int hashindex = CRC_Block((unsigned char *)basename, strlen(basename)) & (SKINFRAME_HASH - 1);
+	textureflags &= ~TEXF_FORCE_RELOAD;
+	for (link = &r_skinframe_prefetchhash[hashindex];(prefetch = *link);link = &prefetch->next)
+	{
+		if (prefetch->textureflags == textureflags && !strcmp(prefetch->basename, basename))
+		{
+			*link = prefetch->next;
+			r_skinframe_numprefetches--;
+			TaskQueue_WaitForTaskDone(&prefetch->task);
+			return prefetch;
+		}
+	}
+	return NULL;
+}
+
+/*
+================
+R_SkinFrame_PrefetchExternal
+
+Starts reading and decoding the images of a skinframe on the taskqueue, so
+that a later R_SkinFrame_LoadExternal of the same name and flags only has to
+upload them.  Loaders call this for all of their textures before loading
+them, keeping R_SkinFrame_PrefetchRoom above zero, and
+R_SkinFrame_FinishPrefetch afterwards to drop the ones that ended up unused.
+================
+*/
+void R_SkinFrame_PrefetchExternal(const char *name, int textureflags, qbool complain)
+{
+	r_skinframe_prefetch_t *prefetch;
+	skinframe_t *skinframe;
+	char basename[MAX_QPATH];
+	int i, hashindex;
+
+	if (cls.state == ca_dedicated || !r_texture_threaded.integer || !name || !name[0])
+		return;
+	// dds files are uploaded directly and the gfx.wad lumps are not safe to
+	// read from another thread
+	if (r_loaddds || !strncasecmp(name, "gfx/", 4) || !strncasecmp(name, "locale/", 7))
+		return;
+	textureflags &= ~TEXF_FORCE_RELOAD;
+
+	// nothing to do if it is already loaded
+	for (skinframe = R_SkinFrame_FindNextByName(NULL, name);skinframe;skinframe = R_SkinFrame_FindNextByName(skinframe, name))
+		if (skinframe->base && skinframe->textureflags == (textureflags & TEXF_IMPORTANTBITS) && !skinframe->comparewidth && !skinframe->compareheight && !skinframe->comparecrc)
+			return;
+
+	Image_StripImageExtension(name, basename, sizeof(basename));
+	hashindex = CRC_Block((unsigned char *)basename, strlen(basename)) & (SKINFRAME_HASH - 1);
+	for (prefetch = r_skinframe_prefetchhash[hashindex];prefetch;prefetch = prefetch->next)
+		if (prefetch->textureflags == textureflags && !strcmp(prefetch->basename, basename))
+			return;
+
+	prefetch = (r_skinframe_prefetch_t *)Mem_Alloc(r_main_mempool, sizeof(*prefetch));
+	dp_strlcpy(prefetch->name, name, sizeof(prefetch->name));
+	dp_strlcpy(prefetch->basename, basename, sizeof(prefetch->basename));
+	prefetch->textureflags = textureflags;
+	prefetch->complain = complain;
+	for (i = 0;i < SKINFRAME_LAYER_COUNT;i++)
+		prefetch->images[i].miplevel = R_PicmipForFlags(textureflags);
+	prefetch->next = r_skinframe_prefetchhash[hashindex];
+	r_skinframe_prefetchhash[hashindex] = prefetch;
+	r_skinframe_numprefetches++;
+	TaskQueue_Setup(&prefetch->task, NULL, R_SkinFrame_Prefetch_Task, 0, 0, prefetch, NULL);
+	TaskQueue_Enqueue(1, &prefetch->task);
+}
+
+/*
+================
+R_SkinFrame_PrefetchRoom
+
+how many more skinframes may be prefetched, every outstanding one holds the
+decoded images of all of its layers until it is uploaded
+================
+*/
+int R_SkinFrame_PrefetchRoom(void)
+{
+	return (TaskQueue_NumThreads() + 1) * 4 - r_skinframe_numprefetches;
+}
+
+void R_SkinFrame_FinishPrefetch(void)
+{
+	int i;
+	r_skinframe_prefetch_t *prefetch;
+	for (i = 0;i < SKINFRAME_HASH;i++)
+	{
+		while ((prefetch = r_skinframe_prefetchhash[i]))
+		{
+			r_skinframe_prefetchhash[i] = prefetch->next;
+			TaskQueue_WaitForTaskDone(&prefetch->task);
+			R_SkinFrame_FreePrefetch(prefetch);
+		}
+	}
+	r_skinframe_numprefetches = 0;
+}
+
+static int R_SkinFrame_TextureCacheUsed_cmp(const void *a, const void *b)
+{
+	return strcasecmp(*(const char **)a, *(const char **)b);
+}
+
+/*
+================
+R_SkinFrame_PruneTextureCache
+
+Deletes texture cache files until the cache fits in r_texture_cache_maxsize,
+the files not used in this session go first.
+================
+*/
+static void R_SkinFrame_PruneTextureCache(void)
+{
+	fssearch_t *search;
+	qfile_t *file;
+	fs_offset_t *sizes, totalsize, maxsize;
+	const char *filename;
+	int i, pass, numremoved = 0;
+
+	if (cls.state == ca_dedicated || r_texture_cache_maxsize.value <= 0)
+		return;
+	if (!(search = FS_Search("texturecache/*.dds", true, true, NULL)))
+		return;
+	maxsize = (fs_offset_t)(r_texture_cache_maxsize.value * 1048576.0);
+	sizes = (fs_offset_t *)Mem_Alloc(tempmempool, search->numfilenames * sizeof(*sizes));
+	totalsize = 0;
+	for (i = 0;i < search->numfilenames;i++)
+	{
+		if ((file = FS_OpenRealFile(search->filenames[i], "rb", true)))
+		{
+			sizes[i] = FS_FileSize(file);
+			totalsize += sizes[i];
+			FS_Close(file);
+		}
+	}
+	stringlistsort(&r_texturecache_used, true);
+	for (pass = 0;pass < 2 && totalsize > maxsize;pass++)
+	{
+		for (i = 0;i < search->numfilenames && totalsize > maxsize;i++)
+		{
+			filename = search->filenames[i];
+			if (!sizes[i] || (pass == 0 && bsearch(&filename, r_texturecache_used.strings, r_texturecache_used.numstrings, sizeof(*r_texturecache_used.strings), R_SkinFrame_TextureCacheUsed_cmp)))
+				continue;
+			if ((file = FS_OpenRealFile(filename, "rb", true)))
+			{
+				FS_RemoveOnClose(file);
+				FS_Close(file);
+				totalsize -= sizes[i];
+				sizes[i] = 0;
+				numremoved++;
+			}
+		}
+	}
+	if (numremoved && developer_loading.integer)
+		Con_Printf("removed %i texture cache files, %.1f MB left\n", numremoved, totalsize / 1048576.0);
+	Mem_Free(sizes);
+	FS_FreeSearch(search);
+}
+
 skinframe_t *R_SkinFrame_LoadExternal(const char *name, int textureflags, qbool complain, qbool fallbacknotexture)
 {
 	skinframe_t *skinframe;
@@ -2327,17 +2877,103 @@ skinframe_t *R_SkinFrame_LoadExternal(const char *name, int textureflags, qbool
 	return R_SkinFrame_LoadExternal_SkinFrame(skinframe, name, textureflags, complain, fallbacknotexture);
 }
 
+/*
+================
+R_SkinFrame_LoadFogMask
+
+The fog texture of a transparent base image, white with its alpha.
+================
+*/
+static rtexture_t *R_SkinFrame_LoadFogMask(skinframe_t *skinframe, const char *name, int textureflags, r_skinframe_image_t *base)
+{
+	int j, flags = R_SkinFrame_LayerTextureFlags(SKINFRAME_LAYER_BASE, textureflags);
+	unsigned char *pixels;
+	r_skinframe_image_t mask;
+	rtexture_t *texture;
+	char vabuf[1024];
+
+	// the digest of the base image covers its miplevel already
+	memset(&mask, 0, sizeof(mask));
+	if (base->cachename[0])
+		R_SkinFrame_SetCacheName(&mask, base->digest, SKINFRAME_LAYER_COUNT, 0, textureflags);
+	if ((texture = R_SkinFrame_LoadCachedTexture(&mask, false, flags, NULL, NULL)))
+		return texture;
+
+	if (!base->decoded)
+		R_SkinFrame_DecodeExternalImage(SKINFRAME_LAYER_BASE, name, skinframe->basename, false, NULL, base);
+	if (!base->pixels)
+		return NULL;
+	pixels = (unsigned char *)Mem_Alloc(tempmempool, base->width * base->height * 4);
+	for (j = 0;j < base->width * base->height * 4;j += 4)
+	{
+		pixels[j+0] = 255;
+		pixels[j+1] = 255;
+		pixels[j+2] = 255;
+		pixels[j+3] = base->pixels[j+3];
+	}
+	texture = R_LoadTexture2D (r_main_texturepool, va(vabuf, sizeof(vabuf), "%s_mask", skinframe->basename), base->width, base->height, pixels, TEXTYPE_BGRA, flags, base->miplevel, NULL);
+	Mem_Free(pixels);
+	R_SkinFrame_SaveCachedTexture(texture, &mask, true);
+	return texture;
+}
+
+/*
+================
+R_SkinFrame_LoadExternalLayer
+
+Uploads one of the external images of a skinframe other than the base, or
+loads it from the texture cache.
+================
+*/
+static rtexture_t *R_SkinFrame_LoadExternalLayer(skinframe_t *skinframe, r_skinframe_prefetch_t *prefetch, r_skinframe_layer_t layer, const char *name, int textureflags, int miplevel, r_skinframe_image_t *base)
+{
+	const r_skinframe_layerinfo_t *info = &r_skinframe_layerinfo[layer];
+	int flags = R_SkinFrame_LayerTextureFlags(layer, textureflags);
+	qbool srgb = info->srgb && vid.sRGB3D;
+	r_skinframe_image_t image;
+	rtexture_t *texture;
+	char vabuf[1024];
+
+	if (prefetch)
+		R_SkinFrame_TakeExternalImage(prefetch, layer, &image);
+	else
+	{
+		memset(&image, 0, sizeof(image));
+		image.miplevel = miplevel;
+		R_SkinFrame_FindExternalImage(layer, name, skinframe->basename, textureflags, base, &image);
+	}
+
+	if ((texture = R_SkinFrame_LoadCachedTexture(&image, srgb, flags, NULL, NULL)))
+	{
+		if (image.pixels)
+			Mem_Free(image.pixels);
+		return texture;
+	}
+
+	if (!image.decoded)
+		R_SkinFrame_DecodeExternalImage(layer, name, skinframe->basename, false, base, &image);
+	if (!image.pixels)
+		return NULL;
+	texture = R_LoadTexture2D (r_main_texturepool, va(vabuf, sizeof(vabuf), "%s%s", skinframe->basename, info->texturesuffix), image.width, image.height, image.pixels, srgb ? TEXTYPE_SRGB_BGRA : TEXTYPE_BGRA, flags, image.miplevel, NULL);
+#ifndef USE_GLES2
+	if (r_savedds && texture)
+		R_SaveTextureDDSFile(texture, va(vabuf, sizeof(vabuf), "dds/%s%s.dds", skinframe->basename, info->ddssuffix), r_texture_dds_save.integer < 2, info->ddshasalpha);
+#endif
+	R_SkinFrame_SaveCachedTexture(texture, &image, info->ddshasalpha);
+	Mem_Free(image.pixels);
+	return texture;
+}
+
 extern cvar_t gl_picmip;
 skinframe_t *R_SkinFrame_LoadExternal_SkinFrame(skinframe_t *skinframe, const char *name, int textureflags, qbool complain, qbool fallbacknotexture)
 {
-	int j;
-	unsigned char *pixels;
-	unsigned char *bumppixels;
-	unsigned char *basepixels = NULL;
-	int basepixels_width = 0;
-	int basepixels_height = 0;
+	int j, layer;
+	r_skinframe_prefetch_t *prefetch;
+	r_skinframe_image_t base;
+	rtexture_t **texture;
 	rtexture_t *ddsbase = NULL;
 	qbool ddshasalpha = false;
+	qbool cachedbase = false;
 	float ddsavgcolor[4];
 	char basename[MAX_QPATH];
 	int miplevel = R_PicmipForFlags(textureflags);
@@ -2350,14 +2986,43 @@ skinframe_t *R_SkinFrame_LoadExternal_SkinFrame(skinframe_t *skinframe, const ch
 
 	Image_StripImageExtension(name, basename, sizeof(basename));
 
+	// pick up the images if they are being decoded on the taskqueue
+	prefetch = R_SkinFrame_TakePrefetch(basename, textureflags);
+
+	memset(&base, 0, sizeof(base));
+	base.miplevel = miplevel;
+
 	// check for DDS texture file first
 	if (!r_loaddds || !(ddsbase = R_LoadTextureDDSFile(r_main_texturepool, va(vabuf, sizeof(vabuf), "dds/%s.dds", basename), vid.sRGB3D, textureflags, &ddshasalpha, ddsavgcolor, miplevel, false)))
 	{
-		basepixels = loadimagepixelsbgra(name, complain, true, false, &miplevel);
-		if (basepixels == NULL && fallbacknotexture)
-			basepixels = Image_GenerateNoTexture();
-		if (basepixels == NULL)
-			return NULL;
+		if (prefetch)
+			R_SkinFrame_TakeExternalImage(prefetch, SKINFRAME_LAYER_BASE, &base);
+		else
+			R_SkinFrame_FindExternalImage(SKINFRAME_LAYER_BASE, name, basename, textureflags, NULL, &base);
+		// then the texture cache, which has the texture if the image file did not change
+		if ((ddsbase = R_SkinFrame_LoadCachedTexture(&base, vid.sRGB3D, R_SkinFrame_LayerTextureFlags(SKINFRAME_LAYER_BASE, textureflags), &ddshasalpha, ddsavgcolor)))
+			cachedbase = true;
+		else
+		{
+			if (!base.decoded)
+				R_SkinFrame_DecodeExternalImage(SKINFRAME_LAYER_BASE, name, basename, complain, NULL, &base);
+			if (base.pixels == NULL && fallbacknotexture)
+			{
+				// the prefetch did not decode the other images without a base
+				R_SkinFrame_FreePrefetch(prefetch);
+				prefetch = NULL;
+				base.pixels = Image_GenerateNoTexture();
+				base.decoded = true;
+				base.width = image_width;
+				base.height = image_height;
+			}
+			if (base.pixels == NULL)
+			{
+				R_SkinFrame_FreePrefetch(prefetch);
+				return NULL;
+			}
+			miplevel = base.miplevel;
+		}
 	}
 
 	// FIXME handle miplevel
@@ -2382,7 +3047,15 @@ skinframe_t *R_SkinFrame_LoadExternal_SkinFrame(skinframe_t *skinframe, const ch
 	skinframe->hasalpha = false;
 	// we could store the q2animname here too
 
-	if (ddsbase)
+	if (cachedbase)
+	{
+		skinframe->base = ddsbase;
+		skinframe->hasalpha = ddshasalpha;
+		Vector4Copy(ddsavgcolor, skinframe->avgcolor);
+		if (r_loadfog && skinframe->hasalpha)
+			skinframe->fog = R_SkinFrame_LoadFogMask(skinframe, name, textureflags, &base);
+	}
+	else if (ddsbase)
 	{
 		skinframe->base = ddsbase;
 		skinframe->hasalpha = ddshasalpha;
@@ -2393,35 +3066,22 @@ skinframe_t *R_SkinFrame_LoadExternal_SkinFrame(skinframe_t *skinframe, const ch
 	}
 	else
 	{
-		basepixels_width = image_width;
-		basepixels_height = image_height;
-		skinframe->base = R_LoadTexture2D (r_main_texturepool, skinframe->basename, basepixels_width, basepixels_height, basepixels, vid.sRGB3D ? TEXTYPE_SRGB_BGRA : TEXTYPE_BGRA, textureflags & (gl_texturecompression_color.integer && gl_texturecompression.integer ? ~0 : ~TEXF_COMPRESS), miplevel, NULL);
+		skinframe->base = R_LoadTexture2D (r_main_texturepool, skinframe->basename, base.width, base.height, base.pixels, vid.sRGB3D ? TEXTYPE_SRGB_BGRA : TEXTYPE_BGRA, R_SkinFrame_LayerTextureFlags(SKINFRAME_LAYER_BASE, textureflags), miplevel, NULL);
 		if (textureflags & TEXF_ALPHA)
 		{
-			for (j = 3;j < basepixels_width * basepixels_height * 4;j += 4)
+			for (j = 3;j < base.width * base.height * 4;j += 4)
 			{
-				if (basepixels[j] < 255)
+				if (base.pixels[j] < 255)
 				{
 					skinframe->hasalpha = true;
 					break;
 				}
 			}
+			// has transparent pixels
 			if (r_loadfog && skinframe->hasalpha)
-			{
-				// has transparent pixels
-				pixels = (unsigned char *)Mem_Alloc(tempmempool, image_width * image_height * 4);
-				for (j = 0;j < image_width * image_height * 4;j += 4)
-				{
-					pixels[j+0] = 255;
-					pixels[j+1] = 255;
-					pixels[j+2] = 255;
-					pixels[j+3] = basepixels[j+3];
-				}
-				skinframe->fog = R_LoadTexture2D (r_main_texturepool, va(vabuf, sizeof(vabuf), "%s_mask", skinframe->basename), image_width, image_height, pixels, TEXTYPE_BGRA, textureflags & (gl_texturecompression_color.integer && gl_texturecompression.integer ? ~0 : ~TEXF_COMPRESS), miplevel, NULL);
-				Mem_Free(pixels);
-			}
+				skinframe->fog = R_SkinFrame_LoadFogMask(skinframe, name, textureflags, &base);
 		}
-		R_SKINFRAME_LOAD_AVERAGE_COLORS(basepixels_width * basepixels_height, basepixels[4 * pix + comp]);
+		R_SKINFRAME_LOAD_AVERAGE_COLORS(base.width * base.height, base.pixels[4 * pix + comp]);
 #ifndef USE_GLES2
 		//Con_Printf("Texture %s has average colors %f %f %f alpha %f\n", name, skinframe->avgcolor[0], skinframe->avgcolor[1], skinframe->avgcolor[2], skinframe->avgcolor[3]);
 		if (r_savedds && skinframe->base)
@@ -2429,6 +3089,7 @@ skinframe_t *R_SkinFrame_LoadExternal_SkinFrame(skinframe_t *skinframe, const ch
 		if (r_savedds && skinframe->fog)
 			R_SaveTextureDDSFile(skinframe->fog, va(vabuf, sizeof(vabuf), "dds/%s_mask.dds", skinframe->basename), r_texture_dds_save.integer < 2, true);
 #endif
+		R_SkinFrame_SaveCachedTexture(skinframe->base, &base, skinframe->hasalpha);
 	}
 
 	if (r_loaddds)
@@ -2444,101 +3105,18 @@ skinframe_t *R_SkinFrame_LoadExternal_SkinFrame(skinframe_t *skinframe, const ch
 		skinframe->reflect = R_LoadTextureDDSFile(r_main_texturepool, va(vabuf, sizeof(vabuf), "dds/%s_reflect.dds", skinframe->basename), vid.sRGB3D, textureflags, NULL, NULL, mymiplevel, true);
 	}
 
-	// _norm is the name used by tenebrae and has been adopted as standard
-	if (r_loadnormalmap && skinframe->nmap == NULL)
-	{
-		mymiplevel = savemiplevel;
-		if ((pixels = loadimagepixelsbgra(va(vabuf, sizeof(vabuf), "%s_norm", skinframe->basename), false, false, false, &mymiplevel)) != NULL)
-		{
-			skinframe->nmap = R_LoadTexture2D (r_main_texturepool, va(vabuf, sizeof(vabuf), "%s_nmap", skinframe->basename), image_width, image_height, pixels, TEXTYPE_BGRA, (TEXF_ALPHA | textureflags) & (r_mipnormalmaps.integer ? ~0 : ~TEXF_MIPMAP) & (gl_texturecompression_normal.integer && gl_texturecompression.integer ? ~0 : ~TEXF_COMPRESS), mymiplevel, NULL);
-			Mem_Free(pixels);
-			pixels = NULL;
-		}
-		else if (r_shadow_bumpscale_bumpmap.value > 0 && (bumppixels = loadimagepixelsbgra(va(vabuf, sizeof(vabuf), "%s_bump", skinframe->basename), false, false, false, &mymiplevel)) != NULL)
-		{
-			pixels = (unsigned char *)Mem_Alloc(tempmempool, image_width * image_height * 4);
-			Image_HeightmapToNormalmap_BGRA(bumppixels, pixels, image_width, image_height, false, r_shadow_bumpscale_bumpmap.value);
-			skinframe->nmap = R_LoadTexture2D (r_main_texturepool, va(vabuf, sizeof(vabuf), "%s_nmap", skinframe->basename), image_width, image_height, pixels, TEXTYPE_BGRA, (TEXF_ALPHA | textureflags) & (r_mipnormalmaps.integer ? ~0 : ~TEXF_MIPMAP) & (gl_texturecompression_normal.integer && gl_texturecompression.integer ? ~0 : ~TEXF_COMPRESS), mymiplevel, NULL);
-			Mem_Free(pixels);
-			Mem_Free(bumppixels);
-		}
-		else if (r_shadow_bumpscale_basetexture.value > 0)
-		{
-			pixels = (unsigned char *)Mem_Alloc(tempmempool, basepixels_width * basepixels_height * 4);
-			Image_HeightmapToNormalmap_BGRA(basepixels, pixels, basepixels_width, basepixels_height, false, r_shadow_bumpscale_basetexture.value);
-			skinframe->nmap = R_LoadTexture2D (r_main_texturepool, va(vabuf, sizeof(vabuf), "%s_nmap", skinframe->basename), basepixels_width, basepixels_height, pixels, TEXTYPE_BGRA, (TEXF_ALPHA | textureflags) & (r_mipnormalmaps.integer ? ~0 : ~TEXF_MIPMAP) & (gl_texturecompression_normal.integer && gl_texturecompression.integer ? ~0 : ~TEXF_COMPRESS), mymiplevel, NULL);
-			Mem_Free(pixels);
-		}
-#ifndef USE_GLES2
-		if (r_savedds && skinframe->nmap)
-			R_SaveTextureDDSFile(skinframe->nmap, va(vabuf, sizeof(vabuf), "dds/%s_norm.dds", skinframe->basename), r_texture_dds_save.integer < 2, true);
-#endif
-	}
-
-	// _luma is supported only for tenebrae compatibility
-	// _blend and .blend are supported only for Q3 & QL compatibility, this hack can be removed if better Q3 shader support is implemented
-	// _glow is the preferred name
-	mymiplevel = savemiplevel;
-	if (skinframe->glow == NULL && ((pixels = loadimagepixelsbgra(va(vabuf, sizeof(vabuf), "%s_glow", skinframe->basename), false, false, false, &mymiplevel)) || (pixels = loadimagepixelsbgra(va(vabuf, sizeof(vabuf), "%s.blend", skinframe->basename), false, false, false, &mymiplevel)) || (pixels = loadimagepixelsbgra(va(vabuf, sizeof(vabuf), "%s_blend", skinframe->basename), false, false, false, &mymiplevel)) || (pixels = loadimagepixelsbgra(va(vabuf, sizeof(vabuf), "%s_luma", skinframe->basename), false, false, false, &mymiplevel))))
-	{
-		skinframe->glow = R_LoadTexture2D (r_main_texturepool, va(vabuf, sizeof(vabuf), "%s_glow", skinframe->basename), image_width, image_height, pixels, vid.sRGB3D ? TEXTYPE_SRGB_BGRA : TEXTYPE_BGRA, textureflags & (gl_texturecompression_glow.integer && gl_texturecompression.integer ? ~0 : ~TEXF_COMPRESS), mymiplevel, NULL);
-#ifndef USE_GLES2
-		if (r_savedds && skinframe->glow)
-			R_SaveTextureDDSFile(skinframe->glow, va(vabuf, sizeof(vabuf), "dds/%s_glow.dds", skinframe->basename), r_texture_dds_save.integer < 2, true);
-#endif
-		Mem_Free(pixels);pixels = NULL;
-	}
-
-	mymiplevel = savemiplevel;
-	if (skinframe->gloss == NULL && r_loadgloss && (pixels = loadimagepixelsbgra(va(vabuf, sizeof(vabuf), "%s_gloss", skinframe->basename), false, false, false, &mymiplevel)))
-	{
-		skinframe->gloss = R_LoadTexture2D (r_main_texturepool, va(vabuf, sizeof(vabuf), "%s_gloss", skinframe->basename), image_width, image_height, pixels, vid.sRGB3D ? TEXTYPE_SRGB_BGRA : TEXTYPE_BGRA, (TEXF_ALPHA | textureflags) & (gl_texturecompression_gloss.integer && gl_texturecompression.integer ? ~0 : ~TEXF_COMPRESS), mymiplevel, NULL);
-#ifndef USE_GLES2
-		if (r_savedds && skinframe->gloss)
-			R_SaveTextureDDSFile(skinframe->gloss, va(vabuf, sizeof(vabuf), "dds/%s_gloss.dds", skinframe->basename), r_texture_dds_save.integer < 2, true);
-#endif
-		Mem_Free(pixels);
-		pixels = NULL;
-	}
-
-	mymiplevel = savemiplevel;
-	if (skinframe->pants == NULL && (pixels = loadimagepixelsbgra(va(vabuf, sizeof(vabuf), "%s_pants", skinframe->basename), false, false, false, &mymiplevel)))
-	{
-		skinframe->pants = R_LoadTexture2D (r_main_texturepool, va(vabuf, sizeof(vabuf), "%s_pants", skinframe->basename), image_width, image_height, pixels, vid.sRGB3D ? TEXTYPE_SRGB_BGRA : TEXTYPE_BGRA, textureflags & (gl_texturecompression_color.integer && gl_texturecompression.integer ? ~0 : ~TEXF_COMPRESS), mymiplevel, NULL);
-#ifndef USE_GLES2
-		if (r_savedds && skinframe->pants)
-			R_SaveTextureDDSFile(skinframe->pants, va(vabuf, sizeof(vabuf), "dds/%s_pants.dds", skinframe->basename), r_texture_dds_save.integer < 2, false);
-#endif
-		Mem_Free(pixels);
-		pixels = NULL;
-	}
-
-	mymiplevel = savemiplevel;
-	if (skinframe->shirt == NULL && (pixels = loadimagepixelsbgra(va(vabuf, sizeof(vabuf), "%s_shirt", skinframe->basename), false, false, false, &mymiplevel)))
-	{
-		skinframe->shirt = R_LoadTexture2D (r_main_texturepool, va(vabuf, sizeof(vabuf), "%s_shirt", skinframe->basename), image_width, image_height, pixels, vid.sRGB3D ? TEXTYPE_SRGB_BGRA : TEXTYPE_BGRA, textureflags & (gl_texturecompression_color.integer && gl_texturecompression.integer ? ~0 : ~TEXF_COMPRESS), mymiplevel, NULL);
-#ifndef USE_GLES2
-		if (r_savedds && skinframe->shirt)
-			R_SaveTextureDDSFile(skinframe->shirt, va(vabuf, sizeof(vabuf), "dds/%s_shirt.dds", skinframe->basename), r_texture_dds_save.integer < 2, false);
-#endif
-		Mem_Free(pixels);
-		pixels = NULL;
-	}
-
-	mymiplevel = savemiplevel;
-	if (skinframe->reflect == NULL && (pixels = loadimagepixelsbgra(va(vabuf, sizeof(vabuf), "%s_reflect", skinframe->basename), false, false, false, &mymiplevel)))
+	for (layer = SKINFRAME_LAYER_NMAP;layer < SKINFRAME_LAYER_COUNT;layer++)
 	{
-		skinframe->reflect = R_LoadTexture2D (r_main_texturepool, va(vabuf, sizeof(vabuf), "%s_reflect", skinframe->basename), image_width, image_height, pixels, vid.sRGB3D ? TEXTYPE_SRGB_BGRA : TEXTYPE_BGRA, textureflags & (gl_texturecompression_reflectmask.integer && gl_texturecompression.integer ? ~0 : ~TEXF_COMPRESS), mymiplevel, NULL);
-#ifndef USE_GLES2
-		if (r_savedds && skinframe->reflect)
-			R_SaveTextureDDSFile(skinframe->reflect, va(vabuf, sizeof(vabuf), "dds/%s_reflect.dds", skinframe->basename), r_texture_dds_save.integer < 2, true);
-#endif
-		Mem_Free(pixels);
-		pixels = NULL;
+		if ((layer == SKINFRAME_LAYER_NMAP && !r_loadnormalmap) || (layer == SKINFRAME_LAYER_GLOSS && !r_loadgloss))
+			continue;
+		texture = R_SkinFrame_LayerTexture(skinframe, (r_skinframe_layer_t)layer);
+		if (*texture == NULL)
+			*texture = R_SkinFrame_LoadExternalLayer(skinframe, prefetch, (r_skinframe_layer_t)layer, name, textureflags, savemiplevel, &base);
 	}
 
-	if (basepixels)
-		Mem_Free(basepixels);
+	if (base.pixels)
+		Mem_Free(base.pixels);
+	R_SkinFrame_FreePrefetch(prefetch);
 
 	return skinframe;
 }
@@ -3164,6 +3742,7 @@ static void gl_main_shutdown(void)
 	r_qwskincache_size = 0;
 
 	// clear out the r_skinframe state
+	R_SkinFrame_FinishPrefetch();
 	Mem_ExpandableArray_FreeArray(&r_skinframe.array);
 	memset(&r_skinframe, 0, sizeof(r_skinframe));
 
@@ -3199,6 +3778,7 @@ static void gl_main_newmap(void)
 		Mem_Free(r_qwskincache);
 	r_qwskincache = NULL;
 	r_qwskincache_size = 0;
+	R_SkinFrame_PruneTextureCache();
 	if (cl.worldmodel)
 	{
 		dpsnprintf(entname, sizeof(entname), "%s.ent", cl.worldnamenoextension);
@@ -3319,7 +3899,11 @@ void GL_Main_Init(void)
 	Cvar_RegisterVariable(&r_transparent_sortmindist);
 	Cvar_RegisterVariable(&r_transparent_sortmaxdist);
 	Cvar_RegisterVariable(&r_transparent_sortarraysize);
+	Cvar_RegisterVariable(&r_transparent_sortbatches);
 	Cvar_RegisterVariable(&r_texture_dds_load);
+	Cvar_RegisterVariable(&r_texture_threaded);
+	Cvar_RegisterVariable(&r_texture_cache);
+	Cvar_RegisterVariable(&r_texture_cache_maxsize);
 	Cvar_RegisterVariable(&r_texture_dds_save);
 	Cvar_RegisterVariable(&r_usedepthtextures);
 	Cvar_RegisterVariable(&r_viewfbo);
@@ -3394,6 +3978,8 @@ void GL_Main_Init(void)
 	Cvar_RegisterVariable(&r_batch_multidraw);
 	Cvar_RegisterVariable(&r_batch_multidraw_mintriangles);
 	Cvar_RegisterVariable(&r_batch_debugdynamicvertexpath);
+	Cvar_RegisterVariable(&r_animcache_share);
+	Cvar_RegisterVariable(&r_animcache_threaded);
 	Cvar_RegisterVariable(&r_glsl_skeletal);
 	Cvar_RegisterVariable(&r_glsl_saturation);
 	Cvar_RegisterVariable(&r_glsl_saturation_redcompensate);
@@ -3473,6 +4059,73 @@ qbool R_CullBox(const vec3_t mins, const vec3_t maxs, int numplanes, const mplan
 	return _R_CullBox(mins, maxs, numplanes, planes, -1);
 }
 
+#if defined(SSE_PRESENT) && !defined(VEC_64)
+#define R_CULLFRUSTUM4_SSE
+#include <xmmintrin.h>
+#endif
+
+/*
+================
+R_CullFrustum4
+
+Same test as R_CullFrustum for the 4 boxes starting at index in a structure
+of arrays box list (see Mod_BuildCullBoxes), returns a mask with bit n set
+if box index+n is culled
+================
+*/
+int R_CullFrustum4(const float *boxes, int stride, int index)
+{
+	int i, culled = 0;
+	const mplane_t *p;
+	const float *mins[3], *maxs[3];
+#ifdef R_CULLFRUSTUM4_SSE
+	__m128 bmins[3], bmaxs[3], c[3], d, out = _mm_setzero_ps();
+#endif
+
+	if (r_trippy.integer)
+		return 0;
+
+	for (i = 0;i < 3;i++)
+	{
+		mins[i] = boxes + i * stride + index;
+		maxs[i] = boxes + (i + 3) * stride + index;
+#ifdef R_CULLFRUSTUM4_SSE
+		bmins[i] = _mm_loadu_ps(mins[i]);
+		bmaxs[i] = _mm_loadu_ps(maxs[i]);
+#endif
+	}
+
+	// skip nearclip plane like R_CullFrustum
+	for (i = 0, p = r_refdef.view.frustum;i < r_refdef.view.numfrustumplanes;i++, p++)
+	{
+		if (i == 4)
+			continue;
+#ifdef R_CULLFRUSTUM4_SSE
+		// same corner selection and operation order as R_GetCornerOfBox
+		// and DotProduct, so the results match the scalar test exactly
+		c[0] = (p->signbits & 1) ? bmins[0] : bmaxs[0];
+		c[1] = (p->signbits & 2) ? bmins[1] : bmaxs[1];
+		c[2] = (p->signbits & 4) ? bmins[2] : bmaxs[2];
+		d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p->normal[0]), c[0]), _mm_mul_ps(_mm_set1_ps(p->normal[1]), c[1])), _mm_mul_ps(_mm_set1_ps(p->normal[2]), c[2]));
+		out = _mm_or_ps(out, _mm_cmplt_ps(d, _mm_set1_ps(p->dist)));
+#else
+		{
+			int j;
+			const float *cx = (p->signbits & 1) ? mins[0] : maxs[0];
+			const float *cy = (p->signbits & 2) ? mins[1] : maxs[1];
+			const float *cz = (p->signbits & 4) ? mins[2] : maxs[2];
+			for (j = 0;j < 4;j++)
+				if (p->normal[0] * cx[j] + p->normal[1] * cy[j] + p->normal[2] * cz[j] < p->dist)
+					culled |= 1 << j;
+		}
+#endif
+	}
+#ifdef R_CULLFRUSTUM4_SSE
+	culled = _mm_movemask_ps(out);
+#endif
+	return culled;
+}
+
 //==================================================================================
 
 // LadyHavoc: this stores temporary data used within the same frame
@@ -3755,8 +4408,180 @@ r_meshbuffer_t *R_BufferData_Store(size_t datasize, const void *data, r_bufferda
  * multiple times in one frame for lighting, shadowing, reflections, etc.
  */
 
+// when R_AnimCache_CacheVisibleEntities is collecting, the AnimateVertices
+// calls are queued here and run on the taskqueue instead of immediately
+typedef struct r_animcache_job_s
+{
+	entity_render_t *ent;
+	float *vertex3f;
+	float *normal3f;
+	float *svector3f;
+	float *tvector3f;
+	// per job scratch memory for skeletal models
+	void *buffers;
+}
+r_animcache_job_t;
+
+// entities whose animation state (model, frameblend and skeleton) is
+// identical share one set of animcache arrays, this is an open addressing
+// hash table of the entities that generated one this frame
+typedef struct r_animcache_shared_s
+{
+	unsigned int hash;
+	entity_render_t *ent;
+}
+r_animcache_shared_t;
+
+static int r_animcache_numshared;
+static int r_animcache_maxshared;
+static r_animcache_shared_t *r_animcache_shared;
+
+static qbool r_animcache_batching;
+static int r_animcache_numjobs;
+static int r_animcache_maxjobs;
+static r_animcache_job_t *r_animcache_jobs;
+static taskqueue_task_t *r_animcache_tasks;
+static taskqueue_task_t r_animcache_done_task;
+
 void R_AnimCache_Free(void)
 {
+	if (r_animcache_jobs)
+		Mem_Free(r_animcache_jobs);
+	if (r_animcache_tasks)
+		Mem_Free(r_animcache_tasks);
+	r_animcache_jobs = NULL;
+	r_animcache_tasks = NULL;
+	r_animcache_numjobs = 0;
+	r_animcache_maxjobs = 0;
+	if (r_animcache_shared)
+		Mem_Free(r_animcache_shared);
+	r_animcache_shared = NULL;
+	r_animcache_numshared = 0;
+	r_animcache_maxshared = 0;
+}
+
+static unsigned int R_AnimCache_Hash(const entity_render_t *ent)
+{
+	int i;
+	unsigned int hash = 2166136261u;
+	const unsigned char *bytes;
+	size_t size;
+
+#define R_ANIMCACHE_HASH(data, len) \
+	for (bytes = (const unsigned char *)(data), size = (len);size;size--) \
+		hash = (hash ^ *bytes++) * 16777619u;
+
+	R_ANIMCACHE_HASH(&ent->model, sizeof(ent->model));
+	for (i = 0;i < MAX_FRAMEBLENDS;i++)
+	{
+		R_ANIMCACHE_HASH(&ent->frameblend[i].lerp, sizeof(ent->frameblend[i].lerp));
+		if (ent->frameblend[i].lerp)
+			R_ANIMCACHE_HASH(&ent->frameblend[i].subframe, sizeof(ent->frameblend[i].subframe));
+	}
+	if (ent->model->num_bones && ent->skeleton && ent->skeleton->relativetransforms)
+		R_ANIMCACHE_HASH(ent->skeleton->relativetransforms, ent->model->num_bones * sizeof(matrix4x4_t));
+#undef R_ANIMCACHE_HASH
+	return hash;
+}
+
+static qbool R_AnimCache_SameAnimation(const entity_render_t *a, const entity_render_t *b)
+{
+	int i;
+	const skeleton_t *as, *bs;
+	if (a->model != b->model)
+		return false;
+	for (i = 0;i < MAX_FRAMEBLENDS;i++)
+		if (a->frameblend[i].lerp != b->frameblend[i].lerp || (a->frameblend[i].lerp && a->frameblend[i].subframe != b->frameblend[i].subframe))
+			return false;
+	if (!a->model->num_bones)
+		return true;
+	as = a->skeleton && a->skeleton->relativetransforms ? a->skeleton : NULL;
+	bs = b->skeleton && b->skeleton->relativetransforms ? b->skeleton : NULL;
+	if (!as || !bs)
+		return as == bs;
+	return as == bs || !memcmp(as->relativetransforms, bs->relativetransforms, a->model->num_bones * sizeof(matrix4x4_t));
+}
+
+/*
+===============
+R_AnimCache_FindShared
+
+returns an entity that already generated its animcache this frame with the
+same animation state as ent, and remembers ent as the owner otherwise
+===============
+*/
+static entity_render_t *R_AnimCache_FindShared(entity_render_t *ent)
+{
+	int i, mask;
+	unsigned int hash;
+	r_animcache_shared_t *entry;
+
+	if (!r_animcache_share.integer)
+		return NULL;
+
+	// keep the table at most half full
+	if (r_animcache_maxshared < (r_animcache_numshared + 1) * 2)
+	{
+		r_animcache_shared_t *old = r_animcache_shared;
+		int oldmax = r_animcache_maxshared;
+		r_animcache_maxshared = max(r_animcache_maxshared * 2, 256);
+		r_animcache_shared = (r_animcache_shared_t *)Mem_Alloc(r_main_mempool, r_animcache_maxshared * sizeof(*r_animcache_shared));
+		mask = r_animcache_maxshared - 1;
+		for (i = 0;i < oldmax;i++)
+		{
+			if (!old[i].ent)
+				continue;
+			for (entry = r_animcache_shared + (old[i].hash & mask);entry->ent;entry = r_animcache_shared + ((entry - r_animcache_shared + 1) & mask))
+				;
+			*entry = old[i];
+		}
+		if (old)
+			Mem_Free(old);
+	}
+
+	hash = R_AnimCache_Hash(ent);
+	mask = r_animcache_maxshared - 1;
+	for (entry = r_animcache_shared + (hash & mask);entry->ent;entry = r_animcache_shared + ((entry - r_animcache_shared + 1) & mask))
+		if (entry->hash == hash && R_AnimCache_SameAnimation(entry->ent, ent))
+			return entry->ent;
+	entry->hash = hash;
+	entry->ent = ent;
+	r_animcache_numshared++;
+	return NULL;
+}
+
+static void R_AnimCache_AnimateVertices(entity_render_t *ent, float *vertex3f, float *normal3f, float *svector3f, float *tvector3f)
+{
+	model_t *model = ent->model;
+	r_animcache_job_t *job;
+	size_t buffersize;
+
+	if (!r_animcache_batching)
+	{
+		model->AnimateVertices(model, ent->frameblend, ent->skeleton, vertex3f, normal3f, svector3f, tvector3f);
+		return;
+	}
+	if (r_animcache_numjobs >= r_animcache_maxjobs)
+	{
+		r_animcache_maxjobs = max(r_animcache_maxjobs * 2, 256);
+		r_animcache_jobs = (r_animcache_job_t *)Mem_Realloc(r_main_mempool, r_animcache_jobs, r_animcache_maxjobs * sizeof(*r_animcache_jobs));
+		r_animcache_tasks = (taskqueue_task_t *)Mem_Realloc(r_main_mempool, r_animcache_tasks, r_animcache_maxjobs * sizeof(*r_animcache_tasks));
+	}
+	job = r_animcache_jobs + r_animcache_numjobs++;
+	job->ent = ent;
+	job->vertex3f = vertex3f;
+	job->normal3f = normal3f;
+	job->svector3f = svector3f;
+	job->tvector3f = tvector3f;
+	buffersize = Mod_AnimateVertices_BufferSize(model);
+	job->buffers = buffersize ? R_FrameData_Alloc(buffersize) : NULL;
+}
+
+static void R_AnimCache_AnimateVertices_Task(taskqueue_task_t *t)
+{
+	r_animcache_job_t *job = r_animcache_jobs + t->i[0];
+	Mod_AnimateVertices_Buffered(job->ent->model, job->ent->frameblend, job->ent->skeleton, job->buffers, job->vertex3f, job->normal3f, job->svector3f, job->tvector3f);
+	t->done = 1;
 }
 
 void R_AnimCache_ClearCache(void)
@@ -3764,6 +4589,10 @@ void R_AnimCache_ClearCache(void)
 	int i;
 	entity_render_t *ent;
 
+	if (r_animcache_numshared)
+		memset(r_animcache_shared, 0, r_animcache_maxshared * sizeof(*r_animcache_shared));
+	r_animcache_numshared = 0;
+
 	for (i = 0;i < r_refdef.scene.numentities;i++)
 	{
 		ent = r_refdef.scene.entities[i];
@@ -3789,6 +4618,7 @@ void R_AnimCache_ClearCache(void)
 qbool R_AnimCache_GetEntity(entity_render_t *ent, qbool wantnormals, qbool wanttangents)
 {
 	model_t *model = ent->model;
+	entity_render_t *shared;
 	int numvertices;
 
 	// see if this ent is worth caching
@@ -3797,6 +4627,28 @@ qbool R_AnimCache_GetEntity(entity_render_t *ent, qbool wantnormals, qbool wantt
 	// nothing to cache if it contains no animations and has no skeleton
 	if (!model->surfmesh.isanimated && !(model->num_bones && ent->skeleton && ent->skeleton->relativetransforms))
 		return false;
+	// reuse the arrays of another entity in the same pose, anything missing
+	// (normals or tangents) is then added to this entity only
+	if (!ent->animcache_skeletaltransform3x4 && !ent->animcache_vertex3f && (shared = R_AnimCache_FindShared(ent)))
+	{
+		ent->animcache_vertex3f = shared->animcache_vertex3f;
+		ent->animcache_vertex3f_vertexbuffer = shared->animcache_vertex3f_vertexbuffer;
+		ent->animcache_vertex3f_bufferoffset = shared->animcache_vertex3f_bufferoffset;
+		ent->animcache_normal3f = shared->animcache_normal3f;
+		ent->animcache_normal3f_vertexbuffer = shared->animcache_normal3f_vertexbuffer;
+		ent->animcache_normal3f_bufferoffset = shared->animcache_normal3f_bufferoffset;
+		ent->animcache_svector3f = shared->animcache_svector3f;
+		ent->animcache_svector3f_vertexbuffer = shared->animcache_svector3f_vertexbuffer;
+		ent->animcache_svector3f_bufferoffset = shared->animcache_svector3f_bufferoffset;
+		ent->animcache_tvector3f = shared->animcache_tvector3f;
+		ent->animcache_tvector3f_vertexbuffer = shared->animcache_tvector3f_vertexbuffer;
+		ent->animcache_tvector3f_bufferoffset = shared->animcache_tvector3f_bufferoffset;
+		ent->animcache_skeletaltransform3x4 = shared->animcache_skeletaltransform3x4;
+		ent->animcache_skeletaltransform3x4buffer = shared->animcache_skeletaltransform3x4buffer;
+		ent->animcache_skeletaltransform3x4offset = shared->animcache_skeletaltransform3x4offset;
+		ent->animcache_skeletaltransform3x4size = shared->animcache_skeletaltransform3x4size;
+		r_refdef.stats[r_stat_animcache_shared_count] += 1;
+	}
 	// see if it is already cached for gpuskeletal
 	if (ent->animcache_skeletaltransform3x4)
 		return false;
@@ -3839,7 +4691,7 @@ qbool R_AnimCache_GetEntity(entity_render_t *ent, qbool wantnormals, qbool wantt
 				ent->animcache_svector3f = (float *)R_FrameData_Alloc(sizeof(float[3])*numvertices);
 				ent->animcache_tvector3f = (float *)R_FrameData_Alloc(sizeof(float[3])*numvertices);
 			}
-			model->AnimateVertices(model, ent->frameblend, ent->skeleton, NULL, wantnormals ? ent->animcache_normal3f : NULL, wanttangents ? ent->animcache_svector3f : NULL, wanttangents ? ent->animcache_tvector3f : NULL);
+			R_AnimCache_AnimateVertices(ent, NULL, wantnormals ? ent->animcache_normal3f : NULL, wanttangents ? ent->animcache_svector3f : NULL, wanttangents ? ent->animcache_tvector3f : NULL);
 			r_refdef.stats[r_stat_animcache_shade_count] += 1;
 			r_refdef.stats[r_stat_animcache_shade_vertices] += numvertices;
 			r_refdef.stats[r_stat_animcache_shade_maxvertices] = max(r_refdef.stats[r_stat_animcache_shade_maxvertices], numvertices);
@@ -3857,7 +4709,7 @@ qbool R_AnimCache_GetEntity(entity_render_t *ent, qbool wantnormals, qbool wantt
 			ent->animcache_svector3f = (float *)R_FrameData_Alloc(sizeof(float[3])*numvertices);
 			ent->animcache_tvector3f = (float *)R_FrameData_Alloc(sizeof(float[3])*numvertices);
 		}
-		model->AnimateVertices(model, ent->frameblend, ent->skeleton, ent->animcache_vertex3f, ent->animcache_normal3f, ent->animcache_svector3f, ent->animcache_tvector3f);
+		R_AnimCache_AnimateVertices(ent, ent->animcache_vertex3f, ent->animcache_normal3f, ent->animcache_svector3f, ent->animcache_tvector3f);
 		if (wantnormals || wanttangents)
 		{
 			r_refdef.stats[r_stat_animcache_shade_count] += 1;
@@ -3875,12 +4727,29 @@ void R_AnimCache_CacheVisibleEntities(void)
 {
 	int i;
 
-	// TODO: thread this
 	// NOTE: R_PrepareRTLights() also caches entities
 
+	// allocate the caches for all visible entities first (that is not
+	// thread safe), then animate them all at once on the taskqueue
+	r_animcache_batching = r_animcache_threaded.integer != 0;
+	r_animcache_numjobs = 0;
 	for (i = 0;i < r_refdef.scene.numentities;i++)
 		if (r_refdef.viewcache.entityvisible[i])
 			R_AnimCache_GetEntity(r_refdef.scene.entities[i], true, true);
+	r_animcache_batching = false;
+
+	if (r_animcache_numjobs == 1)
+		R_AnimCache_AnimateVertices_Task(r_animcache_tasks);
+	else if (r_animcache_numjobs > 1)
+	{
+		for (i = 0;i < r_animcache_numjobs;i++)
+			TaskQueue_Setup(r_animcache_tasks + i, NULL, R_AnimCache_AnimateVertices_Task, i, 0, NULL, NULL);
+		TaskQueue_Setup(&r_animcache_done_task, NULL, TaskQueue_Task_CheckTasksDone, r_animcache_numjobs, 0, r_animcache_tasks, NULL);
+		TaskQueue_Enqueue(r_animcache_numjobs, r_animcache_tasks);
+		TaskQueue_Enqueue(1, &r_animcache_done_task);
+		TaskQueue_WaitForTaskDone(&r_animcache_done_task);
+	}
+	r_animcache_numjobs = 0;
 }
 
 //==================================================================================
@@ -10079,16 +10948,10 @@ void R_DrawModelSurfaces(entity_render_t *ent, qbool skysurfaces, qbool writedep
 			 * For optimal efficiency, this includes the submodels of the worldmodel, so we
 			 * use model->num_surfaces, not nummodelsurfaces.
 			 */
-			for (i = 0; i < model->num_surfaces;i++)
-				if (update[i])
-					R_BuildLightMap(ent, surfaces + i, r_q1bsp_lightmap_updates_combine.integer);
+			R_BuildLightMaps(ent, model->num_surfaces, NULL, r_q1bsp_lightmap_updates_combine.integer);
 		}
 		else
-		{
-			for (i = 0; i < numsurfacelist; i++)
-				if (update[r_surfacelist[i] - surfaces])
-					R_BuildLightMap(ent, (msurface_t *)r_surfacelist[i], r_q1bsp_lightmap_updates_combine.integer);
-		}
+			R_BuildLightMaps(ent, numsurfacelist, r_surfacelist, r_q1bsp_lightmap_updates_combine.integer);
 	}
 
 	R_QueueModelSurfaceList(ent, numsurfacelist, r_surfacelist, flagsmask, writedepth, depthonly, prepass, ui);
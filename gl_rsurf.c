@@ -24,6 +24,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "portals.h"
 #include "csprogs.h"
 #include "image.h"
+#include "taskqueue.h"
 
 cvar_t r_ambient = {CF_CLIENT, "r_ambient", "0", "brightens map, value is 0-128"};
 cvar_t r_lockpvs = {CF_CLIENT, "r_lockpvs", "0", "disables pvs switching, allows you to walk around and inspect what is visible from a given location in the map (anything not visible from your current location will not be drawn)"};
@@ -40,46 +41,29 @@ cvar_t r_vis_trace_pad = {CF_CLIENT, "r_vis_trace_pad", "8", "accept traces that
 cvar_t r_vis_trace_surfaces = {CF_CLIENT, "r_vis_trace_surfaces", "0", "also use tracelines to cull surfaces"};
 cvar_t r_q3bsp_renderskydepth = {CF_CLIENT, "r_q3bsp_renderskydepth", "0", "draws sky depth masking in q3 maps (as in q1 maps), this means for example that sky polygons can hide other things"};
 
+cvar_t r_worldvisibility_threaded = {CF_CLIENT | CF_ARCHIVE, "r_worldvisibility_threaded", "1", "frustum cull the world leafs and surfaces using taskqueue_maxthreads (4 boxes at a time, with SSE where available)"};
+cvar_t r_q1bsp_lightmap_updates_threaded = {CF_CLIENT | CF_ARCHIVE, "r_q1bsp_lightmap_updates_threaded", "1", "rebuild animated lightmaps using taskqueue_maxthreads, only the texture uploads remain on the main thread"};
+
 /*
 ===============
-R_BuildLightMap
+R_BuildLightMap_Lighting
 
-Combine and scale multiple lightmaps into the 8.8 format in blocklights
+Combine and scale the lightmaps into BGRA templight, which may share memory
+with the size*3 ints of intblocklights
 ===============
 */
-void R_BuildLightMap (const entity_render_t *ent, msurface_t *surface, int combine)
+static void R_BuildLightMap_Lighting(const model_t *model, const msurface_t *surface, int *intblocklights, unsigned char *templight)
 {
 	int smax, tmax, i, size, size3, maps, l;
 	int *bl, scale;
-	unsigned char *lightmap, *out, *stain;
-	model_t *model = ent->model;
-	int *intblocklights;
-	unsigned char *templight;
+	const unsigned char *lightmap, *stain;
+	unsigned char *out;
 
 	smax = (surface->lightmapinfo->extents[0]>>4)+1;
 	tmax = (surface->lightmapinfo->extents[1]>>4)+1;
 	size = smax*tmax;
 	size3 = size*3;
 
-	r_refdef.stats[r_stat_lightmapupdatepixels] += size;
-	r_refdef.stats[r_stat_lightmapupdates]++;
-
-	if (cl.buildlightmapmemorysize < size*sizeof(int[3]))
-	{
-		cl.buildlightmapmemorysize = size*sizeof(int[3]);
-		if (cl.buildlightmapmemory)
-			Mem_Free(cl.buildlightmapmemory);
-		cl.buildlightmapmemory = (unsigned char *) Mem_Alloc(cls.levelmempool, cl.buildlightmapmemorysize);
-	}
-
-	// these both point at the same buffer, templight is only used for final
-	// processing and can replace the intblocklights data as it goes
-	intblocklights = (int *)cl.buildlightmapmemory;
-	templight = (unsigned char *)cl.buildlightmapmemory;
-
-	// update cached lighting info
-	model->brushq1.lightmapupdateflags[surface - model->data_surfaces] = false;
-
 	lightmap = surface->lightmapinfo->samples;
 
 // set to full bright if no light data
@@ -131,48 +115,338 @@ void R_BuildLightMap (const entity_render_t *ent, msurface_t *surface, int combi
 
 	if(vid_sRGB.integer && vid_sRGB_fallback.integer && !vid.sRGB3D)
 		Image_MakesRGBColorsFromLinear_Lightmap(templight, templight, size);
+}
+
+/*
+===============
+R_BuildLightMap_Deluxe
+
+Combine the normalmaps weighted by lightstyle intensity into a BGRA
+deluxemap, same buffer rules as R_BuildLightMap_Lighting
+===============
+*/
+static void R_BuildLightMap_Deluxe(const msurface_t *surface, int *intblocklights, unsigned char *templight)
+{
+	int smax, tmax, i, size, size3, maps, l;
+	int *bl, scale;
+	const unsigned char *lightmap, *normalmap;
+	unsigned char *out;
+	vec3_t n;
+
+	smax = (surface->lightmapinfo->extents[0]>>4)+1;
+	tmax = (surface->lightmapinfo->extents[1]>>4)+1;
+	size = smax*tmax;
+	size3 = size*3;
+
+	normalmap = surface->lightmapinfo->nmapsamples;
+	lightmap = surface->lightmapinfo->samples;
+	// clear to no normalmap
+	bl = intblocklights;
+	memset(bl, 0, size3*sizeof(*bl));
+	// add all the normalmaps
+	if (lightmap && normalmap)
+	{
+		for (maps = 0;maps < MAXLIGHTMAPS && surface->lightmapinfo->styles[maps] != 255;maps++, lightmap += size3, normalmap += size3)
+		{
+			for (scale = r_refdef.scene.lightstylevalue[surface->lightmapinfo->styles[maps]], i = 0;i < size;i++)
+			{
+				// add the normalmap with weighting proportional to the style's lightmap intensity
+				l = (int)(VectorLength(lightmap + i*3) * scale);
+				bl[i*3+0] += ((int)normalmap[i*3+0] - 128) * l;
+				bl[i*3+1] += ((int)normalmap[i*3+1] - 128) * l;
+				bl[i*3+2] += ((int)normalmap[i*3+2] - 128) * l;
+			}
+		}
+	}
+	bl = intblocklights;
+	out = templight;
+	// we simply renormalize the weighted normals to get a valid deluxemap
+	for (i = 0;i < size;i++, bl += 3, out += 4)
+	{
+		VectorCopy(bl, n);
+		VectorNormalize(n);
+		l = (int)(n[0] * 128 + 128);out[2] = bound(0, l, 255);
+		l = (int)(n[1] * 128 + 128);out[1] = bound(0, l, 255);
+		l = (int)(n[2] * 128 + 128);out[0] = bound(0, l, 255);
+		out[3] = 255;
+	}
+}
+
+/*
+===============
+R_BuildLightMap
+
+Combine and scale multiple lightmaps into the 8.8 format in blocklights
+===============
+*/
+void R_BuildLightMap (const entity_render_t *ent, msurface_t *surface, int combine)
+{
+	int smax, tmax, size;
+	model_t *model = ent->model;
+	int *intblocklights;
+	unsigned char *templight;
+
+	smax = (surface->lightmapinfo->extents[0]>>4)+1;
+	tmax = (surface->lightmapinfo->extents[1]>>4)+1;
+	size = smax*tmax;
+
+	r_refdef.stats[r_stat_lightmapupdatepixels] += size;
+	r_refdef.stats[r_stat_lightmapupdates]++;
+
+	if (cl.buildlightmapmemorysize < size*sizeof(int[3]))
+	{
+		cl.buildlightmapmemorysize = size*sizeof(int[3]);
+		if (cl.buildlightmapmemory)
+			Mem_Free(cl.buildlightmapmemory);
+		cl.buildlightmapmemory = (unsigned char *) Mem_Alloc(cls.levelmempool, cl.buildlightmapmemorysize);
+	}
+
+	// these both point at the same buffer, templight is only used for final
+	// processing and can replace the intblocklights data as it goes
+	intblocklights = (int *)cl.buildlightmapmemory;
+	templight = (unsigned char *)cl.buildlightmapmemory;
+
+	// update cached lighting info
+	model->brushq1.lightmapupdateflags[surface - model->data_surfaces] = false;
+
+	R_BuildLightMap_Lighting(model, surface, intblocklights, templight);
 	R_UpdateTexture(surface->lightmaptexture, templight, surface->lightmapinfo->lightmaporigin[0], surface->lightmapinfo->lightmaporigin[1], 0, smax, tmax, 1, combine);
 
 	// update the surface's deluxemap if it has one
 	if (surface->deluxemaptexture != r_texture_blanknormalmap)
 	{
-		vec3_t n;
-		unsigned char *normalmap = surface->lightmapinfo->nmapsamples;
-		lightmap = surface->lightmapinfo->samples;
-		// clear to no normalmap
-		bl = intblocklights;
-		memset(bl, 0, size3*sizeof(*bl));
-		// add all the normalmaps
-		if (lightmap && normalmap)
+		R_BuildLightMap_Deluxe(surface, intblocklights, templight);
+		R_UpdateTexture(surface->deluxemaptexture, templight, surface->lightmapinfo->lightmaporigin[0], surface->lightmapinfo->lightmaporigin[1], 0, smax, tmax, 1, r_q1bsp_lightmap_updates_combine.integer);
+	}
+}
+
+#define R_BUILDLIGHTMAPS_PERTASK 16
+#define R_BUILDLIGHTMAPS_MAXTASKS 64
+
+// state for rebuilding a batch of lightmaps on the taskqueue, each surface
+// gets its own region of the staging buffer (lightmap followed by deluxemap
+// if it has one) and each task its own int[3] accumulation buffer
+static struct r_buildlightmaps_s
+{
+	int numsurfaces;
+	int maxsurfaces;
+	msurface_t **surfaces;
+	size_t *offsets;
+	size_t stagingsize;
+	unsigned char *staging;
+	// largest smax*tmax in the batch, scratch holds that many int[3] per task
+	int maxsize;
+	size_t scratchsize;
+	int *scratch;
+	taskqueue_task_t tasks[R_BUILDLIGHTMAPS_MAXTASKS];
+	taskqueue_task_t done_task;
+}
+r_buildlightmaps;
+
+static void R_BuildLightMaps_AddSurface(msurface_t *surface)
+{
+	int size = ((surface->lightmapinfo->extents[0]>>4)+1) * ((surface->lightmapinfo->extents[1]>>4)+1);
+	size_t offset = r_buildlightmaps.numsurfaces ? r_buildlightmaps.offsets[r_buildlightmaps.numsurfaces] : 0;
+	if (r_buildlightmaps.maxsurfaces <= r_buildlightmaps.numsurfaces + 1)
+	{
+		r_buildlightmaps.maxsurfaces = max(r_buildlightmaps.maxsurfaces * 2, 256);
+		r_buildlightmaps.surfaces = (msurface_t **)Mem_Realloc(r_main_mempool, r_buildlightmaps.surfaces, r_buildlightmaps.maxsurfaces * sizeof(*r_buildlightmaps.surfaces));
+		r_buildlightmaps.offsets = (size_t *)Mem_Realloc(r_main_mempool, r_buildlightmaps.offsets, r_buildlightmaps.maxsurfaces * sizeof(*r_buildlightmaps.offsets));
+	}
+	r_buildlightmaps.surfaces[r_buildlightmaps.numsurfaces] = surface;
+	r_buildlightmaps.offsets[r_buildlightmaps.numsurfaces] = offset;
+	offset += size * 4;
+	if (surface->deluxemaptexture != r_texture_blanknormalmap)
+		offset += size * 4;
+	r_buildlightmaps.numsurfaces++;
+	// the entry after the last one holds the total staging size
+	r_buildlightmaps.offsets[r_buildlightmaps.numsurfaces] = offset;
+	r_buildlightmaps.maxsize = max(r_buildlightmaps.maxsize, size);
+}
+
+static void R_BuildLightMaps_Task(taskqueue_task_t *t)
+{
+	const model_t *model = (const model_t *)t->p[0];
+	int *scratch = (int *)t->p[1];
+	size_t i;
+	for (i = t->i[0];i < t->i[1];i++)
+	{
+		msurface_t *surface = r_buildlightmaps.surfaces[i];
+		unsigned char *out = r_buildlightmaps.staging + r_buildlightmaps.offsets[i];
+		R_BuildLightMap_Lighting(model, surface, scratch, out);
+		if (surface->deluxemaptexture != r_texture_blanknormalmap)
 		{
-			for (maps = 0;maps < MAXLIGHTMAPS && surface->lightmapinfo->styles[maps] != 255;maps++, lightmap += size3, normalmap += size3)
-			{
-				for (scale = r_refdef.scene.lightstylevalue[surface->lightmapinfo->styles[maps]], i = 0;i < size;i++)
-				{
-					// add the normalmap with weighting proportional to the style's lightmap intensity
-					l = (int)(VectorLength(lightmap + i*3) * scale);
-					bl[i*3+0] += ((int)normalmap[i*3+0] - 128) * l;
-					bl[i*3+1] += ((int)normalmap[i*3+1] - 128) * l;
-					bl[i*3+2] += ((int)normalmap[i*3+2] - 128) * l;
-				}
-			}
+			int size = ((surface->lightmapinfo->extents[0]>>4)+1) * ((surface->lightmapinfo->extents[1]>>4)+1);
+			R_BuildLightMap_Deluxe(surface, scratch, out + size * 4);
 		}
-		bl = intblocklights;
-		out = templight;
-		// we simply renormalize the weighted normals to get a valid deluxemap
-		for (i = 0;i < size;i++, bl += 3, out += 4)
+	}
+	t->done = 1;
+}
+
+/*
+===============
+R_BuildLightMaps_Run
+
+Rebuilds every surface collected by R_BuildLightMaps_AddSurface into the
+staging buffer, spread over the taskqueue; returns the number of tasks used
+===============
+*/
+static int R_BuildLightMaps_Run(const model_t *model)
+{
+	int i, numtasks, pertask;
+	size_t size;
+
+	size = r_buildlightmaps.offsets[r_buildlightmaps.numsurfaces];
+	if (r_buildlightmaps.stagingsize < size)
+	{
+		r_buildlightmaps.stagingsize = size * 2;
+		if (r_buildlightmaps.staging)
+			Mem_Free(r_buildlightmaps.staging);
+		r_buildlightmaps.staging = (unsigned char *)Mem_Alloc(r_main_mempool, r_buildlightmaps.stagingsize);
+	}
+
+	numtasks = bound(1, (r_buildlightmaps.numsurfaces + R_BUILDLIGHTMAPS_PERTASK - 1) / R_BUILDLIGHTMAPS_PERTASK, R_BUILDLIGHTMAPS_MAXTASKS);
+	pertask = (r_buildlightmaps.numsurfaces + numtasks - 1) / numtasks;
+	numtasks = (r_buildlightmaps.numsurfaces + pertask - 1) / pertask;
+
+	size = (size_t)r_buildlightmaps.maxsize * 3 * numtasks;
+	if (r_buildlightmaps.scratchsize < size)
+	{
+		r_buildlightmaps.scratchsize = size;
+		if (r_buildlightmaps.scratch)
+			Mem_Free(r_buildlightmaps.scratch);
+		r_buildlightmaps.scratch = (int *)Mem_Alloc(r_main_mempool, r_buildlightmaps.scratchsize * sizeof(int));
+	}
+
+	// the sRGB table is built on first use, make sure that is not on a task
+	if(vid_sRGB.integer && vid_sRGB_fallback.integer && !vid.sRGB3D)
+		Image_MakesRGBColorsFromLinear_Lightmap(NULL, NULL, 0);
+
+	for (i = 0;i < numtasks;i++)
+		TaskQueue_Setup(r_buildlightmaps.tasks + i, NULL, R_BuildLightMaps_Task, i * pertask, min((i + 1) * pertask, r_buildlightmaps.numsurfaces), (void *)model, r_buildlightmaps.scratch + (size_t)i * r_buildlightmaps.maxsize * 3);
+	TaskQueue_Setup(&r_buildlightmaps.done_task, NULL, TaskQueue_Task_CheckTasksDone, numtasks, 0, r_buildlightmaps.tasks, NULL);
+	TaskQueue_Enqueue(numtasks, r_buildlightmaps.tasks);
+	TaskQueue_Enqueue(1, &r_buildlightmaps.done_task);
+	TaskQueue_WaitForTaskDone(&r_buildlightmaps.done_task);
+	return numtasks;
+}
+
+/*
+===============
+R_BuildLightMaps
+
+Rebuilds the lightmaps of all surfaces in the list (or all surfaces of the
+model if surfacelist is NULL) that are flagged in lightmapupdateflags, the
+per-surface work runs on the taskqueue and only the texture uploads happen
+here
+===============
+*/
+void R_BuildLightMaps(const entity_render_t *ent, int numsurfaces, const msurface_t **surfacelist, int combine)
+{
+	int i, smax, tmax;
+	model_t *model = ent->model;
+	unsigned char *update = model->brushq1.lightmapupdateflags;
+	msurface_t *surface;
+
+	if (!r_q1bsp_lightmap_updates_threaded.integer)
+	{
+		for (i = 0;i < numsurfaces;i++)
 		{
-			VectorCopy(bl, n);
-			VectorNormalize(n);
-			l = (int)(n[0] * 128 + 128);out[2] = bound(0, l, 255);
-			l = (int)(n[1] * 128 + 128);out[1] = bound(0, l, 255);
-			l = (int)(n[2] * 128 + 128);out[0] = bound(0, l, 255);
-			out[3] = 255;
+			surface = surfacelist ? (msurface_t *)surfacelist[i] : model->data_surfaces + i;
+			if (update[surface - model->data_surfaces])
+				R_BuildLightMap(ent, surface, combine);
 		}
-		R_UpdateTexture(surface->deluxemaptexture, templight, surface->lightmapinfo->lightmaporigin[0], surface->lightmapinfo->lightmaporigin[1], 0, smax, tmax, 1, r_q1bsp_lightmap_updates_combine.integer);
+		return;
+	}
+
+	r_buildlightmaps.numsurfaces = 0;
+	r_buildlightmaps.maxsize = 0;
+	for (i = 0;i < numsurfaces;i++)
+	{
+		surface = surfacelist ? (msurface_t *)surfacelist[i] : model->data_surfaces + i;
+		if (update[surface - model->data_surfaces])
+		{
+			update[surface - model->data_surfaces] = false;
+			R_BuildLightMaps_AddSurface(surface);
+		}
+	}
+	if (!r_buildlightmaps.numsurfaces)
+		return;
+
+	R_BuildLightMaps_Run(model);
+
+	// upload in surface order so combined updates see the same sequence as
+	// the single threaded path
+	for (i = 0;i < r_buildlightmaps.numsurfaces;i++)
+	{
+		unsigned char *out = r_buildlightmaps.staging + r_buildlightmaps.offsets[i];
+		surface = r_buildlightmaps.surfaces[i];
+		smax = (surface->lightmapinfo->extents[0]>>4)+1;
+		tmax = (surface->lightmapinfo->extents[1]>>4)+1;
+		r_refdef.stats[r_stat_lightmapupdatepixels] += smax*tmax;
+		r_refdef.stats[r_stat_lightmapupdates]++;
+		R_UpdateTexture(surface->lightmaptexture, out, surface->lightmapinfo->lightmaporigin[0], surface->lightmapinfo->lightmaporigin[1], 0, smax, tmax, 1, combine);
+		if (surface->deluxemaptexture != r_texture_blanknormalmap)
+			R_UpdateTexture(surface->deluxemaptexture, out + smax*tmax*4, surface->lightmapinfo->lightmaporigin[0], surface->lightmapinfo->lightmaporigin[1], 0, smax, tmax, 1, combine);
 	}
 }
 
+/*
+===============
+R_BuildLightMaps_Benchmark_f
+
+Times the CPU side of rebuilding every lightmap of the current map, once on
+the main thread and once spread over the taskqueue, without uploading
+anything
+===============
+*/
+static void R_BuildLightMaps_Benchmark_f(cmd_state_t *cmd)
+{
+	int i, j, iterations, numtasks = 0;
+	double t0, t1, t2;
+	model_t *model = cl.worldmodel;
+
+	if (!model || !model->brushq1.lightmapupdateflags)
+	{
+		Con_Printf("r_buildlightmaps_benchmark: no map with lightmaps loaded\n");
+		return;
+	}
+	iterations = Cmd_Argc(cmd) > 1 ? atoi(Cmd_Argv(cmd, 1)) : 10;
+	iterations = max(iterations, 1);
+
+	r_buildlightmaps.numsurfaces = 0;
+	r_buildlightmaps.maxsize = 0;
+	for (i = 0;i < model->num_surfaces;i++)
+		if (model->data_surfaces[i].lightmapinfo && model->data_surfaces[i].lightmaptexture)
+			R_BuildLightMaps_AddSurface(model->data_surfaces + i);
+	if (!r_buildlightmaps.numsurfaces)
+	{
+		Con_Printf("r_buildlightmaps_benchmark: no lightmapped surfaces\n");
+		return;
+	}
+	// make sure the buffers are allocated before timing
+	R_BuildLightMaps_Run(model);
+
+	t0 = Sys_DirtyTime();
+	for (j = 0;j < iterations;j++)
+	{
+		for (i = 0;i < r_buildlightmaps.numsurfaces;i++)
+		{
+			msurface_t *surface = r_buildlightmaps.surfaces[i];
+			unsigned char *out = r_buildlightmaps.staging + r_buildlightmaps.offsets[i];
+			R_BuildLightMap_Lighting(model, surface, r_buildlightmaps.scratch, out);
+			if (surface->deluxemaptexture != r_texture_blanknormalmap)
+				R_BuildLightMap_Deluxe(surface, r_buildlightmaps.scratch, out + (r_buildlightmaps.offsets[i+1] - r_buildlightmaps.offsets[i]) / 2);
+		}
+	}
+	t1 = Sys_DirtyTime();
+	for (j = 0;j < iterations;j++)
+		numtasks = R_BuildLightMaps_Run(model);
+	t2 = Sys_DirtyTime();
+
+	Con_Printf("%i lightmaps (%u bytes), %i iterations: serial %.3fms, %i tasks %.3fms per rebuild\n", r_buildlightmaps.numsurfaces, (unsigned int)r_buildlightmaps.offsets[r_buildlightmaps.numsurfaces], iterations, (t1 - t0) * 1000.0 / iterations, numtasks, (t2 - t1) * 1000.0 / iterations);
+}
+
 static void R_StainNode (mnode_t *node, model_t *model, const vec3_t origin, float radius, const float fcolor[8])
 {
 	float ndist, a, ratio, maxdist, maxdist2, maxdist3, invradius, sdtable[256], td, dist2;
@@ -408,6 +682,139 @@ void R_DrawPortals(void)
 	}
 }
 
+#define R_WORLDVISIBILITY_PERTASK 2048
+#define R_WORLDVISIBILITY_MAXTASKS 64
+
+// which checks besides the frustum a leaf has to pass to be visible
+typedef enum r_worldvisibility_leafmode_e
+{
+	R_WORLDVISIBILITY_CUSTOMPVS, // in the pvs
+	R_WORLDVISIBILITY_NOVIS, // has a cluster
+	R_WORLDVISIBILITY_PVS // has a cluster and it is in the pvs
+}
+r_worldvisibility_leafmode_t;
+
+static taskqueue_task_t r_worldvisibility_tasks[R_WORLDVISIBILITY_MAXTASKS];
+static taskqueue_task_t r_worldvisibility_done_task;
+
+/*
+===============
+R_View_WorldVisibility_RunTasks
+
+splits the index range start to end into groups of 4 aligned tasks for
+func, or simply calls it once if it is small or threading is disabled
+===============
+*/
+static void R_View_WorldVisibility_RunTasks(void (*func)(taskqueue_task_t *), int start, int end, void *p0, void *p1)
+{
+	int i, numtasks, pertask;
+	if (end - start <= R_WORLDVISIBILITY_PERTASK || !r_worldvisibility_threaded.integer)
+	{
+		TaskQueue_Setup(r_worldvisibility_tasks, NULL, func, start, end, p0, p1);
+		func(r_worldvisibility_tasks);
+		return;
+	}
+	pertask = max(R_WORLDVISIBILITY_PERTASK, (end - start + R_WORLDVISIBILITY_MAXTASKS - 1) / R_WORLDVISIBILITY_MAXTASKS);
+	pertask = (pertask + 3) & ~3;
+	for (i = start, numtasks = 0;i < end;i += pertask, numtasks++)
+		TaskQueue_Setup(r_worldvisibility_tasks + numtasks, NULL, func, i, min(i + pertask, end), p0, p1);
+	TaskQueue_Setup(&r_worldvisibility_done_task, NULL, TaskQueue_Task_CheckTasksDone, numtasks, 0, r_worldvisibility_tasks, NULL);
+	TaskQueue_Enqueue(numtasks, r_worldvisibility_tasks);
+	TaskQueue_Enqueue(1, &r_worldvisibility_done_task);
+	TaskQueue_WaitForTaskDone(&r_worldvisibility_done_task);
+}
+
+static void R_View_WorldVisibility_CullLeafs_Task(taskqueue_task_t *t)
+{
+	model_t *model = r_refdef.scene.worldmodel;
+	r_worldvisibility_leafmode_t mode = (r_worldvisibility_leafmode_t)(size_t)t->p[0];
+	unsigned char *leafpass = (unsigned char *)t->p[1];
+	const mleaf_t *leaf;
+	int j, k, culled, end = (int)t->i[1];
+	for (j = (int)t->i[0];j < end;j += 4)
+	{
+		culled = R_CullFrustum4(model->brush.data_leafcullboxes, model->brush.cullboxes_leafstride, j);
+		for (k = 0;k < 4 && j + k < end;k++)
+		{
+			leaf = model->brush.data_leafs + j + k;
+			leafpass[j + k] = !(culled & (1 << k))
+				&& (mode == R_WORLDVISIBILITY_CUSTOMPVS || leaf->clusterindex >= 0)
+				&& (mode == R_WORLDVISIBILITY_NOVIS || CHECKPVSBIT(r_refdef.viewcache.world_pvsbits, leaf->clusterindex));
+		}
+	}
+	t->done = 1;
+}
+
+/*
+===============
+R_View_WorldVisibility_MarkLeafs
+
+frustum culls all leafs (on the taskqueue if the map has cull boxes) and
+marks the ones that pass as visible along with their surfaces
+===============
+*/
+static void R_View_WorldVisibility_MarkLeafs(model_t *model, r_worldvisibility_leafmode_t mode)
+{
+	int i, j, *mark;
+	mleaf_t *leaf;
+	unsigned char *leafpass;
+
+	if (!model->brush.data_leafcullboxes)
+	{
+		for (j = 0, leaf = model->brush.data_leafs;j < model->brush.num_leafs;j++, leaf++)
+		{
+			if (mode != R_WORLDVISIBILITY_CUSTOMPVS && leaf->clusterindex < 0)
+				continue;
+			// if leaf is in current pvs and on the screen, mark its surfaces
+			if ((mode == R_WORLDVISIBILITY_NOVIS || CHECKPVSBIT(r_refdef.viewcache.world_pvsbits, leaf->clusterindex)) && !R_CullFrustum(leaf->mins, leaf->maxs))
+			{
+				r_refdef.stats[r_stat_world_leafs]++;
+				r_refdef.viewcache.world_leafvisible[j] = true;
+				if (leaf->numleafsurfaces)
+					for (i = 0, mark = leaf->firstleafsurface;i < leaf->numleafsurfaces;i++, mark++)
+						r_refdef.viewcache.world_surfacevisible[*mark] = true;
+			}
+		}
+		return;
+	}
+
+	// the tests run in parallel, marking the surfaces (which are shared
+	// between leafs) is done here afterwards
+	leafpass = (unsigned char *)R_FrameData_Alloc(model->brush.num_leafs);
+	R_View_WorldVisibility_RunTasks(R_View_WorldVisibility_CullLeafs_Task, 0, model->brush.num_leafs, (void *)(size_t)mode, leafpass);
+	for (j = 0, leaf = model->brush.data_leafs;j < model->brush.num_leafs;j++, leaf++)
+	{
+		if (leafpass[j])
+		{
+			r_refdef.stats[r_stat_world_leafs]++;
+			r_refdef.viewcache.world_leafvisible[j] = true;
+			if (leaf->numleafsurfaces)
+				for (i = 0, mark = leaf->firstleafsurface;i < leaf->numleafsurfaces;i++, mark++)
+					r_refdef.viewcache.world_surfacevisible[*mark] = true;
+		}
+	}
+}
+
+static void R_View_WorldVisibility_CullSurfaces_Task(taskqueue_task_t *t)
+{
+	model_t *model = r_refdef.scene.worldmodel;
+	unsigned char *surfacevisible = r_refdef.viewcache.world_surfacevisible;
+	int j, k, culled, end = (int)t->i[1];
+	for (j = (int)t->i[0];j < end;j += 4)
+	{
+		for (k = 0;k < 4 && j + k < end;k++)
+			if (surfacevisible[j + k])
+				break;
+		if (k == 4 || j + k >= end)
+			continue;
+		culled = R_CullFrustum4(model->brush.data_surfacecullboxes, model->brush.cullboxes_surfacestride, j);
+		for (k = 0;k < 4 && j + k < end;k++)
+			if (culled & (1 << k))
+				surfacevisible[j + k] = 0;
+	}
+	t->done = 1;
+}
+
 static void R_View_WorldVisibility_CullSurfaces(void)
 {
 	int surfaceindex;
@@ -420,6 +827,12 @@ static void R_View_WorldVisibility_CullSurfaces(void)
 		return;
 	if (r_usesurfaceculling.integer < 1)
 		return;
+	// the tracelines are not thread safe
+	if (model->brush.data_surfacecullboxes && !r_vis_trace_surfaces.integer)
+	{
+		R_View_WorldVisibility_RunTasks(R_View_WorldVisibility_CullSurfaces_Task, model->submodelsurfaces_start, model->submodelsurfaces_end, NULL, NULL);
+		return;
+	}
 	surfaces = model->data_surfaces;
 	surfacevisible = r_refdef.viewcache.world_surfacevisible;
 	for (surfaceindex = model->submodelsurfaces_start; surfaceindex < model->submodelsurfaces_end; surfaceindex++)
@@ -435,7 +848,7 @@ static void R_View_WorldVisibility_CullSurfaces(void)
 
 void R_View_WorldVisibility(qbool forcenovis)
 {
-	int i, j, *mark;
+	int i, *mark;
 	mleaf_t *leaf;
 	mleaf_t *viewleaf;
 	model_t *model = r_refdef.scene.worldmodel;
@@ -456,18 +869,7 @@ void R_View_WorldVisibility(qbool forcenovis)
 	if (r_refdef.view.usecustompvs)
 	{
 		// simply cull each marked leaf to the frustum (view pyramid)
-		for (j = 0, leaf = model->brush.data_leafs;j < model->brush.num_leafs;j++, leaf++)
-		{
-			// if leaf is in current pvs and on the screen, mark its surfaces
-			if (CHECKPVSBIT(r_refdef.viewcache.world_pvsbits, leaf->clusterindex) && !R_CullFrustum(leaf->mins, leaf->maxs))
-			{
-				r_refdef.stats[r_stat_world_leafs]++;
-				r_refdef.viewcache.world_leafvisible[j] = true;
-				if (leaf->numleafsurfaces)
-					for (i = 0, mark = leaf->firstleafsurface;i < leaf->numleafsurfaces;i++, mark++)
-						r_refdef.viewcache.world_surfacevisible[*mark] = true;
-			}
-		}
+		R_View_WorldVisibility_MarkLeafs(model, R_WORLDVISIBILITY_CUSTOMPVS);
 	}
 	else
 	{
@@ -485,20 +887,7 @@ void R_View_WorldVisibility(qbool forcenovis)
 			// simply cull each leaf to the frustum (view pyramid)
 			// similar to quake's RecursiveWorldNode but without cache misses
 			r_refdef.viewcache.world_novis = true;
-			for (j = 0, leaf = model->brush.data_leafs;j < model->brush.num_leafs;j++, leaf++)
-			{
-				if (leaf->clusterindex < 0)
-					continue;
-				// if leaf is in current pvs and on the screen, mark its surfaces
-				if (!R_CullFrustum(leaf->mins, leaf->maxs))
-				{
-					r_refdef.stats[r_stat_world_leafs]++;
-					r_refdef.viewcache.world_leafvisible[j] = true;
-					if (leaf->numleafsurfaces)
-						for (i = 0, mark = leaf->firstleafsurface;i < leaf->numleafsurfaces;i++, mark++)
-							r_refdef.viewcache.world_surfacevisible[*mark] = true;
-				}
-			}
+			R_View_WorldVisibility_MarkLeafs(model, R_WORLDVISIBILITY_NOVIS);
 		}
 		// just check if each leaf in the PVS is on screen
 		// (unless portal culling is enabled)
@@ -508,20 +897,7 @@ void R_View_WorldVisibility(qbool forcenovis)
 			// simply check if each leaf is in the Potentially Visible Set,
 			// and cull to frustum (view pyramid)
 			// similar to quake's RecursiveWorldNode but without cache misses
-			for (j = 0, leaf = model->brush.data_leafs;j < model->brush.num_leafs;j++, leaf++)
-			{
-				if (leaf->clusterindex < 0)
-					continue;
-				// if leaf is in current pvs and on the screen, mark its surfaces
-				if (CHECKPVSBIT(r_refdef.viewcache.world_pvsbits, leaf->clusterindex) && !R_CullFrustum(leaf->mins, leaf->maxs))
-				{
-					r_refdef.stats[r_stat_world_leafs]++;
-					r_refdef.viewcache.world_leafvisible[j] = true;
-					if (leaf->numleafsurfaces)
-						for (i = 0, mark = leaf->firstleafsurface;i < leaf->numleafsurfaces;i++, mark++)
-							r_refdef.viewcache.world_surfacevisible[*mark] = true;
-				}
-			}
+			R_View_WorldVisibility_MarkLeafs(model, R_WORLDVISIBILITY_PVS);
 		}
 		// if desired use a recursive portal flow, culling each portal to
 		// frustum and checking if the leaf the portal leads to is in the pvs
@@ -698,11 +1074,26 @@ typedef struct r_q1bsp_getlightinfo_s
 	qbool frontsidecasting; // casts shadows from surfaces facing the light (otherwise ones facing away)
 	int numfrustumplanes;
 	const mplane_t *frustumplanes;
+	const int *materialflags; // per texture, if not NULL R_GetCurrentTexture is not used
 }
 r_q1bsp_getlightinfo_t;
 
 #define GETLIGHTINFO_MAXNODESTACK 4096
 
+// material flags of the textures in r_q1bsp_getlightinfo_threadedmodel, looked
+// up by R_Mod_GetLightInfo_SetThreaded because R_GetCurrentTexture modifies the
+// textures and the rsurface state, so it can only be called on the main thread
+static model_t *r_q1bsp_getlightinfo_threadedmodel;
+static int *r_q1bsp_getlightinfo_materialflags;
+static int r_q1bsp_getlightinfo_maxmaterialflags;
+
+static int R_Q1BSP_GetLightInfo_MaterialFlags(const r_q1bsp_getlightinfo_t *info, texture_t *texture)
+{
+	if (info->materialflags)
+		return info->materialflags[texture - info->model->data_textures];
+	return R_GetCurrentTexture(texture)->currentmaterialflags;
+}
+
 static void R_Q1BSP_RecursiveGetLightInfo_BSP(r_q1bsp_getlightinfo_t *info, qbool skipsurfaces)
 {
 	// nodestack
@@ -882,7 +1273,7 @@ static void R_Q1BSP_RecursiveGetLightInfo_BSP(r_q1bsp_getlightinfo_t *info, qboo
 					surface = surfaces + surfaceindex;
 					if (!BoxesOverlap(info->lightmins, info->lightmaxs, surface->mins, surface->maxs))
 						continue;
-					currentmaterialflags = R_GetCurrentTexture(surface->texture)->currentmaterialflags;
+					currentmaterialflags = R_Q1BSP_GetLightInfo_MaterialFlags(info, surface->texture);
 					castshadow = !(currentmaterialflags & MATERIALFLAG_NOSHADOW);
 					if (!castshadow)
 						continue;
@@ -914,7 +1305,7 @@ static void R_Q1BSP_RecursiveGetLightInfo_BSP(r_q1bsp_getlightinfo_t *info, qboo
 					if (!BoxesOverlap(info->lightmins, info->lightmaxs, surface->mins, surface->maxs))
 						continue;
 					addedtris = false;
-					currentmaterialflags = R_GetCurrentTexture(surface->texture)->currentmaterialflags;
+					currentmaterialflags = R_Q1BSP_GetLightInfo_MaterialFlags(info, surface->texture);
 					castshadow = !(currentmaterialflags & MATERIALFLAG_NOSHADOW);
 					insidebox = BoxInsideBox(surface->mins, surface->maxs, info->lightmins, info->lightmaxs);
 					for (triangleindex = 0, t = surface->num_firsttriangle, e = info->model->surfmesh.data_element3i + t * 3;triangleindex < surface->num_triangles;triangleindex++, t++, e += 3)
@@ -967,15 +1358,11 @@ static void R_Q1BSP_RecursiveGetLightInfo_BSP(r_q1bsp_getlightinfo_t *info, qboo
 	}
 }
 
-static void R_Q1BSP_RecursiveGetLightInfo_BIH(r_q1bsp_getlightinfo_t *info, const bih_t *bih)
+static void R_Q1BSP_GetLightInfo_BIHLeaf(void *context, const bih_leaf_t *leaf)
 {
-	bih_leaf_t *leaf;
-	bih_node_t *node;
-	int nodenum;
-	int axis;
+	r_q1bsp_getlightinfo_t *info = (r_q1bsp_getlightinfo_t *)context;
 	int surfaceindex;
 	int t;
-	int nodeleafindex;
 	int currentmaterialflags;
 	qbool castshadow;
 	qbool noocclusion = info->noocclusion;
@@ -984,10 +1371,88 @@ static void R_Q1BSP_RecursiveGetLightInfo_BIH(r_q1bsp_getlightinfo_t *info, cons
 	const int *e;
 	const vec_t *v[3];
 	float v2[3][3];
+	if (leaf->type != BIH_RENDERTRIANGLE)
+		return;
+#if 1
+	if (!BoxesOverlap(info->lightmins, info->lightmaxs, leaf->mins, leaf->maxs))
+		return;
+#endif
+#if 1
+	if (!r_shadow_compilingrtlight && R_CullBox(leaf->mins, leaf->maxs, info->numfrustumplanes, info->frustumplanes))
+		return;
+#endif
+	surfaceindex = leaf->surfaceindex;
+	surface = info->model->data_surfaces + surfaceindex;
+	currentmaterialflags = R_Q1BSP_GetLightInfo_MaterialFlags(info, surface->texture);
+	castshadow = !(currentmaterialflags & MATERIALFLAG_NOSHADOW);
+	t = leaf->itemindex;
+	e = info->model->surfmesh.data_element3i + t * 3;
+	v[0] = info->model->surfmesh.data_vertex3f + e[0] * 3;
+	v[1] = info->model->surfmesh.data_vertex3f + e[1] * 3;
+	v[2] = info->model->surfmesh.data_vertex3f + e[2] * 3;
+	VectorCopy(v[0], v2[0]);
+	VectorCopy(v[1], v2[1]);
+	VectorCopy(v[2], v2[2]);
+	if (info->svbsp_insertoccluder)
+	{
+		if (castshadow)
+			SVBSP_AddPolygon(&r_svbsp, 3, v2[0], true, NULL, NULL, 0);
+		return;
+	}
+	if (info->svbsp_active && !(SVBSP_AddPolygon(&r_svbsp, 3, v2[0], false, NULL, NULL, 0) & 2))
+		return;
+	// we don't occlude triangles from lighting even
+	// if they are backfacing, because when using
+	// shadowmapping they are often not fully occluded
+	// on the horizon of an edge
+	SETPVSBIT(info->outlighttrispvs, t);
+	if (castshadow)
+	{
+		if (noocclusion || (currentmaterialflags & MATERIALFLAG_NOCULLFACE))
+		{
+			// if the material is double sided we
+			// can't cull by direction
+			SETPVSBIT(info->outshadowtrispvs, t);
+		}
+		else if (frontsidecasting)
+		{
+			// front side casting occludes backfaces,
+			// so they are completely useless as both
+			// casters and lit polygons
+			if (PointInfrontOfTriangle(info->relativelightorigin, v2[0], v2[1], v2[2]))
+				SETPVSBIT(info->outshadowtrispvs, t);
+		}
+		else
+		{
+			// back side casting does not occlude
+			// anything so we can't cull lit polygons
+			if (!PointInfrontOfTriangle(info->relativelightorigin, v2[0], v2[1], v2[2]))
+				SETPVSBIT(info->outshadowtrispvs, t);
+		}
+	}
+	if (!CHECKPVSBIT(info->outsurfacepvs, surfaceindex))
+	{
+		SETPVSBIT(info->outsurfacepvs, surfaceindex);
+		info->outsurfacelist[info->outnumsurfaces++] = surfaceindex;
+	}
+}
+
+static void R_Q1BSP_RecursiveGetLightInfo_BIH(r_q1bsp_getlightinfo_t *info, const bih_t *bih)
+{
+	bih_node_t *node;
+	int nodenum;
+	int axis;
+	int nodeleafindex;
 	int nodestack[GETLIGHTINFO_MAXNODESTACK];
 	int nodestackpos = 0;
 	// note: because the BSP leafs are not in the BIH tree, the _BSP function
 	// must be called to mark leafs visible for entity culling...
+	// the wide hierarchy does its own traversal
+	if (bih->numwidenodes > 0)
+	{
+		BIH_ForEachLeafInBox(bih, info->lightmins, info->lightmaxs, R_Q1BSP_GetLightInfo_BIHLeaf, info);
+		return;
+	}
 	// we start at the root node
 	nodestack[nodestackpos++] = bih->rootnode;
 	// we'll be done when the stack is empty
@@ -1000,73 +1465,7 @@ static void R_Q1BSP_RecursiveGetLightInfo_BIH(r_q1bsp_getlightinfo_t *info, cons
 		if (node->type == BIH_UNORDERED)
 		{
 			for (nodeleafindex = 0;nodeleafindex < BIH_MAXUNORDEREDCHILDREN && node->children[nodeleafindex] >= 0;nodeleafindex++)
-			{
-				leaf = bih->leafs + node->children[nodeleafindex];
-				if (leaf->type != BIH_RENDERTRIANGLE)
-					continue;
-#if 1
-				if (!BoxesOverlap(info->lightmins, info->lightmaxs, leaf->mins, leaf->maxs))
-					continue;
-#endif
-#if 1
-				if (!r_shadow_compilingrtlight && R_CullBox(leaf->mins, leaf->maxs, info->numfrustumplanes, info->frustumplanes))
-					continue;
-#endif
-				surfaceindex = leaf->surfaceindex;
-				surface = info->model->data_surfaces + surfaceindex;
-				currentmaterialflags = R_GetCurrentTexture(surface->texture)->currentmaterialflags;
-				castshadow = !(currentmaterialflags & MATERIALFLAG_NOSHADOW);
-				t = leaf->itemindex;
-				e = info->model->surfmesh.data_element3i + t * 3;
-				v[0] = info->model->surfmesh.data_vertex3f + e[0] * 3;
-				v[1] = info->model->surfmesh.data_vertex3f + e[1] * 3;
-				v[2] = info->model->surfmesh.data_vertex3f + e[2] * 3;
-				VectorCopy(v[0], v2[0]);
-				VectorCopy(v[1], v2[1]);
-				VectorCopy(v[2], v2[2]);
-				if (info->svbsp_insertoccluder)
-				{
-					if (castshadow)
-						SVBSP_AddPolygon(&r_svbsp, 3, v2[0], true, NULL, NULL, 0);
-					continue;
-				}
-				if (info->svbsp_active && !(SVBSP_AddPolygon(&r_svbsp, 3, v2[0], false, NULL, NULL, 0) & 2))
-					continue;
-				// we don't occlude triangles from lighting even
-				// if they are backfacing, because when using
-				// shadowmapping they are often not fully occluded
-				// on the horizon of an edge
-				SETPVSBIT(info->outlighttrispvs, t);
-				if (castshadow)
-				{
-					if (noocclusion || (currentmaterialflags & MATERIALFLAG_NOCULLFACE))
-					{
-						// if the material is double sided we
-						// can't cull by direction
-						SETPVSBIT(info->outshadowtrispvs, t);
-					}
-					else if (frontsidecasting)
-					{
-						// front side casting occludes backfaces,
-						// so they are completely useless as both
-						// casters and lit polygons
-						if (PointInfrontOfTriangle(info->relativelightorigin, v2[0], v2[1], v2[2]))
-							SETPVSBIT(info->outshadowtrispvs, t);
-					}
-					else
-					{
-						// back side casting does not occlude
-						// anything so we can't cull lit polygons
-						if (!PointInfrontOfTriangle(info->relativelightorigin, v2[0], v2[1], v2[2]))
-							SETPVSBIT(info->outshadowtrispvs, t);
-					}
-				}
-				if (!CHECKPVSBIT(info->outsurfacepvs, surfaceindex))
-				{
-					SETPVSBIT(info->outsurfacepvs, surfaceindex);
-					info->outsurfacelist[info->outnumsurfaces++] = surfaceindex;
-				}
-			}
+				R_Q1BSP_GetLightInfo_BIHLeaf(info, bih->leafs + node->children[nodeleafindex]);
 		}
 		else
 		{
@@ -1173,7 +1572,9 @@ static void R_Q1BSP_CallRecursiveGetLightInfo(r_q1bsp_getlightinfo_t *info, qboo
 	else
 		R_Q1BSP_RecursiveGetLightInfo_BSP(info, false);
 	// we're using temporary framedata memory, so this pointer will be invalid soon, clear it
-	r_svbsp.nodes = NULL;
+	// (only if it was used, this may be running on several threads)
+	if (use_svbsp)
+		r_svbsp.nodes = NULL;
 	if (developer_extra.integer && use_svbsp)
 	{
 		Con_DPrintf("GetLightInfo: svbsp built with %i nodes, polygon stats:\n", r_svbsp.numnodes);
@@ -1182,14 +1583,10 @@ static void R_Q1BSP_CallRecursiveGetLightInfo(r_q1bsp_getlightinfo_t *info, qboo
 	}
 }
 
-static msurface_t *r_q1bsp_getlightinfo_surfaces;
-
-static int R_Q1BSP_GetLightInfo_comparefunc(const void *ap, const void *bp)
+static int R_Q1BSP_GetLightInfo_comparefunc(const msurface_t *surfaces, int a, int b)
 {
-	int a = *(int*)ap;
-	int b = *(int*)bp;
-	const msurface_t *as = r_q1bsp_getlightinfo_surfaces + a;
-	const msurface_t *bs = r_q1bsp_getlightinfo_surfaces + b;
+	const msurface_t *as = surfaces + a;
+	const msurface_t *bs = surfaces + b;
 	if (as->texture < bs->texture)
 		return -1;
 	if (as->texture > bs->texture)
@@ -1197,6 +1594,54 @@ static int R_Q1BSP_GetLightInfo_comparefunc(const void *ap, const void *bp)
 	return a - b;
 }
 
+// sorts the surface list by texture, this is a shell sort rather than qsort
+// because qsort has no way to pass the surfaces to the compare function
+// without a global, and this may run on several threads at once
+static void R_Q1BSP_GetLightInfo_SortSurfaces(const msurface_t *surfaces, int *surfacelist, int numsurfaces)
+{
+	int i, j, gap, s;
+	for (gap = 1;gap < numsurfaces / 3;gap = gap * 3 + 1)
+		;
+	for (;gap > 0;gap /= 3)
+	{
+		for (i = gap;i < numsurfaces;i++)
+		{
+			s = surfacelist[i];
+			for (j = i;j >= gap && R_Q1BSP_GetLightInfo_comparefunc(surfaces, surfacelist[j - gap], s) > 0;j -= gap)
+				surfacelist[j] = surfacelist[j - gap];
+			surfacelist[j] = s;
+		}
+	}
+}
+
+/*
+===============
+R_Mod_GetLightInfo_SetThreaded
+
+makes R_Mod_GetLightInfo safe to call from taskqueue threads for the given
+entity (which must be the world) until it is called again with NULL, the
+svbsp and portal culling paths are still not thread safe
+===============
+*/
+void R_Mod_GetLightInfo_SetThreaded(entity_render_t *ent)
+{
+	int i;
+	model_t *model = ent ? ent->model : NULL;
+	r_q1bsp_getlightinfo_threadedmodel = NULL;
+	if (!model || !model->data_textures)
+		return;
+	if (r_q1bsp_getlightinfo_maxmaterialflags < model->num_textures)
+	{
+		r_q1bsp_getlightinfo_maxmaterialflags = model->num_textures;
+		r_q1bsp_getlightinfo_materialflags = (int *)Mem_Realloc(r_main_mempool, r_q1bsp_getlightinfo_materialflags, r_q1bsp_getlightinfo_maxmaterialflags * sizeof(int));
+	}
+	RSurf_ActiveModelEntity(ent, false, false, false);
+	for (i = 0;i < model->num_textures;i++)
+		r_q1bsp_getlightinfo_materialflags[i] = R_GetCurrentTexture(model->data_textures + i)->currentmaterialflags;
+	rsurface.entity = NULL; // used only by R_GetCurrentTexture and RSurf_ActiveModelEntity
+	r_q1bsp_getlightinfo_threadedmodel = model;
+}
+
 extern cvar_t r_shadow_sortsurfaces;
 
 void R_Mod_GetLightInfo(entity_render_t *ent, vec3_t relativelightorigin, float lightradius, vec3_t outmins, vec3_t outmaxs, int *outleaflist, unsigned char *outleafpvs, int *outnumleafspointer, int *outsurfacelist, unsigned char *outsurfacepvs, int *outnumsurfacespointer, unsigned char *outshadowtrispvs, unsigned char *outlighttrispvs, unsigned char *visitingleafpvs, int numfrustumplanes, const mplane_t *frustumplanes, qbool noocclusion)
@@ -1243,7 +1688,13 @@ void R_Mod_GetLightInfo(entity_render_t *ent, vec3_t relativelightorigin, float
 		info.pvs = info.model->brush.GetPVS(info.model, info.relativelightorigin);
 	else
 		info.pvs = NULL;
-	RSurf_ActiveModelEntity(r_refdef.scene.worldentity, false, false, false);
+	if (info.model == r_q1bsp_getlightinfo_threadedmodel)
+		info.materialflags = r_q1bsp_getlightinfo_materialflags;
+	else
+	{
+		info.materialflags = NULL;
+		RSurf_ActiveModelEntity(r_refdef.scene.worldentity, false, false, false);
+	}
 
 	if (!info.noocclusion && r_shadow_compilingrtlight && r_shadow_realtime_world_compileportalculling.integer && info.model->brush.data_portals)
 	{
@@ -1264,7 +1715,8 @@ void R_Mod_GetLightInfo(entity_render_t *ent, vec3_t relativelightorigin, float
 		R_Q1BSP_CallRecursiveGetLightInfo(&info, !info.noocclusion && (r_shadow_compilingrtlight ? r_shadow_realtime_world_compilesvbsp.integer : r_shadow_realtime_dlight_svbspculling.integer) != 0);
 	}
 
-	rsurface.entity = NULL; // used only by R_GetCurrentTexture and RSurf_ActiveModelEntity
+	if (!info.materialflags)
+		rsurface.entity = NULL; // used only by R_GetCurrentTexture and RSurf_ActiveModelEntity
 
 	// limit combined leaf box to light boundaries
 	outmins[0] = max(info.outmins[0] - 1, info.lightmins[0]);
@@ -1278,9 +1730,8 @@ void R_Mod_GetLightInfo(entity_render_t *ent, vec3_t relativelightorigin, float
 	*outnumsurfacespointer = info.outnumsurfaces;
 
 	// now sort surfaces by texture for faster rendering
-	r_q1bsp_getlightinfo_surfaces = info.model->data_surfaces;
 	if (r_shadow_sortsurfaces.integer)
-		qsort(info.outsurfacelist, info.outnumsurfaces, sizeof(*info.outsurfacelist), R_Q1BSP_GetLightInfo_comparefunc);
+		R_Q1BSP_GetLightInfo_SortSurfaces(info.model->data_surfaces, info.outsurfacelist, info.outnumsurfaces);
 }
 
 void R_Mod_CompileShadowMap(entity_render_t *ent, vec3_t relativelightorigin, vec3_t relativelightdirection, float lightradius, int numsurfaces, const int *surfacelist)
@@ -1565,6 +2016,9 @@ void GL_Surf_Init(void)
 {
 
 	Cvar_RegisterVariable(&r_ambient);
+	Cvar_RegisterVariable(&r_q1bsp_lightmap_updates_threaded);
+	Cvar_RegisterVariable(&r_worldvisibility_threaded);
+	Cmd_AddCommand(CF_CLIENT, "r_buildlightmaps_benchmark", R_BuildLightMaps_Benchmark_f, "time the CPU cost of rebuilding every lightmap of the current map, single threaded and on the taskqueue (optional parameter: iterations)");
 	Cvar_RegisterVariable(&r_lockpvs);
 	Cvar_RegisterVariable(&r_lockvisibility);
 	Cvar_RegisterVariable(&r_useportalculling);
@@ -26,6 +26,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "libcurl.h"
 #include "taskqueue.h"
 #include "utf8lib.h"
+#include "image.h"
 
 /*
 
@@ -465,6 +466,9 @@ void Host_Init (void)
 	// initialize ixtable
 	Mathlib_Init();
 
+	// pick the SIMD code paths of the image processing
+	Image_Init();
+
 	// register the cvars for session locking
 	Host_InitSession();
 
@@ -5,9 +5,24 @@
 #include "image_png.h"
 #include "r_shadow.h"
 #include "wad.h"
+#ifdef SSE_POSSIBLE
+#include "image_sse2.h"
+#endif
+#ifdef AVX2_POSSIBLE
+#include "image_avx2.h"
+#endif
+
+DP_THREAD_LOCAL int	image_width;
+DP_THREAD_LOCAL int	image_height;
+DP_THREAD_LOCAL qbool	image_nokeepalive;
 
-int		image_width;
-int		image_height;
+// SIMD code paths of the image processing kernels, picked by Image_Init
+#ifdef SSE_POSSIBLE
+static qbool image_sse2;
+#endif
+#ifdef AVX2_POSSIBLE
+static qbool image_avx2;
+#endif
 
 static unsigned char *Image_GetEmbeddedPicBGRA(const char *name);
 
@@ -924,8 +939,9 @@ void Image_StripImageExtension (const char *in, char *out, size_t size_out)
 		dp_strlcpy(out, in, size_out);
 }
 
-static unsigned char image_linearfromsrgb[256];
-static unsigned char image_srgbfromlinear_lightmap[256];
+// padded for Image_RemapRGB_AVX2
+static unsigned char image_linearfromsrgb[256 + 3];
+static unsigned char image_srgbfromlinear_lightmap[256 + 3];
 
 void Image_MakeLinearColorsFromsRGB(unsigned char *pout, const unsigned char *pin, int numpixels)
 {
@@ -934,6 +950,13 @@ void Image_MakeLinearColorsFromsRGB(unsigned char *pout, const unsigned char *pi
 	if (!image_linearfromsrgb[255])
 		for (i = 0;i < 256;i++)
 			image_linearfromsrgb[i] = (unsigned char)floor(Image_LinearFloatFromsRGB(i) * 255.0f + 0.5f);
+#ifdef AVX2_POSSIBLE
+	if (image_avx2)
+	{
+		Image_RemapRGB_AVX2(pout, pin, numpixels, image_linearfromsrgb);
+		return;
+	}
+#endif
 	for (i = 0;i < numpixels;i++)
 	{
 		pout[i*4+0] = image_linearfromsrgb[pin[i*4+0]];
@@ -950,6 +973,13 @@ void Image_MakesRGBColorsFromLinear_Lightmap(unsigned char *pout, const unsigned
 	if (!image_srgbfromlinear_lightmap[255])
 		for (i = 0;i < 256;i++)
 			image_srgbfromlinear_lightmap[i] = (unsigned char)floor(bound(0.0f, Image_sRGBFloatFromLinear_Lightmap(i), 1.0f) * 255.0f + 0.5f);
+#ifdef AVX2_POSSIBLE
+	if (image_avx2)
+	{
+		Image_RemapRGB_AVX2(pout, pin, numpixels, image_srgbfromlinear_lightmap);
+		return;
+	}
+#endif
 	for (i = 0;i < numpixels;i++)
 	{
 		pout[i*4+0] = image_srgbfromlinear_lightmap[pin[i*4+0]];
@@ -1039,34 +1069,26 @@ imageformat_t imageformats_other[] =
 	{NULL, NULL}
 };
 
-int fixtransparentpixels(unsigned char *data, int w, int h);
-unsigned char *loadimagepixelsbgra (const char *filename, qbool complain, qbool allowFixtrans, qbool convertsRGB, int *miplevel)
+// splits up an image name and picks the list of formats to try for it,
+// basename, path and afterpath must be MAX_QPATH in size
+static imageformat_t *Image_FormatsForName(const char *filename, char *basename, char *path, char *afterpath)
 {
-	fs_offset_t filesize;
-	imageformat_t *firstformat, *format;
-	int mymiplevel;
-	unsigned char *f, *data = NULL, *data2 = NULL;
-	char basename[MAX_QPATH], name[MAX_QPATH], name2[MAX_QPATH], path[MAX_QPATH], afterpath[MAX_QPATH], *c;
-	char vabuf[1024];
-	//if (developer_memorydebug.integer)
-	//	Mem_CheckSentinelsGlobal();
-	if (developer_texturelogging.integer)
-		Log_Printf("textures.log", "%s\n", filename);
-	Image_StripImageExtension(filename, basename, sizeof(basename)); // strip filename extensions to allow replacement by other types
+	imageformat_t *firstformat;
+	char *c;
+	Image_StripImageExtension(filename, basename, MAX_QPATH); // strip filename extensions to allow replacement by other types
 	// replace *'s with #, so commandline utils don't get confused when dealing with the external files
 	for (c = basename;*c;c++)
 		if (*c == '*')
 			*c = '#';
 	path[0] = 0;
-	name[0] = 0;
-	dp_strlcpy(afterpath, basename, sizeof(afterpath));
+	dp_strlcpy(afterpath, basename, MAX_QPATH);
 	if (strchr(basename, '/'))
 	{
 		int i;
-		for (i = 0;i < (int)sizeof(path)-1 && basename[i] != '/' && basename[i];i++)
+		for (i = 0;i < MAX_QPATH-1 && basename[i] != '/' && basename[i];i++)
 			path[i] = basename[i];
 		path[i] = 0;
-		dp_strlcpy(afterpath, basename + i + 1, sizeof(afterpath));
+		dp_strlcpy(afterpath, basename + i + 1, MAX_QPATH);
 	}
 	if (gamemode == GAME_TENEBRAE)
 		firstformat = imageformats_tenebrae;
@@ -1080,6 +1102,80 @@ unsigned char *loadimagepixelsbgra (const char *filename, qbool complain, qbool
 		firstformat = imageformats_nopath;
 	else
 		firstformat = imageformats_other;
+	return firstformat;
+}
+
+/*
+================
+Image_ChecksumImageFile
+
+Computes a checksum of the files loadimagepixelsbgra may load for this name
+(including the alpha image of a jpeg), without decoding them.  A file that
+fails to decode falls through to the next format, so every existing
+candidate is hashed along with its name, not just the first one.  Returns
+false if there is no such file (wad lumps and embedded pics included).
+================
+*/
+qbool Image_ChecksumImageFile(const char *filename, unsigned char *digest)
+{
+	fs_offset_t filesize, alphasize;
+	size_t namesize, datasize;
+	imageformat_t *format;
+	unsigned char *f, *alpha, *data;
+	qbool found = false;
+	char basename[MAX_QPATH], name[MAX_QPATH], alphaname[MAX_QPATH], path[MAX_QPATH], afterpath[MAX_QPATH];
+	char vabuf[1024];
+	for (format = Image_FormatsForName(filename, basename, path, afterpath);format->formatstring;format++)
+	{
+		dpsnprintf (name, sizeof(name), format->formatstring, basename);
+		FS_SanitizePath(name);
+		if(!FS_FileExists(name) || (f = FS_LoadFile(name, tempmempool, true, &filesize)) == NULL)
+			continue;
+		alpha = NULL;
+		alphasize = 0;
+		if(format->loadfunc == JPEG_LoadImage_BGRA)
+		{
+			dpsnprintf (alphaname, sizeof(alphaname), format->formatstring, va(vabuf, sizeof(vabuf), "%s_alpha", basename));
+			alpha = FS_LoadFile(alphaname, tempmempool, true, &alphasize);
+		}
+		// digest of the previous candidates, name, file, alpha file
+		namesize = strlen(name) + 1;
+		datasize = 16 + namesize + filesize + alphasize;
+		data = (unsigned char *)Mem_Alloc(tempmempool, datasize);
+		if (found)
+			memcpy(data, digest, 16);
+		else
+			memset(data, 0, 16);
+		memcpy(data + 16, name, namesize);
+		memcpy(data + 16 + namesize, f, filesize);
+		if (alpha)
+		{
+			memcpy(data + 16 + namesize + filesize, alpha, alphasize);
+			Mem_Free(alpha);
+		}
+		Com_BlockFullChecksum(data, (int)datasize, digest);
+		Mem_Free(data);
+		Mem_Free(f);
+		found = true;
+	}
+	return found;
+}
+
+int fixtransparentpixels(unsigned char *data, int w, int h);
+unsigned char *loadimagepixelsbgra (const char *filename, qbool complain, qbool allowFixtrans, qbool convertsRGB, int *miplevel)
+{
+	fs_offset_t filesize;
+	imageformat_t *firstformat, *format;
+	int mymiplevel;
+	unsigned char *f, *data = NULL, *data2 = NULL;
+	char basename[MAX_QPATH], name[MAX_QPATH], name2[MAX_QPATH], path[MAX_QPATH], afterpath[MAX_QPATH];
+	char vabuf[1024];
+	//if (developer_memorydebug.integer)
+	//	Mem_CheckSentinelsGlobal();
+	if (developer_texturelogging.integer)
+		Log_Printf("textures.log", "%s\n", filename);
+	firstformat = Image_FormatsForName(filename, basename, path, afterpath);
+	name[0] = 0;
 	// now try all the formats in the selected list
 	for (format = firstformat;format->formatstring;format++)
 	{
@@ -1185,7 +1281,8 @@ unsigned char *loadimagepixelsbgra (const char *filename, qbool complain, qbool
 	}
 
 	// texture loading can take a while, so make sure we're sending keepalives
-	CL_KeepaliveMessage(false);
+	if (!image_nokeepalive)
+		CL_KeepaliveMessage(false);
 
 	//if (developer_memorydebug.integer)
 	//	Mem_CheckSentinelsGlobal();
@@ -1254,6 +1351,31 @@ rtexture_t *loadtextureimage (rtexturepool_t *pool, const char *filename, qbool
 	return rt;
 }
 
+static int Image_CountTransparentPixels(const unsigned char *data, int numpixels)
+{
+	int i, count = 0;
+#ifdef SSE_POSSIBLE
+	if (image_sse2)
+		return Image_CountTransparentPixels_SSE2(data, numpixels);
+#endif
+	for (i = 0;i < numpixels;i++)
+		if (data[i * 4 + 3] == 0)
+			count++;
+	return count;
+}
+
+// index of the first mask byte from start on that has any of the bits, or end
+static int Image_FindMaskBits(const unsigned char *mask, int start, int end, int bits)
+{
+#ifdef SSE_POSSIBLE
+	if (image_sse2)
+		return Image_FindMaskBits_SSE2(mask, start, end, bits);
+#endif
+	while (start < end && !(mask[start] & bits))
+		start++;
+	return start;
+}
+
 int fixtransparentpixels(unsigned char *data, int w, int h)
 {
 	int const FIXTRANS_NEEDED = 1;
@@ -1262,10 +1384,10 @@ int fixtransparentpixels(unsigned char *data, int w, int h)
 	int const FIXTRANS_HAS_U = 8;
 	int const FIXTRANS_HAS_D = 16;
 	int const FIXTRANS_FIXED = 32;
-	unsigned char *fixMask = (unsigned char *) Mem_Alloc(tempmempool, w * h);
-	int fixPixels = 0;
+	unsigned char *fixMask;
+	int fixPixels = Image_CountTransparentPixels(data, w * h);
 	int changedPixels = 0;
-	int x, y;
+	int i, x, y;
 
 #define FIXTRANS_PIXEL (y*w+x)
 #define FIXTRANS_PIXEL_U (((y+h-1)%h)*w+x)
@@ -1273,6 +1395,11 @@ int fixtransparentpixels(unsigned char *data, int w, int h)
 #define FIXTRANS_PIXEL_L (y*w+((x+w-1)%w))
 #define FIXTRANS_PIXEL_R (y*w+((x+1)%w))
 
+	if(fixPixels == 0)
+		return 0; // most images have no fully transparent pixels
+	if(fixPixels == w * h)
+		return 0; // sorry, can't do anything about this
+	fixMask = (unsigned char *) Mem_Alloc(tempmempool, w * h);
 	memset(fixMask, 0, w * h);
 	for(y = 0; y < h; ++y)
 		for(x = 0; x < w; ++x)
@@ -1280,7 +1407,6 @@ int fixtransparentpixels(unsigned char *data, int w, int h)
 			if(data[FIXTRANS_PIXEL * 4 + 3] == 0)
 			{
 				fixMask[FIXTRANS_PIXEL] |= FIXTRANS_NEEDED;
-				++fixPixels;
 			}
 			else
 			{
@@ -1290,86 +1416,85 @@ int fixtransparentpixels(unsigned char *data, int w, int h)
 				fixMask[FIXTRANS_PIXEL_L] |= FIXTRANS_HAS_R;
 			}
 		}
-	if(fixPixels == w * h)
-		return 0; // sorry, can't do anything about this
 	while(fixPixels)
 	{
-		for(y = 0; y < h; ++y)
-			for(x = 0; x < w; ++x)
-				if(fixMask[FIXTRANS_PIXEL] & FIXTRANS_NEEDED)
-				{
-					unsigned int sumR = 0, sumG = 0, sumB = 0, sumA = 0, sumRA = 0, sumGA = 0, sumBA = 0, cnt = 0;
-					unsigned char r, g, b, a, r0, g0, b0;
-					if(fixMask[FIXTRANS_PIXEL] & FIXTRANS_HAS_U)
-					{
-						r = data[FIXTRANS_PIXEL_U * 4 + 2];
-						g = data[FIXTRANS_PIXEL_U * 4 + 1];
-						b = data[FIXTRANS_PIXEL_U * 4 + 0];
-						a = data[FIXTRANS_PIXEL_U * 4 + 3];
-						sumR += r; sumG += g; sumB += b; sumA += a; sumRA += r*a; sumGA += g*a; sumBA += b*a; ++cnt;
-					}
-					if(fixMask[FIXTRANS_PIXEL] & FIXTRANS_HAS_D)
-					{
-						r = data[FIXTRANS_PIXEL_D * 4 + 2];
-						g = data[FIXTRANS_PIXEL_D * 4 + 1];
-						b = data[FIXTRANS_PIXEL_D * 4 + 0];
-						a = data[FIXTRANS_PIXEL_D * 4 + 3];
-						sumR += r; sumG += g; sumB += b; sumA += a; sumRA += r*a; sumGA += g*a; sumBA += b*a; ++cnt;
-					}
-					if(fixMask[FIXTRANS_PIXEL] & FIXTRANS_HAS_L)
-					{
-						r = data[FIXTRANS_PIXEL_L * 4 + 2];
-						g = data[FIXTRANS_PIXEL_L * 4 + 1];
-						b = data[FIXTRANS_PIXEL_L * 4 + 0];
-						a = data[FIXTRANS_PIXEL_L * 4 + 3];
-						sumR += r; sumG += g; sumB += b; sumA += a; sumRA += r*a; sumGA += g*a; sumBA += b*a; ++cnt;
-					}
-					if(fixMask[FIXTRANS_PIXEL] & FIXTRANS_HAS_R)
-					{
-						r = data[FIXTRANS_PIXEL_R * 4 + 2];
-						g = data[FIXTRANS_PIXEL_R * 4 + 1];
-						b = data[FIXTRANS_PIXEL_R * 4 + 0];
-						a = data[FIXTRANS_PIXEL_R * 4 + 3];
-						sumR += r; sumG += g; sumB += b; sumA += a; sumRA += r*a; sumGA += g*a; sumBA += b*a; ++cnt;
-					}
-					if(!cnt)
-						continue;
-					r0 = data[FIXTRANS_PIXEL * 4 + 2];
-					g0 = data[FIXTRANS_PIXEL * 4 + 1];
-					b0 = data[FIXTRANS_PIXEL * 4 + 0];
-					if(sumA)
-					{
-						// there is a surrounding non-alpha pixel
-						r = (sumRA + sumA / 2) / sumA;
-						g = (sumGA + sumA / 2) / sumA;
-						b = (sumBA + sumA / 2) / sumA;
-					}
-					else
-					{
-						// need to use a "regular" average
-						r = (sumR + cnt / 2) / cnt;
-						g = (sumG + cnt / 2) / cnt;
-						b = (sumB + cnt / 2) / cnt;
-					}
-					if(r != r0 || g != g0 || b != b0)
-						++changedPixels;
-					data[FIXTRANS_PIXEL * 4 + 2] = r;
-					data[FIXTRANS_PIXEL * 4 + 1] = g;
-					data[FIXTRANS_PIXEL * 4 + 0] = b;
-					fixMask[FIXTRANS_PIXEL] |= FIXTRANS_FIXED;
-				}
-		for(y = 0; y < h; ++y)
-			for(x = 0; x < w; ++x)
-				if(fixMask[FIXTRANS_PIXEL] & FIXTRANS_FIXED)
-				{
-					fixMask[FIXTRANS_PIXEL] &= ~(FIXTRANS_NEEDED | FIXTRANS_FIXED);
-					fixMask[FIXTRANS_PIXEL_D] |= FIXTRANS_HAS_U;
-					fixMask[FIXTRANS_PIXEL_U] |= FIXTRANS_HAS_D;
-					fixMask[FIXTRANS_PIXEL_R] |= FIXTRANS_HAS_L;
-					fixMask[FIXTRANS_PIXEL_L] |= FIXTRANS_HAS_R;
-					--fixPixels;
-				}
+		for(i = Image_FindMaskBits(fixMask, 0, w * h, FIXTRANS_NEEDED); i < w * h; i = Image_FindMaskBits(fixMask, i + 1, w * h, FIXTRANS_NEEDED))
+		{
+			unsigned int sumR = 0, sumG = 0, sumB = 0, sumA = 0, sumRA = 0, sumGA = 0, sumBA = 0, cnt = 0;
+			unsigned char r, g, b, a, r0, g0, b0;
+			y = i / w;
+			x = i - y * w;
+			if(fixMask[FIXTRANS_PIXEL] & FIXTRANS_HAS_U)
+			{
+				r = data[FIXTRANS_PIXEL_U * 4 + 2];
+				g = data[FIXTRANS_PIXEL_U * 4 + 1];
+				b = data[FIXTRANS_PIXEL_U * 4 + 0];
+				a = data[FIXTRANS_PIXEL_U * 4 + 3];
+				sumR += r; sumG += g; sumB += b; sumA += a; sumRA += r*a; sumGA += g*a; sumBA += b*a; ++cnt;
+			}
+			if(fixMask[FIXTRANS_PIXEL] & FIXTRANS_HAS_D)
+			{
+				r = data[FIXTRANS_PIXEL_D * 4 + 2];
+				g = data[FIXTRANS_PIXEL_D * 4 + 1];
+				b = data[FIXTRANS_PIXEL_D * 4 + 0];
+				a = data[FIXTRANS_PIXEL_D * 4 + 3];
+				sumR += r; sumG += g; sumB += b; sumA += a; sumRA += r*a; sumGA += g*a; sumBA += b*a; ++cnt;
+			}
+			if(fixMask[FIXTRANS_PIXEL] & FIXTRANS_HAS_L)
+			{
+				r = data[FIXTRANS_PIXEL_L * 4 + 2];
+				g = data[FIXTRANS_PIXEL_L * 4 + 1];
+				b = data[FIXTRANS_PIXEL_L * 4 + 0];
+				a = data[FIXTRANS_PIXEL_L * 4 + 3];
+				sumR += r; sumG += g; sumB += b; sumA += a; sumRA += r*a; sumGA += g*a; sumBA += b*a; ++cnt;
+			}
+			if(fixMask[FIXTRANS_PIXEL] & FIXTRANS_HAS_R)
+			{
+				r = data[FIXTRANS_PIXEL_R * 4 + 2];
+				g = data[FIXTRANS_PIXEL_R * 4 + 1];
+				b = data[FIXTRANS_PIXEL_R * 4 + 0];
+				a = data[FIXTRANS_PIXEL_R * 4 + 3];
+				sumR += r; sumG += g; sumB += b; sumA += a; sumRA += r*a; sumGA += g*a; sumBA += b*a; ++cnt;
+			}
+			if(!cnt)
+				continue;
+			r0 = data[FIXTRANS_PIXEL * 4 + 2];
+			g0 = data[FIXTRANS_PIXEL * 4 + 1];
+			b0 = data[FIXTRANS_PIXEL * 4 + 0];
+			if(sumA)
+			{
+				// there is a surrounding non-alpha pixel
+				r = (sumRA + sumA / 2) / sumA;
+				g = (sumGA + sumA / 2) / sumA;
+				b = (sumBA + sumA / 2) / sumA;
+			}
+			else
+			{
+				// need to use a "regular" average
+				r = (sumR + cnt / 2) / cnt;
+				g = (sumG + cnt / 2) / cnt;
+				b = (sumB + cnt / 2) / cnt;
+			}
+			if(r != r0 || g != g0 || b != b0)
+				++changedPixels;
+			data[FIXTRANS_PIXEL * 4 + 2] = r;
+			data[FIXTRANS_PIXEL * 4 + 1] = g;
+			data[FIXTRANS_PIXEL * 4 + 0] = b;
+			fixMask[FIXTRANS_PIXEL] |= FIXTRANS_FIXED;
+		}
+		for(i = Image_FindMaskBits(fixMask, 0, w * h, FIXTRANS_FIXED); i < w * h; i = Image_FindMaskBits(fixMask, i + 1, w * h, FIXTRANS_FIXED))
+		{
+			y = i / w;
+			x = i - y * w;
+			fixMask[FIXTRANS_PIXEL] &= ~(FIXTRANS_NEEDED | FIXTRANS_FIXED);
+			fixMask[FIXTRANS_PIXEL_D] |= FIXTRANS_HAS_U;
+			fixMask[FIXTRANS_PIXEL_U] |= FIXTRANS_HAS_D;
+			fixMask[FIXTRANS_PIXEL_R] |= FIXTRANS_HAS_L;
+			fixMask[FIXTRANS_PIXEL_L] |= FIXTRANS_HAS_R;
+			--fixPixels;
+		}
 	}
+	Mem_Free(fixMask);
 	return changedPixels;
 }
 
@@ -1497,6 +1622,13 @@ qbool Image_WriteTGABGRA (const char *filename, int width, int height, const uns
 static void Image_Resample32LerpLine (const unsigned char *in, unsigned char *out, int inwidth, int outwidth)
 {
 	int		j, xi, oldx = 0, f, fstep, endx, lerp;
+#ifdef SSE_POSSIBLE
+	if (image_sse2)
+	{
+		Image_Resample32LerpLine_SSE2(in, out, inwidth, outwidth);
+		return;
+	}
+#endif
 	fstep = (int) (inwidth*65536.0f/outwidth);
 	endx = (inwidth-1);
 	for (j = 0,f = 0;j < outwidth;j++, f += fstep)
@@ -1525,10 +1657,74 @@ static void Image_Resample32LerpLine (const unsigned char *in, unsigned char *ou
 	}
 }
 
-#define LERPBYTE(i) r = resamplerow1[i];out[i] = (unsigned char) ((((resamplerow2[i] - r) * lerp) >> 16) + r)
+#define LERPBYTE(i) r = row1[i];out[i] = (unsigned char) ((((row2[i] - r) * lerp) >> 16) + r)
+static void Image_Resample32LerpRows(const unsigned char *row1, const unsigned char *row2, unsigned char *out, int outwidth, int lerp)
+{
+	int j, r;
+#ifdef AVX2_POSSIBLE
+	if (image_avx2)
+	{
+		Image_Resample32LerpRows_AVX2(row1, row2, out, outwidth * 4, lerp);
+		return;
+	}
+#endif
+#ifdef SSE_POSSIBLE
+	if (image_sse2)
+	{
+		Image_Resample32LerpRows_SSE2(row1, row2, out, outwidth * 4, lerp);
+		return;
+	}
+#endif
+	j = outwidth - 4;
+	while(j >= 0)
+	{
+		LERPBYTE( 0);
+		LERPBYTE( 1);
+		LERPBYTE( 2);
+		LERPBYTE( 3);
+		LERPBYTE( 4);
+		LERPBYTE( 5);
+		LERPBYTE( 6);
+		LERPBYTE( 7);
+		LERPBYTE( 8);
+		LERPBYTE( 9);
+		LERPBYTE(10);
+		LERPBYTE(11);
+		LERPBYTE(12);
+		LERPBYTE(13);
+		LERPBYTE(14);
+		LERPBYTE(15);
+		out += 16;
+		row1 += 16;
+		row2 += 16;
+		j -= 4;
+	}
+	if (j & 2)
+	{
+		LERPBYTE( 0);
+		LERPBYTE( 1);
+		LERPBYTE( 2);
+		LERPBYTE( 3);
+		LERPBYTE( 4);
+		LERPBYTE( 5);
+		LERPBYTE( 6);
+		LERPBYTE( 7);
+		out += 8;
+		row1 += 8;
+		row2 += 8;
+	}
+	if (j & 1)
+	{
+		LERPBYTE( 0);
+		LERPBYTE( 1);
+		LERPBYTE( 2);
+		LERPBYTE( 3);
+	}
+}
+
 static void Image_Resample32Lerp(const void *indata, int inwidth, int inheight, void *outdata, int outwidth, int outheight)
 {
-	int i, j, r, yi, oldy, f, fstep, lerp, endy = (inheight-1), inwidth4 = inwidth*4, outwidth4 = outwidth*4;
+	int i, yi, oldy, f, fstep, lerp, endy = (inheight-1), inwidth4 = inwidth*4, outwidth4 = outwidth*4;
 	unsigned char *out;
 	const unsigned char *inrow;
 	unsigned char *resamplerow1;
@@ -1543,7 +1739,7 @@ static void Image_Resample32Lerp(const void *indata, int inwidth, int inheight,
 	oldy = 0;
 	Image_Resample32LerpLine (inrow, resamplerow1, inwidth, outwidth);
 	Image_Resample32LerpLine (inrow + inwidth4, resamplerow2, inwidth, outwidth);
-	for (i = 0, f = 0;i < outheight;i++,f += fstep)
+	for (i = 0, f = 0;i < outheight;i++,f += fstep, out += outwidth4)
 	{
 		yi = f >> 16;
 		if (yi < endy)
@@ -1559,56 +1755,7 @@ static void Image_Resample32Lerp(const void *indata, int inwidth, int inheight,
 				Image_Resample32LerpLine (inrow + inwidth4, resamplerow2, inwidth, outwidth);
 				oldy = yi;
 			}
-			j = outwidth - 4;
-			while(j >= 0)
-			{
-				LERPBYTE( 0);
-				LERPBYTE( 1);
-				LERPBYTE( 2);
-				LERPBYTE( 3);
-				LERPBYTE( 4);
-				LERPBYTE( 5);
-				LERPBYTE( 6);
-				LERPBYTE( 7);
-				LERPBYTE( 8);
-				LERPBYTE( 9);
-				LERPBYTE(10);
-				LERPBYTE(11);
-				LERPBYTE(12);
-				LERPBYTE(13);
-				LERPBYTE(14);
-				LERPBYTE(15);
-				out += 16;
-				resamplerow1 += 16;
-				resamplerow2 += 16;
-				j -= 4;
-			}
-			if (j & 2)
-			{
-				LERPBYTE( 0);
-				LERPBYTE( 1);
-				LERPBYTE( 2);
-				LERPBYTE( 3);
-				LERPBYTE( 4);
-				LERPBYTE( 5);
-				LERPBYTE( 6);
-				LERPBYTE( 7);
-				out += 8;
-				resamplerow1 += 8;
-				resamplerow2 += 8;
-			}
-			if (j & 1)
-			{
-				LERPBYTE( 0);
-				LERPBYTE( 1);
-				LERPBYTE( 2);
-				LERPBYTE( 3);
-				out += 4;
-				resamplerow1 += 4;
-				resamplerow2 += 4;
-			}
-			resamplerow1 -= outwidth4;
-			resamplerow2 -= outwidth4;
+			Image_Resample32LerpRows(resamplerow1, resamplerow2, out, outwidth, lerp);
 		}
 		else
 		{
@@ -1636,6 +1783,13 @@ static void Image_Resample32Nolerp(const void *indata, int inwidth, int inheight
 	unsigned frac, fracstep;
 	// relies on int being 4 bytes
 	int *inrow, *out;
+#ifdef AVX2_POSSIBLE
+	if (image_avx2)
+	{
+		Image_Resample32Nolerp_AVX2(indata, inwidth, inheight, outdata, outwidth, outheight);
+		return;
+	}
+#endif
 	out = (int *)outdata;
 
 	fracstep = inwidth*0x10000/outwidth;
@@ -1705,6 +1859,18 @@ void Image_MipReduce32(const unsigned char *in, unsigned char *out, int *width,
 	// pixels, rather than doing a proper box-filter scale down
 	inrow = in;
 	nextrow = *width * 4;
+#ifdef SSE_POSSIBLE
+	if (image_sse2 && (*width > destwidth || *height > destheight))
+	{
+		qbool reducewidth = *width > destwidth, reduceheight = *height > destheight;
+		if (reducewidth)
+			*width >>= 1;
+		if (reduceheight)
+			*height >>= 1;
+		Image_MipReduce32_SSE2(in, out, *width, *height, nextrow, reducewidth, reduceheight);
+		return;
+	}
+#endif
 	if (*width > destwidth)
 	{
 		*width >>= 1;
@@ -1773,6 +1939,13 @@ void Image_HeightmapToNormalmap_BGRA(const unsigned char *inpixels, unsigned cha
 	int p[5];
 	unsigned char *out;
 	float ibumpscale, n[3];
+#ifdef SSE_POSSIBLE
+	if (image_sse2)
+	{
+		Image_HeightmapToNormalmap_BGRA_SSE2(inpixels, outpixels, width, height, clamp, bumpscale);
+		return;
+	}
+#endif
 	ibumpscale = (255.0f * 6.0f) / bumpscale;
 	out = outpixels;
 	for (y = 0, y1 = height-1;y < height;y1 = y, y++)
@@ -1808,6 +1981,125 @@ void Image_HeightmapToNormalmap_BGRA(const unsigned char *inpixels, unsigned cha
 }
 
 
+static const char *image_benchmark_names[] =
+{
+	"Image_Resample32 (lerp)",
+	"Image_Resample32 (nolerp)",
+	"Image_MipReduce32",
+	"Image_MakeLinearColorsFromsRGB",
+	"Image_HeightmapToNormalmap_BGRA",
+	"fixtransparentpixels",
+};
+
+// runs one of the benchmarked kernels on a size x size image, returns the
+// number of bytes written to out
+static int Image_Benchmark_Run(int kernel, const unsigned char *in, unsigned char *out, int size)
+{
+	int w = size, h = size, d = 1;
+	switch (kernel)
+	{
+	case 0:
+		Image_Resample32(in, size, size, 1, out, size * 3 / 2, size * 3 / 2, 1, 1);
+		return (size * 3 / 2) * (size * 3 / 2) * 4;
+	case 1:
+		Image_Resample32(in, size, size, 1, out, size * 3 / 2, size * 3 / 2, 1, 0);
+		return (size * 3 / 2) * (size * 3 / 2) * 4;
+	case 2:
+		Image_MipReduce32(in, out, &w, &h, &d, 1, 1, 1);
+		return w * h * 4;
+	case 3:
+		Image_MakeLinearColorsFromsRGB(out, in, size * size);
+		return size * size * 4;
+	case 4:
+		Image_HeightmapToNormalmap_BGRA(in, out, size, size, false, 4.0f);
+		return size * size * 4;
+	default:
+		memcpy(out, in, size * size * 4);
+		fixtransparentpixels(out, size, size);
+		return size * size * 4;
+	}
+}
+
+/*
+================
+Image_Benchmark_f
+
+Times the image processing kernels on a synthetic image with the generic
+code and with the SIMD code paths this cpu has, and checks that both give
+the same pixels
+================
+*/
+static void Image_Benchmark_f(cmd_state_t *cmd)
+{
+	int i, k, x, y, pass, size, iterations, outsize = 0;
+	unsigned char *in, *p, *out[2];
+	double start, t[2];
+	qbool sse2 = false, avx2 = false;
+
+	size = Cmd_Argc(cmd) > 1 ? atoi(Cmd_Argv(cmd, 1)) : 1024;
+	size = bound(16, size, 4096);
+	iterations = Cmd_Argc(cmd) > 2 ? atoi(Cmd_Argv(cmd, 2)) : 10;
+	iterations = max(iterations, 1);
+#ifdef SSE_POSSIBLE
+	sse2 = image_sse2;
+#endif
+#ifdef AVX2_POSSIBLE
+	avx2 = image_avx2;
+#endif
+
+	// gradients with some noise, and blocks of fully transparent pixels for
+	// fixtransparentpixels to fill
+	in = (unsigned char *)Mem_Alloc(tempmempool, size * size * 4);
+	for (y = 0, p = in;y < size;y++)
+	{
+		for (x = 0;x < size;x++, p += 4)
+		{
+			p[0] = (unsigned char)(x + (rand() & 15));
+			p[1] = (unsigned char)(y + (rand() & 15));
+			p[2] = (unsigned char)((x ^ y) + (rand() & 15));
+			p[3] = (((x >> 4) + (y >> 4)) & 3) ? 255 : 0;
+		}
+	}
+	// room for the resample to 1.5 times the size
+	out[0] = (unsigned char *)Mem_Alloc(tempmempool, size * size * 4 * 3);
+	out[1] = (unsigned char *)Mem_Alloc(tempmempool, size * size * 4 * 3);
+
+	Con_Printf("%ix%i image, %i iterations, SIMD code paths:%s%s%s\n", size, size, iterations, sse2 ? " SSE2" : "", avx2 ? " AVX2" : "", (!sse2 && !avx2) ? " none" : "");
+	for (k = 0;k < (int)(sizeof(image_benchmark_names) / sizeof(image_benchmark_names[0]));k++)
+	{
+		// the generic code first
+		for (pass = 0;pass < 2;pass++)
+		{
+#ifdef SSE_POSSIBLE
+			image_sse2 = pass && sse2;
+#endif
+#ifdef AVX2_POSSIBLE
+			image_avx2 = pass && avx2;
+#endif
+			start = Sys_DirtyTime();
+			for (i = 0;i < iterations;i++)
+				outsize = Image_Benchmark_Run(k, in, out[pass], size);
+			t[pass] = (Sys_DirtyTime() - start) * 1000.0 / iterations;
+		}
+		Con_Printf("%-32s generic %8.3fms, SIMD %8.3fms (%.2fx)%s\n", image_benchmark_names[k], t[0], t[1], t[0] / max(t[1], 0.000001), memcmp(out[0], out[1], outsize) ? ", RESULTS DIFFER" : "");
+	}
+
+	Mem_Free(out[1]);
+	Mem_Free(out[0]);
+	Mem_Free(in);
+}
+
+void Image_Init(void)
+{
+#ifdef SSE_POSSIBLE
+	image_sse2 = Sys_HaveSSE2();
+#endif
+#ifdef AVX2_POSSIBLE
+	image_avx2 = Sys_HaveAVX2();
+#endif
+	Cmd_AddCommand(CF_SHARED, "image_benchmark", Image_Benchmark_f, "time the image resample, mipmap, sRGB, normalmap and fixtrans code with and without SIMD and check that the results match (optional parameters: image size, iterations)");
+}
+
 #include "lhfont.h"
 
 static unsigned char *Image_GenerateConChars(void)
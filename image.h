@@ -4,10 +4,17 @@
 
 #include <stddef.h>
 #include "qtypes.h"
+#include "qdefs.h"
 #include "cvar.h"
 #include "r_textures.h"
 
-extern int image_width, image_height;
+// set by the image loaders, thread local so images can be decoded on the taskqueue
+extern DP_THREAD_LOCAL int image_width, image_height;
+// set on taskqueue threads, where loadimagepixelsbgra must not send network keepalives
+extern DP_THREAD_LOCAL qbool image_nokeepalive;
+
+// picks the SIMD code paths and registers the image_benchmark command
+void Image_Init(void);
 
 unsigned char *Image_GenerateNoTexture(void);
 
@@ -31,6 +38,9 @@ unsigned char *LoadTGA_BGRA (const unsigned char *f, int filesize, int *miplevel
 // loads a texture, as pixel data
 unsigned char *loadimagepixelsbgra (const char *filename, qbool complain, qbool allowFixtrans, qbool convertsRGB, int *miplevel);
 
+// md4 checksum of the image file loadimagepixelsbgra would load, returns false if there is none
+qbool Image_ChecksumImageFile(const char *filename, unsigned char *digest);
+
 // searches for lmp and wad pics of the provided name and returns true and their dimensions if found
 qbool Image_GetStockPicSize(const char *filename, int *returnwidth, int *returnheight);
 
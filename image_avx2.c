@@ -0,0 +1,86 @@
+#include "image_avx2.h"
+
+#ifdef AVX2_POSSIBLE
+
+#include <immintrin.h>
+
+// all of these give exactly the same pixels as the generic code in image.c
+
+AVX2_FUNCTION void Image_Resample32Nolerp_AVX2(const void *indata, int inwidth, int inheight, void *outdata, int outwidth, int outheight)
+{
+	int i, j;
+	unsigned frac, fracstep;
+	const int *inrow;
+	int *out = (int *)outdata;
+	__m256i fracs, step;
+
+	fracstep = inwidth*0x10000/outwidth;
+	step = _mm256_set1_epi32((int)(fracstep * 8));
+	for (i = 0;i < outheight;i++)
+	{
+		inrow = (const int *)indata + inwidth*(i*inheight/outheight);
+		frac = fracstep >> 1;
+		fracs = _mm256_add_epi32(_mm256_set1_epi32((int)frac), _mm256_mullo_epi32(_mm256_set1_epi32((int)fracstep), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+		for (j = 0;j + 8 <= outwidth;j += 8)
+		{
+			_mm256_storeu_si256((__m256i *)(out + j), _mm256_i32gather_epi32(inrow, _mm256_srli_epi32(fracs, 16), 4));
+			fracs = _mm256_add_epi32(fracs, step);
+		}
+		for (frac += fracstep * j;j < outwidth;j++, frac += fracstep)
+			out[j] = inrow[frac >> 16];
+		out += outwidth;
+	}
+}
+
+AVX2_FUNCTION void Image_Resample32LerpRows_AVX2(const unsigned char *row1, const unsigned char *row2, unsigned char *out, int numbytes, int lerp)
+{
+	int i;
+	__m256i zero = _mm256_setzero_si256();
+	__m256i l = _mm256_set1_epi16((short)lerp);
+	__m256i fix = _mm256_srai_epi16(l, 15);
+	__m256i a, b, lo, hi, d;
+	for (i = 0;i + 32 <= numbytes;i += 32)
+	{
+		// unpack and pack both work within 128bit lanes, so the order comes out right
+		a = _mm256_loadu_si256((const __m256i *)(row1 + i));
+		b = _mm256_loadu_si256((const __m256i *)(row2 + i));
+		lo = _mm256_unpacklo_epi8(a, zero);
+		hi = _mm256_unpackhi_epi8(a, zero);
+		// ((d * lerp) >> 16) with mulhi reading lerp as signed, see the SSE2 version
+		d = _mm256_sub_epi16(_mm256_unpacklo_epi8(b, zero), lo);
+		lo = _mm256_add_epi16(lo, _mm256_add_epi16(_mm256_mulhi_epi16(d, l), _mm256_and_si256(d, fix)));
+		d = _mm256_sub_epi16(_mm256_unpackhi_epi8(b, zero), hi);
+		hi = _mm256_add_epi16(hi, _mm256_add_epi16(_mm256_mulhi_epi16(d, l), _mm256_and_si256(d, fix)));
+		_mm256_storeu_si256((__m256i *)(out + i), _mm256_packus_epi16(lo, hi));
+	}
+	for (;i < numbytes;i++)
+		out[i] = (unsigned char) ((((row2[i] - row1[i]) * lerp) >> 16) + row1[i]);
+}
+
+// the table needs 3 bytes of padding after its 256 entries, as each lookup
+// gathers 32 bits and keeps the low byte
+AVX2_FUNCTION void Image_RemapRGB_AVX2(unsigned char *pout, const unsigned char *pin, int numpixels, const unsigned char *table)
+{
+	int i;
+	const int *t = (const int *)table;
+	__m256i m = _mm256_set1_epi32(0xFF);
+	__m256i p, c;
+	for (i = 0;i + 8 <= numpixels;i += 8)
+	{
+		p = _mm256_loadu_si256((const __m256i *)(pin + i * 4));
+		c = _mm256_andnot_si256(_mm256_set1_epi32(0x00FFFFFF), p);
+		c = _mm256_or_si256(c, _mm256_and_si256(_mm256_i32gather_epi32(t, _mm256_and_si256(p, m), 1), m));
+		c = _mm256_or_si256(c, _mm256_slli_epi32(_mm256_and_si256(_mm256_i32gather_epi32(t, _mm256_and_si256(_mm256_srli_epi32(p, 8), m), 1), m), 8));
+		c = _mm256_or_si256(c, _mm256_slli_epi32(_mm256_and_si256(_mm256_i32gather_epi32(t, _mm256_and_si256(_mm256_srli_epi32(p, 16), m), 1), m), 16));
+		_mm256_storeu_si256((__m256i *)(pout + i * 4), c);
+	}
+	for (;i < numpixels;i++)
+	{
+		pout[i*4+0] = table[pin[i*4+0]];
+		pout[i*4+1] = table[pin[i*4+1]];
+		pout[i*4+2] = table[pin[i*4+2]];
+		pout[i*4+3] = pin[i*4+3];
+	}
+}
+
+#endif
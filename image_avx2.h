@@ -0,0 +1,12 @@
+#ifndef IMAGE_AVX2_H
+#define IMAGE_AVX2_H
+
+#include "quakedef.h"
+
+#ifdef AVX2_POSSIBLE
+void Image_Resample32Nolerp_AVX2(const void *indata, int inwidth, int inheight, void *outdata, int outwidth, int outheight);
+void Image_Resample32LerpRows_AVX2(const unsigned char *row1, const unsigned char *row2, unsigned char *out, int numbytes, int lerp);
+void Image_RemapRGB_AVX2(unsigned char *pout, const unsigned char *pin, int numpixels, const unsigned char *table);
+#endif
+
+#endif
@@ -226,7 +226,7 @@ void PNG_CloseLibrary (void)
 #define PNG_INFO_tRNS 0x0010
 
 // this struct is only used for status information during loading
-static struct
+static DP_THREAD_LOCAL struct
 {
 	const unsigned char	*tmpBuf;
 	int		tmpBuflength;
@@ -0,0 +1,263 @@
+#include "image_sse2.h"
+
+#ifdef SSE_POSSIBLE
+
+#include <emmintrin.h>
+
+// all of these give exactly the same pixels as the generic code in image.c
+
+// ((d * lerp) >> 16) on 16bit lanes for lerp values 0-65535, mulhi reads
+// lerp values of 32768 and above as lerp - 65536 so d is added back for them
+static inline __m128i Image_LerpMul_SSE2(__m128i d, __m128i lerp)
+{
+	return _mm_add_epi16(_mm_mulhi_epi16(d, lerp), _mm_and_si128(d, _mm_srai_epi16(lerp, 15)));
+}
+
+void Image_Resample32LerpLine_SSE2(const unsigned char *in, unsigned char *out, int inwidth, int outwidth)
+{
+	int j, xi, f, fstep, endx, lerp;
+	__m128i zero = _mm_setzero_si128();
+	__m128i p0, p1, a, b, l;
+	fstep = (int) (inwidth*65536.0f/outwidth);
+	endx = (inwidth-1);
+	// two pixels at a time while both have a pixel to lerp to
+	for (j = 0, f = 0;j + 2 <= outwidth && ((f + fstep) >> 16) < endx;j += 2, f += fstep * 2)
+	{
+		p0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(in + (f >> 16) * 4)), zero);
+		p1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(in + ((f + fstep) >> 16) * 4)), zero);
+		a = _mm_unpacklo_epi64(p0, p1);
+		b = _mm_unpackhi_epi64(p0, p1);
+		l = _mm_unpacklo_epi64(_mm_set1_epi16((short)(f & 0xFFFF)), _mm_set1_epi16((short)((f + fstep) & 0xFFFF)));
+		a = _mm_add_epi16(a, Image_LerpMul_SSE2(_mm_sub_epi16(b, a), l));
+		_mm_storel_epi64((__m128i *)(out + j * 4), _mm_packus_epi16(a, a));
+	}
+	for (;j < outwidth;j++, f += fstep)
+	{
+		xi = f >> 16;
+		if (xi < endx)
+		{
+			lerp = f & 0xFFFF;
+			out[j*4+0] = (unsigned char) ((((in[xi*4+4] - in[xi*4+0]) * lerp) >> 16) + in[xi*4+0]);
+			out[j*4+1] = (unsigned char) ((((in[xi*4+5] - in[xi*4+1]) * lerp) >> 16) + in[xi*4+1]);
+			out[j*4+2] = (unsigned char) ((((in[xi*4+6] - in[xi*4+2]) * lerp) >> 16) + in[xi*4+2]);
+			out[j*4+3] = (unsigned char) ((((in[xi*4+7] - in[xi*4+3]) * lerp) >> 16) + in[xi*4+3]);
+		}
+		else // last pixel of the line has no pixel to lerp to
+		{
+			out[j*4+0] = in[xi*4+0];
+			out[j*4+1] = in[xi*4+1];
+			out[j*4+2] = in[xi*4+2];
+			out[j*4+3] = in[xi*4+3];
+		}
+	}
+}
+
+void Image_Resample32LerpRows_SSE2(const unsigned char *row1, const unsigned char *row2, unsigned char *out, int numbytes, int lerp)
+{
+	int i;
+	__m128i zero = _mm_setzero_si128();
+	__m128i l = _mm_set1_epi16((short)lerp);
+	__m128i a, b, lo, hi;
+	for (i = 0;i + 16 <= numbytes;i += 16)
+	{
+		a = _mm_loadu_si128((const __m128i *)(row1 + i));
+		b = _mm_loadu_si128((const __m128i *)(row2 + i));
+		lo = _mm_unpacklo_epi8(a, zero);
+		hi = _mm_unpackhi_epi8(a, zero);
+		lo = _mm_add_epi16(lo, Image_LerpMul_SSE2(_mm_sub_epi16(_mm_unpacklo_epi8(b, zero), lo), l));
+		hi = _mm_add_epi16(hi, Image_LerpMul_SSE2(_mm_sub_epi16(_mm_unpackhi_epi8(b, zero), hi), l));
+		_mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(lo, hi));
+	}
+	for (;i < numbytes;i++)
+		out[i] = (unsigned char) ((((row2[i] - row1[i]) * lerp) >> 16) + row1[i]);
+}
+
+// sums each pair of neighboring pixels in a and b (8 pixels as 16bit lanes)
+// into 4 pixels
+static inline __m128i Image_PairSum_SSE2(__m128i a, __m128i b)
+{
+	a = _mm_add_epi16(a, _mm_srli_si128(a, 8));
+	b = _mm_add_epi16(b, _mm_srli_si128(b, 8));
+	return _mm_unpacklo_epi64(a, b);
+}
+
+// the output can be the same as the input, it never gets ahead of the reads
+void Image_MipReduce32_SSE2(const unsigned char *in, unsigned char *out, int outwidth, int outheight, int nextrow, qbool reducewidth, qbool reduceheight)
+{
+	const unsigned char *inrow;
+	int x, y, c;
+	__m128i zero = _mm_setzero_si128();
+	__m128i a, b, c0, c1, lo, hi;
+	for (y = 0, inrow = in;y < outheight;y++, inrow += reduceheight ? nextrow * 2 : nextrow)
+	{
+		in = inrow;
+		x = 0;
+		if (reducewidth && reduceheight)
+		{
+			for (;x + 4 <= outwidth;x += 4, in += 32, out += 16)
+			{
+				a = _mm_loadu_si128((const __m128i *)in);
+				b = _mm_loadu_si128((const __m128i *)(in + nextrow));
+				c0 = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+				c1 = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+				lo = Image_PairSum_SSE2(c0, c1);
+				a = _mm_loadu_si128((const __m128i *)(in + 16));
+				b = _mm_loadu_si128((const __m128i *)(in + nextrow + 16));
+				c0 = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+				c1 = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+				hi = Image_PairSum_SSE2(c0, c1);
+				_mm_storeu_si128((__m128i *)out, _mm_packus_epi16(_mm_srli_epi16(lo, 2), _mm_srli_epi16(hi, 2)));
+			}
+			for (;x < outwidth;x++, in += 8, out += 4)
+				for (c = 0;c < 4;c++)
+					out[c] = (unsigned char) ((in[c] + in[c+4] + in[nextrow+c] + in[nextrow+c+4]) >> 2);
+		}
+		else if (reducewidth)
+		{
+			for (;x + 4 <= outwidth;x += 4, in += 32, out += 16)
+			{
+				a = _mm_loadu_si128((const __m128i *)in);
+				lo = Image_PairSum_SSE2(_mm_unpacklo_epi8(a, zero), _mm_unpackhi_epi8(a, zero));
+				a = _mm_loadu_si128((const __m128i *)(in + 16));
+				hi = Image_PairSum_SSE2(_mm_unpacklo_epi8(a, zero), _mm_unpackhi_epi8(a, zero));
+				_mm_storeu_si128((__m128i *)out, _mm_packus_epi16(_mm_srli_epi16(lo, 1), _mm_srli_epi16(hi, 1)));
+			}
+			for (;x < outwidth;x++, in += 8, out += 4)
+				for (c = 0;c < 4;c++)
+					out[c] = (unsigned char) ((in[c] + in[c+4]) >> 1);
+		}
+		else
+		{
+			for (;x + 4 <= outwidth;x += 4, in += 16, out += 16)
+			{
+				a = _mm_loadu_si128((const __m128i *)in);
+				b = _mm_loadu_si128((const __m128i *)(in + nextrow));
+				lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+				hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+				_mm_storeu_si128((__m128i *)out, _mm_packus_epi16(_mm_srli_epi16(lo, 1), _mm_srli_epi16(hi, 1)));
+			}
+			for (;x < outwidth;x++, in += 4, out += 4)
+				for (c = 0;c < 4;c++)
+					out[c] = (unsigned char) ((in[c] + in[nextrow+c]) >> 1);
+		}
+	}
+}
+
+// b+g+r of a row of pixels, with the wrapped around neighbors stored
+// before and after it
+static void Image_HeightmapRowSums_SSE2(const unsigned char *in, int *sums, int width)
+{
+	int x;
+	__m128i m = _mm_set1_epi32(0xFF);
+	__m128i p;
+	for (x = 0;x + 4 <= width;x += 4)
+	{
+		p = _mm_loadu_si128((const __m128i *)(in + x * 4));
+		p = _mm_add_epi32(_mm_add_epi32(_mm_and_si128(p, m), _mm_and_si128(_mm_srli_epi32(p, 8), m)), _mm_and_si128(_mm_srli_epi32(p, 16), m));
+		_mm_storeu_si128((__m128i *)(sums + 1 + x), p);
+	}
+	for (;x < width;x++)
+		sums[1 + x] = in[x*4+0] + in[x*4+1] + in[x*4+2];
+	sums[0] = sums[width];
+	sums[width + 1] = sums[1];
+}
+
+void Image_HeightmapToNormalmap_BGRA_SSE2(const unsigned char *inpixels, unsigned char *outpixels, int width, int height, int clamp, float bumpscale)
+{
+	int x, y, y2, *sums, *row[3], *swap, p[5];
+	unsigned char *out;
+	float ibumpscale, ilength, n[3];
+	__m128 n0, n1, n2, len, il;
+	__m128d lenlo, lenhi;
+	__m128i center, pixel;
+	ibumpscale = (255.0f * 6.0f) / bumpscale;
+	sums = (int *)Mem_Alloc(tempmempool, 3 * (width + 2) * sizeof(int));
+	row[0] = sums;
+	row[1] = sums + (width + 2);
+	row[2] = sums + (width + 2) * 2;
+	Image_HeightmapRowSums_SSE2(inpixels + ((height - 1) * width) * 4, row[0], width);
+	Image_HeightmapRowSums_SSE2(inpixels, row[1], width);
+	out = outpixels;
+	for (y = 0;y < height;y++)
+	{
+		y2 = y + 1;if (y2 >= height) y2 = 0;
+		Image_HeightmapRowSums_SSE2(inpixels + (y2 * width) * 4, row[2], width);
+		for (x = 0;x + 4 <= width;x += 4, out += 16)
+		{
+			n0 = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_loadu_si128((const __m128i *)(row[1] + x)), _mm_loadu_si128((const __m128i *)(row[1] + x + 2))));
+			n1 = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_loadu_si128((const __m128i *)(row[2] + x + 1)), _mm_loadu_si128((const __m128i *)(row[0] + x + 1))));
+			n2 = _mm_set1_ps(ibumpscale);
+			// VectorNormalize does the square root and division in double
+			len = _mm_add_ps(_mm_add_ps(_mm_mul_ps(n0, n0), _mm_mul_ps(n1, n1)), _mm_mul_ps(n2, n2));
+			lenlo = _mm_div_pd(_mm_set1_pd(1.0), _mm_sqrt_pd(_mm_cvtps_pd(len)));
+			lenhi = _mm_div_pd(_mm_set1_pd(1.0), _mm_sqrt_pd(_mm_cvtps_pd(_mm_movehl_ps(len, len))));
+			il = _mm_movelh_ps(_mm_cvtpd_ps(lenlo), _mm_cvtpd_ps(lenhi));
+			n0 = _mm_add_ps(_mm_set1_ps(128.0f), _mm_mul_ps(_mm_mul_ps(n0, il), _mm_set1_ps(127.0f)));
+			n1 = _mm_add_ps(_mm_set1_ps(128.0f), _mm_mul_ps(_mm_mul_ps(n1, il), _mm_set1_ps(127.0f)));
+			n2 = _mm_add_ps(_mm_set1_ps(128.0f), _mm_mul_ps(_mm_mul_ps(n2, il), _mm_set1_ps(127.0f)));
+			// center / 3 as (center * 43691) >> 17, exact for these sums
+			center = _mm_loadu_si128((const __m128i *)(row[1] + x + 1));
+			center = _mm_srli_epi32(_mm_mulhi_epu16(center, _mm_set1_epi32(43691)), 1);
+			pixel = _mm_cvttps_epi32(n2);
+			pixel = _mm_or_si128(pixel, _mm_slli_epi32(_mm_cvttps_epi32(n1), 8));
+			pixel = _mm_or_si128(pixel, _mm_slli_epi32(_mm_cvttps_epi32(n0), 16));
+			pixel = _mm_or_si128(pixel, _mm_slli_epi32(center, 24));
+			_mm_storeu_si128((__m128i *)out, pixel);
+		}
+		for (;x < width;x++, out += 4)
+		{
+			// left, right, above, below, center
+			p[0] = row[1][x];
+			p[1] = row[1][x + 2];
+			p[2] = row[0][x + 1];
+			p[3] = row[2][x + 1];
+			p[4] = row[1][x + 1];
+			n[0] = p[0] - p[1];
+			n[1] = p[3] - p[2];
+			n[2] = ibumpscale;
+			ilength = (float)DotProduct(n, n);
+			if (ilength)
+				ilength = 1.0f / sqrt(ilength);
+			out[2] = (int)(128.0f + n[0] * ilength * 127.0f);
+			out[1] = (int)(128.0f + n[1] * ilength * 127.0f);
+			out[0] = (int)(128.0f + n[2] * ilength * 127.0f);
+			out[3] = (p[4]) / 3;
+		}
+		swap = row[0];
+		row[0] = row[1];
+		row[1] = row[2];
+		row[2] = swap;
+	}
+	Mem_Free(sums);
+}
+
+int Image_CountTransparentPixels_SSE2(const unsigned char *data, int numpixels)
+{
+	int i, count = 0;
+	__m128i alphamask = _mm_set1_epi32((int)0xFF000000);
+	__m128i zero = _mm_setzero_si128();
+	__m128i sum = zero;
+	int lanes[4];
+	for (i = 0;i + 4 <= numpixels;i += 4)
+		sum = _mm_sub_epi32(sum, _mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128((const __m128i *)(data + i * 4)), alphamask), zero));
+	_mm_storeu_si128((__m128i *)lanes, sum);
+	count = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	for (;i < numpixels;i++)
+		if (data[i * 4 + 3] == 0)
+			count++;
+	return count;
+}
+
+int Image_FindMaskBits_SSE2(const unsigned char *mask, int start, int end, int bits)
+{
+	__m128i b = _mm_set1_epi8((char)bits);
+	__m128i zero = _mm_setzero_si128();
+	for (;start + 16 <= end;start += 16)
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(_mm_loadu_si128((const __m128i *)(mask + start)), b), zero)) != 0xFFFF)
+			break;
+	while (start < end && !(mask[start] & bits))
+		start++;
+	return start;
+}
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef IMAGE_SSE2_H
+#define IMAGE_SSE2_H
+
+#include "quakedef.h"
+
+#ifdef SSE_POSSIBLE
+void Image_Resample32LerpLine_SSE2(const unsigned char *in, unsigned char *out, int inwidth, int outwidth);
+void Image_Resample32LerpRows_SSE2(const unsigned char *row1, const unsigned char *row2, unsigned char *out, int numbytes, int lerp);
+void Image_MipReduce32_SSE2(const unsigned char *in, unsigned char *out, int outwidth, int outheight, int nextrow, qbool reducewidth, qbool reduceheight);
+void Image_HeightmapToNormalmap_BGRA_SSE2(const unsigned char *inpixels, unsigned char *outpixels, int width, int height, int clamp, float bumpscale);
+int Image_CountTransparentPixels_SSE2(const unsigned char *data, int numpixels);
+int Image_FindMaskBits_SSE2(const unsigned char *mask, int start, int end, int bits);
+#endif
+
+#endif
@@ -459,8 +459,8 @@ qbool jpeg_tried_loading = 0;
 #endif
 
 static unsigned char jpeg_eoi_marker [2] = {0xFF, JPEG_EOI};
-static jmp_buf error_in_jpeg;
-static qbool jpeg_toolarge;
+static DP_THREAD_LOCAL jmp_buf error_in_jpeg;
+static DP_THREAD_LOCAL qbool jpeg_toolarge;
 
 // Our own output manager for JPEG compression
 typedef struct
@@ -872,6 +872,17 @@ static void M_ScanSaves (void)
 		len = FS_Read(f, buf, sizeof(buf) - 1);
 		len = min(len, sizeof(buf)-1);
 		buf[len] = 0;
+		if (len >= SAVEGAME_BINARY_MAGICSIZE + SAVEGAME_COMMENT_LENGTH + 1 && !memcmp(buf, SAVEGAME_BINARY_MAGIC, SAVEGAME_BINARY_MAGICSIZE))
+		{
+			// binary saves keep the comment uncompressed right after the magic
+			dp_ustr2stp(m_filenames[i], sizeof(m_filenames[i]), buf + SAVEGAME_BINARY_MAGICSIZE, SAVEGAME_COMMENT_LENGTH);
+			for (j=0 ; j<SAVEGAME_COMMENT_LENGTH ; j++)
+				if (m_filenames[i][j] == '_')
+					m_filenames[i][j] = ' ';
+			loadable[i] = true;
+			FS_Close (f);
+			continue;
+		}
 		t = buf;
 		// version
 		COM_ParseToken_Simple(&t, false, false, true);
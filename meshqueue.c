@@ -3,7 +3,6 @@
 
 typedef struct meshqueue_s
 {
-	struct meshqueue_s *next;
 	void (*callback)(const entity_render_t *ent, const rtlight_t *rtlight, int numsurfaces, int *surfaceindices);
 	const entity_render_t *ent;
 	int surfacenumber;
@@ -13,9 +12,8 @@ typedef struct meshqueue_s
 }
 meshqueue_t;
 
-int trans_sortarraysize;
-meshqueue_t **trans_hash = NULL;
-meshqueue_t ***trans_hashpointer = NULL;
+// largest batch group number, later groups share it (and just merge less)
+#define MESHQUEUE_MAXGROUP 65535
 
 float mqt_viewplanedist;
 float mqt_viewmaxdist;
@@ -23,6 +21,15 @@ meshqueue_t *mqt_array;
 int mqt_count;
 int mqt_total;
 
+// sort keys and item numbers for the radix sort, twice mqt_total of each
+// so the passes can go back and forth
+unsigned int *mqt_sortkeys;
+int *mqt_sortindices;
+// open hash of the first item (plus one) of each batch group, and the
+// group numbers given out so far this frame
+int *mqt_grouphash;
+int mqt_grouphashsize;
+
 void R_MeshQueue_BeginScene(void)
 {
 	mqt_count = 0;
@@ -41,9 +48,16 @@ void R_MeshQueue_AddTransparent(dptransparentsortcategory_t category, const vec3
 		{
 			memcpy(newarray, mqt_array, mqt_total * sizeof(meshqueue_t));
 			Mem_Free(mqt_array);
+			Mem_Free(mqt_sortkeys);
+			Mem_Free(mqt_sortindices);
+			Mem_Free(mqt_grouphash);
 		}
 		mqt_array = newarray;
 		mqt_total = newtotal;
+		mqt_sortkeys = (unsigned int *)Mem_Alloc(cls.permanentmempool, 2 * newtotal * sizeof(unsigned int));
+		mqt_sortindices = (int *)Mem_Alloc(cls.permanentmempool, 2 * newtotal * sizeof(int));
+		mqt_grouphashsize = 2 * newtotal;
+		mqt_grouphash = (int *)Mem_Alloc(cls.permanentmempool, mqt_grouphashsize * sizeof(int));
 	}
 	mq = &mqt_array[mqt_count++];
 	mq->callback = callback;
@@ -55,14 +69,87 @@ void R_MeshQueue_AddTransparent(dptransparentsortcategory_t category, const vec3
 		mq->dist = DotProduct(center, r_refdef.view.forward) - mqt_viewplanedist;
 	else
 		mq->dist = VectorDistance(center, r_refdef.view.origin);
-	mq->next = NULL;
 	mqt_viewmaxdist = max(mqt_viewmaxdist, mq->dist);
 }
 
+/*
+================
+R_MeshQueue_BatchGroup
+
+numbers the different entity, light and callback combinations in the order
+they are first seen, the items of each sorting layer are drawn by group
+================
+*/
+static int R_MeshQueue_BatchGroup(int index, int *numgroups)
+{
+	const meshqueue_t *mqt = mqt_array + index, *other;
+	size_t hash;
+	int i, j;
+
+	hash = (size_t)mqt->ent * 0x9E3779B1u + (size_t)mqt->rtlight * 0x85EBCA77u + (size_t)mqt->callback * 0xC2B2AE3Du;
+	hash ^= hash >> 16;
+	for (i = (int)(hash & (mqt_grouphashsize - 1));;i = (i + 1) & (mqt_grouphashsize - 1))
+	{
+		j = mqt_grouphash[i];
+		if (!j)
+		{
+			mqt_grouphash[i] = index + 1;
+			return min((*numgroups)++, MESHQUEUE_MAXGROUP);
+		}
+		// earlier items already have their key, with the group in the low bits
+		other = mqt_array + j - 1;
+		if (other->ent == mqt->ent && other->rtlight == mqt->rtlight && other->callback == mqt->callback)
+			return mqt_sortkeys[j - 1] & 0xFFFF;
+	}
+}
+
+/*
+================
+R_MeshQueue_RadixSort
+
+stable sort of the first count keys (with their item numbers) in the first
+halves of mqt_sortkeys and mqt_sortindices, 8 bits per pass, skipping the
+passes where all keys have the same digit, returns the sorted item numbers
+================
+*/
+static const int *R_MeshQueue_RadixSort(int count)
+{
+	int i, shift, offset;
+	int histogram[256];
+	unsigned int *keys = mqt_sortkeys, *outkeys = mqt_sortkeys + mqt_total, *tempkeys;
+	int *indices = mqt_sortindices, *outindices = mqt_sortindices + mqt_total, *tempindices;
+
+	for (shift = 0;shift < 32;shift += 8)
+	{
+		memset(histogram, 0, sizeof(histogram));
+		for (i = 0;i < count;i++)
+			histogram[(keys[i] >> shift) & 0xFF]++;
+		if (histogram[(keys[0] >> shift) & 0xFF] == count)
+			continue;
+		for (i = 0, offset = 0;i < 256;i++)
+		{
+			int n = histogram[i];
+			histogram[i] = offset;
+			offset += n;
+		}
+		for (i = 0;i < count;i++)
+		{
+			int d = histogram[(keys[i] >> shift) & 0xFF]++;
+			outkeys[d] = keys[i];
+			outindices[d] = indices[i];
+		}
+		tempkeys = keys;keys = outkeys;outkeys = tempkeys;
+		tempindices = indices;indices = outindices;outindices = tempindices;
+	}
+	return indices;
+}
+
 void R_MeshQueue_RenderTransparent(void)
 {
-	int i, hashindex, maxhashindex, batchnumsurfaces;
+	int i, hashindex, maxhashindex, batchnumsurfaces, numgroups, group, sortarraysize;
 	float distscale;
+	qbool sortbatches;
+	const int *sorted;
 	const entity_render_t *ent;
 	const rtlight_t *rtlight;
 	void (*callback)(const entity_render_t *ent, const rtlight_t *rtlight, int numsurfaces, int *surfaceindices);
@@ -80,24 +167,15 @@ void R_MeshQueue_RenderTransparent(void)
 	if (r_transparent_sortmaxdist.integer < r_transparent_sortmindist.integer || r_transparent_sortmaxdist.integer > 32768)
 		Cvar_SetValueQuick(&r_transparent_sortmaxdist, bound(r_transparent_sortmindist.integer, r_transparent_sortmaxdist.integer, 32768));
 
-	// update hash array
-	if (trans_sortarraysize != r_transparent_sortarraysize.integer)
-	{
-		trans_sortarraysize = r_transparent_sortarraysize.integer;
-		if (trans_hash)
-			Mem_Free(trans_hash);
-		trans_hash = (meshqueue_t **)Mem_Alloc(cls.permanentmempool, sizeof(meshqueue_t *) * trans_sortarraysize); 
-		if (trans_hashpointer)
-			Mem_Free(trans_hashpointer);
-		trans_hashpointer = (meshqueue_t ***)Mem_Alloc(cls.permanentmempool, sizeof(meshqueue_t **) * trans_sortarraysize); 
-	}
-
-	// build index
-	memset(trans_hash, 0, sizeof(meshqueue_t *) * trans_sortarraysize);
-	for (i = 0; i < trans_sortarraysize; i++)
-		trans_hashpointer[i] = &trans_hash[i];
-	distscale = (trans_sortarraysize - 1) / min(mqt_viewmaxdist, r_transparent_sortmaxdist.integer);
-	maxhashindex = trans_sortarraysize - 1;
+	// the key is the sorting layer (far to near) above the batch group, the
+	// sort is stable so items with the same key keep their queued order
+	sortarraysize = r_transparent_sortarraysize.integer;
+	distscale = (sortarraysize - 1) / min(mqt_viewmaxdist, r_transparent_sortmaxdist.integer);
+	maxhashindex = sortarraysize - 1;
+	sortbatches = r_transparent_sortbatches.integer != 0;
+	if (sortbatches)
+		memset(mqt_grouphash, 0, mqt_grouphashsize * sizeof(int));
+	numgroups = 0;
 	for (i = 0, mqt = mqt_array; i < mqt_count; i++, mqt++)
 	{
 		switch(mqt->category)
@@ -114,35 +192,32 @@ void R_MeshQueue_RenderTransparent(void)
 			hashindex = maxhashindex;
 			break;
 		}
-		// link to tail of hash chain (to preserve render order)
-		mqt->next = NULL;
-		*trans_hashpointer[hashindex] = mqt;
-		trans_hashpointer[hashindex] = &mqt->next;
+		group = sortbatches ? R_MeshQueue_BatchGroup(i, &numgroups) : 0;
+		mqt_sortkeys[i] = ((unsigned int)(maxhashindex - hashindex) << 16) | group;
 	}
+	for (i = 0; i < mqt_count; i++)
+		mqt_sortindices[i] = i;
+	sorted = R_MeshQueue_RadixSort(mqt_count);
+
 	callback = NULL;
 	ent = NULL;
 	rtlight = NULL;
 	batchnumsurfaces = 0;
 
 	// draw
-	for (i = maxhashindex; i >= 0; i--)
+	for (i = 0; i < mqt_count; i++)
 	{
-		if (trans_hash[i])
+		mqt = mqt_array + sorted[i];
+		if (ent != mqt->ent || rtlight != mqt->rtlight || callback != mqt->callback || batchnumsurfaces >= MESHQUEUE_TRANSPARENT_BATCHSIZE)
 		{
-			for (mqt = trans_hash[i]; mqt; mqt = mqt->next)
-			{
-				if (ent != mqt->ent || rtlight != mqt->rtlight || callback != mqt->callback || batchnumsurfaces >= MESHQUEUE_TRANSPARENT_BATCHSIZE)
-				{
-					if (batchnumsurfaces)
-						callback(ent, rtlight, batchnumsurfaces, batchsurfaceindex);
-					batchnumsurfaces = 0;
-					ent = mqt->ent;
-					rtlight = mqt->rtlight;
-					callback = mqt->callback;
-				}
-				batchsurfaceindex[batchnumsurfaces++] = mqt->surfacenumber;
-			}
+			if (batchnumsurfaces)
+				callback(ent, rtlight, batchnumsurfaces, batchsurfaceindex);
+			batchnumsurfaces = 0;
+			ent = mqt->ent;
+			rtlight = mqt->rtlight;
+			callback = mqt->callback;
 		}
+		batchsurfaceindex[batchnumsurfaces++] = mqt->surfacenumber;
 	}
 	if (batchnumsurfaces)
 		callback(ent, rtlight, batchnumsurfaces, batchsurfaceindex);
@@ -0,0 +1,138 @@
+#include "mod_skeletal_animatevertices_avx2.h"
+
+#ifdef AVX2_POSSIBLE
+
+#ifdef MATRIX4x4_OPENGLORIENTATION
+#error "AVX2 skeletal requires D3D matrix layout"
+#endif
+
+#include <immintrin.h>
+
+AVX2_FUNCTION void Mod_Skeletal_AnimateVertices_AVX2(const model_t * RESTRICT model, const frameblend_t * RESTRICT frameblend, const skeleton_t *skeleton, void *buffers, float * RESTRICT vertex3f, float * RESTRICT normal3f, float * RESTRICT svector3f, float * RESTRICT tvector3f)
+{
+	// vertex weighted skeletal
+	int i, k;
+	int numvertices = model->surfmesh.num_vertices;
+	float *bonepose;
+	float *boneposerelative;
+	float *bonecolumns;
+	const blendweights_t * RESTRICT weights;
+	const unsigned short * RESTRICT b = model->surfmesh.blends;
+
+	// bonepose and boneposerelative are 3x4 row major as produced by
+	// Mod_Skeletal_BuildTransforms, bonecolumns holds the same matrices (and
+	// then the blended ones) as four 4 float columns like the SSE path
+	bonepose = buffers ? (float *)buffers : (float *) Mod_Skeletal_AnimateVertices_AllocBuffers(sizeof(float[16]) * (model->num_bones*3 + model->surfmesh.num_blends));
+	boneposerelative = bonepose + model->num_bones * 12;
+	bonecolumns = boneposerelative + model->num_bones * 12;
+
+	Mod_Skeletal_BuildTransforms(model, frameblend, skeleton, bonepose, boneposerelative);
+
+	for (i = 0;i < model->num_bones;i++)
+	{
+		const float * RESTRICT m = boneposerelative + i * 12;
+		__m128 r0 = _mm_loadu_ps(m), r1 = _mm_loadu_ps(m + 4), r2 = _mm_loadu_ps(m + 8), r3 = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_store_ps(bonecolumns + i * 16, r0);
+		_mm_store_ps(bonecolumns + i * 16 + 4, r1);
+		_mm_store_ps(bonecolumns + i * 16 + 8, r2);
+		_mm_store_ps(bonecolumns + i * 16 + 12, r3);
+	}
+
+	// generate matrices for all blend combinations
+	// (the buffers are only guaranteed to be 16 byte aligned)
+	weights = model->surfmesh.data_blendweights;
+	for (i = 0;i < model->surfmesh.num_blends;i++, weights++)
+	{
+		float * RESTRICT out = bonecolumns + 16 * (model->num_bones + i);
+		const float * RESTRICT m = bonecolumns + 16 * (unsigned int)weights->index[0];
+		__m256 f = _mm256_set1_ps(weights->influence[0] * (1.0f / 255.0f));
+		__m256 b0 = _mm256_mul_ps(_mm256_loadu_ps(m), f);
+		__m256 b1 = _mm256_mul_ps(_mm256_loadu_ps(m + 8), f);
+		for (k = 1;k < 4 && weights->influence[k];k++)
+		{
+			m = bonecolumns + 16 * (unsigned int)weights->index[k];
+			f = _mm256_set1_ps(weights->influence[k] * (1.0f / 255.0f));
+			b0 = _mm256_fmadd_ps(_mm256_loadu_ps(m), f, b0);
+			b1 = _mm256_fmadd_ps(_mm256_loadu_ps(m + 8), f, b1);
+		}
+		_mm256_storeu_ps(out, b0);
+		_mm256_storeu_ps(out + 8, b1);
+	}
+
+// two vertices per iteration, the first in the low and the second in the high lane
+#define PAIR(lo, hi) _mm256_insertf128_ps(_mm256_castps128_ps256(lo), (hi), 1)
+#define LOAD_MATRIX2() \
+	const float * RESTRICT ma = bonecolumns + 16 * (unsigned int)b[i]; \
+	const float * RESTRICT mb = bonecolumns + 16 * (unsigned int)b[i+1]; \
+	__m256 m0 = PAIR(_mm_load_ps(ma), _mm_load_ps(mb)); \
+	__m256 m1 = PAIR(_mm_load_ps(ma + 4), _mm_load_ps(mb + 4)); \
+	__m256 m2 = PAIR(_mm_load_ps(ma + 8), _mm_load_ps(mb + 8)); \
+	__m256 m3 = PAIR(_mm_load_ps(ma + 12), _mm_load_ps(mb + 12))
+
+	// each store writes one float past the vertex, which the next store
+	// overwrites, so the last vertex pair has to be done with scalars
+#define TRANSFORM2(in, out, translate) { \
+		const float * RESTRICT vin = (in) + i * 3; \
+		float * RESTRICT vout = (out) + i * 3; \
+		__m256 t = _mm256_mul_ps(PAIR(_mm_set1_ps(vin[0]), _mm_set1_ps(vin[3])), m0); \
+		t = _mm256_fmadd_ps(PAIR(_mm_set1_ps(vin[1]), _mm_set1_ps(vin[4])), m1, t); \
+		t = _mm256_fmadd_ps(PAIR(_mm_set1_ps(vin[2]), _mm_set1_ps(vin[5])), m2, t); \
+		if (translate) \
+			t = _mm256_add_ps(t, m3); \
+		_mm_storeu_ps(vout, _mm256_castps256_ps128(t)); \
+		_mm_storeu_ps(vout + 3, _mm256_extractf128_ps(t, 1)); \
+	}
+
+	/* Note that matrix is 4x4 and transposed compared to the generic codepath */
+#define TRANSFORM_POSITION_SCALAR(in, out) \
+	(out)[0] = ((in)[0] * m[0] + (in)[1] * m[4] + (in)[2] * m[ 8] + m[12]); \
+	(out)[1] = ((in)[0] * m[1] + (in)[1] * m[5] + (in)[2] * m[ 9] + m[13]); \
+	(out)[2] = ((in)[0] * m[2] + (in)[1] * m[6] + (in)[2] * m[10] + m[14]);
+#define TRANSFORM_VECTOR_SCALAR(in, out) \
+	(out)[0] = ((in)[0] * m[0] + (in)[1] * m[4] + (in)[2] * m[ 8]); \
+	(out)[1] = ((in)[0] * m[1] + (in)[1] * m[5] + (in)[2] * m[ 9]); \
+	(out)[2] = ((in)[0] * m[2] + (in)[1] * m[6] + (in)[2] * m[10]);
+
+	// transform vertex attributes by blended matrices
+	for (i = 0;i + 2 < numvertices;i += 2)
+	{
+		LOAD_MATRIX2();
+		if (vertex3f)
+			TRANSFORM2(model->surfmesh.data_vertex3f, vertex3f, true);
+		if (normal3f)
+			TRANSFORM2(model->surfmesh.data_normal3f, normal3f, false);
+		if (svector3f)
+			TRANSFORM2(model->surfmesh.data_svector3f, svector3f, false);
+		if (tvector3f)
+			TRANSFORM2(model->surfmesh.data_tvector3f, tvector3f, false);
+	}
+	for (;i < numvertices;i++)
+	{
+		const float * RESTRICT m = bonecolumns + 16 * (unsigned int)b[i];
+		if (vertex3f)
+		{
+			TRANSFORM_POSITION_SCALAR(model->surfmesh.data_vertex3f + i * 3, vertex3f + i * 3);
+		}
+		if (normal3f)
+		{
+			TRANSFORM_VECTOR_SCALAR(model->surfmesh.data_normal3f + i * 3, normal3f + i * 3);
+		}
+		if (svector3f)
+		{
+			TRANSFORM_VECTOR_SCALAR(model->surfmesh.data_svector3f + i * 3, svector3f + i * 3);
+		}
+		if (tvector3f)
+		{
+			TRANSFORM_VECTOR_SCALAR(model->surfmesh.data_tvector3f + i * 3, tvector3f + i * 3);
+		}
+	}
+
+#undef PAIR
+#undef LOAD_MATRIX2
+#undef TRANSFORM2
+#undef TRANSFORM_POSITION_SCALAR
+#undef TRANSFORM_VECTOR_SCALAR
+}
+
+#endif
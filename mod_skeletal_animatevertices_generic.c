@@ -1,6 +1,6 @@
 #include "mod_skeletal_animatevertices_generic.h"
 
-void Mod_Skeletal_AnimateVertices_Generic(const model_t * RESTRICT model, const frameblend_t * RESTRICT frameblend, const skeleton_t *skeleton, float * RESTRICT vertex3f, float * RESTRICT normal3f, float * RESTRICT svector3f, float * RESTRICT tvector3f)
+void Mod_Skeletal_AnimateVertices_Generic(const model_t * RESTRICT model, const frameblend_t * RESTRICT frameblend, const skeleton_t *skeleton, void *buffers, float * RESTRICT vertex3f, float * RESTRICT normal3f, float * RESTRICT svector3f, float * RESTRICT tvector3f)
 {
 	// vertex weighted skeletal
 	int i, k;
@@ -9,7 +9,7 @@ void Mod_Skeletal_AnimateVertices_Generic(const model_t * RESTRICT model, const
 	const blendweights_t * RESTRICT weights;
 
 	//unsigned long long ts = rdtsc();
-	bonepose = (float *) Mod_Skeletal_AnimateVertices_AllocBuffers(sizeof(float[12]) * (model->num_bones*2 + model->surfmesh.num_blends));
+	bonepose = buffers ? (float *)buffers : (float *) Mod_Skeletal_AnimateVertices_AllocBuffers(sizeof(float[12]) * (model->num_bones*2 + model->surfmesh.num_blends));
 	boneposerelative = bonepose + model->num_bones * 12;
 
 	Mod_Skeletal_BuildTransforms(model, frameblend, skeleton, bonepose, boneposerelative);
@@ -8,7 +8,7 @@
 
 #include <xmmintrin.h>
 
-void Mod_Skeletal_AnimateVertices_SSE(const model_t * RESTRICT model, const frameblend_t * RESTRICT frameblend, const skeleton_t *skeleton, float * RESTRICT vertex3f, float * RESTRICT normal3f, float * RESTRICT svector3f, float * RESTRICT tvector3f)
+void Mod_Skeletal_AnimateVertices_SSE(const model_t * RESTRICT model, const frameblend_t * RESTRICT frameblend, const skeleton_t *skeleton, void *buffers, float * RESTRICT vertex3f, float * RESTRICT normal3f, float * RESTRICT svector3f, float * RESTRICT tvector3f)
 {
 	// vertex weighted skeletal
 	int i, k;
@@ -21,7 +21,7 @@ void Mod_Skeletal_AnimateVertices_SSE(const model_t * RESTRICT model, const fram
 	num_vertices_minus_one = model->surfmesh.num_vertices - 1;
 
 	//unsigned long long ts = rdtsc();
-	bonepose = (matrix4x4_t *) Mod_Skeletal_AnimateVertices_AllocBuffers(sizeof(matrix4x4_t) * (model->num_bones*2 + model->surfmesh.num_blends));
+	bonepose = buffers ? (matrix4x4_t *)buffers : (matrix4x4_t *) Mod_Skeletal_AnimateVertices_AllocBuffers(sizeof(matrix4x4_t) * (model->num_bones*2 + model->surfmesh.num_blends));
 	boneposerelative = bonepose + model->num_bones;
 
 	if (skeleton && !skeleton->relativetransforms)
@@ -25,11 +25,18 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #ifdef SSE_POSSIBLE
 #include "mod_skeletal_animatevertices_sse.h"
 #endif
+#ifdef AVX2_POSSIBLE
+#include "mod_skeletal_animatevertices_avx2.h"
+#endif
 
 #ifdef SSE_POSSIBLE
 static qbool r_skeletal_use_sse_defined = false;
 cvar_t r_skeletal_use_sse = {CF_CLIENT, "r_skeletal_use_sse", "1", "use SSE for skeletal model animation"};
 #endif
+#ifdef AVX2_POSSIBLE
+static qbool r_skeletal_use_avx2_defined = false;
+cvar_t r_skeletal_use_avx2 = {CF_CLIENT, "r_skeletal_use_avx2", "1", "use AVX2/FMA for skeletal model animation (takes precedence over r_skeletal_use_sse)"};
+#endif
 cvar_t r_skeletal_debugbone = {CF_CLIENT, "r_skeletal_debugbone", "-1", "development cvar for testing skeletal model code"};
 cvar_t r_skeletal_debugbonecomponent = {CF_CLIENT, "r_skeletal_debugbonecomponent", "3", "development cvar for testing skeletal model code"};
 cvar_t r_skeletal_debugbonevalue = {CF_CLIENT, "r_skeletal_debugbonevalue", "100", "development cvar for testing skeletal model code"};
@@ -160,7 +167,7 @@ void Mod_Skeletal_BuildTransforms(const model_t * RESTRICT model, const frameble
 	}
 }
 
-static void Mod_Skeletal_AnimateVertices(const model_t * RESTRICT model, const frameblend_t * RESTRICT frameblend, const skeleton_t *skeleton, float * RESTRICT vertex3f, float * RESTRICT normal3f, float * RESTRICT svector3f, float * RESTRICT tvector3f)
+static void Mod_Skeletal_AnimateVertices_Dispatch(const model_t * RESTRICT model, const frameblend_t * RESTRICT frameblend, const skeleton_t *skeleton, void *buffers, float * RESTRICT vertex3f, float * RESTRICT normal3f, float * RESTRICT svector3f, float * RESTRICT tvector3f)
 {
 
 	if (!model->surfmesh.num_vertices)
@@ -175,15 +182,63 @@ static void Mod_Skeletal_AnimateVertices(const model_t * RESTRICT model, const f
 		return;
 	}
 
+#ifdef AVX2_POSSIBLE
+	if(r_skeletal_use_avx2_defined)
+		if(r_skeletal_use_avx2.integer)
+		{
+			Mod_Skeletal_AnimateVertices_AVX2(model, frameblend, skeleton, buffers, vertex3f, normal3f, svector3f, tvector3f);
+			return;
+		}
+#endif
 #ifdef SSE_POSSIBLE
 	if(r_skeletal_use_sse_defined)
 		if(r_skeletal_use_sse.integer)
 		{
-			Mod_Skeletal_AnimateVertices_SSE(model, frameblend, skeleton, vertex3f, normal3f, svector3f, tvector3f);
+			Mod_Skeletal_AnimateVertices_SSE(model, frameblend, skeleton, buffers, vertex3f, normal3f, svector3f, tvector3f);
 			return;
 		}
 #endif
-	Mod_Skeletal_AnimateVertices_Generic(model, frameblend, skeleton, vertex3f, normal3f, svector3f, tvector3f);
+	Mod_Skeletal_AnimateVertices_Generic(model, frameblend, skeleton, buffers, vertex3f, normal3f, svector3f, tvector3f);
+}
+
+static void Mod_Skeletal_AnimateVertices(const model_t * RESTRICT model, const frameblend_t * RESTRICT frameblend, const skeleton_t *skeleton, float * RESTRICT vertex3f, float * RESTRICT normal3f, float * RESTRICT svector3f, float * RESTRICT tvector3f)
+{
+	Mod_Skeletal_AnimateVertices_Dispatch(model, frameblend, skeleton, NULL, vertex3f, normal3f, svector3f, tvector3f);
+}
+
+/*
+===============
+Mod_AnimateVertices_BufferSize
+
+returns how much scratch memory Mod_AnimateVertices_Buffered needs for this
+model, 0 if its AnimateVertices does not use any (all the vertex morph
+formats)
+===============
+*/
+size_t Mod_AnimateVertices_BufferSize(const model_t *model)
+{
+	if (model->AnimateVertices != Mod_Skeletal_AnimateVertices || !model->num_bones || !model->surfmesh.num_vertices)
+		return 0;
+	// enough for any of the skeletal code paths
+	return sizeof(float[16]) * (model->num_bones*3 + model->surfmesh.num_blends);
+}
+
+/*
+===============
+Mod_AnimateVertices_Buffered
+
+same as model->AnimateVertices, but skeletal models use the supplied
+(16 byte aligned, Mod_AnimateVertices_BufferSize bytes) scratch memory
+instead of the shared buffer, so it can be called from several threads at
+once
+===============
+*/
+void Mod_AnimateVertices_Buffered(const model_t * RESTRICT model, const frameblend_t * RESTRICT frameblend, const skeleton_t *skeleton, void *buffers, float * RESTRICT vertex3f, float * RESTRICT normal3f, float * RESTRICT svector3f, float * RESTRICT tvector3f)
+{
+	if (buffers && model->AnimateVertices == Mod_Skeletal_AnimateVertices)
+		Mod_Skeletal_AnimateVertices_Dispatch(model, frameblend, skeleton, buffers, vertex3f, normal3f, svector3f, tvector3f);
+	else
+		model->AnimateVertices(model, frameblend, skeleton, vertex3f, normal3f, svector3f, tvector3f);
 }
 
 void Mod_AliasInit (void)
@@ -199,6 +254,14 @@ void Mod_AliasInit (void)
 	Cvar_RegisterVariable(&mod_alias_force_animated);
 	for (i = 0;i < 320;i++)
 		mod_md3_sin[i] = sin(i * M_PI * 2.0f / 256.0);
+#ifdef AVX2_POSSIBLE
+	if(Sys_HaveAVX2())
+	{
+		Con_Printf("Skeletal animation uses AVX2 code path\n");
+		r_skeletal_use_avx2_defined = true;
+		Cvar_RegisterVariable(&r_skeletal_use_avx2);
+	}
+#endif
 #ifdef SSE_POSSIBLE
 	if(Sys_HaveSSE())
 	{
@@ -249,6 +249,8 @@ struct frameblend_s;
 struct skeleton_s;
 
 void *Mod_Skeletal_AnimateVertices_AllocBuffers(size_t nbytes);
+size_t Mod_AnimateVertices_BufferSize(const struct model_s *model);
+void Mod_AnimateVertices_Buffered(const struct model_s * RESTRICT model, const struct frameblend_s * RESTRICT frameblend, const struct skeleton_s *skeleton, void *buffers, float * RESTRICT vertex3f, float * RESTRICT normal3f, float * RESTRICT svector3f, float * RESTRICT tvector3f);
 void Mod_Skeletal_BuildTransforms(const struct model_s * RESTRICT model, const struct frameblend_s * RESTRICT frameblend, const struct skeleton_s *skeleton, float * RESTRICT bonepose, float * RESTRICT boneposerelative);
 
 #endif
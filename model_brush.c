@@ -24,6 +24,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "polygon.h"
 #include "curves.h"
 #include "wad.h"
+#ifdef SSE2_PRESENT
+#include <emmintrin.h>
+#endif
 
 
 cvar_t r_trippy = {CF_CLIENT, "r_trippy", "0", "easter egg"};
@@ -60,6 +63,7 @@ cvar_t mod_q3shader_force_terrain_alphaflag = {CF_CLIENT, "mod_q3shader_force_te
 
 cvar_t mod_q2bsp_littransparentsurfaces = {CF_CLIENT, "mod_q2bsp_littransparentsurfaces", "0", "allows lighting on rain in 3v3gloom3 and other cases of transparent surfaces that have lightmaps that were ignored by quake2"};
 
+cvar_t mod_bih_wide = {CF_CLIENT | CF_SERVER, "mod_bih_wide", "1", "also build a 4-wide surface area heuristic hierarchy over the render triangles of map models, used for light culling and decals (takes effect on map load)"};
 cvar_t mod_q1bsp_polygoncollisions = {CF_CLIENT | CF_SERVER, "mod_q1bsp_polygoncollisions", "0", "disables use of precomputed cliphulls and instead collides with polygons (uses Bounding Interval Hierarchy optimizations)"};
 cvar_t mod_q1bsp_traceoutofsolid = {CF_SHARED, "mod_q1bsp_traceoutofsolid", "1", "enables tracebox to move an entity that's stuck in solid brushwork out to empty space, 1 matches FTEQW and QSS and is required by many community maps (items/monsters will be missing otherwise), 0 matches old versions of DP and the original Quake engine (if your map or QC needs 0 it's buggy)"};
 cvar_t mod_q1bsp_zero_hullsize_cutoff = {CF_CLIENT | CF_SERVER, "mod_q1bsp_zero_hullsize_cutoff", "3", "bboxes with an X dimension smaller than this will use the smallest cliphull (0x0x0) instead of being rounded up to the player cliphull (32x32x56) in Q1BSP, or crouching player (32x32x36) in HLBSP"};
@@ -112,6 +116,7 @@ void Mod_BrushInit(void)
 	Cvar_RegisterVariable(&mod_q3shader_default_refractive_index);
 	Cvar_RegisterVariable(&mod_q3shader_force_addalpha);
 	Cvar_RegisterVariable(&mod_q3shader_force_terrain_alphaflag);
+	Cvar_RegisterVariable(&mod_bih_wide);
 	Cvar_RegisterVariable(&mod_q1bsp_polygoncollisions);
 	Cvar_RegisterVariable(&mod_q1bsp_traceoutofsolid);
 	Cvar_RegisterVariable(&mod_q1bsp_zero_hullsize_cutoff);
@@ -952,6 +957,219 @@ static void Mod_Q1BSP_TraceLine(struct model_s *model, const frameblend_t *frame
 #endif
 }
 
+// number of lines Mod_Q1BSP_TraceLines walks through the hull together
+#define Q1BSP_PACKETLINES 4
+
+typedef struct q1bsphullpacket_s
+{
+	int numlines;
+	// indices into the RecursiveHullCheckTraceInfo_t array
+	int lines[Q1BSP_PACKETLINES];
+	// start and end of each line, one array per axis
+	double start[3][Q1BSP_PACKETLINES];
+	double end[3][Q1BSP_PACKETLINES];
+}
+q1bsphullpacket_t;
+
+static void Mod_Q1BSP_HullPacket_Init(q1bsphullpacket_t *packet, const RecursiveHullCheckTraceInfo_t *rhc, int numlines, const int *lines)
+{
+	int i, k;
+	packet->numlines = numlines;
+	// unused slots repeat the first line so they never disagree with it
+	for (i = 0;i < Q1BSP_PACKETLINES;i++)
+	{
+		packet->lines[i] = i < numlines ? lines[i] : lines[0];
+		for (k = 0;k < 3;k++)
+		{
+			packet->start[k][i] = rhc[packet->lines[i]].start[k];
+			packet->end[k][i] = rhc[packet->lines[i]].end[k];
+		}
+	}
+}
+
+/*
+==================
+Mod_Q1BSP_HullPacket_PlaneSides
+
+Sets bit i of *startbits and *endbits if the start or end of line i is behind
+the plane, computing the distances exactly like Mod_Q1BSP_RecursiveHullCheck.
+==================
+*/
+static void Mod_Q1BSP_HullPacket_PlaneSides(const q1bsphullpacket_t *packet, const mplane_t *plane, int *startbits, int *endbits)
+{
+	int i;
+#ifdef SSE2_PRESENT
+	__m128d zero = _mm_setzero_pd(), dist = _mm_set1_pd(plane->dist);
+	__m128d t1, t2;
+	*startbits = *endbits = 0;
+	for (i = 0;i < Q1BSP_PACKETLINES;i += 2)
+	{
+		if (plane->type < 3)
+		{
+			t1 = _mm_sub_pd(_mm_loadu_pd(&packet->start[plane->type][i]), dist);
+			t2 = _mm_sub_pd(_mm_loadu_pd(&packet->end[plane->type][i]), dist);
+		}
+		else
+		{
+			__m128d n0 = _mm_set1_pd(plane->normal[0]), n1 = _mm_set1_pd(plane->normal[1]), n2 = _mm_set1_pd(plane->normal[2]);
+			t1 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(n0, _mm_loadu_pd(&packet->start[0][i])), _mm_mul_pd(n1, _mm_loadu_pd(&packet->start[1][i]))), _mm_mul_pd(n2, _mm_loadu_pd(&packet->start[2][i])));
+			t2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(n0, _mm_loadu_pd(&packet->end[0][i])), _mm_mul_pd(n1, _mm_loadu_pd(&packet->end[1][i]))), _mm_mul_pd(n2, _mm_loadu_pd(&packet->end[2][i])));
+			t1 = _mm_sub_pd(t1, dist);
+			t2 = _mm_sub_pd(t2, dist);
+		}
+		*startbits |= _mm_movemask_pd(_mm_cmplt_pd(t1, zero)) << i;
+		*endbits |= _mm_movemask_pd(_mm_cmplt_pd(t2, zero)) << i;
+	}
+#else
+	double t1, t2;
+	*startbits = *endbits = 0;
+	for (i = 0;i < Q1BSP_PACKETLINES;i++)
+	{
+		if (plane->type < 3)
+		{
+			t1 = packet->start[plane->type][i] - plane->dist;
+			t2 = packet->end[plane->type][i] - plane->dist;
+		}
+		else
+		{
+			t1 = plane->normal[0] * packet->start[0][i] + plane->normal[1] * packet->start[1][i] + plane->normal[2] * packet->start[2][i] - plane->dist;
+			t2 = plane->normal[0] * packet->end[0][i] + plane->normal[1] * packet->end[1][i] + plane->normal[2] * packet->end[2][i] - plane->dist;
+		}
+		*startbits |= (t1 < 0) << i;
+		*endbits |= (t2 < 0) << i;
+	}
+#endif
+}
+
+/*
+==================
+Mod_Q1BSP_RecursiveHullCheckPacket
+
+Walks a packet of lines down the hull for as long as they stay on one side of
+every plane.  A line crossing a plane continues alone in
+Mod_Q1BSP_RecursiveHullCheck from that node, and the packet splits when lines
+go to different children.  Until a line crosses a plane the scalar walk only
+descends as well, so each trace comes out exactly as if traced alone.
+==================
+*/
+static void Mod_Q1BSP_RecursiveHullCheckPacket(RecursiveHullCheckTraceInfo_t *rhc, int numlines, const int *lines, int num)
+{
+	q1bsphullpacket_t packet;
+	const hull_t *hull = rhc[lines[0]].hull;
+	const mclipnode_t *node;
+	int i, startbits, endbits, livebits, frontbits, backbits, numfront, numback;
+	int front[Q1BSP_PACKETLINES], back[Q1BSP_PACKETLINES];
+
+	Mod_Q1BSP_HullPacket_Init(&packet, rhc, numlines, lines);
+	while (num >= 0 && packet.numlines > 1)
+	{
+		node = hull->clipnodes + num;
+		Mod_Q1BSP_HullPacket_PlaneSides(&packet, hull->planes + node->planenum, &startbits, &endbits);
+		livebits = (1 << packet.numlines) - 1;
+
+		// lines crossing the plane leave the packet here
+		for (i = 0;i < Q1BSP_PACKETLINES;i++)
+			if ((startbits ^ endbits) & livebits & (1 << i))
+				Mod_Q1BSP_RecursiveHullCheck(rhc + packet.lines[i], num, 0, 1, rhc[packet.lines[i]].start, rhc[packet.lines[i]].end);
+		livebits &= ~(startbits ^ endbits);
+		backbits = startbits & livebits;
+		frontbits = ~startbits & livebits;
+
+		numfront = numback = 0;
+		for (i = 0;i < Q1BSP_PACKETLINES;i++)
+		{
+			if (frontbits & (1 << i))
+				front[numfront++] = packet.lines[i];
+			else if (backbits & (1 << i))
+				back[numback++] = packet.lines[i];
+		}
+		if (numfront && numback)
+		{
+			// the lines diverge, send the back ones off on their own
+			Mod_Q1BSP_RecursiveHullCheckPacket(rhc, numback, back, node->children[1]);
+			Mod_Q1BSP_HullPacket_Init(&packet, rhc, numfront, front);
+			num = node->children[0];
+		}
+		else if (numfront)
+		{
+			if (numfront < packet.numlines)
+				Mod_Q1BSP_HullPacket_Init(&packet, rhc, numfront, front);
+			num = node->children[0];
+		}
+		else if (numback)
+		{
+			if (numback < packet.numlines)
+				Mod_Q1BSP_HullPacket_Init(&packet, rhc, numback, back);
+			num = node->children[1];
+		}
+		else
+			return;
+	}
+
+	// reached a leaf or only one line is left
+	for (i = 0;i < packet.numlines;i++)
+		Mod_Q1BSP_RecursiveHullCheck(rhc + packet.lines[i], num, 0, 1, rhc[packet.lines[i]].start, rhc[packet.lines[i]].end);
+}
+
+/*
+==================
+Mod_Q1BSP_TraceLines
+
+Same as calling Mod_Q1BSP_TraceLine for each line, lines are walked through
+the hull in packets of Q1BSP_PACKETLINES so neighbouring lines should be
+passed next to each other.
+==================
+*/
+static void Mod_Q1BSP_TraceLines(struct model_s *model, int numlines, trace_t *traces, const vec3_t *starts, const vec3_t *ends, int hitsupercontentsmask, int skipsupercontentsmask, int skipmaterialflagsmask)
+{
+	RecursiveHullCheckTraceInfo_t rhc[Q1BSP_PACKETLINES];
+	int lines[Q1BSP_PACKETLINES];
+	int i, n;
+
+	// these modes need the per line path
+	if (sv_gameplayfix_q1bsptracelinereportstexture.integer || COLLISIONPARANOID >= 2)
+	{
+		for (i = 0;i < numlines;i++)
+			Mod_Q1BSP_TraceLine(model, NULL, NULL, traces + i, starts[i], ends[i], hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask);
+		return;
+	}
+
+	n = 0;
+	for (i = 0;i < numlines;i++)
+	{
+		if (VectorCompare(starts[i], ends[i]))
+		{
+			Mod_Q1BSP_TracePoint(model, NULL, NULL, traces + i, starts[i], hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask);
+			continue;
+		}
+		memset(rhc + n, 0, sizeof(rhc[n]));
+		memset(traces + i, 0, sizeof(trace_t));
+		rhc[n].trace = traces + i;
+		rhc[n].trace->hitsupercontentsmask = hitsupercontentsmask;
+		rhc[n].trace->skipsupercontentsmask = skipsupercontentsmask;
+		rhc[n].trace->skipmaterialflagsmask = skipmaterialflagsmask;
+		rhc[n].trace->fraction = 1;
+		rhc[n].trace->allsolid = true;
+		rhc[n].hull = &model->brushq1.hulls[0]; // 0x0x0
+		VectorCopy(starts[i], rhc[n].start);
+		VectorCopy(ends[i], rhc[n].end);
+		VectorSubtract(rhc[n].end, rhc[n].start, rhc[n].dist);
+		if (!VectorLength2(rhc[n].dist))
+		{
+			Mod_Q1BSP_RecursiveHullCheckPoint(rhc + n, rhc[n].hull->firstclipnode);
+			continue;
+		}
+		lines[n] = n;
+		if (++n == Q1BSP_PACKETLINES)
+		{
+			Mod_Q1BSP_RecursiveHullCheckPacket(rhc, n, lines, rhc[0].hull->firstclipnode);
+			n = 0;
+		}
+	}
+	if (n)
+		Mod_Q1BSP_RecursiveHullCheckPacket(rhc, n, lines, rhc[0].hull->firstclipnode);
+}
+
 static void Mod_Q1BSP_TraceBox(struct model_s *model, const frameblend_t *frameblend, const skeleton_t *skeleton, trace_t *trace, const vec3_t start, const vec3_t boxmins, const vec3_t boxmaxs, const vec3_t end, int hitsupercontentsmask, int skipsupercontentsmask, int skipmaterialflagsmask)
 {
 	// this function currently only supports same size start and end
@@ -3959,6 +4177,7 @@ void Mod_Q1BSP_Load(model_t *mod, void *buffer, void *bufferend)
 	mod->soundfromcenter = true;
 	mod->TraceBox = Mod_Q1BSP_TraceBox;
 	mod->TraceLine = Mod_Q1BSP_TraceLine;
+	mod->TraceLines = Mod_Q1BSP_TraceLines;
 	mod->TracePoint = Mod_Q1BSP_TracePoint;
 	mod->PointSuperContents = Mod_Q1BSP_PointSuperContents;
 	mod->TraceLineAgainstSurfaces = Mod_Q1BSP_TraceLineAgainstSurfaces;
@@ -4204,6 +4423,7 @@ void Mod_Q1BSP_Load(model_t *mod, void *buffer, void *bufferend)
 			mod->collision_bih = mod->render_bih;
 			// point traces and contents checks still use the bsp tree
 			mod->TraceLine = Mod_CollisionBIH_TraceLine;
+			mod->TraceLines = NULL;
 			mod->TraceBox = Mod_CollisionBIH_TraceBox;
 			mod->TraceBrush = Mod_CollisionBIH_TraceBrush;
 			mod->TraceLineAgainstSurfaces = Mod_CollisionBIH_TraceLineAgainstSurfaces;
@@ -5219,7 +5439,7 @@ static void Mod_Q3BSP_LoadTextures(lump_t *l)
 {
 	q3dtexture_t *in;
 	texture_t *out;
-	int i, count;
+	int i, j, count;
 
 	in = (q3dtexture_t *)(mod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
@@ -5231,8 +5451,12 @@ static void Mod_Q3BSP_LoadTextures(lump_t *l)
 	loadmodel->num_textures = count;
 	loadmodel->num_texturesperskin = loadmodel->num_textures;
 
-	for (i = 0;i < count;i++)
+	for (i = 0, j = 0;i < count;i++)
 	{
+		// read and decode the images of the next few textures on the
+		// taskqueue while this one is uploaded
+		for (;j < count && R_SkinFrame_PrefetchRoom() > 0;j++)
+			Mod_PrefetchTextureFromQ3Shader(in[j].name, TEXF_MIPMAP | TEXF_ISWORLD | TEXF_PICMIP | TEXF_COMPRESS);
 		out[i].surfaceflags = LittleLong(in[i].surfaceflags);
 		out[i].supercontents = Mod_Q3BSP_SuperContentsFromNativeContents(LittleLong(in[i].contents));
 		Mod_LoadTextureFromQ3Shader(loadmodel->mempool, loadmodel->name, out + i, in[i].name, true, true, TEXF_MIPMAP | TEXF_ISWORLD | TEXF_PICMIP | TEXF_COMPRESS, MATERIALFLAG_WALL);
@@ -5240,6 +5464,7 @@ static void Mod_Q3BSP_LoadTextures(lump_t *l)
 		out[i].surfaceflags = LittleLong(in[i].surfaceflags);
 		out[i].supercontents = Mod_Q3BSP_SuperContentsFromNativeContents(LittleLong(in[i].contents));
 	}
+	R_SkinFrame_FinishPrefetch();
 }
 
 static void Mod_Q3BSP_LoadPlanes(lump_t *l)
@@ -7542,6 +7767,26 @@ bih_t *Mod_MakeCollisionBIH(model_t *model, qbool userendersurfaces, bih_t *out)
 		out->nodes = (bih_node_t *)Mem_Realloc(loadmodel->mempool, out->nodes, out->numnodes * sizeof(bih_node_t));
 	}
 
+	// the render triangles are only queried by box, which the wide
+	// hierarchy answers faster
+	if (userendersurfaces && mod_bih_wide.integer && bihnumleafs > 0)
+	{
+		bih_widenode_t *widenodes = (bih_widenode_t *)Mem_Alloc(loadmodel->mempool, sizeof(bih_widenode_t) * bihnumleafs);
+		int *wideleafs = (int *)Mem_Alloc(loadmodel->mempool, sizeof(int) * bihnumleafs);
+		temp_leafsortscratch = (int *)Mem_Alloc(loadmodel->mempool, sizeof(int) * bihnumleafs);
+		BIH_BuildWide(out, bihnumleafs, widenodes, wideleafs, temp_leafsortscratch);
+		Mem_Free(temp_leafsortscratch);
+		if (out->numwidenodes > 0)
+			out->widenodes = (bih_widenode_t *)Mem_Realloc(loadmodel->mempool, out->widenodes, out->numwidenodes * sizeof(bih_widenode_t));
+		else
+		{
+			Mem_Free(widenodes);
+			Mem_Free(wideleafs);
+			out->widenodes = NULL;
+			out->wideleafs = NULL;
+		}
+	}
+
 	return out;
 }
 
@@ -294,6 +294,14 @@ typedef struct model_brush_s
 	int num_leafsurfaces;
 	int *data_leafsurfaces;
 
+	// structure of arrays copies of the leaf and surface bounding boxes for
+	// the view culling: minsx, minsy, minsz, maxsx, maxsy, maxsz, each
+	// cullboxes_*stride floats long (see Mod_BuildCullBoxes)
+	int cullboxes_leafstride;
+	float *data_leafcullboxes;
+	int cullboxes_surfacestride;
+	float *data_surfacecullboxes;
+
 	int num_portals;
 	mportal_t *data_portals;
 
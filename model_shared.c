@@ -542,6 +542,7 @@ model_t *Mod_LoadModel(model_t *mod, qbool crash, qbool checkdisk)
 				}
 
 				Mod_SetDrawSkyAndWater(mod);
+				Mod_BuildCullBoxes(mod);
 				Mod_BuildVBOs();
 				break;
 			}
@@ -2267,6 +2268,34 @@ texture_shaderpass_t *Mod_CreateShaderPassFromQ3ShaderLayer(mempool_t *mempool,
 	return shaderpass;
 }
 
+// starts decoding the images that Mod_LoadTextureFromQ3Shader will load for
+// this name on the taskqueue, see R_SkinFrame_PrefetchExternal
+void Mod_PrefetchTextureFromQ3Shader(const char *name, int defaulttexflags)
+{
+	int i, j, texflagsmask, texflagsor;
+	shader_t *shader;
+	if (cls.state == ca_dedicated || !name || !name[0])
+		return;
+	shader = Mod_LookupQ3Shader(name);
+	if (!shader)
+	{
+		R_SkinFrame_PrefetchExternal(name, defaulttexflags, false);
+		return;
+	}
+	// same flags as Mod_LoadTextureFromQ3Shader uses for the layers
+	texflagsmask = ~0;
+	if(!(defaulttexflags & TEXF_PICMIP))
+		texflagsmask &= ~TEXF_PICMIP;
+	if(!(defaulttexflags & TEXF_COMPRESS))
+		texflagsmask &= ~TEXF_COMPRESS;
+	texflagsor = defaulttexflags & (TEXF_ISWORLD | TEXF_ISSPRITE);
+	for (i = 0;i < shader->numlayers;i++)
+		if (shader->layers[i].texturename)
+			for (j = 0;j < shader->layers[i].numframes;j++)
+				if (shader->layers[i].texturename[j] && shader->layers[i].texturename[j][0] != '$')
+					R_SkinFrame_PrefetchExternal(shader->layers[i].texturename[j], (shader->layers[i].dptexflags & texflagsmask) | texflagsor, false);
+}
+
 qbool Mod_LoadTextureFromQ3Shader(mempool_t *mempool, const char *modelname, texture_t *texture, const char *name, qbool warnmissing, qbool fallback, int defaulttexflags, int defaultmaterialflags)
 {
 	int texflagsmask, texflagsor;
@@ -2884,6 +2913,52 @@ void Mod_VertexRangeFromElements(int numelements, const int *elements, int *firs
 		*lastvertexpointer = lastvertex;
 }
 
+/*
+=================
+Mod_BuildCullBoxes
+
+Copies the leaf and surface bounding boxes of a map into the structure of
+arrays layout R_CullFrustum4 works on; each array is padded so that a group
+of 4 starting at any valid index can be read
+=================
+*/
+void Mod_BuildCullBoxes(model_t *mod)
+{
+	int i, k;
+	int stride;
+	float *boxes;
+
+	if (!mod->brush.num_leafs)
+		return;
+
+	stride = (mod->brush.num_leafs + 7) & ~3;
+	boxes = mod->brush.data_leafcullboxes = (float *)Mem_Alloc(mod->mempool, stride * 6 * sizeof(float));
+	mod->brush.cullboxes_leafstride = stride;
+	for (i = 0;i < mod->brush.num_leafs;i++)
+	{
+		for (k = 0;k < 3;k++)
+		{
+			boxes[k * stride + i] = mod->brush.data_leafs[i].mins[k];
+			boxes[(k + 3) * stride + i] = mod->brush.data_leafs[i].maxs[k];
+		}
+	}
+
+	if (!mod->num_surfaces)
+		return;
+
+	stride = (mod->num_surfaces + 7) & ~3;
+	boxes = mod->brush.data_surfacecullboxes = (float *)Mem_Alloc(mod->mempool, stride * 6 * sizeof(float));
+	mod->brush.cullboxes_surfacestride = stride;
+	for (i = 0;i < mod->num_surfaces;i++)
+	{
+		for (k = 0;k < 3;k++)
+		{
+			boxes[k * stride + i] = mod->data_surfaces[i].mins[k];
+			boxes[(k + 3) * stride + i] = mod->data_surfaces[i].maxs[k];
+		}
+	}
+}
+
 void Mod_SetDrawSkyAndWater(model_t* mod)
 {
 	int j;
@@ -4473,14 +4548,33 @@ void Mod_Mesh_Reset(model_t *mod)
 	mod->DrawAddWaterPlanes = NULL; // will be set if a texture needs it
 }
 
+// adds a texture to the name hash table of the mesh model
+static void Mod_Mesh_HashTexture(model_t *mod, int texnum)
+{
+	int h, mask = mod->num_texturehashsize - 1;
+	const char *name = mod->data_textures[texnum].name;
+	for (h = CRC_Block((const unsigned char *)name, strlen(name)) & mask; mod->data_texturehash[h] >= 0; h = (h + 1) & mask)
+		; // just iterate until we find the terminator
+	mod->data_texturehash[h] = texnum;
+}
+
 texture_t *Mod_Mesh_GetTexture(model_t *mod, const char *name, int defaultdrawflags, int defaulttexflags, int defaultmaterialflags)
 {
-	int i;
+	int i, h, mask;
 	texture_t *t;
 	int drawflag = defaultdrawflags & DRAWFLAG_MASK;
-	for (i = 0, t = mod->data_textures; i < mod->num_textures; i++, t++)
-		if (!strcmp(t->name, name) && t->mesh_drawflag == drawflag && t->mesh_defaulttexflags == defaulttexflags && t->mesh_defaultmaterialflags == defaultmaterialflags)
-			return t;
+	// the UI looks up a texture for every pic and character it draws, so this
+	// uses a hash table rather than comparing against every texture
+	if (mod->num_texturehashsize)
+	{
+		mask = mod->num_texturehashsize - 1;
+		for (h = CRC_Block((const unsigned char *)name, strlen(name)) & mask; (i = mod->data_texturehash[h]) >= 0; h = (h + 1) & mask)
+		{
+			t = mod->data_textures + i;
+			if (!strcmp(t->name, name) && t->mesh_drawflag == drawflag && t->mesh_defaulttexflags == defaulttexflags && t->mesh_defaultmaterialflags == defaultmaterialflags)
+				return t;
+		}
+	}
 	if (mod->max_textures <= mod->num_textures)
 	{
 		texture_t *oldtextures = mod->data_textures;
@@ -4489,6 +4583,12 @@ texture_t *Mod_Mesh_GetTexture(model_t *mod, const char *name, int defaultdrawfl
 		// update the pointers
 		for (i = 0; i < mod->num_surfaces; i++)
 			mod->data_surfaces[i].texture = mod->data_textures + (mod->data_surfaces[i].texture - oldtextures);
+		// rebuild the hash table
+		mod->num_texturehashsize = 2 * mod->max_textures;
+		mod->data_texturehash = (int *)Mem_Realloc(mod->mempool, mod->data_texturehash, mod->num_texturehashsize * sizeof(*mod->data_texturehash));
+		memset(mod->data_texturehash, -1, mod->num_texturehashsize * sizeof(*mod->data_texturehash));
+		for (i = 0; i < mod->num_textures; i++)
+			Mod_Mesh_HashTexture(mod, i);
 	}
 	t = &mod->data_textures[mod->num_textures++];
 	Mod_LoadTextureFromQ3Shader(mod->mempool, mod->name, t, name, true, true, defaulttexflags, defaultmaterialflags);
@@ -4522,6 +4622,7 @@ texture_t *Mod_Mesh_GetTexture(model_t *mod, const char *name, int defaultdrawfl
 	default:
 		break;
 	}
+	Mod_Mesh_HashTexture(mod, t - mod->data_textures);
 	return t;
 }
 
@@ -4551,51 +4652,39 @@ msurface_t *Mod_Mesh_AddSurface(model_t *mod, texture_t *tex, qbool batchwithpre
 	return surf;
 }
 
-int Mod_Mesh_IndexForVertex(model_t *mod, msurface_t *surf, float x, float y, float z, float nx, float ny, float nz, float s, float t, float u, float v, float r, float g, float b, float a)
+static void Mod_Mesh_GrowVertices(model_t *mod, msurface_t *surf)
 {
 	int hashindex, h, vnum, mask;
 	surfmesh_t *mesh = &mod->surfmesh;
-	if (mesh->max_vertices == mesh->num_vertices)
-	{
-		mesh->max_vertices = max(mesh->num_vertices * 2, 256);
-		mesh->data_vertex3f = (float *)Mem_Realloc(mod->mempool, mesh->data_vertex3f, mesh->max_vertices * sizeof(float[3]));
-		mesh->data_svector3f = (float *)Mem_Realloc(mod->mempool, mesh->data_svector3f, mesh->max_vertices * sizeof(float[3]));
-		mesh->data_tvector3f = (float *)Mem_Realloc(mod->mempool, mesh->data_tvector3f, mesh->max_vertices * sizeof(float[3]));
-		mesh->data_normal3f = (float *)Mem_Realloc(mod->mempool, mesh->data_normal3f, mesh->max_vertices * sizeof(float[3]));
-		mesh->data_texcoordtexture2f = (float *)Mem_Realloc(mod->mempool, mesh->data_texcoordtexture2f, mesh->max_vertices * sizeof(float[2]));
-		mesh->data_texcoordlightmap2f = (float *)Mem_Realloc(mod->mempool, mesh->data_texcoordlightmap2f, mesh->max_vertices * sizeof(float[2]));
-		mesh->data_lightmapcolor4f = (float *)Mem_Realloc(mod->mempool, mesh->data_lightmapcolor4f, mesh->max_vertices * sizeof(float[4]));
-		// rebuild the hash table
-		mesh->num_vertexhashsize = 4 * mesh->max_vertices;
-		mesh->num_vertexhashsize &= ~(mesh->num_vertexhashsize - 1); // round down to pow2
-		mesh->data_vertexhash = (int *)Mem_Realloc(mod->mempool, mesh->data_vertexhash, mesh->num_vertexhashsize * sizeof(*mesh->data_vertexhash));
-		memset(mesh->data_vertexhash, -1, mesh->num_vertexhashsize * sizeof(*mesh->data_vertexhash));
-		mask = mod->surfmesh.num_vertexhashsize - 1;
-		// no need to hash the vertices for the entire model, the latest surface will suffice.
-		for (vnum = surf ? surf->num_firstvertex : 0; vnum < mesh->num_vertices; vnum++)
-		{
-			// this uses prime numbers intentionally for computing the hash
-			hashindex = (unsigned int)(mesh->data_vertex3f[vnum * 3 + 0] * 2003 + mesh->data_vertex3f[vnum * 3 + 1] * 4001 + mesh->data_vertex3f[vnum * 3 + 2] * 7919 + mesh->data_normal3f[vnum * 3 + 0] * 4097 + mesh->data_normal3f[vnum * 3 + 1] * 257 + mesh->data_normal3f[vnum * 3 + 2] * 17) & mask;
-			for (h = hashindex; mesh->data_vertexhash[h] >= 0; h = (h + 1) & mask)
-				; // just iterate until we find the terminator
-			mesh->data_vertexhash[h] = vnum;
-		}
-	}
+	mesh->max_vertices = max(mesh->num_vertices * 2, 256);
+	mesh->data_vertex3f = (float *)Mem_Realloc(mod->mempool, mesh->data_vertex3f, mesh->max_vertices * sizeof(float[3]));
+	mesh->data_svector3f = (float *)Mem_Realloc(mod->mempool, mesh->data_svector3f, mesh->max_vertices * sizeof(float[3]));
+	mesh->data_tvector3f = (float *)Mem_Realloc(mod->mempool, mesh->data_tvector3f, mesh->max_vertices * sizeof(float[3]));
+	mesh->data_normal3f = (float *)Mem_Realloc(mod->mempool, mesh->data_normal3f, mesh->max_vertices * sizeof(float[3]));
+	mesh->data_texcoordtexture2f = (float *)Mem_Realloc(mod->mempool, mesh->data_texcoordtexture2f, mesh->max_vertices * sizeof(float[2]));
+	mesh->data_texcoordlightmap2f = (float *)Mem_Realloc(mod->mempool, mesh->data_texcoordlightmap2f, mesh->max_vertices * sizeof(float[2]));
+	mesh->data_lightmapcolor4f = (float *)Mem_Realloc(mod->mempool, mesh->data_lightmapcolor4f, mesh->max_vertices * sizeof(float[4]));
+	// rebuild the hash table
+	mesh->num_vertexhashsize = 4 * mesh->max_vertices;
+	mesh->num_vertexhashsize &= ~(mesh->num_vertexhashsize - 1); // round down to pow2
+	mesh->data_vertexhash = (int *)Mem_Realloc(mod->mempool, mesh->data_vertexhash, mesh->num_vertexhashsize * sizeof(*mesh->data_vertexhash));
+	memset(mesh->data_vertexhash, -1, mesh->num_vertexhashsize * sizeof(*mesh->data_vertexhash));
 	mask = mod->surfmesh.num_vertexhashsize - 1;
-	// this uses prime numbers intentionally for computing the hash
-	hashindex = (unsigned int)(x * 2003 + y * 4001 + z * 7919 + nx * 4097 + ny * 257 + nz * 17) & mask;
-	// when possible find an identical vertex within the same surface and return it
-	for(h = hashindex;(vnum = mesh->data_vertexhash[h]) >= 0;h = (h + 1) & mask)
+	// no need to hash the vertices for the entire model, the latest surface will suffice.
+	for (vnum = surf ? surf->num_firstvertex : 0; vnum < mesh->num_vertices; vnum++)
 	{
-		if (vnum >= surf->num_firstvertex
-		 && mesh->data_vertex3f[vnum * 3 + 0] == x && mesh->data_vertex3f[vnum * 3 + 1] == y && mesh->data_vertex3f[vnum * 3 + 2] == z
-		 && mesh->data_normal3f[vnum * 3 + 0] == nx && mesh->data_normal3f[vnum * 3 + 1] == ny && mesh->data_normal3f[vnum * 3 + 2] == nz
-		 && mesh->data_texcoordtexture2f[vnum * 2 + 0] == s && mesh->data_texcoordtexture2f[vnum * 2 + 1] == t
-		 && mesh->data_texcoordlightmap2f[vnum * 2 + 0] == u && mesh->data_texcoordlightmap2f[vnum * 2 + 1] == v
-		 && mesh->data_lightmapcolor4f[vnum * 4 + 0] == r && mesh->data_lightmapcolor4f[vnum * 4 + 1] == g && mesh->data_lightmapcolor4f[vnum * 4 + 2] == b && mesh->data_lightmapcolor4f[vnum * 4 + 3] == a)
-			return vnum;
+		// this uses prime numbers intentionally for computing the hash
+		hashindex = (unsigned int)(mesh->data_vertex3f[vnum * 3 + 0] * 2003 + mesh->data_vertex3f[vnum * 3 + 1] * 4001 + mesh->data_vertex3f[vnum * 3 + 2] * 7919 + mesh->data_normal3f[vnum * 3 + 0] * 4097 + mesh->data_normal3f[vnum * 3 + 1] * 257 + mesh->data_normal3f[vnum * 3 + 2] * 17) & mask;
+		for (h = hashindex; mesh->data_vertexhash[h] >= 0; h = (h + 1) & mask)
+			; // just iterate until we find the terminator
+		mesh->data_vertexhash[h] = vnum;
 	}
-	// add the new vertex
+}
+
+static int Mod_Mesh_StoreVertex(model_t *mod, msurface_t *surf, float x, float y, float z, float nx, float ny, float nz, float s, float t, float u, float v, float r, float g, float b, float a)
+{
+	int vnum;
+	surfmesh_t *mesh = &mod->surfmesh;
 	vnum = mesh->num_vertices++;
 	if (surf->num_vertices > 0)
 	{
@@ -4612,7 +4701,6 @@ int Mod_Mesh_IndexForVertex(model_t *mod, msurface_t *surf, float x, float y, fl
 		VectorSet(surf->maxs, x, y, z);
 	}
 	surf->num_vertices = mesh->num_vertices - surf->num_firstvertex;
-	mesh->data_vertexhash[h] = vnum;
 	mesh->data_vertex3f[vnum * 3 + 0] = x;
 	mesh->data_vertex3f[vnum * 3 + 1] = y;
 	mesh->data_vertex3f[vnum * 3 + 2] = z;
@@ -4630,6 +4718,41 @@ int Mod_Mesh_IndexForVertex(model_t *mod, msurface_t *surf, float x, float y, fl
 	return vnum;
 }
 
+int Mod_Mesh_IndexForVertex(model_t *mod, msurface_t *surf, float x, float y, float z, float nx, float ny, float nz, float s, float t, float u, float v, float r, float g, float b, float a)
+{
+	int hashindex, h, vnum, mask;
+	surfmesh_t *mesh = &mod->surfmesh;
+	if (mesh->max_vertices == mesh->num_vertices)
+		Mod_Mesh_GrowVertices(mod, surf);
+	mask = mod->surfmesh.num_vertexhashsize - 1;
+	// this uses prime numbers intentionally for computing the hash
+	hashindex = (unsigned int)(x * 2003 + y * 4001 + z * 7919 + nx * 4097 + ny * 257 + nz * 17) & mask;
+	// when possible find an identical vertex within the same surface and return it
+	for(h = hashindex;(vnum = mesh->data_vertexhash[h]) >= 0;h = (h + 1) & mask)
+	{
+		if (vnum >= surf->num_firstvertex
+		 && mesh->data_vertex3f[vnum * 3 + 0] == x && mesh->data_vertex3f[vnum * 3 + 1] == y && mesh->data_vertex3f[vnum * 3 + 2] == z
+		 && mesh->data_normal3f[vnum * 3 + 0] == nx && mesh->data_normal3f[vnum * 3 + 1] == ny && mesh->data_normal3f[vnum * 3 + 2] == nz
+		 && mesh->data_texcoordtexture2f[vnum * 2 + 0] == s && mesh->data_texcoordtexture2f[vnum * 2 + 1] == t
+		 && mesh->data_texcoordlightmap2f[vnum * 2 + 0] == u && mesh->data_texcoordlightmap2f[vnum * 2 + 1] == v
+		 && mesh->data_lightmapcolor4f[vnum * 4 + 0] == r && mesh->data_lightmapcolor4f[vnum * 4 + 1] == g && mesh->data_lightmapcolor4f[vnum * 4 + 2] == b && mesh->data_lightmapcolor4f[vnum * 4 + 3] == a)
+			return vnum;
+	}
+	// add the new vertex
+	vnum = Mod_Mesh_StoreVertex(mod, surf, x, y, z, nx, ny, nz, s, t, u, v, r, g, b, a);
+	mesh->data_vertexhash[h] = vnum;
+	return vnum;
+}
+
+// like Mod_Mesh_IndexForVertex but always adds a new vertex without looking
+// for one to share, for callers like the 2D drawing that rarely have any
+int Mod_Mesh_AddVertex(model_t *mod, msurface_t *surf, float x, float y, float z, float nx, float ny, float nz, float s, float t, float u, float v, float r, float g, float b, float a)
+{
+	if (mod->surfmesh.max_vertices == mod->surfmesh.num_vertices)
+		Mod_Mesh_GrowVertices(mod, surf);
+	return Mod_Mesh_StoreVertex(mod, surf, x, y, z, nx, ny, nz, s, t, u, v, r, g, b, a);
+}
+
 void Mod_Mesh_AddTriangle(model_t *mod, msurface_t *surf, int e0, int e1, int e2)
 {
 	surfmesh_t *mesh = &mod->surfmesh;
@@ -4777,7 +4900,17 @@ void Mod_Mesh_Finalize(model_t *mod)
 	if (gl_paranoid.integer)
 		Mod_Mesh_Validate(mod);
 	Mod_Mesh_ComputeBounds(mod);
-	Mod_Mesh_MakeSortedSurfaces(mod);
+	if (mod == CL_Mesh_UI())
+	{
+		// the UI is drawn in the order of its surfaces, so skip the sort, which
+		// gets slow with the thousands of surfaces a busy HUD can have
+		// (draw2dstage is no test for this, the scene mesh is finalized in 2D
+		// stage too)
+		mod->submodelsurfaces_start = 0;
+		mod->submodelsurfaces_end = mod->num_surfaces;
+	}
+	else
+		Mod_Mesh_MakeSortedSurfaces(mod);
 	if(!r_refdef.draw2dstage)
 		Mod_BuildTextureVectorsFromNormals(0, mod->surfmesh.num_vertices, mod->surfmesh.num_triangles, mod->surfmesh.data_vertex3f, mod->surfmesh.data_texcoordtexture2f, mod->surfmesh.data_normal3f, mod->surfmesh.data_element3i, mod->surfmesh.data_svector3f, mod->surfmesh.data_tvector3f, true);
 	Mod_Mesh_UploadDynamicBuffers(mod);
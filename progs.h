@@ -102,6 +102,11 @@ typedef struct edict_engineprivate_s
 	int areagridmarknumber;
 	// mins/maxs passed to World_LinkEdict
 	vec3_t areamins, areamaxs;
+	// area tree leaf this edict is linked into (if the world uses one)
+	struct world_s *areatree_world;
+	int areatree_leaf;
+	// 1-based index of the world clip precomputed for this frame's move (0 = none)
+	int prepass;
 
 	// PROTOCOL_QUAKE, PROTOCOL_QUAKEDP, PROTOCOL_NEHAHRAMOVIE, PROTOCOL_QUAKEWORLD
 	// baseline values
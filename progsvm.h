@@ -530,6 +530,16 @@ typedef struct prvm_prog_garbagecollection_state_s
 }
 prvm_prog_garbagecollection_state_t;
 
+/// name lookup hash for fielddefs, globaldefs or functions, head and next
+/// entries are indices into the looked up array (-1 terminates a chain)
+typedef struct prvm_namehash_s
+{
+	int size; ///< power of two, 0 while not built yet
+	int *head;
+	int *next;
+}
+prvm_namehash_t;
+
 // [INIT] variables flagged with this token can be initialized by 'you'
 // NOTE: external code has to create and free the mempools but everything else is done by prvm !
 typedef struct prvm_prog_s
@@ -566,6 +576,12 @@ typedef struct prvm_prog_s
 	int					numstrings;
 	int					numglobals;
 
+	/// hashed lookups used by PRVM_ED_FindField, PRVM_ED_FindGlobal and
+	/// PRVM_ED_FindFunction once the loader is done modifying the defs
+	prvm_namehash_t		fieldhash;
+	prvm_namehash_t		globalhash;
+	prvm_namehash_t		functionhash;
+
 	int					*statement_linenums; ///< NULL if not available
 	int					*statement_columnnums; ///< NULL if not available
 
@@ -860,6 +876,7 @@ qbool PRVM_ED_CallSpawnFunction(prvm_prog_t *prog, prvm_edict_t *ent, const char
 void PRVM_ED_CallPostspawnFunction (prvm_prog_t *prog, prvm_edict_t *ent);
 
 void PRVM_ED_LoadFromFile(prvm_prog_t *prog, const char *data);
+void PRVM_ED_LoadFromFile_Cached(prvm_prog_t *prog, const char *data);
 
 unsigned int PRVM_EDICT_NUM_ERROR(prvm_prog_t *prog, unsigned int n, const char *filename, int fileline);
 #define PRVM_EDICT(n) (((unsigned)(n) < (unsigned int)prog->max_edicts) ? (unsigned int)(n) : PRVM_EDICT_NUM_ERROR(prog, (unsigned int)(n), __FILE__, __LINE__))
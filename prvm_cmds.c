@@ -678,9 +678,19 @@ cmd (string, ...)
 void VM_localcmd(prvm_prog_t *prog)
 {
 	char string[VM_TEMPSTRING_MAXSIZE];
+	qbool oldfromserverprogs;
 	VM_SAFEPARMCOUNTRANGE(1, 8, VM_localcmd);
 	VM_VarString(prog, 0, string, sizeof(string));
-	Cbuf_AddText(cmd_local, string);
+	if (prog == SVVM_prog)
+	{
+		// tagged so server recordings don't run it twice on replay
+		oldfromserverprogs = cmd_local->cbuf->fromserverprogs;
+		cmd_local->cbuf->fromserverprogs = true;
+		Cbuf_AddText(cmd_local, string);
+		cmd_local->cbuf->fromserverprogs = oldfromserverprogs;
+	}
+	else
+		Cbuf_AddText(cmd_local, string);
 }
 
 static qbool PRVM_Cvar_ReadOk(prvm_prog_t *prog, const char *string)
@@ -54,6 +54,7 @@ cvar_t prvm_garbagecollection_scan_limit = {CF_CLIENT | CF_SERVER, "prvm_garbage
 cvar_t prvm_garbagecollection_strings = {CF_CLIENT | CF_SERVER, "prvm_garbagecollection_strings", "1", "automatically call strunzone() on strings that are not referenced"};
 cvar_t prvm_stringdebug = {CF_CLIENT | CF_SERVER, "prvm_stringdebug", "0", "Print debug and warning messages related to strings"};
 cvar_t sv_entfields_noescapes = {CF_SERVER, "sv_entfields_noescapes", "wad", "Space-separated list of fields in which backslashes won't be parsed as escapes when loading entities from .bsp or .ent files. This is a workaround for buggy maps with unescaped backslashes used as path separators (only forward slashes are allowed in Quake VFS paths)."};
+cvar_t prvm_entitylumpcache = {CF_CLIENT | CF_SERVER, "prvm_entitylumpcache", "1", "keep map entity lumps parsed with their keys resolved to fields, so the same map loads faster the next time with the same progs (set developer_entityparsing to bypass it)"};
 
 static double prvm_reuseedicts_always_allow = 0;
 qbool prvm_runawaycheck = true;
@@ -329,6 +330,45 @@ void PRVM_ED_Free(prvm_prog_t *prog, prvm_edict_t *ed)
 
 //===========================================================================
 
+/*
+============
+PRVM_NameHashIndex
+============
+*/
+static int PRVM_NameHashIndex(const prvm_namehash_t *hash, const char *name)
+{
+	return CRC_Block((const unsigned char *)name, strlen(name)) & (hash->size - 1);
+}
+
+/*
+============
+PRVM_NameHash_Build
+
+Builds the lookup chains for an array of numnames entries, names are
+fetched from the s_name member at nameoffset inside each stride sized entry.
+Entries are linked in reverse so the first of several equal names is found,
+like the linear search does.
+============
+*/
+static void PRVM_NameHash_Build(prvm_prog_t *prog, prvm_namehash_t *hash, const void *base, size_t stride, size_t nameoffset, int numnames)
+{
+	int i, h;
+	const char *name;
+
+	for (hash->size = 64;hash->size < numnames && hash->size < 65536;hash->size <<= 1)
+		;
+	hash->head = (int *)Mem_Alloc(prog->progs_mempool, hash->size * sizeof(int));
+	hash->next = (int *)Mem_Alloc(prog->progs_mempool, max(numnames, 1) * sizeof(int));
+	memset(hash->head, -1, hash->size * sizeof(int));
+	for (i = numnames - 1;i >= 0;i--)
+	{
+		name = PRVM_GetString(prog, *(const int *)((const unsigned char *)base + i * stride + nameoffset));
+		h = PRVM_NameHashIndex(hash, name);
+		hash->next[i] = hash->head[h];
+		hash->head[h] = i;
+	}
+}
+
 /*
 ============
 PRVM_ED_GlobalAtOfs
@@ -377,6 +417,17 @@ mdef_t *PRVM_ED_FindField (prvm_prog_t *prog, const char *name)
 	mdef_t *def;
 	int i;
 
+	if (prog->fieldhash.size)
+	{
+		for (i = prog->fieldhash.head[PRVM_NameHashIndex(&prog->fieldhash, name)];i >= 0;i = prog->fieldhash.next[i])
+		{
+			def = &prog->fielddefs[i];
+			if (!strcmp(PRVM_GetString(prog, def->s_name), name))
+				return def;
+		}
+		return NULL;
+	}
+
 	for (i = 0;i < prog->numfielddefs;i++)
 	{
 		def = &prog->fielddefs[i];
@@ -396,6 +447,17 @@ mdef_t *PRVM_ED_FindGlobal (prvm_prog_t *prog, const char *name)
 	mdef_t *def;
 	int i;
 
+	if (prog->globalhash.size)
+	{
+		for (i = prog->globalhash.head[PRVM_NameHashIndex(&prog->globalhash, name)];i >= 0;i = prog->globalhash.next[i])
+		{
+			def = &prog->globaldefs[i];
+			if (!strcmp(PRVM_GetString(prog, def->s_name), name))
+				return def;
+		}
+		return NULL;
+	}
+
 	for (i = 0;i < prog->numglobaldefs;i++)
 	{
 		def = &prog->globaldefs[i];
@@ -426,6 +488,17 @@ mfunction_t *PRVM_ED_FindFunction (prvm_prog_t *prog, const char *name)
 	mfunction_t		*func;
 	int				i;
 
+	if (prog->functionhash.size)
+	{
+		for (i = prog->functionhash.head[PRVM_NameHashIndex(&prog->functionhash, name)];i >= 0;i = prog->functionhash.next[i])
+		{
+			func = &prog->functions[i];
+			if (!strcmp(PRVM_GetString(prog, func->s_name), name))
+				return func;
+		}
+		return NULL;
+	}
+
 	for (i = 0;i < prog->numfunctions;i++)
 	{
 		func = &prog->functions[i];
@@ -1270,83 +1343,103 @@ static void PRVM_ED_EdictSet_f(cmd_state_t *cmd)
 
 /*
 ====================
-PRVM_ED_ParseEdict
+PRVM_ED_ParseEdictPair
 
-Parses an edict out of the given string, returning the new position
-ed should be a properly initialized empty edict.
-Used for initial level load and for savegames.
+Parses one key/value pair of an edict into keyname and com_token,
+applying the QuakeEd key hacks. Returns false at the closing brace.
 ====================
 */
-const char *PRVM_ED_ParseEdict (prvm_prog_t *prog, const char *data, prvm_edict_t *ent, qbool saveload)
+static qbool PRVM_ED_ParseEdictPair(prvm_prog_t *prog, const char **data, char *keyname, size_t keynamesize, qbool saveload)
 {
-	mdef_t *key;
 	qbool anglehack;
-	qbool init = false;
 	qbool parsebackslash = true;
-	char keyname[256];
 	size_t n;
 
-// go through all the dictionary pairs
-	while (1)
-	{
 	// parse key
-		if (!COM_ParseToken_Simple(&data, false, false, true))
-			prog->error_cmd("PRVM_ED_ParseEdict: EOF without closing brace");
-		if (developer_entityparsing.integer)
-			Con_Printf("Key: \"%s\"", com_token);
-		if (com_token[0] == '}')
-			break;
+	if (!COM_ParseToken_Simple(data, false, false, true))
+		prog->error_cmd("PRVM_ED_ParseEdict: EOF without closing brace");
+	if (developer_entityparsing.integer)
+		Con_Printf("Key: \"%s\"", com_token);
+	if (com_token[0] == '}')
+		return false;
 
-		// anglehack is to allow QuakeEd to write single scalar angles
-		// and allow them to be turned into vectors. (FIXME...)
-		if (!strcmp(com_token, "angle"))
-		{
-			dp_strlcpy (com_token, "angles", sizeof(com_token));
-			anglehack = true;
-		}
-		else
-			anglehack = false;
+	// anglehack is to allow QuakeEd to write single scalar angles
+	// and allow them to be turned into vectors. (FIXME...)
+	if (!strcmp(com_token, "angle"))
+	{
+		dp_strlcpy (com_token, "angles", sizeof(com_token));
+		anglehack = true;
+	}
+	else
+		anglehack = false;
 
-		// FIXME: change light to _light to get rid of this hack
-		if (!strcmp(com_token, "light"))
-			dp_strlcpy (com_token, "light_lev", sizeof(com_token));	// hack for single light def
+	// FIXME: change light to _light to get rid of this hack
+	if (!strcmp(com_token, "light"))
+		dp_strlcpy (com_token, "light_lev", sizeof(com_token));	// hack for single light def
 
-		n = dp_strlcpy (keyname, com_token, sizeof(keyname));
+	n = dp_strlcpy (keyname, com_token, keynamesize);
 
-		// another hack to fix keynames with trailing spaces
-		while (n && keyname[n-1] == ' ')
-		{
-			keyname[n-1] = 0;
-			n--;
-		}
+	// another hack to fix keynames with trailing spaces
+	while (n && keyname[n-1] == ' ')
+	{
+		keyname[n-1] = 0;
+		n--;
+	}
 
 	// Check if escape parsing is disabled for this key (see cvar description).
 	// Escapes are always used in savegames and DP_QC_ENTITYSTRING for compatibility.
-		if (!saveload)
-		{
-			const char *cvarpos = sv_entfields_noescapes.string;
+	if (!saveload)
+	{
+		const char *cvarpos = sv_entfields_noescapes.string;
 
-			while (COM_ParseToken_Console(&cvarpos))
+		while (COM_ParseToken_Console(&cvarpos))
+		{
+			if (strcmp(com_token, keyname) == 0)
 			{
-				if (strcmp(com_token, keyname) == 0)
-				{
-					parsebackslash = false;
-					break;
-				}
+				parsebackslash = false;
+				break;
 			}
 		}
+	}
 
 	// parse value
-		// If loading a save, unescape characters (they're escaped when saving).
-		// Otherwise, load them as they are (BSP compilers don't support escaping).
-		if (!COM_ParseToken_Simple(&data, false, parsebackslash, true))
-			prog->error_cmd("PRVM_ED_ParseEdict: EOF without closing brace");
-		if (developer_entityparsing.integer)
-			Con_Printf(" \"%s\"\n", com_token);
+	// If loading a save, unescape characters (they're escaped when saving).
+	// Otherwise, load them as they are (BSP compilers don't support escaping).
+	if (!COM_ParseToken_Simple(data, false, parsebackslash, true))
+		prog->error_cmd("PRVM_ED_ParseEdict: EOF without closing brace");
+	if (developer_entityparsing.integer)
+		Con_Printf(" \"%s\"\n", com_token);
 
-		if (com_token[0] == '}')
-			prog->error_cmd("PRVM_ED_ParseEdict: closing brace without data");
+	if (com_token[0] == '}')
+		prog->error_cmd("PRVM_ED_ParseEdict: closing brace without data");
 
+	if (anglehack)
+	{
+		char	temp[32];
+		dp_strlcpy (temp, com_token, sizeof(temp));
+		dpsnprintf (com_token, sizeof(com_token), "0 %s 0", temp);
+	}
+	return true;
+}
+
+/*
+====================
+PRVM_ED_ParseEdict
+
+Parses an edict out of the given string, returning the new position
+ed should be a properly initialized empty edict.
+Used for initial level load and for savegames.
+====================
+*/
+const char *PRVM_ED_ParseEdict (prvm_prog_t *prog, const char *data, prvm_edict_t *ent, qbool saveload)
+{
+	mdef_t *key;
+	qbool init = false;
+	char keyname[256];
+
+// go through all the dictionary pairs
+	while (PRVM_ED_ParseEdictPair(prog, &data, keyname, sizeof(keyname), saveload))
+	{
 		init = true;
 
 		// ignore attempts to set key "" (this problem occurs in nehahra neh1m8.bsp)
@@ -1365,13 +1458,6 @@ const char *PRVM_ED_ParseEdict (prvm_prog_t *prog, const char *data, prvm_edict_
 			continue;
 		}
 
-		if (anglehack)
-		{
-			char	temp[32];
-			dp_strlcpy (temp, com_token, sizeof(temp));
-			dpsnprintf (com_token, sizeof(com_token), "0 %s 0", temp);
-		}
-
 		if (!PRVM_ED_ParseEpair(prog, ent, key, com_token, false))
 			prog->error_cmd("PRVM_ED_ParseEdict: parse error");
 	}
@@ -1492,9 +1578,178 @@ void PRVM_ED_CallPostspawnFunction (prvm_prog_t *prog, prvm_edict_t *ent)
 	}
 }
 
+/*
+==============================================================================
+
+ENTITY LUMP CACHE
+
+Map entity lumps are tokenized and their keys resolved to field indices once
+per progs and entity data, later loads of the same map (restarts, changelevel
+back to a map) just replay the resolved pairs. The cache lives outside of the
+prog because the progs are reloaded for every map.
+==============================================================================
+*/
+
+typedef struct prvm_entitylump_pair_s
+{
+	int fieldindex; ///< index into prog->fielddefs
+	int value; ///< offset of the parsed value in text
+}
+prvm_entitylump_pair_t;
+
+typedef struct prvm_entitylump_edict_s
+{
+	int start; ///< offset of the opening brace in the entity data
+	int end; ///< offset behind the closing brace in the entity data
+	int firstpair;
+	int numpairs;
+	qbool init; ///< false if the edict had no keys at all and should be freed
+}
+prvm_entitylump_edict_t;
+
+typedef struct prvm_entitylumpcache_s
+{
+	// what the cache was built from
+	int filecrc;
+	int numfielddefs;
+	int entityfields;
+	size_t datasize;
+	unsigned short datacrc;
+	unsigned short noescapescrc;
+
+	int numedicts, maxedicts;
+	prvm_entitylump_edict_t *edicts;
+	int numpairs, maxpairs;
+	prvm_entitylump_pair_t *pairs;
+	int textsize, maxtextsize;
+	char *text;
+}
+prvm_entitylumpcache_t;
+
+static mempool_t *prvm_entitylumpcache_mempool;
+static prvm_entitylumpcache_t prvm_entitylumpcaches[PRVM_PROG_MAX];
+
+static void PRVM_ED_EntityLumpCache_Clear(prvm_entitylumpcache_t *cache)
+{
+	if (cache->edicts)
+		Mem_Free(cache->edicts);
+	if (cache->pairs)
+		Mem_Free(cache->pairs);
+	if (cache->text)
+		Mem_Free(cache->text);
+	memset(cache, 0, sizeof(*cache));
+}
+
+static void PRVM_ED_EntityLumpCache_AddPair(prvm_entitylumpcache_t *cache, int fieldindex, const char *value)
+{
+	int len = (int)strlen(value) + 1;
+	prvm_entitylump_pair_t *pair;
+
+	if (cache->numpairs >= cache->maxpairs)
+	{
+		cache->maxpairs = max(cache->maxpairs * 2, 1024);
+		cache->pairs = (prvm_entitylump_pair_t *)Mem_Realloc(prvm_entitylumpcache_mempool, cache->pairs, cache->maxpairs * sizeof(*cache->pairs));
+	}
+	if (cache->textsize + len > cache->maxtextsize)
+	{
+		cache->maxtextsize = max(cache->maxtextsize * 2, cache->textsize + len + 16384);
+		cache->text = (char *)Mem_Realloc(prvm_entitylumpcache_mempool, cache->text, cache->maxtextsize);
+	}
+	pair = cache->pairs + cache->numpairs++;
+	pair->fieldindex = fieldindex;
+	pair->value = cache->textsize;
+	memcpy(cache->text + cache->textsize, value, len);
+	cache->textsize += len;
+}
+
 /*
 ================
-PRVM_ED_LoadFromFile
+PRVM_ED_EntityLumpCache_Get
+
+Returns the cache for data, (re)building it if the map or progs changed.
+Parse errors abort through prog->error_cmd like PRVM_ED_ParseEdict does.
+================
+*/
+static prvm_entitylumpcache_t *PRVM_ED_EntityLumpCache_Get(prvm_prog_t *prog, const char *data)
+{
+	prvm_entitylumpcache_t *cache = &prvm_entitylumpcaches[prog - prvm_prog_list];
+	prvm_entitylump_edict_t *edict;
+	const char *base = data;
+	size_t datasize = strlen(data);
+	unsigned short datacrc = CRC_Block((const unsigned char *)data, datasize);
+	unsigned short noescapescrc = CRC_Block((const unsigned char *)sv_entfields_noescapes.string, strlen(sv_entfields_noescapes.string));
+	char keyname[256];
+	mdef_t *key;
+
+	if (cache->edicts
+	 && cache->filecrc == prog->filecrc
+	 && cache->numfielddefs == prog->numfielddefs
+	 && cache->entityfields == prog->entityfields
+	 && cache->datasize == datasize
+	 && cache->datacrc == datacrc
+	 && cache->noescapescrc == noescapescrc)
+		return cache;
+
+	PRVM_ED_EntityLumpCache_Clear(cache);
+	for (;;)
+	{
+		const char *start = data;
+
+		// parse the opening brace
+		if (!COM_ParseToken_Simple(&data, false, false, true))
+			break;
+		if (com_token[0] != '{')
+		{
+			PRVM_ED_EntityLumpCache_Clear(cache);
+			prog->error_cmd("PRVM_ED_LoadFromFile: %s: found %s when expecting {", prog->name, com_token);
+		}
+
+		if (cache->numedicts >= cache->maxedicts)
+		{
+			cache->maxedicts = max(cache->maxedicts * 2, 256);
+			cache->edicts = (prvm_entitylump_edict_t *)Mem_Realloc(prvm_entitylumpcache_mempool, cache->edicts, cache->maxedicts * sizeof(*cache->edicts));
+		}
+		edict = cache->edicts + cache->numedicts++;
+		edict->start = (int)(start - base);
+		edict->firstpair = cache->numpairs;
+		edict->init = false;
+
+		// same rules as PRVM_ED_ParseEdict
+		while (PRVM_ED_ParseEdictPair(prog, &data, keyname, sizeof(keyname), false))
+		{
+			edict->init = true;
+			if (!keyname[0] || keyname[0] == '_')
+				continue;
+			key = PRVM_ED_FindField(prog, keyname);
+			if (!key)
+			{
+				Con_DPrintf("%s: '%s' is not a field\n", prog->name, keyname);
+				continue;
+			}
+			PRVM_ED_EntityLumpCache_AddPair(cache, key - prog->fielddefs, com_token);
+		}
+		edict->numpairs = cache->numpairs - edict->firstpair;
+		edict->end = (int)(data - base);
+	}
+
+	if (!cache->edicts)
+	{
+		// keep an allocation around to mark an empty lump as valid
+		cache->maxedicts = 1;
+		cache->edicts = (prvm_entitylump_edict_t *)Mem_Alloc(prvm_entitylumpcache_mempool, sizeof(*cache->edicts));
+	}
+	cache->filecrc = prog->filecrc;
+	cache->numfielddefs = prog->numfielddefs;
+	cache->entityfields = prog->entityfields;
+	cache->datasize = datasize;
+	cache->datacrc = datacrc;
+	cache->noescapescrc = noescapescrc;
+	return cache;
+}
+
+/*
+================
+PRVM_ED_LoadFromData
 
 The entities are directly placed in the array, rather than allocated with
 PRVM_ED_Alloc, because otherwise an error loading the map would have entity
@@ -1507,29 +1762,47 @@ Used for both fresh maps and savegame loads.  A fresh map would also need
 to call PRVM_ED_CallSpawnFunctions () to let the objects initialize themselves.
 ================
 */
-void PRVM_ED_LoadFromFile (prvm_prog_t *prog, const char *data)
+static void PRVM_ED_LoadFromData (prvm_prog_t *prog, const char *data, qbool usecache)
 {
 	prvm_edict_t *ent;
+	const char *base = data;
 	const char *start;
 	int parsed, inhibited, spawned, died;
+	int i, entnum;
+	prvm_entitylumpcache_t *cache = NULL;
+	prvm_entitylump_edict_t *cached;
 
 	parsed = 0;
 	inhibited = 0;
 	spawned = 0;
 	died = 0;
 
+	if (usecache && prvm_entitylumpcache.integer && !developer_entityparsing.integer)
+		cache = PRVM_ED_EntityLumpCache_Get(prog, data);
+
 	prvm_reuseedicts_always_allow = host.realtime;
 
 	// parse ents
-	while (1)
+	for (entnum = 0;;entnum++)
 	{
-		start = data;
+		if (cache)
+		{
+			if (entnum >= cache->numedicts)
+				break;
+			cached = cache->edicts + entnum;
+			start = base + cached->start;
+		}
+		else
+		{
+			cached = NULL;
+			start = data;
 
-		// parse the opening brace
-		if (!COM_ParseToken_Simple(&data, false, false, true))
-			break;
-		if (com_token[0] != '{')
-			prog->error_cmd("PRVM_ED_LoadFromFile: %s: found %s when expecting {", prog->name, com_token);
+			// parse the opening brace
+			if (!COM_ParseToken_Simple(&data, false, false, true))
+				break;
+			if (com_token[0] != '{')
+				prog->error_cmd("PRVM_ED_LoadFromFile: %s: found %s when expecting {", prog->name, com_token);
+		}
 
 		// CHANGED: this is not conform to PR_LoadFromFile
 		if(prog->loadintoworld)
@@ -1544,7 +1817,20 @@ void PRVM_ED_LoadFromFile (prvm_prog_t *prog, const char *data)
 		if (ent != prog->edicts)	// hack
 			memset (ent->fields.fp, 0, prog->entityfields * sizeof(prvm_vec_t));
 
-		data = PRVM_ED_ParseEdict (prog, data, ent, false);
+		if (cached)
+		{
+			for (i = cached->firstpair;i < cached->firstpair + cached->numpairs;i++)
+				if (!PRVM_ED_ParseEpair(prog, ent, prog->fielddefs + cache->pairs[i].fieldindex, cache->text + cache->pairs[i].value, false))
+					prog->error_cmd("PRVM_ED_ParseEdict: parse error");
+			if (!cached->init)
+			{
+				ent->free = true;
+				ent->freetime = host.realtime;
+			}
+			data = base + cached->end;
+		}
+		else
+			data = PRVM_ED_ParseEdict (prog, data, ent, false);
 		parsed++;
 
 		// remove the entity ?
@@ -1575,11 +1861,36 @@ void PRVM_ED_LoadFromFile (prvm_prog_t *prog, const char *data)
 			died++;
 	}
 
-	Con_DPrintf("%s: %i new entities parsed, %i new inhibited, %i (%i new) spawned (whereas %i removed self, %i stayed)\n", prog->name, parsed, inhibited, prog->num_edicts, spawned, died, spawned - died);
+	Con_DPrintf("%s: %i new entities parsed, %i new inhibited, %i (%i new) spawned (whereas %i removed self, %i stayed)%s\n", prog->name, parsed, inhibited, prog->num_edicts, spawned, died, spawned - died, cache ? " (cached)" : "");
 
 	prvm_reuseedicts_always_allow = 0;
 }
 
+/*
+================
+PRVM_ED_LoadFromFile
+
+Loads entities from a one-off string (such as QC provided data)
+================
+*/
+void PRVM_ED_LoadFromFile (prvm_prog_t *prog, const char *data)
+{
+	PRVM_ED_LoadFromData(prog, data, false);
+}
+
+/*
+================
+PRVM_ED_LoadFromFile_Cached
+
+Loads the entities of a map, the parsed lump is kept for the next load of
+the same map with the same progs
+================
+*/
+void PRVM_ED_LoadFromFile_Cached (prvm_prog_t *prog, const char *data)
+{
+	PRVM_ED_LoadFromData(prog, data, true);
+}
+
 static void PRVM_FindOffsets(prvm_prog_t *prog)
 {
 	// field and global searches use -1 for NULL
@@ -2241,6 +2552,11 @@ void PRVM_Prog_Load(prvm_prog_t *prog, const char *filename, unsigned char *data
 		prog->numfielddefs++;
 	}
 
+	// the defs are final now, speed up name lookups
+	PRVM_NameHash_Build(prog, &prog->fieldhash, prog->fielddefs, sizeof(mdef_t), offsetof(mdef_t, s_name), prog->numfielddefs);
+	PRVM_NameHash_Build(prog, &prog->globalhash, prog->globaldefs, sizeof(mdef_t), offsetof(mdef_t, s_name), prog->numglobaldefs);
+	PRVM_NameHash_Build(prog, &prog->functionhash, prog->functions, sizeof(mfunction_t), offsetof(mfunction_t, s_name), prog->numfunctions);
+
 	// LadyHavoc: TODO: reorder globals to match engine struct
 	// LadyHavoc: TODO: reorder fields to match engine struct
 #define remapglobal(index) (index)
@@ -3232,6 +3548,9 @@ void PRVM_Init (void)
 	Cvar_RegisterVariable (&prvm_garbagecollection_strings);
 	Cvar_RegisterVariable (&prvm_stringdebug);
 	Cvar_RegisterVariable (&sv_entfields_noescapes);
+	Cvar_RegisterVariable (&prvm_entitylumpcache);
+
+	prvm_entitylumpcache_mempool = Mem_AllocPool("entity lump cache", 0, NULL);
 
 	// COMMANDLINEOPTION: PRVM: -norunaway disables the runaway loop check (it might be impossible to exit DarkPlaces if used!)
 	prvm_runawaycheck = !Sys_CheckParm("-norunaway");
@@ -21,6 +21,15 @@
 # endif
 #endif
 
+// each thread gets its own copy of a variable declared with this
+#if defined (_MSC_VER)
+#define DP_THREAD_LOCAL __declspec(thread)
+#elif defined (__GNUC__) || defined (__clang__)
+#define DP_THREAD_LOCAL __thread
+#else
+#define DP_THREAD_LOCAL _Thread_local
+#endif
+
 #define MAX_NUM_ARGVS	50
 
 #ifdef DP_SMALLMEMORY
@@ -160,6 +160,7 @@ cvar_t r_shadow_realtime_dlight = {CF_CLIENT | CF_ARCHIVE, "r_shadow_realtime_dl
 cvar_t r_shadow_realtime_dlight_shadows = {CF_CLIENT | CF_ARCHIVE, "r_shadow_realtime_dlight_shadows", "1", "enables rendering of shadows from dynamic lights"};
 cvar_t r_shadow_realtime_dlight_svbspculling = {CF_CLIENT, "r_shadow_realtime_dlight_svbspculling", "0", "enables svbsp optimization on dynamic lights (very slow!)"};
 cvar_t r_shadow_realtime_dlight_portalculling = {CF_CLIENT, "r_shadow_realtime_dlight_portalculling", "0", "enables portal optimization on dynamic lights (slow!)"};
+cvar_t r_shadow_preparelights_threaded = {CF_CLIENT | CF_ARCHIVE, "r_shadow_preparelights_threaded", "1", "find the lit surfaces and shadow casting entities of lights using taskqueue_maxthreads (not with r_shadow_realtime_dlight_svbspculling or r_shadow_realtime_dlight_portalculling)"};
 cvar_t r_shadow_realtime_world = {CF_CLIENT | CF_ARCHIVE, "r_shadow_realtime_world", "0", "enables rendering of full world lighting (whether loaded from the map, or a .rtlights file, or a .ent file, or a .lights file produced by hlight)"};
 cvar_t r_shadow_realtime_world_importlightentitiesfrommap = {CF_CLIENT, "r_shadow_realtime_world_importlightentitiesfrommap", "1", "load lights from .ent file or map entities at startup if no .rtlights or .lights file is present (if set to 2, always use the .ent or map entities)"};
 cvar_t r_shadow_realtime_world_lightmaps = {CF_CLIENT | CF_ARCHIVE, "r_shadow_realtime_world_lightmaps", "0", "brightness to render lightmaps when using full world lighting, try 0.5 for a tenebrae-like appearance"};
@@ -167,6 +168,7 @@ cvar_t r_shadow_realtime_world_shadows = {CF_CLIENT | CF_ARCHIVE, "r_shadow_real
 cvar_t r_shadow_realtime_world_compile = {CF_CLIENT, "r_shadow_realtime_world_compile", "1", "enables compilation of world lights for higher performance rendering"};
 cvar_t r_shadow_realtime_world_compileshadow = {CF_CLIENT, "r_shadow_realtime_world_compileshadow", "1", "enables compilation of shadows from world lights for higher performance rendering"};
 cvar_t r_shadow_realtime_world_compilesvbsp = {CF_CLIENT, "r_shadow_realtime_world_compilesvbsp", "1", "enables svbsp optimization during compilation (slower than compileportalculling but more exact)"};
+cvar_t r_shadow_realtime_world_compilecache = {CF_CLIENT | CF_ARCHIVE, "r_shadow_realtime_world_compilecache", "1", "save compiled world lights to maps/<mapname>.rtlightcache and load them from there when the map is loaded again"};
 cvar_t r_shadow_realtime_world_compileportalculling = {CF_CLIENT, "r_shadow_realtime_world_compileportalculling", "1", "enables portal-based culling optimization during compilation (overrides compilesvbsp)"};
 cvar_t r_shadow_scissor = {CF_CLIENT, "r_shadow_scissor", "1", "use scissor optimization of light rendering (restricts rendering to the portion of the screen affected by the light)"};
 cvar_t r_shadow_shadowmapping = {CF_CLIENT | CF_ARCHIVE, "r_shadow_shadowmapping", "1", "enables use of shadowmapping (shadow rendering by depth texture sampling)"};
@@ -201,6 +203,8 @@ cvar_t r_shadow_bouncegrid_dynamic_bounceminimumintensity = {CF_CLIENT | CF_ARCH
 cvar_t r_shadow_bouncegrid_dynamic_culllightpaths = {CF_CLIENT | CF_ARCHIVE, "r_shadow_bouncegrid_dynamic_culllightpaths", "0", "skip accumulating light in the bouncegrid texture where the light paths are out of view (dynamic mode only)"};
 cvar_t r_shadow_bouncegrid_dynamic_directionalshading = {CF_CLIENT | CF_ARCHIVE, "r_shadow_bouncegrid_dynamic_directionalshading", "1", "use diffuse shading rather than ambient, 3D texture becomes 8x as many pixels to hold the additional data"};
 cvar_t r_shadow_bouncegrid_dynamic_dlightparticlemultiplier = {CF_CLIENT | CF_ARCHIVE, "r_shadow_bouncegrid_dynamic_dlightparticlemultiplier", "1", "if set to a high value like 16 this can make dlights look great, but 0 is recommended for performance reasons"};
+cvar_t r_shadow_bouncegrid_dynamic_incremental = {CF_CLIENT | CF_ARCHIVE, "r_shadow_bouncegrid_dynamic_incremental", "1", "reuse the photons of lights that did not move or change since the previous update instead of tracing them again (needs r_shadow_bouncegrid_rng_seed >= 0, not used with r_shadow_bouncegrid_dynamic_hitmodels or r_shadow_bouncegrid_dynamic_culllightpaths)"};
+cvar_t r_shadow_bouncegrid_dynamic_incremental_refresh = {CF_CLIENT | CF_ARCHIVE, "r_shadow_bouncegrid_dynamic_incremental_refresh", "0.125", "fraction of the unchanged lights that are traced again on each update anyway, so doors and other moving geometry show up over time"};
 cvar_t r_shadow_bouncegrid_dynamic_hitmodels = {CF_CLIENT | CF_ARCHIVE, "r_shadow_bouncegrid_dynamic_hitmodels", "0", "enables hitting character model geometry (SLOW)"};
 cvar_t r_shadow_bouncegrid_dynamic_lightradiusscale = {CF_CLIENT | CF_ARCHIVE, "r_shadow_bouncegrid_dynamic_lightradiusscale", "5", "particles stop at this fraction of light radius (can be more than 1)"};
 cvar_t r_shadow_bouncegrid_dynamic_maxbounce = {CF_CLIENT | CF_ARCHIVE, "r_shadow_bouncegrid_dynamic_maxbounce", "5", "maximum number of bounces for a particle (minimum is 0)"};
@@ -495,11 +499,15 @@ static void R_Shadow_BounceGrid_FreeHighPixels(void)
 	if (r_shadow_bouncegrid_state.u8pixels)      { Mem_Free(r_shadow_bouncegrid_state.u8pixels);      r_shadow_bouncegrid_state.u8pixels      = NULL; }
 	if (r_shadow_bouncegrid_state.fp16pixels)    { Mem_Free(r_shadow_bouncegrid_state.fp16pixels);    r_shadow_bouncegrid_state.fp16pixels    = NULL; }
 	if (r_shadow_bouncegrid_state.photons)       { Mem_Free(r_shadow_bouncegrid_state.photons);       r_shadow_bouncegrid_state.photons       = NULL; }
+	if (r_shadow_bouncegrid_state.prevphotons)   { Mem_Free(r_shadow_bouncegrid_state.prevphotons);   r_shadow_bouncegrid_state.prevphotons   = NULL; }
+	r_shadow_bouncegrid_state.prevnumphotons = 0;
 	if (r_shadow_bouncegrid_state.photons_tasks) { Mem_Free(r_shadow_bouncegrid_state.photons_tasks); r_shadow_bouncegrid_state.photons_tasks = NULL; }
 	if (r_shadow_bouncegrid_state.slices_tasks)  { Mem_Free(r_shadow_bouncegrid_state.slices_tasks);  r_shadow_bouncegrid_state.slices_tasks  = NULL; }
 }
 
 static void R_Shadow_FreeDeferred(void);
+static void R_Shadow_PrepareLights_FreeSlots(void);
+static void R_Shadow_RTLightCache_Free(void);
 static void r_shadow_shutdown(void)
 {
 	CHECKGLERROR
@@ -580,6 +588,8 @@ static void r_shadow_shutdown(void)
 	r_shadow_buffer_numlighttrispvsbytes = 0;
 	if (r_shadow_buffer_lighttrispvs)
 		Mem_Free(r_shadow_buffer_lighttrispvs);
+	R_Shadow_PrepareLights_FreeSlots();
+	R_Shadow_RTLightCache_Free();
 }
 
 static void r_shadow_newmap(void)
@@ -623,6 +633,7 @@ void R_Shadow_Init(void)
 	Cvar_RegisterVariable(&r_shadow_realtime_dlight_shadows);
 	Cvar_RegisterVariable(&r_shadow_realtime_dlight_svbspculling);
 	Cvar_RegisterVariable(&r_shadow_realtime_dlight_portalculling);
+	Cvar_RegisterVariable(&r_shadow_preparelights_threaded);
 	Cvar_RegisterVariable(&r_shadow_realtime_world);
 	Cvar_RegisterVariable(&r_shadow_realtime_world_lightmaps);
 	Cvar_RegisterVariable(&r_shadow_realtime_world_shadows);
@@ -630,6 +641,7 @@ void R_Shadow_Init(void)
 	Cvar_RegisterVariable(&r_shadow_realtime_world_compileshadow);
 	Cvar_RegisterVariable(&r_shadow_realtime_world_compilesvbsp);
 	Cvar_RegisterVariable(&r_shadow_realtime_world_compileportalculling);
+	Cvar_RegisterVariable(&r_shadow_realtime_world_compilecache);
 	Cvar_RegisterVariable(&r_shadow_scissor);
 	Cvar_RegisterVariable(&r_shadow_shadowmapping);
 	Cvar_RegisterVariable(&r_shadow_shadowmapping_vsdct);
@@ -663,6 +675,8 @@ void R_Shadow_Init(void)
 	Cvar_RegisterVariable(&r_shadow_bouncegrid_dynamic_culllightpaths);
 	Cvar_RegisterVariable(&r_shadow_bouncegrid_dynamic_directionalshading);
 	Cvar_RegisterVariable(&r_shadow_bouncegrid_dynamic_dlightparticlemultiplier);
+	Cvar_RegisterVariable(&r_shadow_bouncegrid_dynamic_incremental);
+	Cvar_RegisterVariable(&r_shadow_bouncegrid_dynamic_incremental_refresh);
 	Cvar_RegisterVariable(&r_shadow_bouncegrid_dynamic_hitmodels);
 	Cvar_RegisterVariable(&r_shadow_bouncegrid_dynamic_lightradiusscale);
 	Cvar_RegisterVariable(&r_shadow_bouncegrid_dynamic_maxbounce);
@@ -1950,6 +1964,9 @@ static void R_Shadow_BounceGrid_AssignPhotons_Task(taskqueue_task_t *t)
 	unsigned int seed;
 	randomseed_t randomseed;
 	vec3_t baseshotcolor;
+	int numshots;
+	int refreshperiod;
+	r_shadow_bouncegrid_photon_t *p;
 
 	normalphotonscaling = 1.0f / max(0.0000001f, r_shadow_bouncegrid_state.settings.energyperphoton);
 	for (lightindex = 0;lightindex < range2;lightindex++)
@@ -2077,6 +2094,11 @@ static void R_Shadow_BounceGrid_AssignPhotons_Task(taskqueue_task_t *t)
 	Math_RandomSeed_FromInts(&randomseed, 0, 0, 0, host.realtime * 1000.0);
 	seed = host.realtime * 1000.0;
 
+	// every refreshperiod-th unchanged light is traced again
+	refreshperiod = 0;
+	if (r_shadow_bouncegrid_dynamic_incremental_refresh.value > 0)
+		refreshperiod = (int)floor(1.0f / min(r_shadow_bouncegrid_dynamic_incremental_refresh.value, 1.0f) + 0.5f);
+
 	for (lightindex = 0; lightindex < range2; lightindex++)
 	{
 		if (lightindex < range)
@@ -2102,7 +2124,40 @@ static void R_Shadow_BounceGrid_AssignPhotons_Task(taskqueue_task_t *t)
 		if (VectorLength2(baseshotcolor) <= 0.0f)
 			continue;
 		r_refdef.stats[r_stat_bouncegrid_lights]++;
-		r_refdef.stats[r_stat_bouncegrid_particles] += shootparticles;
+
+		// if nothing about the light changed since the previous update, its
+		// photons would be traced the same way again, so copy them (except
+		// for the few lights that are refreshed on each update)
+		numshots = min(shootparticles, r_shadow_bouncegrid_state.settings.maxphotons - r_shadow_bouncegrid_state.numphotons);
+		if (numshots <= 0)
+			continue;
+		if (r_shadow_bouncegrid_state.incremental
+			&& rtlight->bouncegrid_cachedupdate
+			&& rtlight->bouncegrid_cachedupdate == r_shadow_bouncegrid_state.prevupdatenumber
+			&& rtlight->bouncegrid_cachednumphotons == numshots
+			&& rtlight->bouncegrid_cachedfirstphoton + numshots <= r_shadow_bouncegrid_state.prevnumphotons
+			&& rtlight->bouncegrid_cachedradius == radius
+			&& VectorCompare(rtlight->bouncegrid_cachedorigin, rtlight->shadoworigin)
+			&& VectorCompare(rtlight->bouncegrid_cachedcolor, baseshotcolor)
+			&& (!refreshperiod || (lightindex + r_shadow_bouncegrid_state.updatenumber) % refreshperiod))
+		{
+			p = r_shadow_bouncegrid_state.photons + r_shadow_bouncegrid_state.numphotons;
+			memcpy(p, r_shadow_bouncegrid_state.prevphotons + rtlight->bouncegrid_cachedfirstphoton, numshots * sizeof(*p));
+			for (shotparticles = 0;shotparticles < numshots;shotparticles++)
+				p[shotparticles].cached = true;
+			rtlight->bouncegrid_cachedupdate = r_shadow_bouncegrid_state.updatenumber;
+			rtlight->bouncegrid_cachedfirstphoton = r_shadow_bouncegrid_state.numphotons;
+			r_shadow_bouncegrid_state.numphotons += numshots;
+			continue;
+		}
+		rtlight->bouncegrid_cachedupdate = r_shadow_bouncegrid_state.updatenumber;
+		rtlight->bouncegrid_cachedfirstphoton = r_shadow_bouncegrid_state.numphotons;
+		rtlight->bouncegrid_cachednumphotons = numshots;
+		rtlight->bouncegrid_cachedradius = radius;
+		VectorCopy(rtlight->shadoworigin, rtlight->bouncegrid_cachedorigin);
+		VectorCopy(baseshotcolor, rtlight->bouncegrid_cachedcolor);
+		r_refdef.stats[r_stat_bouncegrid_particles] += numshots;
+
 		// we stop caring about bounces once the brightness goes below this fraction of the original intensity
 		bounceminimumintensity2 = VectorLength(baseshotcolor) * r_shadow_bouncegrid_state.settings.bounceminimumintensity2;
 
@@ -2135,9 +2190,9 @@ static void R_Shadow_BounceGrid_AssignPhotons_Task(taskqueue_task_t *t)
 			}
 		}
 
-		for (shotparticles = 0; shotparticles < shootparticles && r_shadow_bouncegrid_state.numphotons < r_shadow_bouncegrid_state.settings.maxphotons; shotparticles++)
+		for (shotparticles = 0; shotparticles < numshots; shotparticles++)
 		{
-			r_shadow_bouncegrid_photon_t *p = r_shadow_bouncegrid_state.photons + r_shadow_bouncegrid_state.numphotons++;
+			p = r_shadow_bouncegrid_state.photons + r_shadow_bouncegrid_state.numphotons++;
 			VectorCopy(baseshotcolor, p->color);
 			VectorCopy(rtlight->shadoworigin, p->start);
 			switch (r_shadow_bouncegrid_state.settings.rng_type)
@@ -2160,6 +2215,9 @@ static void R_Shadow_BounceGrid_AssignPhotons_Task(taskqueue_task_t *t)
 			VectorMA(p->start, radius, p->end, p->end);
 			p->bounceminimumintensity2 = bounceminimumintensity2;
 			p->startrefractiveindex = startrefractiveindex;
+			p->cached = false;
+			p->numtraces = 0;
+			p->numhits = 0;
 			p->numpaths = 0;
 		}
 	}
@@ -2622,6 +2680,9 @@ static void R_Shadow_BounceGrid_TracePhotons_Shot(r_shadow_bouncegrid_photon_t *
 		// dynamic mode fires many rays and most will match the cache from the previous frame
 		cliptrace = CL_Cache_TraceLineSurfaces(shotstart, shotend, r_shadow_bouncegrid_state.settings.staticmode ? MOVE_WORLDONLY : (r_shadow_bouncegrid_state.settings.hitmodels ? MOVE_HITMODEL : MOVE_NOMONSTERS), hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask);
 	}
+	p->numtraces++;
+	if (cliptrace.fraction < 1.0f)
+		p->numhits++;
 	VectorCopy(cliptrace.endpos, shothit);
 	if ((remainingbounces == r_shadow_bouncegrid_state.settings.maxbounce || r_shadow_bouncegrid_state.settings.includedirectlighting) && p->numpaths < PHOTON_MAX_PATHS)
 	{
@@ -2733,31 +2794,52 @@ static void R_Shadow_BounceGrid_TracePhotons_ShotTask(taskqueue_task_t *t)
 
 static void R_Shadow_BounceGrid_EnqueuePhotons_Task(taskqueue_task_t *t)
 {
-	int i;
-	for (i = 0; i < r_shadow_bouncegrid_state.numphotons; i++)
-		TaskQueue_Setup(r_shadow_bouncegrid_state.photons_tasks + i, NULL, R_Shadow_BounceGrid_TracePhotons_ShotTask, 0, 0, r_shadow_bouncegrid_state.photons + i, NULL);
-	TaskQueue_Setup(&r_shadow_bouncegrid_state.photons_done_task, NULL, TaskQueue_Task_CheckTasksDone, r_shadow_bouncegrid_state.numphotons, 0, r_shadow_bouncegrid_state.photons_tasks, NULL);
+	int i, numtasks;
+	// photons copied from the previous update already have their paths
+	for (i = 0, numtasks = 0; i < r_shadow_bouncegrid_state.numphotons; i++)
+		if (!r_shadow_bouncegrid_state.photons[i].cached)
+			TaskQueue_Setup(r_shadow_bouncegrid_state.photons_tasks + numtasks++, NULL, R_Shadow_BounceGrid_TracePhotons_ShotTask, 0, 0, r_shadow_bouncegrid_state.photons + i, NULL);
+	TaskQueue_Setup(&r_shadow_bouncegrid_state.photons_done_task, NULL, TaskQueue_Task_CheckTasksDone, numtasks, 0, r_shadow_bouncegrid_state.photons_tasks, NULL);
 	if (r_shadow_bouncegrid_threaded.integer)
 	{
-		TaskQueue_Enqueue(r_shadow_bouncegrid_state.numphotons, r_shadow_bouncegrid_state.photons_tasks);
+		TaskQueue_Enqueue(numtasks, r_shadow_bouncegrid_state.photons_tasks);
 		TaskQueue_Enqueue(1, &r_shadow_bouncegrid_state.photons_done_task);
 	}
 	else
 	{
 		// when not threaded we still have to report task status
-		for (i = 0; i < r_shadow_bouncegrid_state.numphotons; i++)
+		for (i = 0; i < numtasks; i++)
 			r_shadow_bouncegrid_state.photons_tasks[i].func(r_shadow_bouncegrid_state.photons_tasks + i);
 		r_shadow_bouncegrid_state.photons_done_task.done = 1;
 	}
 	t->done = 1;
 }
 
+// tallies what the photons of this update cost for r_speeds
+static void R_Shadow_BounceGrid_CountPhotons(void)
+{
+	int i;
+	const r_shadow_bouncegrid_photon_t *p;
+	for (i = 0, p = r_shadow_bouncegrid_state.photons;i < r_shadow_bouncegrid_state.numphotons;i++, p++)
+	{
+		r_refdef.stats[r_stat_bouncegrid_splats] += p->numpaths;
+		if (p->cached)
+			continue;
+		r_refdef.stats[r_stat_bouncegrid_traces] += p->numtraces;
+		r_refdef.stats[r_stat_bouncegrid_hits] += p->numhits;
+		r_refdef.stats[r_stat_bouncegrid_bounces] += p->numtraces - 1;
+	}
+}
+
+static unsigned int r_shadow_bouncegrid_updatecounter;
+
 void R_Shadow_UpdateBounceGridTexture(void)
 {
 	int flag = r_refdef.scene.rtworld ? LIGHTFLAG_REALTIMEMODE : LIGHTFLAG_NORMALMODE;
 	r_shadow_bouncegrid_settings_t settings;
 	qbool enable = false;
 	qbool settingschanged;
+	qbool incremental;
 
 	enable = R_Shadow_BounceGrid_CheckEnable(flag);
 	
@@ -2803,7 +2885,26 @@ void R_Shadow_UpdateBounceGridTexture(void)
 	r_shadow_bouncegrid_state.highpixels_index = 0;
 	r_shadow_bouncegrid_state.highpixels = r_shadow_bouncegrid_state.blurpixels[r_shadow_bouncegrid_state.highpixels_index];
 
-	// set up the tracking of photon data
+	// set up the tracking of photon data, in incremental mode the photons of
+	// the previous update are kept for the lights that do not change
+	incremental = r_shadow_bouncegrid_dynamic_incremental.integer
+		&& !settings.staticmode && settings.rng_seed >= 0 && !settings.hitmodels && !r_shadow_bouncegrid_dynamic_culllightpaths.integer;
+	if (incremental && r_shadow_bouncegrid_state.photons)
+	{
+		r_shadow_bouncegrid_photon_t *prevphotons = r_shadow_bouncegrid_state.prevphotons;
+		r_shadow_bouncegrid_state.prevphotons = r_shadow_bouncegrid_state.photons;
+		r_shadow_bouncegrid_state.prevnumphotons = r_shadow_bouncegrid_state.numphotons;
+		r_shadow_bouncegrid_state.prevupdatenumber = r_shadow_bouncegrid_state.updatenumber;
+		r_shadow_bouncegrid_state.photons = prevphotons;
+	}
+	else if (!incremental && r_shadow_bouncegrid_state.prevphotons)
+	{
+		Mem_Free(r_shadow_bouncegrid_state.prevphotons);
+		r_shadow_bouncegrid_state.prevphotons = NULL;
+		r_shadow_bouncegrid_state.prevnumphotons = 0;
+	}
+	r_shadow_bouncegrid_state.updatenumber = ++r_shadow_bouncegrid_updatecounter;
+	r_shadow_bouncegrid_state.incremental = incremental && r_shadow_bouncegrid_state.prevphotons;
 	if (r_shadow_bouncegrid_state.photons == NULL)
 		r_shadow_bouncegrid_state.photons = (r_shadow_bouncegrid_photon_t *)Mem_Alloc(r_main_mempool, r_shadow_bouncegrid_state.settings.maxphotons * sizeof(r_shadow_bouncegrid_photon_t));
 	if (r_shadow_bouncegrid_state.photons_tasks == NULL)
@@ -2845,6 +2946,7 @@ void R_Shadow_UpdateBounceGridTexture(void)
 	TaskQueue_Enqueue(1, &r_shadow_bouncegrid_state.blurpixels_task);
 
 	TaskQueue_WaitForTaskDone(&r_shadow_bouncegrid_state.blurpixels_task);
+	R_Shadow_BounceGrid_CountPhotons();
 	R_TimeReport("bouncegrid_gen");
 
 	// convert the pixels to lower precision and upload the texture
@@ -3018,6 +3120,388 @@ void R_RTLight_Update(rtlight_t *rtlight, int isstatic, matrix4x4_t *matrix, vec
 	rtlight->cullmaxs[2] = rtlight->shadoworigin[2] + rtlight->radius;
 }
 
+/*
+=============================================================================
+
+COMPILED LIGHT CACHE
+
+Compiling the world lights takes seconds on large maps, so the compiled data
+is saved to <mapname>.rtlightcache and loaded from there the next time the
+map is loaded.  The file is only used with the same world model and compile
+settings, and lights are looked up by everything that affects their compiled
+data, so moved or edited lights are simply compiled again.
+
+=============================================================================
+*/
+
+#define RTLIGHTCACHE_MAGIC "DPRTLC01"
+#define RTLIGHTCACHE_BYTEORDER 0x01020304
+
+typedef struct r_shadow_rtlightcache_header_s
+{
+	char magic[8];
+	int byteorder; // the file is in native byte order, so check it matches
+	unsigned int modelcrc;
+	int numleafs;
+	int numsurfaces;
+	int numtriangles;
+	int numvertices;
+	int settingscrc;
+	int datacrc; // of everything after the header
+	int numlights;
+}
+r_shadow_rtlightcache_header_t;
+
+typedef struct r_shadow_rtlightcache_key_s
+{
+	float origin[3];
+	float radius;
+	float matrix[4][3];
+	int shadow;
+}
+r_shadow_rtlightcache_key_t;
+
+typedef struct r_shadow_rtlightcache_light_s
+{
+	r_shadow_rtlightcache_key_t key;
+	float cullmins[3];
+	float cullmaxs[3];
+	int numsurfaces;
+	int numleafs;
+	int numleafpvsbytes;
+	int numshadowtrispvsbytes;
+	int numlighttrispvsbytes;
+	int shadowmap_receivers;
+	int shadowmap_casters;
+	// shadow mesh, meshnumtriangles is -1 if the light has none
+	int meshnumverts;
+	int meshnumtriangles;
+	int meshsideoffsets[6];
+	int meshsidetotals[6];
+	// followed by the surface list, leaf list, leaf pvs, shadow and light
+	// triangle pvs (padded to 4 bytes), then the mesh vertices and elements
+}
+r_shadow_rtlightcache_light_t;
+
+typedef struct r_shadow_rtlightcache_s
+{
+	// what the loaded file is for
+	qbool opened;
+	char mapname[MAX_QPATH];
+	unsigned int modelcrc;
+	int settingscrc;
+	// lights have been compiled that are not in the file yet
+	qbool dirty;
+	// file contents
+	unsigned char *data;
+	int numlights;
+	const r_shadow_rtlightcache_light_t **lights;
+	unsigned short *keycrcs;
+}
+r_shadow_rtlightcache_t;
+
+static r_shadow_rtlightcache_t r_shadow_rtlightcache;
+
+static void R_Shadow_RTLightCache_Free(void)
+{
+	if (r_shadow_rtlightcache.data)
+		Mem_Free(r_shadow_rtlightcache.data);
+	if (r_shadow_rtlightcache.lights)
+		Mem_Free((void *)r_shadow_rtlightcache.lights);
+	if (r_shadow_rtlightcache.keycrcs)
+		Mem_Free(r_shadow_rtlightcache.keycrcs);
+	memset(&r_shadow_rtlightcache, 0, sizeof(r_shadow_rtlightcache));
+}
+
+static int R_Shadow_RTLightCache_SettingsCRC(void)
+{
+	char settings[256];
+	dpsnprintf(settings, sizeof(settings), "%i %i %i %i %i %i %i", r_shadow_realtime_world_compileportalculling.integer, r_shadow_realtime_world_compilesvbsp.integer, r_shadow_frontsidecasting.integer, r_shadow_sortsurfaces.integer, r_shadow_usebihculling.integer, r_shadow_shadowmapborder, r_shadow_shadowmapmaxsize);
+	return CRC_Block((const unsigned char *)settings, strlen(settings));
+}
+
+static void R_Shadow_RTLightCache_MakeKey(const rtlight_t *rtlight, r_shadow_rtlightcache_key_t *key)
+{
+	memset(key, 0, sizeof(*key));
+	VectorCopy(rtlight->shadoworigin, key->origin);
+	key->radius = rtlight->radius;
+	Matrix4x4_ToArray12FloatGL(&rtlight->matrix_lighttoworld, key->matrix);
+	key->shadow = rtlight->shadow;
+}
+
+static size_t R_Shadow_RTLightCache_LightSize(const r_shadow_rtlightcache_light_t *l)
+{
+	return sizeof(*l)
+		+ sizeof(int) * ((size_t)l->numsurfaces + l->numleafs)
+		+ (((size_t)l->numleafpvsbytes + l->numshadowtrispvsbytes + l->numlighttrispvsbytes + 3) & ~3)
+		+ sizeof(float[3]) * (size_t)l->meshnumverts
+		+ sizeof(int[3]) * (size_t)max(l->meshnumtriangles, 0);
+}
+
+/*
+================
+R_Shadow_RTLightCache_Open
+
+loads the cache file for the current map and settings, if it is not loaded
+already, the lights in it are checked against the world model
+================
+*/
+static void R_Shadow_RTLightCache_Open(model_t *model)
+{
+	char name[MAX_QPATH];
+	fs_offset_t filesize;
+	size_t offset, size;
+	int i;
+	int settingscrc = R_Shadow_RTLightCache_SettingsCRC();
+	const r_shadow_rtlightcache_header_t *header;
+	const r_shadow_rtlightcache_light_t *l;
+
+	if (r_shadow_rtlightcache.opened
+	 && r_shadow_rtlightcache.modelcrc == model->crc
+	 && r_shadow_rtlightcache.settingscrc == settingscrc
+	 && !strcmp(r_shadow_rtlightcache.mapname, cl.worldnamenoextension))
+		return;
+
+	R_Shadow_RTLightCache_Free();
+	r_shadow_rtlightcache.opened = true;
+	r_shadow_rtlightcache.modelcrc = model->crc;
+	r_shadow_rtlightcache.settingscrc = settingscrc;
+	dp_strlcpy(r_shadow_rtlightcache.mapname, cl.worldnamenoextension, sizeof(r_shadow_rtlightcache.mapname));
+
+	dpsnprintf(name, sizeof(name), "%s.rtlightcache", cl.worldnamenoextension);
+	r_shadow_rtlightcache.data = FS_LoadFile(name, r_main_mempool, true, &filesize);
+	if (!r_shadow_rtlightcache.data)
+		return;
+	header = (const r_shadow_rtlightcache_header_t *)r_shadow_rtlightcache.data;
+	if ((size_t)filesize < sizeof(*header)
+	 || memcmp(header->magic, RTLIGHTCACHE_MAGIC, sizeof(header->magic))
+	 || header->byteorder != RTLIGHTCACHE_BYTEORDER
+	 || header->modelcrc != model->crc
+	 || header->numleafs != model->brush.num_leafs
+	 || header->numsurfaces != model->num_surfaces
+	 || header->numtriangles != model->surfmesh.num_triangles
+	 || header->numvertices != model->surfmesh.num_vertices
+	 || header->settingscrc != settingscrc
+	 || header->numlights < 0
+	 || header->datacrc != CRC_Block(r_shadow_rtlightcache.data + sizeof(*header), filesize - sizeof(*header)))
+	{
+		Con_DPrintf("%s is outdated, lights will be compiled again\n", name);
+		Mem_Free(r_shadow_rtlightcache.data);
+		r_shadow_rtlightcache.data = NULL;
+		return;
+	}
+
+	r_shadow_rtlightcache.lights = (const r_shadow_rtlightcache_light_t **)Mem_Alloc(r_main_mempool, max(header->numlights, 1) * sizeof(*r_shadow_rtlightcache.lights));
+	r_shadow_rtlightcache.keycrcs = (unsigned short *)Mem_Alloc(r_main_mempool, max(header->numlights, 1) * sizeof(*r_shadow_rtlightcache.keycrcs));
+	for (i = 0, offset = sizeof(*header);i < header->numlights;i++, offset += size)
+	{
+		l = (const r_shadow_rtlightcache_light_t *)(r_shadow_rtlightcache.data + offset);
+		if (offset + sizeof(*l) > (size_t)filesize
+		 || l->numsurfaces < 0 || l->numsurfaces > model->num_surfaces
+		 || l->numleafs < 0 || l->numleafs > model->brush.num_leafs
+		 || l->numleafpvsbytes != ((model->brush.num_leafs + 7) >> 3)
+		 || l->numshadowtrispvsbytes != ((model->surfmesh.num_triangles + 7) >> 3)
+		 || l->numlighttrispvsbytes != ((model->surfmesh.num_triangles + 7) >> 3)
+		 || l->meshnumverts < 0 || l->meshnumverts > model->surfmesh.num_vertices
+		 // R_Mod_CompileShadowMap allocates the mesh for this many triangles
+		 || l->meshnumtriangles < -1 || l->meshnumtriangles > model->surfmesh.num_triangles + 128
+		 || offset + (size = R_Shadow_RTLightCache_LightSize(l)) > (size_t)filesize)
+			break;
+		r_shadow_rtlightcache.lights[i] = l;
+		r_shadow_rtlightcache.keycrcs[i] = CRC_Block((const unsigned char *)&l->key, sizeof(l->key));
+	}
+	r_shadow_rtlightcache.numlights = i;
+	if (i < header->numlights)
+		Con_DPrintf("%s: light %i is corrupt, ignoring the rest\n", name, i);
+}
+
+/*
+================
+R_Shadow_RTLightCache_Restore
+
+sets up the compiled data of the light from the cache file, returns false if
+it is not in there (or the cache is disabled)
+================
+*/
+static qbool R_Shadow_RTLightCache_Restore(rtlight_t *rtlight, model_t *model)
+{
+	int i;
+	unsigned short keycrc;
+	r_shadow_rtlightcache_key_t key;
+	const r_shadow_rtlightcache_light_t *l = NULL;
+	const unsigned char *in;
+	const int *elements;
+	unsigned char *data;
+	shadowmesh_t *mesh;
+
+	if (!r_shadow_realtime_world_compilecache.integer || !cl.worldnamenoextension[0])
+		return false;
+	R_Shadow_RTLightCache_Open(model);
+	R_Shadow_RTLightCache_MakeKey(rtlight, &key);
+	keycrc = CRC_Block((const unsigned char *)&key, sizeof(key));
+	// the crc only skips most of the keys quickly, the memcmp decides
+	for (i = 0;i < r_shadow_rtlightcache.numlights;i++)
+	{
+		if (r_shadow_rtlightcache.keycrcs[i] == keycrc && !memcmp(&r_shadow_rtlightcache.lights[i]->key, &key, sizeof(key)))
+		{
+			l = r_shadow_rtlightcache.lights[i];
+			break;
+		}
+	}
+	if (!l)
+		return false;
+
+	// check the lists, as these are used to index arrays directly
+	in = (const unsigned char *)(l + 1);
+	for (i = 0;i < l->numsurfaces;i++)
+		if ((unsigned int)((const int *)in)[i] >= (unsigned int)model->num_surfaces)
+			return false;
+	for (i = 0;i < l->numleafs;i++)
+		if ((unsigned int)((const int *)in)[l->numsurfaces + i] >= (unsigned int)model->brush.num_leafs)
+			return false;
+	// and the shadow mesh, which is drawn by the side ranges
+	if (l->meshnumtriangles >= 0)
+	{
+		for (i = 0;i < 6;i++)
+			if (l->meshsideoffsets[i] < 0 || l->meshsidetotals[i] < 0 || l->meshsideoffsets[i] > l->meshnumtriangles - l->meshsidetotals[i])
+				return false;
+		elements = (const int *)(in + sizeof(int) * ((size_t)l->numsurfaces + l->numleafs) + (((size_t)l->numleafpvsbytes + l->numshadowtrispvsbytes + l->numlighttrispvsbytes + 3) & ~3) + sizeof(float[3]) * l->meshnumverts);
+		for (i = 0;i < l->meshnumtriangles * 3;i++)
+			if ((unsigned int)elements[i] >= (unsigned int)l->meshnumverts)
+				return false;
+	}
+
+	// same layout as R_RTLight_Compile, so R_RTLight_Uncompile can free it
+	data = (unsigned char *)Mem_Alloc(r_main_mempool, sizeof(int) * l->numsurfaces + sizeof(int) * l->numleafs + l->numleafpvsbytes + l->numshadowtrispvsbytes + l->numlighttrispvsbytes);
+	memcpy(data, in, sizeof(int) * l->numsurfaces + sizeof(int) * l->numleafs + l->numleafpvsbytes + l->numshadowtrispvsbytes + l->numlighttrispvsbytes);
+	rtlight->static_numsurfaces = l->numsurfaces;
+	rtlight->static_surfacelist = (int *)data;data += sizeof(int) * l->numsurfaces;
+	rtlight->static_numleafs = l->numleafs;
+	rtlight->static_leaflist = (int *)data;data += sizeof(int) * l->numleafs;
+	rtlight->static_numleafpvsbytes = l->numleafpvsbytes;
+	rtlight->static_leafpvs = (unsigned char *)data;data += l->numleafpvsbytes;
+	rtlight->static_numshadowtrispvsbytes = l->numshadowtrispvsbytes;
+	rtlight->static_shadowtrispvs = (unsigned char *)data;data += l->numshadowtrispvsbytes;
+	rtlight->static_numlighttrispvsbytes = l->numlighttrispvsbytes;
+	rtlight->static_lighttrispvs = (unsigned char *)data;data += l->numlighttrispvsbytes;
+	in += sizeof(int) * ((size_t)l->numsurfaces + l->numleafs) + (((size_t)l->numleafpvsbytes + l->numshadowtrispvsbytes + l->numlighttrispvsbytes + 3) & ~3);
+
+	if (l->meshnumtriangles >= 0)
+	{
+		mesh = Mod_ShadowMesh_Alloc(r_main_mempool, l->meshnumverts, l->meshnumtriangles);
+		mesh->numverts = l->meshnumverts;
+		mesh->numtriangles = l->meshnumtriangles;
+		memcpy(mesh->sideoffsets, l->meshsideoffsets, sizeof(mesh->sideoffsets));
+		memcpy(mesh->sidetotals, l->meshsidetotals, sizeof(mesh->sidetotals));
+		memcpy(mesh->vertex3f, in, sizeof(float[3]) * l->meshnumverts);
+		in += sizeof(float[3]) * l->meshnumverts;
+		memcpy(mesh->element3i, in, sizeof(int[3]) * l->meshnumtriangles);
+		rtlight->static_meshchain_shadow_shadowmap = Mod_ShadowMesh_Finish(mesh, true);
+	}
+	rtlight->static_shadowmap_receivers = l->shadowmap_receivers;
+	rtlight->static_shadowmap_casters = l->shadowmap_casters;
+	VectorCopy(l->cullmins, rtlight->cullmins);
+	VectorCopy(l->cullmaxs, rtlight->cullmaxs);
+	return true;
+}
+
+static void R_Shadow_RTLightCache_FillLight(const rtlight_t *rtlight, r_shadow_rtlightcache_light_t *l)
+{
+	const shadowmesh_t *mesh = rtlight->static_meshchain_shadow_shadowmap;
+	memset(l, 0, sizeof(*l));
+	R_Shadow_RTLightCache_MakeKey(rtlight, &l->key);
+	VectorCopy(rtlight->cullmins, l->cullmins);
+	VectorCopy(rtlight->cullmaxs, l->cullmaxs);
+	l->numsurfaces = rtlight->static_numsurfaces;
+	l->numleafs = rtlight->static_numleafs;
+	l->numleafpvsbytes = rtlight->static_numleafpvsbytes;
+	l->numshadowtrispvsbytes = rtlight->static_numshadowtrispvsbytes;
+	l->numlighttrispvsbytes = rtlight->static_numlighttrispvsbytes;
+	l->shadowmap_receivers = rtlight->static_shadowmap_receivers;
+	l->shadowmap_casters = rtlight->static_shadowmap_casters;
+	l->meshnumverts = mesh ? mesh->numverts : 0;
+	l->meshnumtriangles = mesh ? mesh->numtriangles : -1;
+	if (mesh)
+	{
+		memcpy(l->meshsideoffsets, mesh->sideoffsets, sizeof(l->meshsideoffsets));
+		memcpy(l->meshsidetotals, mesh->sidetotals, sizeof(l->meshsidetotals));
+	}
+}
+
+/*
+================
+R_Shadow_RTLightCache_Save
+
+writes all compiled world lights to the cache file of the current map
+================
+*/
+static void R_Shadow_RTLightCache_Save(void)
+{
+	char name[MAX_QPATH];
+	size_t lightindex, range, size;
+	dlight_t *light;
+	rtlight_t *rtlight;
+	model_t *model = r_refdef.scene.worldmodel;
+	r_shadow_rtlightcache_header_t *header;
+	r_shadow_rtlightcache_light_t l;
+	unsigned char *data, *out;
+
+	r_shadow_rtlightcache.dirty = false;
+	if (!model || !r_shadow_rtlightcache.opened || strcmp(r_shadow_rtlightcache.mapname, cl.worldnamenoextension))
+		return;
+
+	// the lights are not necessarily in the same order every time, but
+	// they are compared by their key when loading
+	range = Mem_ExpandableArray_IndexRange(&r_shadow_worldlightsarray); // checked
+	size = sizeof(*header);
+	for (lightindex = 0;lightindex < range;lightindex++)
+	{
+		light = (dlight_t *)Mem_ExpandableArray_RecordAtIndex(&r_shadow_worldlightsarray, lightindex);
+		if (!light || !light->rtlight.compiled)
+			continue;
+		R_Shadow_RTLightCache_FillLight(&light->rtlight, &l);
+		size += R_Shadow_RTLightCache_LightSize(&l);
+	}
+
+	data = (unsigned char *)Mem_Alloc(tempmempool, size);
+	header = (r_shadow_rtlightcache_header_t *)data;
+	memcpy(header->magic, RTLIGHTCACHE_MAGIC, sizeof(header->magic));
+	header->byteorder = RTLIGHTCACHE_BYTEORDER;
+	header->modelcrc = model->crc;
+	header->numleafs = model->brush.num_leafs;
+	header->numsurfaces = model->num_surfaces;
+	header->numtriangles = model->surfmesh.num_triangles;
+	header->numvertices = model->surfmesh.num_vertices;
+	header->settingscrc = r_shadow_rtlightcache.settingscrc;
+	out = data + sizeof(*header);
+	for (lightindex = 0;lightindex < range;lightindex++)
+	{
+		light = (dlight_t *)Mem_ExpandableArray_RecordAtIndex(&r_shadow_worldlightsarray, lightindex);
+		if (!light || !light->rtlight.compiled)
+			continue;
+		rtlight = &light->rtlight;
+		R_Shadow_RTLightCache_FillLight(rtlight, &l);
+		memcpy(out, &l, sizeof(l));
+		out += sizeof(l);
+		// the surface list is followed by the other arrays, as allocated by R_RTLight_Compile
+		memcpy(out, rtlight->static_surfacelist, sizeof(int) * (l.numsurfaces + l.numleafs) + l.numleafpvsbytes + l.numshadowtrispvsbytes + l.numlighttrispvsbytes);
+		out += sizeof(int) * ((size_t)l.numsurfaces + l.numleafs) + (((size_t)l.numleafpvsbytes + l.numshadowtrispvsbytes + l.numlighttrispvsbytes + 3) & ~3);
+		if (l.meshnumtriangles >= 0)
+		{
+			memcpy(out, rtlight->static_meshchain_shadow_shadowmap->vertex3f, sizeof(float[3]) * l.meshnumverts);
+			out += sizeof(float[3]) * l.meshnumverts;
+			memcpy(out, rtlight->static_meshchain_shadow_shadowmap->element3i, sizeof(int[3]) * l.meshnumtriangles);
+			out += sizeof(int[3]) * l.meshnumtriangles;
+		}
+		header->numlights++;
+	}
+	header->datacrc = CRC_Block(data + sizeof(*header), size - sizeof(*header));
+
+	dpsnprintf(name, sizeof(name), "%s.rtlightcache", cl.worldnamenoextension);
+	FS_WriteFile(name, data, size);
+	Mem_Free(data);
+}
+
 // compiles rtlight geometry
 // (undone by R_FreeCompiledRTLight, which R_UpdateLight calls)
 void R_RTLight_Compile(rtlight_t *rtlight)
@@ -3046,7 +3530,11 @@ void R_RTLight_Compile(rtlight_t *rtlight)
 	rtlight->cullmaxs[1] = rtlight->shadoworigin[1] + rtlight->radius;
 	rtlight->cullmaxs[2] = rtlight->shadoworigin[2] + rtlight->radius;
 
-	if (model && model->GetLightInfo)
+	if (model && model->GetLightInfo && R_Shadow_RTLightCache_Restore(rtlight, model))
+	{
+		// loaded from the cache file
+	}
+	else if (model && model->GetLightInfo)
 	{
 		// this variable must be set for the CompileShadowMap code
 		r_shadow_compilingrtlight = rtlight;
@@ -3083,6 +3571,8 @@ void R_RTLight_Compile(rtlight_t *rtlight)
 		R_FrameData_ReturnToMark();
 		// now we're done compiling the rtlight
 		r_shadow_compilingrtlight = NULL;
+		if (r_shadow_realtime_world_compilecache.integer && rtlight->isstatic)
+			r_shadow_rtlightcache.dirty = true;
 	}
 
 
@@ -3394,27 +3884,58 @@ static void R_Shadow_DrawEntityLight(entity_render_t *ent)
 	rsurface.entity = NULL; // used only by R_GetCurrentTexture and RSurf_ActiveModelEntity
 }
 
-static void R_Shadow_PrepareLight(rtlight_t *rtlight)
+typedef struct r_shadow_preparelight_s
 {
-	int i;
-	float f;
-	int numleafs, numsurfaces;
-	int *leaflist, *surfacelist;
+	rtlight_t *rtlight;
+	qbool gather; // passed the checks in R_Shadow_PrepareLight_Begin
+	qbool culled; // R_Shadow_PrepareLight_Gather found nothing visible to light
+	qbool copybuffers; // the light info is in the buffers below rather than compiled data
+
+	// results of R_Shadow_PrepareLight_Gather
+	int numleafs;
+	int *leaflist;
 	unsigned char *leafpvs;
+	int numsurfaces;
+	int *surfacelist;
 	unsigned char *shadowtrispvs;
 	unsigned char *lighttrispvs;
-	//unsigned char *surfacesides;
 	int numlightentities;
 	int numlightentities_noselfshadow;
 	int numshadowentities;
 	int numshadowentities_noselfshadow;
-	// FIXME: bounds check lightentities and shadowentities, etc.
-	static entity_render_t *lightentities[MAX_EDICTS];
-	static entity_render_t *lightentities_noselfshadow[MAX_EDICTS];
-	static entity_render_t *shadowentities[MAX_EDICTS];
-	static entity_render_t *shadowentities_noselfshadow[MAX_EDICTS];
+
+	// buffers written by R_Shadow_PrepareLight_Gather
+	int buffer_numleafpvsbytes;
+	int buffer_numsurfacepvsbytes;
+	int buffer_numtrispvsbytes;
+	int buffer_maxentities;
+	int *buffer_leaflist;
+	unsigned char *buffer_leafpvs;
+	unsigned char *buffer_visitingleafpvs;
+	int *buffer_surfacelist;
+	unsigned char *buffer_surfacepvs;
+	unsigned char *buffer_shadowtrispvs;
+	unsigned char *buffer_lighttrispvs;
+	entity_render_t **lightentities;
+	entity_render_t **lightentities_noselfshadow;
+	entity_render_t **shadowentities;
+	entity_render_t **shadowentities_noselfshadow;
+}
+r_shadow_preparelight_t;
+
+/*
+================
+R_Shadow_PrepareLight_Begin
+
+resets the per frame state of the light and does the cheap culling,
+returns false if the light does not need to be gathered.
+this may compile the light, so it must run on the main thread
+================
+*/
+static qbool R_Shadow_PrepareLight_Begin(rtlight_t *rtlight)
+{
+	float f;
 	qbool nolight;
-	qbool castshadows;
 
 	rtlight->draw = false;
 	rtlight->cached_numlightentities = 0;
@@ -3458,18 +3979,18 @@ static void R_Shadow_PrepareLight(rtlight_t *rtlight)
 
 	// skip if lightstyle is currently off
 	if (VectorLength2(rtlight->currentcolor) < (1.0f / 1048576.0f))
-		return;
+		return false;
 
 	// skip processing on corona-only lights
 	if (nolight)
-		return;
+		return false;
 
 	// skip if the light box is not touching any visible leafs
 	if (r_shadow_culllights_pvs.integer
 		&& r_refdef.scene.worldmodel
 		&& r_refdef.scene.worldmodel->brush.BoxTouchingVisibleLeafs
 		&& !r_refdef.scene.worldmodel->brush.BoxTouchingVisibleLeafs(r_refdef.scene.worldmodel, r_refdef.viewcache.world_leafvisible, rtlight->cullmins, rtlight->cullmaxs))
-		return;
+		return false;
 
 	// skip if the light box is not visible to traceline
 	if (r_shadow_culllights_trace.integer)
@@ -3477,12 +3998,12 @@ static void R_Shadow_PrepareLight(rtlight_t *rtlight)
 		if (rtlight->trace_timer != host.realtime && R_CanSeeBox(rtlight->trace_timer == 0 ? r_shadow_culllights_trace_tempsamples.integer : r_shadow_culllights_trace_samples.integer, r_shadow_culllights_trace_eyejitter.value, r_shadow_culllights_trace_enlarge.value, r_shadow_culllights_trace_expand.value, r_shadow_culllights_trace_pad.value, r_refdef.view.origin, rtlight->cullmins, rtlight->cullmaxs))
 			rtlight->trace_timer = host.realtime;
 		if (host.realtime - rtlight->trace_timer > r_shadow_culllights_trace_delay.value)
-			return;
+			return false;
 	}
 
 	// skip if the light box is off screen
 	if (R_CullFrustum(rtlight->cullmins, rtlight->cullmaxs))
-		return;
+		return false;
 
 	// in the typical case this will be quickly replaced by GetLightInfo
 	VectorCopy(rtlight->cullmins, rtlight->cached_cullmins);
@@ -3492,33 +4013,56 @@ static void R_Shadow_PrepareLight(rtlight_t *rtlight)
 
 	// don't allow lights to be drawn if using r_shadow_bouncegrid 2, except if we're using static bouncegrid where dynamic lights still need to draw
 	if (r_shadow_bouncegrid.integer == 2 && (rtlight->isstatic || !r_shadow_bouncegrid_static.integer))
-		return;
+		return false;
 
+	return true;
+}
+
+/*
+================
+R_Shadow_PrepareLight_Gather
+
+finds the lit leafs, surfaces and triangles of the world and the entities
+that receive light from or cast shadows for the light.
+only writes to the light and p, so lights can be gathered in parallel as
+long as R_Mod_GetLightInfo_SetThreaded has been called for the world
+================
+*/
+static void R_Shadow_PrepareLight_Gather(r_shadow_preparelight_t *p)
+{
+	int i;
+	rtlight_t *rtlight = p->rtlight;
+	int numlightentities;
+	int numlightentities_noselfshadow;
+	int numshadowentities;
+	int numshadowentities_noselfshadow;
+
+	p->culled = true;
+	p->copybuffers = false;
 	if (rtlight->compiled && r_shadow_realtime_world_compile.integer)
 	{
 		// compiled light, world available and can receive realtime lighting
 		// retrieve leaf information
-		numleafs = rtlight->static_numleafs;
-		leaflist = rtlight->static_leaflist;
-		leafpvs = rtlight->static_leafpvs;
-		numsurfaces = rtlight->static_numsurfaces;
-		surfacelist = rtlight->static_surfacelist;
-		//surfacesides = NULL;
-		shadowtrispvs = rtlight->static_shadowtrispvs;
-		lighttrispvs = rtlight->static_lighttrispvs;
+		p->numleafs = rtlight->static_numleafs;
+		p->leaflist = rtlight->static_leaflist;
+		p->leafpvs = rtlight->static_leafpvs;
+		p->numsurfaces = rtlight->static_numsurfaces;
+		p->surfacelist = rtlight->static_surfacelist;
+		p->shadowtrispvs = rtlight->static_shadowtrispvs;
+		p->lighttrispvs = rtlight->static_lighttrispvs;
 	}
 	else if (r_refdef.scene.worldmodel && r_refdef.scene.worldmodel->GetLightInfo)
 	{
 		// dynamic light, world available and can receive realtime lighting
 		// calculate lit surfaces and leafs
-		r_refdef.scene.worldmodel->GetLightInfo(r_refdef.scene.worldentity, rtlight->shadoworigin, rtlight->radius, rtlight->cached_cullmins, rtlight->cached_cullmaxs, r_shadow_buffer_leaflist, r_shadow_buffer_leafpvs, &numleafs, r_shadow_buffer_surfacelist, r_shadow_buffer_surfacepvs, &numsurfaces, r_shadow_buffer_shadowtrispvs, r_shadow_buffer_lighttrispvs, r_shadow_buffer_visitingleafpvs, rtlight->cached_numfrustumplanes, rtlight->cached_frustumplanes, rtlight->shadow == 0);
+		r_refdef.scene.worldmodel->GetLightInfo(r_refdef.scene.worldentity, rtlight->shadoworigin, rtlight->radius, rtlight->cached_cullmins, rtlight->cached_cullmaxs, p->buffer_leaflist, p->buffer_leafpvs, &p->numleafs, p->buffer_surfacelist, p->buffer_surfacepvs, &p->numsurfaces, p->buffer_shadowtrispvs, p->buffer_lighttrispvs, p->buffer_visitingleafpvs, rtlight->cached_numfrustumplanes, rtlight->cached_frustumplanes, rtlight->shadow == 0);
 		R_Shadow_ComputeShadowCasterCullingPlanes(rtlight);
-		leaflist = r_shadow_buffer_leaflist;
-		leafpvs = r_shadow_buffer_leafpvs;
-		surfacelist = r_shadow_buffer_surfacelist;
-		//surfacesides = r_shadow_buffer_surfacesides;
-		shadowtrispvs = r_shadow_buffer_shadowtrispvs;
-		lighttrispvs = r_shadow_buffer_lighttrispvs;
+		p->leaflist = p->buffer_leaflist;
+		p->leafpvs = p->buffer_leafpvs;
+		p->surfacelist = p->buffer_surfacelist;
+		p->shadowtrispvs = p->buffer_shadowtrispvs;
+		p->lighttrispvs = p->buffer_lighttrispvs;
+		p->copybuffers = true;
 		// if the reduced leaf bounds are offscreen, skip it
 		if (R_CullFrustum(rtlight->cached_cullmins, rtlight->cached_cullmaxs))
 			return;
@@ -3526,22 +4070,21 @@ static void R_Shadow_PrepareLight(rtlight_t *rtlight)
 	else
 	{
 		// no world
-		numleafs = 0;
-		leaflist = NULL;
-		leafpvs = NULL;
-		numsurfaces = 0;
-		surfacelist = NULL;
-		//surfacesides = NULL;
-		shadowtrispvs = NULL;
-		lighttrispvs = NULL;
+		p->numleafs = 0;
+		p->leaflist = NULL;
+		p->leafpvs = NULL;
+		p->numsurfaces = 0;
+		p->surfacelist = NULL;
+		p->shadowtrispvs = NULL;
+		p->lighttrispvs = NULL;
 	}
 	// check if light is illuminating any visible leafs
-	if (numleafs)
+	if (p->numleafs)
 	{
-		for (i = 0; i < numleafs; i++)
-			if (r_refdef.viewcache.world_leafvisible[leaflist[i]])
+		for (i = 0; i < p->numleafs; i++)
+			if (r_refdef.viewcache.world_leafvisible[p->leaflist[i]])
 				break;
-		if (i == numleafs)
+		if (i == p->numleafs)
 			return;
 	}
 
@@ -3571,12 +4114,12 @@ static void R_Shadow_PrepareLight(rtlight_t *rtlight)
 			// inside the light box
 			// TODO: check if the surfaces in the model can receive light
 			// so now check if it's in a leaf seen by the light
-			if (r_refdef.scene.worldmodel && r_refdef.scene.worldmodel->brush.BoxTouchingLeafPVS && !r_refdef.scene.worldmodel->brush.BoxTouchingLeafPVS(r_refdef.scene.worldmodel, leafpvs, ent->mins, ent->maxs))
+			if (r_refdef.scene.worldmodel && r_refdef.scene.worldmodel->brush.BoxTouchingLeafPVS && !r_refdef.scene.worldmodel->brush.BoxTouchingLeafPVS(r_refdef.scene.worldmodel, p->leafpvs, ent->mins, ent->maxs))
 				continue;
 			if (ent->flags & RENDER_NOSELFSHADOW)
-				lightentities_noselfshadow[numlightentities_noselfshadow++] = ent;
+				p->lightentities_noselfshadow[numlightentities_noselfshadow++] = ent;
 			else
-				lightentities[numlightentities++] = ent;
+				p->lightentities[numlightentities++] = ent;
 			// since it is lit, it probably also casts a shadow...
 			// about the VectorDistance2 - light emitting entities should not cast their own shadow
 			Matrix4x4_OriginFromMatrix(&ent->matrix, org);
@@ -3589,9 +4132,9 @@ static void R_Shadow_PrepareLight(rtlight_t *rtlight)
 				// RENDER_NOSELFSHADOW entities such as the gun
 				// (very weird, but keeps the player shadow off the gun)
 				if (ent->flags & (RENDER_NOSELFSHADOW | RENDER_EXTERIORMODEL))
-					shadowentities_noselfshadow[numshadowentities_noselfshadow++] = ent;
+					p->shadowentities_noselfshadow[numshadowentities_noselfshadow++] = ent;
 				else
-					shadowentities[numshadowentities++] = ent;
+					p->shadowentities[numshadowentities++] = ent;
 			}
 		}
 		else if (ent->flags & RENDER_SHADOW)
@@ -3600,24 +4143,53 @@ static void R_Shadow_PrepareLight(rtlight_t *rtlight)
 			// cast a shadow...
 			// TODO: check if the surfaces in the model can cast shadow
 			// now check if it is in a leaf seen by the light
-			if (r_refdef.scene.worldmodel && r_refdef.scene.worldmodel->brush.BoxTouchingLeafPVS && !r_refdef.scene.worldmodel->brush.BoxTouchingLeafPVS(r_refdef.scene.worldmodel, leafpvs, ent->mins, ent->maxs))
+			if (r_refdef.scene.worldmodel && r_refdef.scene.worldmodel->brush.BoxTouchingLeafPVS && !r_refdef.scene.worldmodel->brush.BoxTouchingLeafPVS(r_refdef.scene.worldmodel, p->leafpvs, ent->mins, ent->maxs))
 				continue;
 			// about the VectorDistance2 - light emitting entities should not cast their own shadow
 			Matrix4x4_OriginFromMatrix(&ent->matrix, org);
 			if ((ent->flags & RENDER_SHADOW) && model->DrawShadowMap && VectorDistance2(org, rtlight->shadoworigin) > 0.1)
 			{
 				if (ent->flags & (RENDER_NOSELFSHADOW | RENDER_EXTERIORMODEL))
-					shadowentities_noselfshadow[numshadowentities_noselfshadow++] = ent;
+					p->shadowentities_noselfshadow[numshadowentities_noselfshadow++] = ent;
 				else
-					shadowentities[numshadowentities++] = ent;
+					p->shadowentities[numshadowentities++] = ent;
 			}
 		}
 	}
 
+	p->numlightentities = numlightentities;
+	p->numlightentities_noselfshadow = numlightentities_noselfshadow;
+	p->numshadowentities = numshadowentities;
+	p->numshadowentities_noselfshadow = numshadowentities_noselfshadow;
+	p->culled = false;
+}
+
+/*
+================
+R_Shadow_PrepareLight_Finish
+
+stores the gathered lists in frame data and sets up the light for drawing,
+this has to run on the main thread in the same order as the serial path
+================
+*/
+static void R_Shadow_PrepareLight_Finish(r_shadow_preparelight_t *p)
+{
+	int i;
+	rtlight_t *rtlight = p->rtlight;
+	int numsurfaces = p->numsurfaces;
+	int numlightentities = p->numlightentities;
+	int numlightentities_noselfshadow = p->numlightentities_noselfshadow;
+	int numshadowentities = p->numshadowentities;
+	int numshadowentities_noselfshadow = p->numshadowentities_noselfshadow;
+	entity_render_t **lightentities = p->lightentities;
+	entity_render_t **lightentities_noselfshadow = p->lightentities_noselfshadow;
+	entity_render_t **shadowentities = p->shadowentities;
+	entity_render_t **shadowentities_noselfshadow = p->shadowentities_noselfshadow;
+	qbool castshadows;
+
 	// return if there's nothing at all to light
 	if (numsurfaces + numlightentities + numlightentities_noselfshadow == 0)
 		return;
-
 	// count this light in the r_speeds
 	r_refdef.stats[r_stat_lights]++;
 
@@ -3663,20 +4235,20 @@ static void R_Shadow_PrepareLight(rtlight_t *rtlight)
 	rtlight->cached_lightentities_noselfshadow     = (entity_render_t**)R_FrameData_Store(numlightentities_noselfshadow*sizeof(entity_render_t*), (void*)lightentities_noselfshadow);
 	rtlight->cached_shadowentities                 = (entity_render_t**)R_FrameData_Store(numshadowentities*sizeof(entity_render_t*), (void*)shadowentities);
 	rtlight->cached_shadowentities_noselfshadow    = (entity_render_t**)R_FrameData_Store(numshadowentities_noselfshadow*sizeof(entity_render_t *), (void*)shadowentities_noselfshadow);
-	if (shadowtrispvs == r_shadow_buffer_shadowtrispvs)
+	if (p->copybuffers)
 	{
 		int numshadowtrispvsbytes = ((r_refdef.scene.worldmodel->surfmesh.num_triangles + 7) >> 3);
 		int numlighttrispvsbytes = ((r_refdef.scene.worldmodel->surfmesh.num_triangles + 7) >> 3);
-		rtlight->cached_shadowtrispvs                  =   (unsigned char *)R_FrameData_Store(numshadowtrispvsbytes, shadowtrispvs);
-		rtlight->cached_lighttrispvs                   =   (unsigned char *)R_FrameData_Store(numlighttrispvsbytes, lighttrispvs);
-		rtlight->cached_surfacelist                    =              (int*)R_FrameData_Store(numsurfaces*sizeof(int), (void*)surfacelist);
+		rtlight->cached_shadowtrispvs                  =   (unsigned char *)R_FrameData_Store(numshadowtrispvsbytes, p->shadowtrispvs);
+		rtlight->cached_lighttrispvs                   =   (unsigned char *)R_FrameData_Store(numlighttrispvsbytes, p->lighttrispvs);
+		rtlight->cached_surfacelist                    =              (int*)R_FrameData_Store(numsurfaces*sizeof(int), (void*)p->surfacelist);
 	}
 	else
 	{
 		// compiled light data
-		rtlight->cached_shadowtrispvs = shadowtrispvs;
-		rtlight->cached_lighttrispvs = lighttrispvs;
-		rtlight->cached_surfacelist = surfacelist;
+		rtlight->cached_shadowtrispvs = p->shadowtrispvs;
+		rtlight->cached_lighttrispvs = p->lighttrispvs;
+		rtlight->cached_surfacelist = p->surfacelist;
 	}
 
 	if (R_Shadow_ShadowMappingEnabled())
@@ -3697,6 +4269,36 @@ static void R_Shadow_PrepareLight(rtlight_t *rtlight)
 	}
 }
 
+static void R_Shadow_PrepareLight(rtlight_t *rtlight)
+{
+	// FIXME: bounds check lightentities and shadowentities, etc.
+	static entity_render_t *lightentities[MAX_EDICTS];
+	static entity_render_t *lightentities_noselfshadow[MAX_EDICTS];
+	static entity_render_t *shadowentities[MAX_EDICTS];
+	static entity_render_t *shadowentities_noselfshadow[MAX_EDICTS];
+	r_shadow_preparelight_t p;
+
+	if (!R_Shadow_PrepareLight_Begin(rtlight))
+		return;
+
+	memset(&p, 0, sizeof(p));
+	p.rtlight = rtlight;
+	p.buffer_leaflist = r_shadow_buffer_leaflist;
+	p.buffer_leafpvs = r_shadow_buffer_leafpvs;
+	p.buffer_visitingleafpvs = r_shadow_buffer_visitingleafpvs;
+	p.buffer_surfacelist = r_shadow_buffer_surfacelist;
+	p.buffer_surfacepvs = r_shadow_buffer_surfacepvs;
+	p.buffer_shadowtrispvs = r_shadow_buffer_shadowtrispvs;
+	p.buffer_lighttrispvs = r_shadow_buffer_lighttrispvs;
+	p.lightentities = lightentities;
+	p.lightentities_noselfshadow = lightentities_noselfshadow;
+	p.shadowentities = shadowentities;
+	p.shadowentities_noselfshadow = shadowentities_noselfshadow;
+	R_Shadow_PrepareLight_Gather(&p);
+	if (!p.culled)
+		R_Shadow_PrepareLight_Finish(&p);
+}
+
 static void R_Shadow_DrawLightShadowMaps(rtlight_t *rtlight)
 {
 	int i;
@@ -4027,6 +4629,128 @@ static qbool R_Shadow_PrepareLights_AddSceneLight(rtlight_t *rtlight)
 	return true;
 }
 
+// lights are prepared in batches of this many, each with its own buffers
+#define R_SHADOW_PREPARELIGHTS_BATCH 32
+
+static r_shadow_preparelight_t r_shadow_preparelights_slots[R_SHADOW_PREPARELIGHTS_BATCH];
+static int r_shadow_preparelights_numslots;
+static taskqueue_task_t r_shadow_preparelights_tasks[R_SHADOW_PREPARELIGHTS_BATCH];
+static taskqueue_task_t r_shadow_preparelights_done_task;
+
+static void R_Shadow_PrepareLights_EnlargeSlot(r_shadow_preparelight_t *p)
+{
+	model_t *model = r_refdef.scene.worldmodel;
+	int numleafpvsbytes = (((model->brush.num_leafs + 7) >> 3) + 255) & ~255;
+	int numsurfacepvsbytes = (((model->num_surfaces + 7) >> 3) + 255) & ~255;
+	int numtrispvsbytes = (((model->surfmesh.num_triangles + 7) >> 3) + 255) & ~255;
+	if (p->buffer_numleafpvsbytes < numleafpvsbytes)
+	{
+		p->buffer_numleafpvsbytes = numleafpvsbytes;
+		p->buffer_visitingleafpvs = (unsigned char *)Mem_Realloc(r_main_mempool, p->buffer_visitingleafpvs, numleafpvsbytes);
+		p->buffer_leafpvs = (unsigned char *)Mem_Realloc(r_main_mempool, p->buffer_leafpvs, numleafpvsbytes);
+		p->buffer_leaflist = (int *)Mem_Realloc(r_main_mempool, p->buffer_leaflist, numleafpvsbytes * 8 * sizeof(*p->buffer_leaflist));
+	}
+	if (p->buffer_numsurfacepvsbytes < numsurfacepvsbytes)
+	{
+		p->buffer_numsurfacepvsbytes = numsurfacepvsbytes;
+		p->buffer_surfacepvs = (unsigned char *)Mem_Realloc(r_main_mempool, p->buffer_surfacepvs, numsurfacepvsbytes);
+		p->buffer_surfacelist = (int *)Mem_Realloc(r_main_mempool, p->buffer_surfacelist, numsurfacepvsbytes * 8 * sizeof(*p->buffer_surfacelist));
+	}
+	if (p->buffer_numtrispvsbytes < numtrispvsbytes)
+	{
+		p->buffer_numtrispvsbytes = numtrispvsbytes;
+		p->buffer_shadowtrispvs = (unsigned char *)Mem_Realloc(r_main_mempool, p->buffer_shadowtrispvs, numtrispvsbytes);
+		p->buffer_lighttrispvs = (unsigned char *)Mem_Realloc(r_main_mempool, p->buffer_lighttrispvs, numtrispvsbytes);
+	}
+	if (p->buffer_maxentities < r_refdef.scene.numentities)
+	{
+		p->buffer_maxentities = max(r_refdef.scene.numentities, 256);
+		p->lightentities = (entity_render_t **)Mem_Realloc(r_main_mempool, p->lightentities, p->buffer_maxentities * sizeof(entity_render_t *));
+		p->lightentities_noselfshadow = (entity_render_t **)Mem_Realloc(r_main_mempool, p->lightentities_noselfshadow, p->buffer_maxentities * sizeof(entity_render_t *));
+		p->shadowentities = (entity_render_t **)Mem_Realloc(r_main_mempool, p->shadowentities, p->buffer_maxentities * sizeof(entity_render_t *));
+		p->shadowentities_noselfshadow = (entity_render_t **)Mem_Realloc(r_main_mempool, p->shadowentities_noselfshadow, p->buffer_maxentities * sizeof(entity_render_t *));
+	}
+}
+
+static void R_Shadow_PrepareLights_FreeSlots(void)
+{
+	int i;
+	r_shadow_preparelight_t *p;
+	for (i = 0, p = r_shadow_preparelights_slots;i < R_SHADOW_PREPARELIGHTS_BATCH;i++, p++)
+	{
+		if (p->buffer_visitingleafpvs) Mem_Free(p->buffer_visitingleafpvs);
+		if (p->buffer_leafpvs) Mem_Free(p->buffer_leafpvs);
+		if (p->buffer_leaflist) Mem_Free(p->buffer_leaflist);
+		if (p->buffer_surfacepvs) Mem_Free(p->buffer_surfacepvs);
+		if (p->buffer_surfacelist) Mem_Free(p->buffer_surfacelist);
+		if (p->buffer_shadowtrispvs) Mem_Free(p->buffer_shadowtrispvs);
+		if (p->buffer_lighttrispvs) Mem_Free(p->buffer_lighttrispvs);
+		if (p->lightentities) Mem_Free(p->lightentities);
+		if (p->lightentities_noselfshadow) Mem_Free(p->lightentities_noselfshadow);
+		if (p->shadowentities) Mem_Free(p->shadowentities);
+		if (p->shadowentities_noselfshadow) Mem_Free(p->shadowentities_noselfshadow);
+		memset(p, 0, sizeof(*p));
+	}
+	r_shadow_preparelights_numslots = 0;
+}
+
+static void R_Shadow_PrepareLight_Task(taskqueue_task_t *t)
+{
+	R_Shadow_PrepareLight_Gather((r_shadow_preparelight_t *)t->p[0]);
+	t->done = 1;
+}
+
+/*
+================
+R_Shadow_PrepareLights_Flush
+
+gathers all queued lights on the taskqueue, then finishes them and adds
+them to the scene in the order they were queued
+================
+*/
+static void R_Shadow_PrepareLights_Flush(void)
+{
+	int i, numtasks = 0;
+	r_shadow_preparelight_t *p;
+	for (i = 0, p = r_shadow_preparelights_slots;i < r_shadow_preparelights_numslots;i++, p++)
+		if (p->gather)
+			TaskQueue_Setup(r_shadow_preparelights_tasks + numtasks++, NULL, R_Shadow_PrepareLight_Task, 0, 0, p, NULL);
+	if (numtasks)
+	{
+		R_Mod_GetLightInfo_SetThreaded(r_refdef.scene.worldentity);
+		TaskQueue_Setup(&r_shadow_preparelights_done_task, NULL, TaskQueue_Task_CheckTasksDone, numtasks, 0, r_shadow_preparelights_tasks, NULL);
+		TaskQueue_Enqueue(numtasks, r_shadow_preparelights_tasks);
+		TaskQueue_Enqueue(1, &r_shadow_preparelights_done_task);
+		TaskQueue_WaitForTaskDone(&r_shadow_preparelights_done_task);
+		R_Mod_GetLightInfo_SetThreaded(NULL);
+	}
+	for (i = 0, p = r_shadow_preparelights_slots;i < r_shadow_preparelights_numslots;i++, p++)
+	{
+		if (p->gather && !p->culled)
+			R_Shadow_PrepareLight_Finish(p);
+		R_Shadow_PrepareLights_AddSceneLight(p->rtlight);
+	}
+	r_shadow_preparelights_numslots = 0;
+}
+
+static void R_Shadow_PrepareLights_Queue(rtlight_t *rtlight, qbool threaded)
+{
+	r_shadow_preparelight_t *p;
+	if (!threaded)
+	{
+		R_Shadow_PrepareLight(rtlight);
+		R_Shadow_PrepareLights_AddSceneLight(rtlight);
+		return;
+	}
+	p = r_shadow_preparelights_slots + r_shadow_preparelights_numslots++;
+	p->rtlight = rtlight;
+	p->gather = R_Shadow_PrepareLight_Begin(rtlight);
+	if (p->gather)
+		R_Shadow_PrepareLights_EnlargeSlot(p);
+	if (r_shadow_preparelights_numslots == R_SHADOW_PREPARELIGHTS_BATCH)
+		R_Shadow_PrepareLights_Flush();
+}
+
 void R_Shadow_DrawLightSprites(void);
 void R_Shadow_PrepareLights(void)
 {
@@ -4036,6 +4760,8 @@ void R_Shadow_PrepareLights(void)
 	dlight_t *light;
 	size_t range;
 	float f;
+	// svbsp and portal culling of dynamic lights use global state
+	qbool threaded = r_shadow_preparelights_threaded.integer && !r_shadow_realtime_dlight_svbspculling.integer && !r_shadow_realtime_dlight_portalculling.integer;
 
 	int shadowmapborder = bound(1, r_shadow_shadowmapping_bordersize.integer, 16);
 	int shadowmaptexturesize = bound(256, r_shadow_shadowmapping_texturesize.integer, (int)vid.maxtexturesize_2d);
@@ -4115,18 +4841,12 @@ void R_Shadow_PrepareLights(void)
 	{
 		light = (dlight_t *)Mem_ExpandableArray_RecordAtIndex(&r_shadow_worldlightsarray, lightindex);
 		if (light && (light->flags & flag))
-		{
-			R_Shadow_PrepareLight(&light->rtlight);
-			R_Shadow_PrepareLights_AddSceneLight(&light->rtlight);
-		}
+			R_Shadow_PrepareLights_Queue(&light->rtlight, threaded);
 	}
 	if (r_refdef.scene.rtdlight)
 	{
 		for (lnum = 0; lnum < r_refdef.scene.numlights; lnum++)
-		{
-			R_Shadow_PrepareLight(r_refdef.scene.lights[lnum]);
-			R_Shadow_PrepareLights_AddSceneLight(r_refdef.scene.lights[lnum]);
-		}
+			R_Shadow_PrepareLights_Queue(r_refdef.scene.lights[lnum], threaded);
 	}
 	else if (gl_flashblend.integer)
 	{
@@ -4137,6 +4857,11 @@ void R_Shadow_PrepareLights(void)
 			VectorScale(rtlight->color, f, rtlight->currentcolor);
 		}
 	}
+	R_Shadow_PrepareLights_Flush();
+
+	// save the world lights compiled this frame for the next time the map is loaded
+	if (r_shadow_rtlightcache.dirty)
+		R_Shadow_RTLightCache_Save();
 
 	// when debugging a single light, we still want to run the prepare, so we only replace the light list afterward...
 	if (r_shadow_debuglight.integer >= 0)
@@ -83,8 +83,11 @@ typedef struct r_shadow_bouncegrid_photon_s
 	float color[3];
 	float bounceminimumintensity2;
 	float startrefractiveindex;
+	qbool cached; // copied from the previous update, does not need tracing
 
 	// results
+	int numtraces;
+	int numhits;
 	int numpaths;
 	r_shadow_bouncegrid_photon_path_t paths[PHOTON_MAX_PATHS];
 }
@@ -121,6 +124,12 @@ typedef struct r_shadow_bouncegrid_state_s
 								// describe the photons we intend to shoot for threaded dispatch
 	int numphotons; // number of photons to shoot this frame, always <= settings.maxphotons
 	r_shadow_bouncegrid_photon_t *photons; // describes the photons being shot this frame
+	// photons of the previous update, unchanged lights copy theirs from here
+	qbool incremental;
+	unsigned int updatenumber;
+	unsigned int prevupdatenumber;
+	int prevnumphotons;
+	r_shadow_bouncegrid_photon_t *prevphotons;
 
 	// tasks
 	taskqueue_task_t cleartex_task; // clears the highpixels array
@@ -86,6 +86,7 @@ const char *r_stat_name[r_stat_count] =
 	"animcache_shape_count",
 	"animcache_shape_vertices",
 	"animcache_shape_maxvertices",
+	"animcache_shared_count",
 	"batch_batches",
 	"batch_withgaps",
 	"batch_surfaces",
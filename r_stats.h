@@ -67,6 +67,7 @@ typedef enum r_stat_e
 	r_stat_animcache_shape_count,
 	r_stat_animcache_shape_vertices,
 	r_stat_animcache_shape_maxvertices,
+	r_stat_animcache_shared_count,
 	r_stat_batch_batches,
 	r_stat_batch_withgaps,
 	r_stat_batch_surfaces,
@@ -480,6 +480,9 @@ void R_SkinFrame_Purge(void);
 skinframe_t *R_SkinFrame_FindNextByName( skinframe_t *last, const char *name );
 skinframe_t *R_SkinFrame_Find(const char *name, int textureflags, int comparewidth, int compareheight, int comparecrc, qbool add);
 skinframe_t *R_SkinFrame_LoadExternal(const char *name, int textureflags, qbool complain, qbool fallbacknotexture);
+void R_SkinFrame_PrefetchExternal(const char *name, int textureflags, qbool complain);
+int R_SkinFrame_PrefetchRoom(void);
+void R_SkinFrame_FinishPrefetch(void);
 skinframe_t *R_SkinFrame_LoadExternal_SkinFrame(skinframe_t *skinframe, const char *name, int textureflags, qbool complain, qbool fallbacknotexture);
 skinframe_t *R_SkinFrame_LoadInternalBGRA(const char *name, int textureflags, const unsigned char *skindata, int width, int height, int comparewidth, int compareheight, int comparecrc, qbool sRGB);
 skinframe_t *R_SkinFrame_LoadInternalQuake(const char *name, int textureflags, int loadpantsandshirt, int loadglowtexture, const unsigned char *skindata, int width, int height);
@@ -499,6 +502,7 @@ void R_DrawExplosions(void);
 
 qbool R_CullFrustum(const vec3_t mins, const vec3_t maxs);
 qbool R_CullBox(const vec3_t mins, const vec3_t maxs, int numplanes, const mplane_t *planes);
+int R_CullFrustum4(const float *boxes, int stride, int index);
 qbool R_CanSeeBox(int numsamples, vec_t eyejitter, vec_t entboxenlarge, vec_t entboxexpand, vec_t pad, vec3_t eye, vec3_t entboxmins, vec3_t entboxmaxs);
 
 #include "r_modules.h"
@@ -932,6 +936,7 @@ extern cvar_t r_transparent_useplanardistance;
 extern cvar_t r_transparent_sortarraysize;
 extern cvar_t r_transparent_sortmindist;
 extern cvar_t r_transparent_sortmaxdist;
+extern cvar_t r_transparent_sortbatches;
 
 extern qbool r_shadow_usingdeferredprepass;
 extern rtexture_t *r_shadow_attenuationgradienttexture;
@@ -977,6 +982,7 @@ void R_DecalSystem_Reset(decalsystem_t *decalsystem);
 void R_Shadow_UpdateBounceGridTexture(void);
 void R_DrawPortals(void);
 void R_BuildLightMap(const entity_render_t *ent, msurface_t *surface, int combine);
+void R_BuildLightMaps(const entity_render_t *ent, int numsurfaces, const msurface_t **surfacelist, int combine);
 void R_Water_AddWaterPlane(msurface_t *surface, int entno);
 int R_Shadow_GetRTLightInfo(unsigned int lightindex, float *origin, float *radius, float *color);
 dp_font_t *FindFont(const char *title, qbool allocate_new);
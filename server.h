@@ -415,6 +415,7 @@ extern cvar_t sv_allowdownloads_dlcache;
 extern cvar_t sv_allowdownloads_inarchive;
 extern cvar_t sv_areagrid_link_SOLID_NOT;
 extern cvar_t sv_areagrid_mingridsize;
+extern cvar_t sv_areagrid_tree;
 extern cvar_t sv_checkforpacketsduringsleep;
 extern cvar_t sv_clmovement_enable;
 extern cvar_t sv_clmovement_minping;
@@ -476,11 +477,14 @@ extern cvar_t sv_maxrate;
 extern cvar_t sv_maxspeed;
 extern cvar_t sv_maxvelocity;
 extern cvar_t sv_nostep;
+extern cvar_t sv_physics_prepass;
 extern cvar_t sv_playerphysicsqc;
 extern cvar_t sv_progs;
 extern cvar_t sv_protocolname;
 extern cvar_t sv_random_seed;
+extern cvar_t sv_replay_quit;
 extern cvar_t host_limitlocal;
+extern cvar_t sv_save_binary;
 extern cvar_t sv_sound_land;
 extern cvar_t sv_sound_watersplash;
 extern cvar_t sv_stepheight;
@@ -570,6 +574,7 @@ int SV_GenericHitSuperContentsMask(const prvm_edict_t *edict);
 trace_t SV_TraceBox(const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int type, prvm_edict_t *passedict, int hitsupercontentsmask, int skipsupercontentsmask, int skipmaterialflagsmask, float extend);
 trace_t SV_TraceLine(const vec3_t start, const vec3_t end, int type, prvm_edict_t *passedict, int hitsupercontentsmask, int skipsupercontentsmask, int skipmaterialflagsmask, float extend);
 trace_t SV_TracePoint(const vec3_t start, int type, prvm_edict_t *passedict, int hitsupercontentsmask, int skipsupercontentsmask, int skipmaterialflagsmask);
+void SV_TraceLineBatch(int numtraces, const vec3_t *starts, const vec3_t *ends, int type, prvm_edict_t *passedict, int hitsupercontentsmask, int skipsupercontentsmask, int skipmaterialflagsmask, float extend, trace_t *traces);
 int SV_EntitiesInBox(const vec3_t mins, const vec3_t maxs, int maxedicts, prvm_edict_t **resultedicts);
 
 qbool SV_CanSeeBox(int numsamples, vec_t eyejitter, vec_t enlarge, vec_t entboxexpand, vec3_t eye, vec3_t entboxmins, vec3_t entboxmaxs);
@@ -611,6 +616,11 @@ void VM_SV_UpdateCustomStats(client_t *client, prvm_edict_t *ent, sizebuf_t *msg
 void SV_Name(int clientnum);
 void SV_InitOperatorCommands(void);
 
+/// binary savegames start with the magic and then the menu comment padded
+/// with zeros to SAVEGAME_COMMENT_LENGTH+1 bytes, never compressed
+#define SAVEGAME_BINARY_MAGIC "DPSAVEB"
+#define SAVEGAME_BINARY_MAGICSIZE 8
+
 void SV_Savegame_to(prvm_prog_t *prog, const char *name);
 void SV_Savegame_f(cmd_state_t *cmd);
 void SV_Loadgame_f(cmd_state_t *cmd);
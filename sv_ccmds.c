@@ -1663,6 +1663,9 @@ void SV_InitOperatorCommands(void)
 	Cmd_AddCommand(CF_SHARED, "viewnext", SV_Viewnext_f, "change to next animation frame of viewthing entity in current level");
 	Cmd_AddCommand(CF_SHARED, "viewprev", SV_Viewprev_f, "change to previous animation frame of viewthing entity in current level");
 	Cmd_AddCommand(CF_SHARED, "maxplayers", SV_MaxPlayers_f, "sets limit on how many players (or bots) may be connected to the server at once");
+	Cmd_AddCommand(CF_SERVER, "sv_record", SV_Record_f, "record the server session starting with the next map (client input, console commands and frame times) for sv_replay");
+	Cmd_AddCommand(CF_SERVER, "sv_stoprecord", SV_StopRecord_f, "stop recording the server session");
+	Cmd_AddCommand(CF_SERVER, "sv_replay", SV_Replay_f, "run a session recorded with sv_record as fast as possible, reporting tick times and whether the state still matches the recording");
 	host.hook.SV_SendCvar = SV_SendCvar_f;
 
 	// commands that do not have automatic forwarding from cmd_local, these are internal details of the network protocol and not of interest to users (if they know what they are doing they can still use a generic "cmd prespawn" or similar)
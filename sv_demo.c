@@ -97,3 +97,720 @@ void SV_WriteNetnameIntoDemo(client_t *client)
 	MSG_WriteString(&buf, "\n");
 	SV_WriteDemoMessage(client, &buf, false);
 }
+
+/*
+===============================================================================
+
+SERVER REPLAY
+
+records everything that feeds into the server simulation (client messages,
+client connects and drops, server console commands, the frame times, the
+SV_PausedTic calls and the random seed) so that the session can be run again on a dedicated server as
+fast as possible, for benchmarking physics and QC changes and catching
+determinism regressions
+
+===============================================================================
+*/
+
+#define SV_REPLAY_MAGIC "DPSVRPL1"
+
+// event types in the replay stream, each is followed by the host realtime
+// it happened at (the edict reuse rules depend on it)
+#define SV_REPLAY_COMMAND	'X' // string: console command
+#define SV_REPLAY_CONNECT	'C' // byte: client slot
+#define SV_REPLAY_DROP		'D' // byte: client slot, byte: leaving
+#define SV_REPLAY_MESSAGE	'M' // byte: client slot, long: length, data
+#define SV_REPLAY_PHYSICS	'P' // double: frametime, long: state checksum after the frame
+#define SV_REPLAY_ENDFRAME	'E' // client messages were sent
+#define SV_REPLAY_PAUSEDTIC	'T' // double: seconds paused, SV_PausedTic ran after the frame
+
+extern cvar_t sv_threaded;
+
+static qfile_t *sv_record_file;
+static char sv_record_pending[MAX_QPATH];
+static qbool sv_record_clearseed;
+static int sv_record_frames;
+static unsigned char sv_record_bufdata[NET_MAXMESSAGE + 64];
+
+// a cvar set by the replay, with the value it gets back afterwards
+typedef struct sv_replay_savedcvar_s
+{
+	struct sv_replay_savedcvar_s *next;
+	cvar_t *var;
+	char *string;
+}
+sv_replay_savedcvar_t;
+
+typedef struct sv_replay_s
+{
+	qbool running;
+	char filename[MAX_QPATH];
+	char ticklog[MAX_QPATH];
+	unsigned char *data;
+	sizebuf_t buf;
+	int frames;
+	int mismatches;
+	int firstmismatch;
+	unsigned int checksum;
+	double physicstime;
+	double starttime;
+	float *ticks;
+	int maxticks;
+	sv_replay_savedcvar_t *savedcvars;
+}
+sv_replay_t;
+
+static sv_replay_t sv_replay;
+
+static void SV_Replay_SaveCvar(cvar_t *var)
+{
+	sv_replay_savedcvar_t *saved;
+	for (saved = sv_replay.savedcvars;saved;saved = saved->next)
+		if (saved->var == var)
+			return;
+	saved = (sv_replay_savedcvar_t *)Mem_Alloc(sv_mempool, sizeof(*saved));
+	saved->var = var;
+	saved->string = Mem_strdup(sv_mempool, var->string);
+	saved->next = sv_replay.savedcvars;
+	sv_replay.savedcvars = saved;
+}
+
+static void SV_Replay_RestoreCvars(void)
+{
+	sv_replay_savedcvar_t *saved;
+	while ((saved = sv_replay.savedcvars))
+	{
+		sv_replay.savedcvars = saved->next;
+		Cvar_SetQuick(saved->var, saved->string);
+		Mem_Free(saved->string);
+		Mem_Free(saved);
+	}
+}
+
+static void SV_Replay_WriteDouble(sizebuf_t *sb, double d)
+{
+	union { double d; unsigned long long u; } v;
+	v.d = d;
+	MSG_WriteLong(sb, (int)(v.u & 0xFFFFFFFFu));
+	MSG_WriteLong(sb, (int)(v.u >> 32));
+}
+
+static double SV_Replay_ReadDouble(sizebuf_t *sb)
+{
+	union { double d; unsigned long long u; } v;
+	v.u = (unsigned int)MSG_ReadLong(sb);
+	v.u |= (unsigned long long)(unsigned int)MSG_ReadLong(sb) << 32;
+	return v.d;
+}
+
+static unsigned int SV_Replay_Hash(unsigned int h, const void *data, size_t size)
+{
+	const unsigned char *b = (const unsigned char *)data;
+	size_t i;
+	// FNV-1a
+	for (i = 0;i < size;i++)
+		h = (h ^ b[i]) * 16777619u;
+	return h;
+}
+
+/*
+================
+SV_Replay_Checksum
+
+hashes the physics relevant state of every edict, this is what a replay
+compares against the recording after each frame
+================
+*/
+static unsigned int SV_Replay_Checksum(void)
+{
+	prvm_prog_t *prog = SVVM_prog;
+	unsigned int h = 2166136261u;
+	int i;
+	prvm_edict_t *ent;
+	prvm_vec_t v[8];
+
+	h = SV_Replay_Hash(h, &sv.time, sizeof(sv.time));
+	h = SV_Replay_Hash(h, &prog->num_edicts, sizeof(prog->num_edicts));
+	for (i = 0, ent = prog->edicts;i < prog->num_edicts;i++, ent = PRVM_NEXT_EDICT(ent))
+	{
+		h = SV_Replay_Hash(h, &ent->free, sizeof(ent->free));
+		if (ent->free)
+			continue;
+		h = SV_Replay_Hash(h, PRVM_serveredictvector(ent, origin), sizeof(prvm_vec3_t));
+		h = SV_Replay_Hash(h, PRVM_serveredictvector(ent, velocity), sizeof(prvm_vec3_t));
+		h = SV_Replay_Hash(h, PRVM_serveredictvector(ent, angles), sizeof(prvm_vec3_t));
+		h = SV_Replay_Hash(h, PRVM_serveredictvector(ent, avelocity), sizeof(prvm_vec3_t));
+		v[0] = PRVM_serveredictfloat(ent, flags);
+		v[1] = PRVM_serveredictfloat(ent, movetype);
+		v[2] = PRVM_serveredictfloat(ent, solid);
+		v[3] = PRVM_serveredictfloat(ent, modelindex);
+		v[4] = PRVM_serveredictfloat(ent, frame);
+		v[5] = PRVM_serveredictfloat(ent, nextthink);
+		v[6] = PRVM_serveredictfloat(ent, effects);
+		v[7] = PRVM_serveredictedict(ent, groundentity);
+		h = SV_Replay_Hash(h, v, sizeof(v));
+	}
+	return h;
+}
+
+static sizebuf_t *SV_Record_BeginEvent(int type)
+{
+	static sizebuf_t buf;
+	buf.data = sv_record_bufdata;
+	buf.maxsize = sizeof(sv_record_bufdata);
+	SZ_Clear(&buf);
+	MSG_WriteByte(&buf, type);
+	SV_Replay_WriteDouble(&buf, host.realtime);
+	return &buf;
+}
+
+static void SV_Record_EndEvent(sizebuf_t *buf)
+{
+	FS_Write(sv_record_file, buf->data, buf->cursize);
+}
+
+/*
+================
+SV_Record_Stop
+================
+*/
+static void SV_Record_Stop(void)
+{
+	if (!sv_record_file)
+		return;
+	FS_Close(sv_record_file);
+	sv_record_file = NULL;
+	Con_Printf("Stopped server recording (%i frames)\n", sv_record_frames);
+	if (sv_record_clearseed)
+		Cvar_SetQuick(&sv_random_seed, "");
+	sv_record_clearseed = false;
+}
+
+static void SV_Replay_Finish(void)
+{
+	int i, j;
+	float t;
+	qfile_t *f;
+
+	if (!sv_replay.running)
+		return;
+	sv_replay.running = false;
+	SV_Replay_RestoreCvars();
+
+	if (sv_replay.frames && sv_replay.ticklog[0] && (f = FS_OpenRealFile(sv_replay.ticklog, "wb", false)))
+	{
+		for (i = 0;i < sv_replay.frames;i++)
+			FS_Printf(f, "%i %.4f\n", i + 1, sv_replay.ticks[i]);
+		FS_Close(f);
+	}
+
+	if (sv_replay.frames)
+	{
+		// sort the tick times for the median and 99th percentile
+		for (i = 1;i < sv_replay.frames;i++)
+		{
+			t = sv_replay.ticks[i];
+			for (j = i;j > 0 && sv_replay.ticks[j - 1] > t;j--)
+				sv_replay.ticks[j] = sv_replay.ticks[j - 1];
+			sv_replay.ticks[j] = t;
+		}
+		Con_Printf("Replay of %s: %i frames in %.3f seconds (%.3f in physics), tick min %.3fms median %.3fms 99%% %.3fms max %.3fms\n",
+			sv_replay.filename, sv_replay.frames, Sys_DirtyTime() - sv_replay.starttime, sv_replay.physicstime,
+			sv_replay.ticks[0], sv_replay.ticks[sv_replay.frames / 2], sv_replay.ticks[(int)(sv_replay.frames * 0.99)], sv_replay.ticks[sv_replay.frames - 1]);
+	}
+	else
+		Con_Printf("Replay of %s: no frames\n", sv_replay.filename);
+	if (sv_replay.mismatches)
+		Con_Printf(CON_WARN "Replay state checksum %08x, %i frames differ from the recording (first at frame %i)\n", sv_replay.checksum, sv_replay.mismatches, sv_replay.firstmismatch);
+	else
+		Con_Printf("Replay state checksum %08x, all frames match the recording\n", sv_replay.checksum);
+
+	if (sv_replay.data)
+		Mem_Free(sv_replay.data);
+	if (sv_replay.ticks)
+		Mem_Free(sv_replay.ticks);
+	sv_replay.data = NULL;
+	sv_replay.ticks = NULL;
+
+	if (sv_replay_quit.integer)
+		Cbuf_AddText(cmd_local, "\nquit\n");
+}
+
+static void SV_Replay_LogTick(float ms)
+{
+	if (sv_replay.frames >= sv_replay.maxticks)
+	{
+		float *oldticks = sv_replay.ticks;
+		sv_replay.maxticks = max(sv_replay.maxticks * 2, 4096);
+		sv_replay.ticks = (float *)Mem_Alloc(sv_mempool, sv_replay.maxticks * sizeof(*sv_replay.ticks));
+		if (oldticks)
+		{
+			memcpy(sv_replay.ticks, oldticks, sv_replay.frames * sizeof(*sv_replay.ticks));
+			Mem_Free(oldticks);
+		}
+	}
+	sv_replay.ticks[sv_replay.frames++] = ms;
+	sv_replay.physicstime += ms * 0.001;
+}
+
+/*
+================
+SV_Replay_SpawnServer
+
+called by SV_SpawnServer just before the new level is loaded, ends any
+recording or replay of the previous level and starts a pending recording
+================
+*/
+void SV_Replay_SpawnServer(const char *map)
+{
+	sizebuf_t buf;
+	cvar_t *var;
+	char name[MAX_QPATH], buf1[MAX_INPUTLINE], buf2[MAX_INPUTLINE], text[MAX_INPUTLINE * 2 + 8];
+	int i;
+
+	SV_Record_Stop();
+	SV_Replay_Finish();
+
+	if (!sv_record_pending[0])
+		return;
+	dp_strlcpy(name, sv_record_pending, sizeof(name));
+	sv_record_pending[0] = 0;
+	FS_DefaultExtension(name, ".dsr", sizeof(name));
+
+	sv_record_file = FS_OpenRealFile(name, "wb", false);
+	if (!sv_record_file)
+	{
+		Con_Printf(CON_ERROR "ERROR: couldn't open %s.\n", name);
+		return;
+	}
+	Con_Printf("Recording server session to %s\n", name);
+	sv_record_frames = 0;
+
+	// the replay needs the same random sequence
+	if (!*sv_random_seed.string)
+	{
+		Cvar_SetValueQuick(&sv_random_seed, (int)(Sys_DirtyTime() * 1000.0) & 0x7FFFFFFF);
+		sv_record_clearseed = true;
+	}
+
+	buf.data = sv_record_bufdata;
+	buf.maxsize = sizeof(sv_record_bufdata);
+	SZ_Clear(&buf);
+	SZ_Write(&buf, (const unsigned char *)SV_REPLAY_MAGIC, 8);
+	MSG_WriteLong(&buf, sv_random_seed.integer);
+	MSG_WriteLong(&buf, svs.maxclients);
+	SV_Replay_WriteDouble(&buf, host.realtime);
+	MSG_WriteString(&buf, map);
+	FS_Write(sv_record_file, buf.data, buf.cursize);
+
+	// server cvars that differ from their defaults are set before the replay
+	// spawns the level
+	for (var = cmd_local->cvars->vars;var;var = var->next)
+	{
+		if (!(var->flags & CF_SERVER) || (var->flags & (CF_READONLY | CF_PRIVATE)) || !strcmp(var->string, var->defstring))
+			continue;
+		if (var == &sv_random_seed || var == &sv_replay_quit || var == &sv_threaded || !strcmp(var->name, "port") || !strcmp(var->name, "sv_public"))
+			continue;
+		Cmd_QuoteString(buf1, sizeof(buf1), var->name, "\"\\$", false);
+		Cmd_QuoteString(buf2, sizeof(buf2), var->string, "\"\\$", false);
+		SZ_Clear(&buf);
+		dpsnprintf(text, sizeof(text), "\"%s\" \"%s\"", buf1, buf2);
+		MSG_WriteString(&buf, text);
+		FS_Write(sv_record_file, buf.data, buf.cursize);
+	}
+	SZ_Clear(&buf);
+	MSG_WriteString(&buf, "");
+	FS_Write(sv_record_file, buf.data, buf.cursize);
+
+	// clients that stay connected through a changelevel
+	for (i = 0;i < svs.maxclients;i++)
+		if (svs.clients[i].active && svs.clients[i].netconnection)
+			SV_Record_Connect(i);
+}
+
+/*
+================
+SV_Replay_Shutdown
+================
+*/
+void SV_Replay_Shutdown(void)
+{
+	SV_Record_Stop();
+	SV_Replay_Finish();
+}
+
+void SV_Record_Connect(int clientnum)
+{
+	sizebuf_t *buf;
+	if (!sv_record_file)
+		return;
+	buf = SV_Record_BeginEvent(SV_REPLAY_CONNECT);
+	MSG_WriteByte(buf, clientnum);
+	SV_Record_EndEvent(buf);
+}
+
+void SV_Record_Drop(client_t *client, qbool leaving)
+{
+	sizebuf_t *buf;
+	if (!sv_record_file || !client->netconnection)
+		return;
+	buf = SV_Record_BeginEvent(SV_REPLAY_DROP);
+	MSG_WriteByte(buf, (int)(client - svs.clients));
+	MSG_WriteByte(buf, leaving);
+	SV_Record_EndEvent(buf);
+}
+
+void SV_Record_ClientMessage(client_t *client, sizebuf_t *msg)
+{
+	sizebuf_t *buf;
+	if (!sv_record_file || !client->netconnection || msg->readcount >= msg->cursize)
+		return;
+	buf = SV_Record_BeginEvent(SV_REPLAY_MESSAGE);
+	MSG_WriteByte(buf, (int)(client - svs.clients));
+	MSG_WriteLong(buf, msg->cursize - msg->readcount);
+	SV_Record_EndEvent(buf);
+	FS_Write(sv_record_file, msg->data + msg->readcount, msg->cursize - msg->readcount);
+}
+
+/*
+================
+SV_Record_Command
+
+called by Cmd_ExecuteString for every command from the local console, only
+the ones that can change the server state are kept, commands the server
+progs queued are left out by the caller
+================
+*/
+void SV_Record_Command(cmd_state_t *cmd, const char *text)
+{
+	sizebuf_t *buf;
+	cmd_function_t *func;
+	cvar_t *var;
+	unsigned flags = 0;
+	const char *name;
+
+	if (!sv_record_file || !Cmd_Argc(cmd))
+		return;
+	name = Cmd_Argv(cmd, 0);
+	// commands that start or end a session are not part of it
+	if (!strncasecmp(name, "sv_record", 9) || !strcasecmp(name, "sv_stoprecord") || !strcasecmp(name, "sv_replay") || !strcasecmp(name, "map") || !strcasecmp(name, "changelevel") || !strcasecmp(name, "restart") || !strcasecmp(name, "load") || !strcasecmp(name, "quit"))
+		return;
+	for (func = cmd->userdefined->qc_functions;func;func = func->next)
+		if (!strcasecmp(name, func->name))
+			break;
+	if (!func)
+		for (func = cmd->engine_functions;func;func = func->next)
+			if (!strcasecmp(name, func->name))
+				break;
+	if (func)
+		flags = func->flags;
+	else if ((var = Cvar_FindVar(cmd->cvars, name, cmd->cvars_flagsmask)))
+		flags = var->flags;
+	if (!(flags & CF_SERVER))
+		return;
+
+	buf = SV_Record_BeginEvent(SV_REPLAY_COMMAND);
+	MSG_WriteString(buf, text);
+	SV_Record_EndEvent(buf);
+}
+
+void SV_Record_Physics(void)
+{
+	sizebuf_t *buf;
+	if (!sv_record_file)
+		return;
+	buf = SV_Record_BeginEvent(SV_REPLAY_PHYSICS);
+	SV_Replay_WriteDouble(buf, sv.frametime);
+	MSG_WriteLong(buf, (int)SV_Replay_Checksum());
+	SV_Record_EndEvent(buf);
+	sv_record_frames++;
+}
+
+void SV_Record_EndFrame(void)
+{
+	sizebuf_t *buf;
+	if (!sv_record_file)
+		return;
+	buf = SV_Record_BeginEvent(SV_REPLAY_ENDFRAME);
+	SV_Record_EndEvent(buf);
+}
+
+void SV_Record_PausedTic(double paused)
+{
+	sizebuf_t *buf;
+	if (!sv_record_file)
+		return;
+	buf = SV_Record_BeginEvent(SV_REPLAY_PAUSEDTIC);
+	SV_Replay_WriteDouble(buf, paused);
+	SV_Record_EndEvent(buf);
+}
+
+/*
+================
+SV_Replay_Frame
+
+runs the recorded events up to the end of the next recorded server frame,
+returns false when the replay is over
+================
+*/
+static qbool SV_Replay_Frame(void)
+{
+	prvm_prog_t *prog = SVVM_prog;
+	sizebuf_t *buf = &sv_replay.buf;
+	client_t *oldhostclient = host_client;
+	double oldrealtime = host.realtime;
+	double t;
+	int type, clientnum, length, leaving;
+	unsigned int checksum;
+	char text[MAX_INPUTLINE];
+	qbool more = true;
+
+	while (sv.active)
+	{
+		type = MSG_ReadByte(buf);
+		if (type < 0)
+		{
+			more = false;
+			break;
+		}
+		host.realtime = SV_Replay_ReadDouble(buf);
+		if (type == SV_REPLAY_ENDFRAME)
+		{
+			SV_SendClientMessages();
+			break;
+		}
+		switch (type)
+		{
+		case SV_REPLAY_COMMAND:
+			MSG_ReadString(buf, text, sizeof(text));
+			Cmd_ExecuteString(cmd_local, text, strlen(text), src_local, true);
+			break;
+		case SV_REPLAY_CONNECT:
+			clientnum = MSG_ReadByte(buf);
+			if (clientnum < 0 || clientnum >= svs.maxclients)
+				break;
+			// the recorded client becomes a bot that goes through the
+			// same signon commands the real one sent
+			SV_ConnectClient(clientnum, NULL);
+			svs.clients[clientnum].prespawned = svs.clients[clientnum].spawned = svs.clients[clientnum].begun = false;
+			break;
+		case SV_REPLAY_DROP:
+			clientnum = MSG_ReadByte(buf);
+			leaving = MSG_ReadByte(buf);
+			if (clientnum < 0 || clientnum >= svs.maxclients || !svs.clients[clientnum].active)
+				break;
+			host_client = svs.clients + clientnum;
+			SV_DropClient(leaving != 0, "Dropped in recording");
+			break;
+		case SV_REPLAY_MESSAGE:
+			clientnum = MSG_ReadByte(buf);
+			length = MSG_ReadLong(buf);
+			if (length < 0 || length > (int)sv_message.maxsize || buf->readcount + length > buf->cursize)
+			{
+				buf->badread = true;
+				break;
+			}
+			if (clientnum >= 0 && clientnum < svs.maxclients && svs.clients[clientnum].active)
+			{
+				SZ_Clear(&sv_message);
+				SZ_Write(&sv_message, buf->data + buf->readcount, length);
+				MSG_BeginReading(&sv_message);
+				host_client = svs.clients + clientnum;
+				SV_ReadClientMessage();
+			}
+			buf->readcount += length;
+			break;
+		case SV_REPLAY_PHYSICS:
+			sv.frametime = SV_Replay_ReadDouble(buf);
+			checksum = (unsigned int)MSG_ReadLong(buf);
+			t = Sys_DirtyTime();
+			SV_Physics();
+			SV_Replay_LogTick((Sys_DirtyTime() - t) * 1000.0);
+			sv_replay.checksum = SV_Replay_Checksum();
+			if (sv_replay.checksum != checksum && !sv_replay.mismatches++)
+				sv_replay.firstmismatch = sv_replay.frames;
+			break;
+		case SV_REPLAY_PAUSEDTIC:
+			// timeouts and packets need no event of their own, they end up
+			// as the connects, drops and messages above
+			t = SV_Replay_ReadDouble(buf);
+			PRVM_serverglobalfloat(time) = sv.time;
+			prog->globals.fp[OFS_PARM0] = t;
+			prog->ExecuteProgram(prog, PRVM_serverfunction(SV_PausedTic), "QC function SV_PausedTic is missing");
+			break;
+		default:
+			buf->badread = true;
+			break;
+		}
+		if (buf->badread)
+		{
+			Con_Printf(CON_ERROR "Replay %s is corrupt at offset %i\n", sv_replay.filename, buf->readcount);
+			more = false;
+			break;
+		}
+	}
+
+	host.realtime = oldrealtime;
+	host_client = oldhostclient;
+	return more && sv.active;
+}
+
+/*
+================
+SV_Replay_ServerFrame
+
+called by SV_Frame instead of running in real time while a replay is
+active, returns true if it took care of the frame
+================
+*/
+qbool SV_Replay_ServerFrame(void)
+{
+	if (!sv_replay.running)
+		return false;
+	if (!SV_Replay_Frame())
+		SV_Replay_Finish();
+	return true;
+}
+
+/*
+================
+SV_Record_f
+================
+*/
+void SV_Record_f(cmd_state_t *cmd)
+{
+	if (Cmd_Argc(cmd) != 2)
+	{
+		Con_Print("sv_record <filename> : record the server session starting with the next map for sv_replay\n");
+		return;
+	}
+	if (sv_replay.running)
+	{
+		Con_Print("Can't record while a replay is running\n");
+		return;
+	}
+	dp_strlcpy(sv_record_pending, Cmd_Argv(cmd, 1), sizeof(sv_record_pending));
+	Con_Printf("Server recording will start on the next map load\n");
+}
+
+/*
+================
+SV_StopRecord_f
+================
+*/
+void SV_StopRecord_f(cmd_state_t *cmd)
+{
+	sv_record_pending[0] = 0;
+	if (!sv_record_file)
+	{
+		Con_Print("Not recording a server session\n");
+		return;
+	}
+	SV_Record_Stop();
+}
+
+/*
+================
+SV_Replay_f
+================
+*/
+void SV_Replay_f(cmd_state_t *cmd)
+{
+	char name[MAX_QPATH], map[MAX_QPATH], text[MAX_INPUTLINE];
+	const char *p;
+	cvar_t *var;
+	unsigned char *data;
+	fs_offset_t size;
+	sizebuf_t *buf = &sv_replay.buf;
+	int seed, maxclients;
+	double realtime, oldrealtime;
+
+	if (Cmd_Argc(cmd) < 2 || Cmd_Argc(cmd) > 3)
+	{
+		Con_Print("sv_replay <filename> [ticklog] : run a recorded server session as fast as possible and report tick times and whether the state matches the recording\n");
+		return;
+	}
+	if (svs.threaded)
+	{
+		Con_Print("sv_replay does not work with sv_threaded\n");
+		return;
+	}
+
+	dp_strlcpy(name, Cmd_Argv(cmd, 1), sizeof(name));
+	FS_DefaultExtension(name, ".dsr", sizeof(name));
+	data = FS_LoadFile(name, sv_mempool, false, &size);
+	if (!data)
+	{
+		Con_Printf(CON_ERROR "Couldn't load %s\n", name);
+		return;
+	}
+	if (size < 8 || memcmp(data, SV_REPLAY_MAGIC, 8))
+	{
+		Con_Printf(CON_ERROR "%s is not a server recording\n", name);
+		Mem_Free(data);
+		return;
+	}
+
+	SV_Replay_Shutdown();
+	sv_record_pending[0] = 0;
+	memset(&sv_replay, 0, sizeof(sv_replay));
+	dp_strlcpy(sv_replay.filename, name, sizeof(sv_replay.filename));
+	if (Cmd_Argc(cmd) == 3)
+		dp_strlcpy(sv_replay.ticklog, Cmd_Argv(cmd, 2), sizeof(sv_replay.ticklog));
+	sv_replay.data = data;
+	buf->data = data;
+	buf->maxsize = buf->cursize = (int)size;
+	buf->readcount = 8;
+	buf->badread = false;
+
+	seed = MSG_ReadLong(buf);
+	maxclients = MSG_ReadLong(buf);
+	realtime = SV_Replay_ReadDouble(buf);
+	MSG_ReadString(buf, map, sizeof(map));
+	while (MSG_ReadString(buf, text, sizeof(text))[0])
+	{
+		p = text;
+		if (COM_ParseToken_Console(&p) && (var = Cvar_FindVar(cmd_local->cvars, com_token, ~0)))
+			SV_Replay_SaveCvar(var);
+		Cmd_ExecuteString(cmd_local, text, strlen(text), src_local, true);
+	}
+	if (buf->badread || maxclients < 1)
+	{
+		Con_Printf(CON_ERROR "%s is corrupt\n", name);
+		SV_Replay_RestoreCvars();
+		Mem_Free(data);
+		sv_replay.data = NULL;
+		return;
+	}
+	SV_Replay_SaveCvar(&sv_random_seed);
+	Cvar_SetValueQuick(&sv_random_seed, seed);
+
+	// start the level the same way the map command does, at the realtime
+	// the recording started at
+	if(host.hook.Disconnect)
+		host.hook.Disconnect(false, NULL);
+	SV_Shutdown();
+	if (svs.maxclients != maxclients)
+	{
+		svs.maxclients = svs.maxclients_next = maxclients;
+		if (svs.clients)
+			Mem_Free(svs.clients);
+		svs.clients = (client_t *)Mem_Alloc(sv_mempool, sizeof(client_t) * svs.maxclients);
+	}
+	svs.serverflags = 0;
+	oldrealtime = host.realtime;
+	host.realtime = realtime;
+	SV_SpawnServer(map);
+	host.realtime = oldrealtime;
+	if (!sv.active)
+	{
+		SV_Replay_RestoreCvars();
+		Mem_Free(data);
+		sv_replay.data = NULL;
+		return;
+	}
+
+	Con_Printf("Replaying %s\n", name);
+	sv_replay.running = true;
+	sv_replay.starttime = Sys_DirtyTime();
+}
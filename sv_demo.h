@@ -4,10 +4,25 @@
 #include "qtypes.h"
 struct sizebuf_s;
 struct client_s;
+struct cmd_state_s;
 
 void SV_StartDemoRecording(struct client_s *client, const char *filename, int forcetrack);
 void SV_WriteDemoMessage(struct client_s *client, struct sizebuf_s *sendbuffer, qbool clienttoserver);
 void SV_StopDemoRecording(struct client_s *client);
 void SV_WriteNetnameIntoDemo(struct client_s *client);
 
+void SV_Replay_SpawnServer(const char *map);
+void SV_Replay_Shutdown(void);
+qbool SV_Replay_ServerFrame(void);
+void SV_Record_Connect(int clientnum);
+void SV_Record_Drop(struct client_s *client, qbool leaving);
+void SV_Record_ClientMessage(struct client_s *client, struct sizebuf_s *msg);
+void SV_Record_Command(struct cmd_state_s *cmd, const char *text);
+void SV_Record_Physics(void);
+void SV_Record_EndFrame(void);
+void SV_Record_PausedTic(double paused);
+void SV_Record_f(struct cmd_state_s *cmd);
+void SV_StopRecord_f(struct cmd_state_s *cmd);
+void SV_Replay_f(struct cmd_state_s *cmd);
+
 #endif
@@ -73,6 +73,7 @@ cvar_t sv_allowdownloads_dlcache = {CF_SERVER, "sv_allowdownloads_dlcache", "0",
 cvar_t sv_allowdownloads_inarchive = {CF_SERVER, "sv_allowdownloads_inarchive", "0", "whether to allow downloads from archives (pak/pk3)"};
 cvar_t sv_areagrid_link_SOLID_NOT = {CF_SERVER | CF_NOTIFY, "sv_areagrid_link_SOLID_NOT", "1", "set to 0 to prevent SOLID_NOT entities from being linked to the area grid, and unlink any that are already linked (in the code paths that would otherwise link them), for better performance"};
 cvar_t sv_areagrid_mingridsize = {CF_SERVER | CF_NOTIFY, "sv_areagrid_mingridsize", "128", "minimum areagrid cell size, smaller values work better for lots of small objects, higher values for large objects"};
+cvar_t sv_areagrid_tree = {CF_SERVER | CF_NOTIFY, "sv_areagrid_tree", "0", "link entities into a dynamic bounding box tree instead of the areagrid, works better for maps with many entities crowded in one place or spread out far beyond the world (takes effect on next map load)"};
 cvar_t sv_checkforpacketsduringsleep = {CF_SERVER, "sv_checkforpacketsduringsleep", "0", "uses select() function to wait between frames which can be interrupted by packets being received, instead of Sleep()/usleep()/SDL_Sleep() functions which do not check for packets"};
 cvar_t sv_clmovement_enable = {CF_SERVER, "sv_clmovement_enable", "1", "whether to allow clients to use cl_movement prediction, which can cause choppy movement on the server which may annoy other players"};
 cvar_t sv_clmovement_minping = {CF_SERVER, "sv_clmovement_minping", "0", "if client ping is below this time in milliseconds, then their ability to use cl_movement prediction is disabled for a while (as they don't need it)"};
@@ -142,11 +143,13 @@ cvar_t sv_maxrate = {CF_SERVER | CF_ARCHIVE | CF_NOTIFY, "sv_maxrate", "1000000"
 cvar_t sv_maxspeed = {CF_SERVER | CF_NOTIFY, "sv_maxspeed", "320", "maximum speed a player can accelerate to when on ground (can be exceeded by tricks)"};
 cvar_t sv_maxvelocity = {CF_SERVER | CF_NOTIFY, "sv_maxvelocity","2000", "universal speed limit on all entities"};
 cvar_t sv_nostep = {CF_SERVER | CF_NOTIFY, "sv_nostep","0", "prevents MOVETYPE_STEP entities (monsters) from moving"};
+cvar_t sv_physics_prepass = {CF_SERVER, "sv_physics_prepass", "1", "computes the world collision of projectile moves on worker threads before running entity physics, the results are only used when the move turns out exactly as predicted (touch and think functions still run in order)"};
 cvar_t sv_playerphysicsqc = {CF_SERVER | CF_NOTIFY, "sv_playerphysicsqc", "1", "enables QuakeC function to override player physics"};
 cvar_t sv_progs = {CF_SERVER, "sv_progs", "progs.dat", "selects which quakec progs.dat file to run" };
 cvar_t sv_protocolname = {CF_SERVER, "sv_protocolname", "DP7", "selects network protocol to host for (values include QUAKE, QUAKEDP, NEHAHRAMOVIE, DP1 and up)"};
 cvar_t sv_qcstats = {CF_SERVER, "sv_qcstats", "0", "Disables engine sending of stats 220 and above, for use by certain games such as Xonotic, NOTE: it's strongly recommended that SVQC send correct STAT_MOVEVARS_TICRATE and STAT_MOVEVARS_TIMESCALE"};
 cvar_t sv_random_seed = {CF_SERVER, "sv_random_seed", "", "random seed; when set, on every map start this random seed is used to initialize the random number generator. Don't touch it unless for benchmarking or debugging"};
+cvar_t sv_replay_quit = {CF_SERVER, "sv_replay_quit", "0", "quit when sv_replay finishes, for scripted benchmarks on a dedicated server"};
 cvar_t host_limitlocal = {CF_SERVER, "host_limitlocal", "0", "whether to apply rate limiting to the local player in a listen server (only useful for testing)"};
 cvar_t sv_sound_land = {CF_SERVER, "sv_sound_land", "demon/dland2.wav", "sound to play when MOVETYPE_STEP entity hits the ground at high speed (empty cvar disables the sound)"};
 cvar_t sv_sound_watersplash = {CF_SERVER, "sv_sound_watersplash", "misc/h2ohit1.wav", "sound to play when MOVETYPE_FLY/TOSS/BOUNCE/STEP entity enters or leaves water (empty cvar disables the sound)"};
@@ -220,6 +223,8 @@ cvar_t sv_writepicture_quality = {CF_SERVER | CF_ARCHIVE, "sv_writepicture_quali
 
 cvar_t sv_sendentities_csqc_randomize_order = {CF_SERVER, "sv_sendentities_csqc_randomize_order", "1", "Randomize the order of sending CSQC entities (should behave better when packet size or bandwidth limits are exceeded)."};
 
+cvar_t sv_save_binary = {CF_SERVER | CF_ARCHIVE, "sv_save_binary", "0", "write savegames in the compact binary format (much faster to load on big maps), 1 = uncompressed, 2 = deflate compressed; the load command accepts both text and binary savegames"};
+
 server_t sv;
 server_static_t svs;
 
@@ -561,6 +566,7 @@ void SV_Init (void)
 	Cvar_RegisterVariable (&sv_allowdownloads_inarchive);
 	Cvar_RegisterVariable (&sv_areagrid_link_SOLID_NOT);
 	Cvar_RegisterVariable (&sv_areagrid_mingridsize);
+	Cvar_RegisterVariable (&sv_areagrid_tree);
 	Cvar_RegisterVariable (&sv_checkforpacketsduringsleep);
 	Cvar_RegisterVariable (&sv_clmovement_enable);
 	Cvar_RegisterVariable (&sv_clmovement_minping);
@@ -631,10 +637,12 @@ void SV_Init (void)
 	Cvar_RegisterVariable (&sv_maxspeed);
 	Cvar_RegisterVariable (&sv_maxvelocity);
 	Cvar_RegisterVariable (&sv_nostep);
+	Cvar_RegisterVariable (&sv_physics_prepass);
 	Cvar_RegisterVariable (&sv_playerphysicsqc);
 	Cvar_RegisterVariable (&sv_progs);
 	Cvar_RegisterVariable (&sv_protocolname);
 	Cvar_RegisterVariable (&sv_random_seed);
+	Cvar_RegisterVariable (&sv_replay_quit);
 	Cvar_RegisterVariable (&host_limitlocal);
 	Cvar_RegisterVirtual(&host_limitlocal, "sv_ratelimitlocalplayer");
 	Cvar_RegisterVariable (&sv_sound_land);
@@ -710,6 +718,8 @@ void SV_Init (void)
 
 	Cvar_RegisterVariable (&sv_sendentities_csqc_randomize_order);
 
+	Cvar_RegisterVariable (&sv_save_binary);
+
 	SV_InitOperatorCommands();
 	host.hook.SV_Shutdown = SV_Shutdown;
 
@@ -1002,7 +1012,10 @@ void SV_ConnectClient (int clientnum, netconn_t *netconnection)
 	// don't call SendServerinfo for a fresh botclient because its fields have
 	// not been set up by the qc yet
 	if (client->netconnection)
+	{
+		SV_Record_Connect(clientnum);
 		SV_SendServerinfo (client);
+	}
 	else
 		client->prespawned = client->spawned = client->begun = true;
 }
@@ -1039,6 +1052,7 @@ void SV_DropClient(qbool leaving, const char *fmt, ... )
 	}
 
 	SV_StopDemoRecording(host_client);
+	SV_Record_Drop(host_client, leaving);
 
 	// make sure edict is not corrupt (from a level change for example)
 	host_client->edict = PRVM_EDICT_NUM(host_client - svs.clients + 1);
@@ -1926,6 +1940,9 @@ void SV_SpawnServer (const char *map)
 	Cvar_SetValueQuick(&sv_mapformat_is_quake2, worldmodel->brush.isq2bsp);
 	Cvar_SetValueQuick(&sv_mapformat_is_quake3, worldmodel->brush.isq3bsp);
 
+	// end or start a server recording (this may set the random seed)
+	SV_Replay_SpawnServer(map);
+
 	if(*sv_random_seed.string)
 	{
 		srand(sv_random_seed.integer);
@@ -1988,7 +2005,7 @@ void SV_SpawnServer (const char *map)
 //
 // clear world interaction links
 //
-	World_SetSize(&sv.world, sv.worldname, sv.worldmodel->normalmins, sv.worldmodel->normalmaxs, prog);
+	World_SetSize(&sv.world, sv.worldname, sv.worldmodel->normalmins, sv.worldmodel->normalmaxs, prog, sv_areagrid_tree.integer != 0);
 	World_Start(&sv.world);
 
 	dp_strlcpy(sv.sound_precache[0], "", sizeof(sv.sound_precache[0]));
@@ -2044,11 +2061,11 @@ void SV_SpawnServer (const char *map)
 	if (sv_entpatch.integer && (entities = (char *)FS_LoadFile(va(vabuf, sizeof(vabuf), "%s.ent", sv.worldnamenoextension), tempmempool, true, NULL)))
 	{
 		Con_Printf("Loaded %s.ent\n", sv.worldnamenoextension);
-		PRVM_ED_LoadFromFile(prog, entities);
+		PRVM_ED_LoadFromFile_Cached(prog, entities);
 		Mem_Free(entities);
 	}
 	else
-		PRVM_ED_LoadFromFile(prog, sv.worldmodel->brush.entities);
+		PRVM_ED_LoadFromFile_Cached(prog, sv.worldmodel->brush.entities);
 
 
 	// LadyHavoc: clear world angles (to fix e3m3.bsp)
@@ -2136,6 +2153,8 @@ void SV_Shutdown(void)
 
 	Con_DPrintf("SV_Shutdown\n");
 
+	SV_Replay_Shutdown();
+
 	NetConn_Heartbeat(2);
 	NetConn_Heartbeat(2);
 
@@ -2535,6 +2554,10 @@ double SV_Frame(double time)
 	if (host.framecount == sv.spawnframe || host.framecount == sv.spawnframe + 1)
 		sv_timer = time = host.sleeptime = 0;
 
+	// a replay runs its recorded frames back to back instead of in real time
+	if (sv.active && !svs.threaded && SV_Replay_ServerFrame())
+		return 0;
+
 	if (!svs.threaded)
 	{
 		prvm_prog_t *prog = SVVM_prog;
@@ -2670,7 +2693,10 @@ double SV_Frame(double time)
 
 			// move things around and think unless paused
 			if (sv.frametime)
+			{
 				SV_Physics();
+				SV_Record_Physics();
+			}
 
 			// if this server frame took too long, break out of the loop
 			if (framelimit > 1 && Sys_DirtyTime() >= aborttime)
@@ -2684,8 +2710,10 @@ double SV_Frame(double time)
 
 		// send all messages to the clients
 		SV_SendClientMessages();
+		SV_Record_EndFrame();
 
 		if (sv.paused == 1 && host.realtime > sv.pausedstart && sv.pausedstart > 0) {
+			SV_Record_PausedTic(host.realtime - sv.pausedstart);
 			prog->globals.fp[OFS_PARM0] = host.realtime - sv.pausedstart;
 			PRVM_serverglobalfloat(time) = sv.time;
 			prog->ExecuteProgram(prog, PRVM_serverfunction(SV_PausedTic), "QC function SV_PausedTic is missing");
@@ -2817,13 +2845,18 @@ static int SV_ThreadFunc(void *voiddata)
 
 			// move things around and think unless paused
 			if (sv.frametime)
+			{
 				SV_Physics();
+				SV_Record_Physics();
+			}
 
 			// send all messages to the clients
 			SV_SendClientMessages();
+			SV_Record_EndFrame();
 
 			if (sv.paused == 1 && sv_realtime > sv.pausedstart && sv.pausedstart > 0)
 			{
+				SV_Record_PausedTic(sv_realtime - sv.pausedstart);
 				PRVM_serverglobalfloat(time) = sv.time;
 				prog->globals.fp[OFS_PARM0] = sv_realtime - sv.pausedstart;
 				prog->ExecuteProgram(prog, PRVM_serverfunction(SV_PausedTic), "QC function SV_PausedTic is missing");
@@ -37,8 +37,9 @@ qbool SV_CheckBottom (prvm_edict_t *ent)
 {
 	prvm_prog_t *prog = SVVM_prog;
 	vec3_t	mins, maxs, start, stop;
-	trace_t	trace;
-	int		x, y;
+	vec3_t	starts[4], stops[4];
+	trace_t	trace, traces[4];
+	int		x, y, i;
 	float	mid, bottom;
 
 	VectorAdd (PRVM_serveredictvector(ent, origin), PRVM_serveredictvector(ent, mins), mins);
@@ -78,19 +79,22 @@ realcheck:
 	mid = bottom = trace.endpos[2];
 
 // the corners must be within 16 of the midpoint
-	for	(x=0 ; x<=1 ; x++)
-		for	(y=0 ; y<=1 ; y++)
-		{
-			start[0] = stop[0] = x ? maxs[0] : mins[0];
-			start[1] = stop[1] = y ? maxs[1] : mins[1];
-
-			trace = SV_TraceLine(start, stop, MOVE_NOMONSTERS, ent, SV_GenericHitSuperContentsMask(ent), 0, 0, collision_extendmovelength.value);
+	for	(i=0 ; i<4 ; i++)
+	{
+		starts[i][0] = stops[i][0] = (i & 1) ? maxs[0] : mins[0];
+		starts[i][1] = stops[i][1] = (i & 2) ? maxs[1] : mins[1];
+		starts[i][2] = start[2];
+		stops[i][2] = stop[2];
+	}
+	SV_TraceLineBatch(4, (const vec3_t *)starts, (const vec3_t *)stops, MOVE_NOMONSTERS, ent, SV_GenericHitSuperContentsMask(ent), 0, 0, collision_extendmovelength.value, traces);
 
-			if (trace.fraction != 1.0 && trace.endpos[2] > bottom)
-				bottom = trace.endpos[2];
-			if (trace.fraction == 1.0 || mid - trace.endpos[2] > sv_stepheight.value)
-				return false;
-		}
+	for	(i=0 ; i<4 ; i++)
+	{
+		if (traces[i].fraction != 1.0 && traces[i].endpos[2] > bottom)
+			bottom = traces[i].endpos[2];
+		if (traces[i].fraction == 1.0 || mid - traces[i].endpos[2] > sv_stepheight.value)
+			return false;
+	}
 
 	c_yes++;
 	return true;
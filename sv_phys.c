@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "quakedef.h"
 #include "prvm_cmds.h"
+#include "taskqueue.h"
 
 /*
 
@@ -96,6 +97,72 @@ int SV_GenericHitSuperContentsMask(const prvm_edict_t *passedict)
 		return SUPERCONTENTS_SOLID | SUPERCONTENTS_BODY | SUPERCONTENTS_CORPSE;
 }
 
+/*
+===============================================================================
+
+PROJECTILE PRE-PASS
+
+the world clip of a projectile move depends only on the move itself, so
+SV_Physics predicts the first move of each projectile and clips it against
+the world on worker threads before running the entities in order; the
+traces below only take a result when every input matches what was predicted
+
+===============================================================================
+*/
+
+typedef enum sv_prepasskind_e
+{
+	SV_PREPASS_LINE,
+	SV_PREPASS_BOX
+}
+sv_prepasskind_t;
+
+typedef struct sv_prepass_s
+{
+	int entnum;
+	sv_prepasskind_t kind;
+	vec3_t start, end, mins, maxs;
+	int hitsupercontentsmask;
+	float extend;
+	trace_t trace;
+}
+sv_prepass_t;
+
+#define SV_PREPASS_PERTASK 16
+
+static sv_prepass_t *sv_prepass;
+static taskqueue_task_t *sv_prepass_tasks;
+static int sv_prepass_max;
+
+static qbool SV_Prepass_ClipToWorld(trace_t *trace, prvm_edict_t *passedict, sv_prepasskind_t kind, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int hitsupercontentsmask, int skipsupercontentsmask, int skipmaterialflagsmask, float extend)
+{
+	sv_prepass_t *p;
+	if (!passedict || !passedict->priv.server->prepass || skipsupercontentsmask || skipmaterialflagsmask)
+		return false;
+	p = sv_prepass + passedict->priv.server->prepass - 1;
+	if (p->kind != kind || p->hitsupercontentsmask != hitsupercontentsmask || p->extend != extend
+	 || !VectorCompare(p->start, start) || !VectorCompare(p->end, end) || !VectorCompare(p->mins, mins) || !VectorCompare(p->maxs, maxs))
+		return false;
+	// each prediction covers a single move
+	passedict->priv.server->prepass = 0;
+	*trace = p->trace;
+	return true;
+}
+
+static void SV_Prepass_Task(taskqueue_task_t *t)
+{
+	sv_prepass_t *p = (sv_prepass_t *)t->p[0];
+	size_t i;
+	for (i = 0;i < t->i[0];i++, p++)
+	{
+		if (p->kind == SV_PREPASS_LINE)
+			Collision_ClipLineToWorld(&p->trace, sv.worldmodel, p->start, p->end, p->hitsupercontentsmask, 0, 0, p->extend, false);
+		else
+			Collision_ClipToWorld(&p->trace, sv.worldmodel, p->start, p->mins, p->maxs, p->end, p->hitsupercontentsmask, 0, 0, p->extend);
+	}
+	t->done = 1;
+}
+
 /*
 ==================
 SV_TracePoint
@@ -293,7 +360,8 @@ trace_t SV_TraceLine(const vec3_t start, const vec3_t end, int type, prvm_edict_
 #endif
 
 	// clip to world
-	Collision_ClipLineToWorld(&cliptrace, sv.worldmodel, clipstart, clipend, hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask, extend, false);
+	if (!SV_Prepass_ClipToWorld(&cliptrace, passedict, SV_PREPASS_LINE, clipstart, vec3_origin, vec3_origin, clipend, hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask, extend))
+		Collision_ClipLineToWorld(&cliptrace, sv.worldmodel, clipstart, clipend, hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask, extend, false);
 	cliptrace.worldstartsolid = cliptrace.bmodelstartsolid = cliptrace.startsolid;
 	if (cliptrace.startsolid || cliptrace.fraction < 1)
 		cliptrace.ent = prog->edicts;
@@ -403,6 +471,266 @@ finished:
 	return cliptrace;
 }
 
+/*
+==================
+SV_TraceLineBatch
+
+Same fraction and endpos as calling SV_TraceLine for each start/end pair,
+but the entities are gathered and filtered once for the whole batch, and
+each trace culls the candidate boxes with Collision_BoxListOverlap before
+the exact clips.  Entity matrices and skeletons are also only set up once
+per batch.  The candidates are in batch order rather than the order
+World_EntitiesInBox gives for one line, so when two entities are hit at the
+same fraction trace.ent may be the other one.
+==================
+*/
+#define SV_TRACEBATCH_SIZE 64
+typedef struct sv_tracebatchentity_s
+{
+	prvm_edict_t *touch;
+	model_t *model;
+	matrix4x4_t matrix, imatrix;
+	// temporary storage because prvm_vec_t may differ from vec_t
+	vec3_t touchmins, touchmaxs;
+	int bodysupercontents;
+	qbool prepared;
+}
+sv_tracebatchentity_t;
+void SV_TraceLineBatch(int numtraces, const vec3_t *starts, const vec3_t *ends, int type, prvm_edict_t *passedict, int hitsupercontentsmask, int skipsupercontentsmask, int skipmaterialflagsmask, float extend, trace_t *traces)
+{
+	prvm_prog_t *prog = SVVM_prog;
+	int i, j, k;
+	int passedictprog;
+	prvm_edict_t *traceowner, *touch;
+	trace_t trace;
+	// bounding box of each move and of the entire batch
+	vec3_t clipboxmins[SV_TRACEBATCH_SIZE], clipboxmaxs[SV_TRACEBATCH_SIZE];
+	vec3_t batchmins, batchmaxs;
+	// size when clipping against monsters
+	vec3_t clipmins2, clipmaxs2;
+	// traces that are already complete (point traces)
+	qbool done[SV_TRACEBATCH_SIZE];
+	// the line traces, clipped to world together
+	vec3_t linestarts[SV_TRACEBATCH_SIZE], lineends[SV_TRACEBATCH_SIZE];
+	trace_t linetraces[SV_TRACEBATCH_SIZE];
+	int numlines;
+	// candidate entities, their boxes for culling, and the culling results
+	sv_tracebatchentity_t *candidates, *c;
+	float *boxes;
+	int numcandidates, stride, numhits;
+	// list of entities to test for collisions
+	int numtouchedicts;
+	static prvm_edict_t *touchedicts[MAX_EDICTS];
+	static int hits[MAX_EDICTS];
+	int clipgroup;
+
+	// split big batches so the per trace arrays can stay on the stack
+	while (numtraces > SV_TRACEBATCH_SIZE)
+	{
+		SV_TraceLineBatch(SV_TRACEBATCH_SIZE, starts, ends, type, passedict, hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask, extend, traces);
+		starts += SV_TRACEBATCH_SIZE;
+		ends += SV_TRACEBATCH_SIZE;
+		traces += SV_TRACEBATCH_SIZE;
+		numtraces -= SV_TRACEBATCH_SIZE;
+	}
+	if (numtraces <= 0)
+		return;
+
+	VectorClear(clipmins2);
+	VectorClear(clipmaxs2);
+	if (type == MOVE_MISSILE)
+	{
+		// LadyHavoc: modified this, was = -15, now -= 15
+		for (i = 0;i < 3;i++)
+		{
+			clipmins2[i] -= 15;
+			clipmaxs2[i] += 15;
+		}
+	}
+
+	// point traces go the usual way, the lines are clipped to world together
+	numlines = 0;
+	for (j = 0;j < numtraces;j++)
+	{
+		done[j] = VectorCompare(starts[j], ends[j]);
+		if (done[j])
+			traces[j] = SV_TracePoint(starts[j], type, passedict, hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask);
+		else
+		{
+			VectorCopy(starts[j], linestarts[numlines]);
+			VectorCopy(ends[j], lineends[numlines]);
+			numlines++;
+		}
+	}
+	if (numlines == 0)
+		return;
+	Collision_ClipLinesToWorld(numlines, linetraces, sv.worldmodel, (const vec3_t *)linestarts, (const vec3_t *)lineends, hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask, extend);
+
+	for (j = 0, k = 0;j < numtraces;j++)
+	{
+		if (done[j])
+			continue;
+		traces[j] = linetraces[k++];
+		traces[j].worldstartsolid = traces[j].bmodelstartsolid = traces[j].startsolid;
+		if (traces[j].startsolid || traces[j].fraction < 1)
+			traces[j].ent = prog->edicts;
+
+		// create the bounding box of the entire move
+		for (i = 0;i < 3;i++)
+		{
+			clipboxmins[j][i] = min(starts[j][i], traces[j].endpos[i]) + clipmins2[i] - 1;
+			clipboxmaxs[j][i] = max(starts[j][i], traces[j].endpos[i]) + clipmaxs2[i] + 1;
+		}
+
+		// debug override to test against everything
+		if (sv_debugmove.integer)
+		{
+			clipboxmins[j][0] = clipboxmins[j][1] = clipboxmins[j][2] = (vec_t)-999999999;
+			clipboxmaxs[j][0] = clipboxmaxs[j][1] = clipboxmaxs[j][2] =  (vec_t)999999999;
+		}
+
+		if (k == 1)
+		{
+			VectorCopy(clipboxmins[j], batchmins);
+			VectorCopy(clipboxmaxs[j], batchmaxs);
+		}
+		else
+		{
+			for (i = 0;i < 3;i++)
+			{
+				batchmins[i] = min(batchmins[i], clipboxmins[j][i]);
+				batchmaxs[i] = max(batchmaxs[i], clipboxmaxs[j][i]);
+			}
+		}
+	}
+	if (type == MOVE_WORLDONLY)
+		return;
+
+	// if the passedict is world, make it NULL (to avoid two checks each time)
+	if (passedict == prog->edicts)
+		passedict = NULL;
+	// precalculate prog value for passedict for comparisons
+	passedictprog = PRVM_EDICT_TO_PROG(passedict);
+	// precalculate passedict's owner edict pointer for comparisons
+	traceowner = passedict ? PRVM_PROG_TO_EDICT(PRVM_serveredictedict(passedict, owner)) : 0;
+
+	clipgroup = passedict ? (int)PRVM_serveredictfloat(passedict, clipgroup) : 0;
+
+	// gather the entities touching any of the moves
+	numtouchedicts = SV_EntitiesInBox(batchmins, batchmaxs, MAX_EDICTS, touchedicts);
+	if (numtouchedicts > MAX_EDICTS)
+	{
+		// this never happens
+		Con_Printf("SV_EntitiesInBox returned %i edicts, max was %i\n", numtouchedicts, MAX_EDICTS);
+		numtouchedicts = MAX_EDICTS;
+	}
+	if (numtouchedicts == 0)
+		return;
+
+	// the same rejections as SV_TraceLine, these do not depend on the move
+	candidates = (sv_tracebatchentity_t *)Mem_Alloc(tempmempool, numtouchedicts * sizeof(*candidates) + 6 * (numtouchedicts + 3) * sizeof(float));
+	numcandidates = 0;
+	for (i = 0;i < numtouchedicts;i++)
+	{
+		touch = touchedicts[i];
+
+		if (PRVM_serveredictfloat(touch, solid) < SOLID_BBOX)
+			continue;
+		if (type == MOVE_NOMONSTERS && PRVM_serveredictfloat(touch, solid) != SOLID_BSP)
+			continue;
+
+		if (passedict)
+		{
+			// don't clip against self
+			if (passedict == touch)
+				continue;
+			// don't clip owned entities against owner
+			if (traceowner == touch)
+				continue;
+			// don't clip owner against owned entities
+			if (passedictprog == PRVM_serveredictedict(touch, owner))
+				continue;
+			// don't clip against any entities in the same clipgroup (DP_RM_CLIPGROUP)
+			if (clipgroup && clipgroup == (int)PRVM_serveredictfloat(touch, clipgroup))
+				continue;
+			// don't clip points against points (they can't collide)
+			if (VectorCompare(PRVM_serveredictvector(touch, mins), PRVM_serveredictvector(touch, maxs)) && (type != MOVE_MISSILE || !((int)PRVM_serveredictfloat(touch, flags) & FL_MONSTER)))
+				continue;
+		}
+
+		candidates[numcandidates++].touch = touch;
+	}
+
+	// lay out the boxes World_EntitiesInBox checked as one array per axis,
+	// padded with boxes that never overlap anything
+	stride = (numcandidates + 3) & ~3;
+	boxes = (float *)(candidates + numtouchedicts);
+	for (k = 0;k < stride;k++)
+	{
+		if (k < numcandidates)
+		{
+			touch = candidates[k].touch;
+			for (i = 0;i < 3;i++)
+			{
+				boxes[i * stride + k] = touch->priv.server->areamins[i];
+				boxes[(i + 3) * stride + k] = touch->priv.server->areamaxs[i];
+			}
+		}
+		else
+		{
+			for (i = 0;i < 3;i++)
+			{
+				boxes[i * stride + k] = 1e30f;
+				boxes[(i + 3) * stride + k] = -1e30f;
+			}
+		}
+	}
+
+	// clip each move to the entities its own box touches
+	for (j = 0;j < numtraces;j++)
+	{
+		if (done[j])
+			continue;
+		numhits = Collision_BoxListOverlap(clipboxmins[j], clipboxmaxs[j], boxes, numcandidates, stride, hits);
+		for (k = 0;k < numhits;k++)
+		{
+			c = candidates + hits[k];
+			touch = c->touch;
+			if (!c->prepared)
+			{
+				float pitchsign = 1;
+				c->prepared = true;
+				c->bodysupercontents = PRVM_serveredictfloat(touch, solid) == SOLID_CORPSE ? SUPERCONTENTS_CORPSE : SUPERCONTENTS_BODY;
+				c->model = NULL;
+				if ((int) PRVM_serveredictfloat(touch, solid) == SOLID_BSP || type == MOVE_HITMODEL)
+				{
+					c->model = SV_GetModelFromEdict(touch);
+					pitchsign = SV_GetPitchSign(prog, touch);
+				}
+				if (c->model)
+					Matrix4x4_CreateFromQuakeEntity(&c->matrix, PRVM_serveredictvector(touch, origin)[0], PRVM_serveredictvector(touch, origin)[1], PRVM_serveredictvector(touch, origin)[2], pitchsign * PRVM_serveredictvector(touch, angles)[0], PRVM_serveredictvector(touch, angles)[1], PRVM_serveredictvector(touch, angles)[2], 1);
+				else
+					Matrix4x4_CreateTranslate(&c->matrix, PRVM_serveredictvector(touch, origin)[0], PRVM_serveredictvector(touch, origin)[1], PRVM_serveredictvector(touch, origin)[2]);
+				Matrix4x4_Invert_Simple(&c->imatrix, &c->matrix);
+				VM_GenerateFrameGroupBlend(prog, touch->priv.server->framegroupblend, touch);
+				VM_FrameBlendFromFrameGroupBlend(touch->priv.server->frameblend, touch->priv.server->framegroupblend, c->model, sv.time);
+				VM_UpdateEdictSkeleton(prog, touch, c->model, touch->priv.server->frameblend);
+				VectorCopy(PRVM_serveredictvector(touch, mins), c->touchmins);
+				VectorCopy(PRVM_serveredictvector(touch, maxs), c->touchmaxs);
+			}
+			// might interact, so do an exact clip
+			if (type == MOVE_MISSILE && (int)PRVM_serveredictfloat(touch, flags) & FL_MONSTER)
+				Collision_ClipToGenericEntity(&trace, c->model, touch->priv.server->frameblend, &touch->priv.server->skeleton, c->touchmins, c->touchmaxs, c->bodysupercontents, &c->matrix, &c->imatrix, starts[j], clipmins2, clipmaxs2, ends[j], hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask, extend);
+			else
+				Collision_ClipLineToGenericEntity(&trace, c->model, touch->priv.server->frameblend, &touch->priv.server->skeleton, c->touchmins, c->touchmaxs, c->bodysupercontents, &c->matrix, &c->imatrix, starts[j], ends[j], hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask, extend, false);
+
+			Collision_CombineTraces(&traces[j], &trace, (void *)touch, PRVM_serveredictfloat(touch, solid) == SOLID_BSP);
+		}
+	}
+
+	Mem_Free(candidates);
+}
+
 /*
 ==================
 SV_Move
@@ -466,7 +794,8 @@ trace_t SV_TraceBox(const vec3_t start, const vec3_t mins, const vec3_t maxs, co
 #endif
 
 	// clip to world
-	Collision_ClipToWorld(&cliptrace, sv.worldmodel, clipstart, clipmins, clipmaxs, clipend, hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask, extend);
+	if (!SV_Prepass_ClipToWorld(&cliptrace, passedict, SV_PREPASS_BOX, clipstart, clipmins, clipmaxs, clipend, hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask, extend))
+		Collision_ClipToWorld(&cliptrace, sv.worldmodel, clipstart, clipmins, clipmaxs, clipend, hitsupercontentsmask, skipsupercontentsmask, skipmaterialflagsmask, extend);
 	cliptrace.worldstartsolid = cliptrace.bmodelstartsolid = cliptrace.startsolid;
 	if (cliptrace.startsolid || cliptrace.fraction < 1)
 		cliptrace.ent = prog->edicts;
@@ -3004,6 +3333,117 @@ static void SV_Physics_ClientEntity(prvm_edict_t *ent)
 	SV_CheckVelocity (ent);
 }
 
+/*
+================
+SV_Physics_Prepass
+
+predicts the first move of each airborne projectile the same way
+SV_Physics_Toss and SV_PushEntity will make it, and clips those moves against
+the world on worker threads, returns the number of predictions made
+================
+*/
+static int SV_Physics_Prepass (void)
+{
+	prvm_prog_t *prog = SVVM_prog;
+	int i, num, numtasks, movetype;
+	prvm_edict_t *ent;
+	sv_prepass_t *p;
+	taskqueue_task_t donetask;
+	prvm_vec3_t velocity;
+	vec3_t move;
+	vec_t movetime;
+
+	if (!sv.worldmodel || sv_freezenonclients.integer)
+		return 0;
+
+	if (sv_prepass_max < prog->num_edicts)
+	{
+		if (sv_prepass)
+			Mem_Free(sv_prepass);
+		if (sv_prepass_tasks)
+			Mem_Free(sv_prepass_tasks);
+		sv_prepass_max = prog->max_edicts;
+		sv_prepass = (sv_prepass_t *)Mem_Alloc(sv_mempool, sv_prepass_max * sizeof(*sv_prepass));
+		sv_prepass_tasks = (taskqueue_task_t *)Mem_Alloc(sv_mempool, (sv_prepass_max / SV_PREPASS_PERTASK + 1) * sizeof(*sv_prepass_tasks));
+	}
+
+	num = 0;
+	for (i = svs.maxclients + 1, ent = PRVM_EDICT_NUM(i);i < prog->num_edicts;i++, ent = PRVM_NEXT_EDICT(ent))
+	{
+		if (ent->free)
+			continue;
+		movetype = (int)PRVM_serveredictfloat(ent, movetype);
+		if (movetype != MOVETYPE_TOSS && movetype != MOVETYPE_BOUNCE && movetype != MOVETYPE_BOUNCEMISSILE && movetype != MOVETYPE_FLYMISSILE && movetype != MOVETYPE_FLY && movetype != MOVETYPE_FLY_WORLDONLY)
+			continue;
+		// skip the cases where SV_Physics_Entity or SV_Physics_Toss would
+		// not move at all or a think function may change the move first
+		if (!ent->priv.server->move && sv_gameplayfix_delayprojectiles.integer > 0)
+			continue;
+		if ((int)PRVM_serveredictfloat(ent, flags) & FL_ONGROUND)
+			continue;
+		if (PRVM_serveredictfloat(ent, nextthink) > 0 && PRVM_serveredictfloat(ent, nextthink) <= sv.time + sv.frametime)
+			continue;
+
+		VectorCopy(PRVM_serveredictvector(ent, velocity), velocity);
+		if (movetype == MOVETYPE_TOSS || movetype == MOVETYPE_BOUNCE)
+			velocity[2] -= SV_Gravity(ent);
+		movetime = sv.frametime;
+		VectorScale(velocity, movetime, move);
+
+		p = sv_prepass + num;
+		p->entnum = i;
+		VectorCopy(PRVM_serveredictvector(ent, origin), p->start);
+		VectorAdd(p->start, move, p->end);
+		VectorCopy(PRVM_serveredictvector(ent, mins), p->mins);
+		VectorCopy(PRVM_serveredictvector(ent, maxs), p->maxs);
+		p->hitsupercontentsmask = SV_GenericHitSuperContentsMask(ent);
+		p->extend = collision_extendmovelength.value;
+		if (VectorCompare(p->start, p->end))
+			continue;
+		// SV_TraceBox turns point sized moves into lines shifted by mins
+		if (VectorCompare(p->mins, p->maxs))
+		{
+			VectorAdd(p->start, p->mins, p->start);
+			VectorAdd(p->end, p->mins, p->end);
+			if (VectorCompare(p->start, p->end))
+				continue;
+			VectorClear(p->mins);
+			VectorClear(p->maxs);
+			p->kind = SV_PREPASS_LINE;
+		}
+		else
+			p->kind = SV_PREPASS_BOX;
+		ent->priv.server->prepass = ++num;
+	}
+
+	if (!num)
+		return 0;
+
+	numtasks = 0;
+	for (i = 0;i < num;i += SV_PREPASS_PERTASK)
+		TaskQueue_Setup(sv_prepass_tasks + numtasks++, NULL, SV_Prepass_Task, min(num - i, SV_PREPASS_PERTASK), 0, sv_prepass + i, NULL);
+	TaskQueue_Enqueue(numtasks, sv_prepass_tasks);
+	TaskQueue_Setup(&donetask, NULL, TaskQueue_Task_CheckTasksDone, numtasks, 0, sv_prepass_tasks, NULL);
+	TaskQueue_Enqueue(1, &donetask);
+	TaskQueue_WaitForTaskDone(&donetask);
+	return num;
+}
+
+/*
+================
+SV_Physics_PrepassFinish
+
+drops whatever predictions were not used by this frame's moves
+================
+*/
+static void SV_Physics_PrepassFinish (int num)
+{
+	prvm_prog_t *prog = SVVM_prog;
+	int i;
+	for (i = 0;i < num;i++)
+		PRVM_EDICT_NUM(sv_prepass[i].entnum)->priv.server->prepass = 0;
+}
+
 /*
 ================
 SV_Physics
@@ -3013,7 +3453,7 @@ SV_Physics
 void SV_Physics (void)
 {
 	prvm_prog_t *prog = SVVM_prog;
-	int i;
+	int i, numprepass;
 	prvm_edict_t *ent;
 
 	// free memory for resources that are no longer referenced
@@ -3073,6 +3513,7 @@ void SV_Physics (void)
 	// run physics on all the non-client entities
 	if (!sv_freezenonclients.integer)
 	{
+		numprepass = sv_physics_prepass.integer ? SV_Physics_Prepass() : 0;
 		for (;i < prog->num_edicts;i++, ent = PRVM_NEXT_EDICT(ent))
 			if (!ent->free)
 				SV_Physics_Entity(ent);
@@ -3082,6 +3523,7 @@ void SV_Physics (void)
 			for (i = svs.maxclients + 1, ent = PRVM_EDICT_NUM(i);i < prog->num_edicts;i++, ent = PRVM_NEXT_EDICT(ent))
 				if (!ent->priv.server->move && !ent->free)
 					SV_Physics_Entity(ent);
+		SV_Physics_PrepassFinish(numprepass);
 	}
 
 	if (PRVM_serverglobalfloat(force_retouch) > 0)
@@ -180,6 +180,708 @@ void SV_Savegame_to(prvm_prog_t *prog, const char *name)
 	Con_Print("done.\n");
 }
 
+/*
+===============================================================================
+
+BINARY SAVEGAMES
+
+The binary format starts with a small uncompressed header:
+  "DPSAVEB" magic, comment (SAVEGAME_COMMENT_LENGTH+1 bytes, zero padded),
+  int version, int flags, int vec size, int payload size
+followed by the (optionally deflated) payload, all values little endian.
+The comment is at a fixed offset so the load/save menu can read it without
+decompressing anything.
+The payload carries a field and global name schema, so it stays loadable
+after the progs are recompiled with added or reordered fields.
+===============================================================================
+*/
+
+#define SAVEGAME_BINARY_VERSION 2
+#define SAVEGAME_BINARY_FIELDSOFS (SAVEGAME_BINARY_MAGICSIZE + SAVEGAME_COMMENT_LENGTH + 1)
+#define SAVEGAME_BINARY_HEADERSIZE (SAVEGAME_BINARY_FIELDSOFS + 16)
+#define SAVEGAME_BINARY_FLAG_DEFLATED 1
+
+static void SV_SaveBinary_Reserve(sizebuf_t *sb, int length)
+{
+	unsigned char *olddata;
+
+	if (sb->cursize + length <= sb->maxsize)
+		return;
+	olddata = sb->data;
+	sb->maxsize = max(sb->maxsize * 2, sb->cursize + length);
+	sb->data = (unsigned char *)Mem_Alloc(tempmempool, sb->maxsize);
+	if (olddata)
+	{
+		memcpy(sb->data, olddata, sb->cursize);
+		Mem_Free(olddata);
+	}
+}
+
+static void SV_SaveBinary_WriteByte(sizebuf_t *sb, int c)
+{
+	SV_SaveBinary_Reserve(sb, 1);
+	MSG_WriteByte(sb, c);
+}
+
+static void SV_SaveBinary_WriteLong(sizebuf_t *sb, int c)
+{
+	SV_SaveBinary_Reserve(sb, 4);
+	MSG_WriteLong(sb, c);
+}
+
+static void SV_SaveBinary_WriteString(sizebuf_t *sb, const char *s)
+{
+	SV_SaveBinary_Reserve(sb, (int)strlen(s) + 1);
+	MSG_WriteString(sb, s);
+}
+
+static void SV_SaveBinary_WriteDouble(sizebuf_t *sb, double d)
+{
+	union
+	{
+		double d;
+		uint64_t l;
+	} dat;
+
+	dat.d = d;
+	SV_SaveBinary_WriteLong(sb, (int)(dat.l & 0xFFFFFFFF));
+	SV_SaveBinary_WriteLong(sb, (int)(dat.l >> 32));
+}
+
+static void SV_SaveBinary_WriteVec(sizebuf_t *sb, prvm_vec_t v)
+{
+#ifdef PRVM_64
+	SV_SaveBinary_WriteDouble(sb, v);
+#else
+	SV_SaveBinary_Reserve(sb, 4);
+	MSG_WriteFloat(sb, v);
+#endif
+}
+
+static double SV_LoadBinary_ReadDouble(sizebuf_t *sb)
+{
+	union
+	{
+		double d;
+		uint64_t l;
+	} dat;
+
+	dat.l = (uint32_t)MSG_ReadLong(sb);
+	dat.l |= (uint64_t)(uint32_t)MSG_ReadLong(sb) << 32;
+	return dat.d;
+}
+
+static prvm_vec_t SV_LoadBinary_ReadVec(sizebuf_t *sb, int vecsize)
+{
+	if (vecsize == 8)
+		return (prvm_vec_t)SV_LoadBinary_ReadDouble(sb);
+	return (prvm_vec_t)MSG_ReadFloat(sb);
+}
+
+// returns a pointer into the buffer instead of copying, strings may be long
+static const char *SV_LoadBinary_ReadString(sizebuf_t *sb)
+{
+	const char *s = (const char *)sb->data + sb->readcount;
+	const unsigned char *end = NULL;
+
+	if (sb->readcount < sb->cursize)
+		end = (const unsigned char *)memchr(s, 0, sb->cursize - sb->readcount);
+	if (!end)
+	{
+		sb->badread = true;
+		sb->readcount = sb->cursize;
+		return "";
+	}
+	sb->readcount = (int)(end - sb->data) + 1;
+	return s;
+}
+
+// only types that survive a round trip through the text format are saved
+static qbool SV_SaveBinary_TypeIsSaved(int type)
+{
+	switch (type)
+	{
+	case ev_string:
+	case ev_float:
+	case ev_vector:
+	case ev_entity:
+	case ev_field:
+	case ev_function:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static qbool SV_SaveBinary_FieldIsSaved(prvm_prog_t *prog, mdef_t *d)
+{
+	const char *name = PRVM_GetString(prog, d->s_name);
+	size_t len = strlen(name);
+
+	// same rule as PRVM_ED_Write: skip _x, _y, _z and other _? vars
+	if (len > 1 && name[len-2] == '_')
+		return false;
+	return SV_SaveBinary_TypeIsSaved(d->type & ~DEF_SAVEGLOBAL);
+}
+
+static qbool SV_SaveBinary_ValueIsZero(int type, prvm_eval_t *val)
+{
+	int j;
+
+	for (j = 0;j < prvm_type_size[type];j++)
+		if (val->ivector[j])
+			return false;
+	return true;
+}
+
+static void SV_SaveBinary_WriteValue(prvm_prog_t *prog, sizebuf_t *sb, int type, prvm_eval_t *val)
+{
+	mdef_t *def;
+
+	switch (type)
+	{
+	case ev_string:
+		SV_SaveBinary_WriteString(sb, PRVM_GetString(prog, val->string));
+		break;
+	case ev_float:
+		SV_SaveBinary_WriteVec(sb, val->_float);
+		break;
+	case ev_vector:
+		SV_SaveBinary_WriteVec(sb, val->vector[0]);
+		SV_SaveBinary_WriteVec(sb, val->vector[1]);
+		SV_SaveBinary_WriteVec(sb, val->vector[2]);
+		break;
+	case ev_entity:
+		SV_SaveBinary_WriteLong(sb, (int)val->edict);
+		break;
+	case ev_field:
+		def = PRVM_ED_FieldAtOfs(prog, val->_int);
+		SV_SaveBinary_WriteString(sb, def ? PRVM_GetString(prog, def->s_name) : "");
+		break;
+	case ev_function:
+		if ((unsigned int)val->function < (unsigned int)prog->progs_numfunctions)
+			SV_SaveBinary_WriteString(sb, PRVM_GetString(prog, prog->functions[val->function].s_name));
+		else
+			SV_SaveBinary_WriteString(sb, "");
+		break;
+	}
+}
+
+/*
+===============
+SV_LoadBinary_ReadValue
+
+Reads one saved value, storing it into ent (or the globals if ent is NULL)
+when def is not NULL, otherwise just skips over it
+===============
+*/
+static void SV_LoadBinary_ReadValue(prvm_prog_t *prog, sizebuf_t *sb, int type, int vecsize, prvm_edict_t *ent, mdef_t *def)
+{
+	prvm_eval_t *val;
+	prvm_vec_t v[3];
+	const char *s;
+	char *new_p;
+	size_t l;
+	int i;
+	mdef_t *fielddef;
+	mfunction_t *func;
+
+	switch (type)
+	{
+	case ev_string:
+		s = SV_LoadBinary_ReadString(sb);
+		if (!def)
+			return;
+		l = strlen(s) + 1;
+		val = (prvm_eval_t *)((ent ? ent->fields.fp : prog->globals.fp) + def->ofs);
+		val->string = PRVM_AllocString(prog, l, &new_p);
+		memcpy(new_p, s, l);
+		break;
+	case ev_float:
+		v[0] = SV_LoadBinary_ReadVec(sb, vecsize);
+		if (!def)
+			return;
+		val = (prvm_eval_t *)((ent ? ent->fields.fp : prog->globals.fp) + def->ofs);
+		val->_float = v[0];
+		break;
+	case ev_vector:
+		v[0] = SV_LoadBinary_ReadVec(sb, vecsize);
+		v[1] = SV_LoadBinary_ReadVec(sb, vecsize);
+		v[2] = SV_LoadBinary_ReadVec(sb, vecsize);
+		if (!def)
+			return;
+		val = (prvm_eval_t *)((ent ? ent->fields.fp : prog->globals.fp) + def->ofs);
+		VectorCopy(v, val->vector);
+		break;
+	case ev_entity:
+		i = MSG_ReadLong(sb);
+		if (!def)
+			return;
+		if (i < 0 || i >= prog->limit_edicts)
+		{
+			Con_Printf("SV_Loadgame_f: ev_entity reference %i out of range (MAX_EDICTS %u) on %s\n", i, prog->limit_edicts, prog->name);
+			i = 0;
+		}
+		while (i >= prog->max_edicts)
+			PRVM_MEM_IncreaseEdicts(prog);
+		// if IncreaseEdicts was called the base pointer needs to be updated
+		val = (prvm_eval_t *)((ent ? ent->fields.fp : prog->globals.fp) + def->ofs);
+		val->edict = PRVM_EDICT_TO_PROG(PRVM_EDICT_NUM(i));
+		break;
+	case ev_field:
+		s = SV_LoadBinary_ReadString(sb);
+		if (!def)
+			return;
+		val = (prvm_eval_t *)((ent ? ent->fields.fp : prog->globals.fp) + def->ofs);
+		fielddef = s[0] ? PRVM_ED_FindField(prog, s) : NULL;
+		if (s[0] && !fielddef)
+			Con_DPrintf("SV_Loadgame_f: Can't find field %s in %s\n", s, prog->name);
+		val->_int = fielddef ? fielddef->ofs : 0;
+		break;
+	case ev_function:
+		s = SV_LoadBinary_ReadString(sb);
+		if (!def)
+			return;
+		val = (prvm_eval_t *)((ent ? ent->fields.fp : prog->globals.fp) + def->ofs);
+		func = s[0] ? PRVM_ED_FindFunction(prog, s) : NULL;
+		if (s[0] && !func)
+			Con_Printf("SV_Loadgame_f: Can't find function %s in %s\n", s, prog->name);
+		val->function = func ? func - prog->functions : 0;
+		break;
+	default:
+		sb->badread = true;
+		break;
+	}
+}
+
+/*
+===============
+SV_Savegame_Binary_to
+
+Writes the same state as SV_Savegame_to, but as raw values behind a
+name schema instead of text
+===============
+*/
+static void SV_Savegame_Binary_to(prvm_prog_t *prog, const char *name, qbool compress)
+{
+	qfile_t *f;
+	sizebuf_t sb;
+	int i, k, numfields, numbuffers, maskbytes, maskofs;
+	int *savedfields;
+	unsigned char *deflated = NULL;
+	size_t deflatedsize = 0;
+	unsigned char header[SAVEGAME_BINARY_HEADERSIZE];
+	char comment[SAVEGAME_COMMENT_LENGTH+1];
+	mdef_t *d;
+	prvm_edict_t *ent;
+	prvm_stringbuffer_t *stringbuffer;
+	int type;
+
+	Con_Printf("Saving game to %s...\n", name);
+
+	memset(&sb, 0, sizeof(sb));
+	SV_SaveBinary_Reserve(&sb, 65536);
+
+	memset(comment, 0, sizeof(comment));
+	dpsnprintf(comment, sizeof(comment), "%-21.21s kills:%3i/%3i", PRVM_GetString(prog, PRVM_serveredictstring(prog->edicts, message)), (int)PRVM_serverglobalfloat(killed_monsters), (int)PRVM_serverglobalfloat(total_monsters));
+	for (i=0 ; i<SAVEGAME_COMMENT_LENGTH ; i++)
+		if (ISWHITESPACEORCONTROL(comment[i]))
+			comment[i] = '_';
+	comment[SAVEGAME_COMMENT_LENGTH] = '\0';
+
+	for (i=0 ; i<NUM_SPAWN_PARMS ; i++)
+		SV_SaveBinary_WriteVec(&sb, svs.clients[0].spawn_parms[i]);
+	SV_SaveBinary_WriteLong(&sb, current_skill);
+	SV_SaveBinary_WriteString(&sb, sv.worldbasename);
+	SV_SaveBinary_WriteDouble(&sb, sv.time);
+
+	// light styles and precaches, as index/name pairs terminated by -1
+	for (i=0 ; i<MAX_LIGHTSTYLES ; i++)
+	{
+		if (sv.lightstyles[i][0])
+		{
+			SV_SaveBinary_WriteLong(&sb, i);
+			SV_SaveBinary_WriteString(&sb, sv.lightstyles[i]);
+		}
+	}
+	SV_SaveBinary_WriteLong(&sb, -1);
+	for (i=1 ; i<MAX_MODELS ; i++)
+	{
+		if (sv.model_precache[i][0])
+		{
+			SV_SaveBinary_WriteLong(&sb, i);
+			SV_SaveBinary_WriteString(&sb, sv.model_precache[i]);
+		}
+	}
+	SV_SaveBinary_WriteLong(&sb, -1);
+	for (i=1 ; i<MAX_SOUNDS ; i++)
+	{
+		if (sv.sound_precache[i][0])
+		{
+			SV_SaveBinary_WriteLong(&sb, i);
+			SV_SaveBinary_WriteString(&sb, sv.sound_precache[i]);
+		}
+	}
+	SV_SaveBinary_WriteLong(&sb, -1);
+
+	// globals, schema and value together as they are only written once
+	for (i = 0, k = 0;i < prog->numglobaldefs;i++)
+	{
+		d = &prog->globaldefs[i];
+		type = d->type & ~DEF_SAVEGLOBAL;
+		if ((d->type & DEF_SAVEGLOBAL) && (type == ev_string || type == ev_float || type == ev_entity))
+			k++;
+	}
+	SV_SaveBinary_WriteLong(&sb, k);
+	for (i = 0;i < prog->numglobaldefs;i++)
+	{
+		d = &prog->globaldefs[i];
+		type = d->type & ~DEF_SAVEGLOBAL;
+		if (!(d->type & DEF_SAVEGLOBAL) || (type != ev_string && type != ev_float && type != ev_entity))
+			continue;
+		SV_SaveBinary_WriteString(&sb, PRVM_GetString(prog, d->s_name));
+		SV_SaveBinary_WriteByte(&sb, type);
+		SV_SaveBinary_WriteValue(prog, &sb, type, (prvm_eval_t *)&prog->globals.fp[d->ofs]);
+	}
+
+	// field schema
+	savedfields = (int *)Mem_Alloc(tempmempool, prog->numfielddefs * sizeof(*savedfields));
+	for (i = 1, numfields = 0;i < prog->numfielddefs;i++)
+		if (SV_SaveBinary_FieldIsSaved(prog, &prog->fielddefs[i]))
+			savedfields[numfields++] = i;
+	SV_SaveBinary_WriteLong(&sb, numfields);
+	for (i = 0;i < numfields;i++)
+	{
+		d = &prog->fielddefs[savedfields[i]];
+		SV_SaveBinary_WriteString(&sb, PRVM_GetString(prog, d->s_name));
+		SV_SaveBinary_WriteByte(&sb, d->type & ~DEF_SAVEGLOBAL);
+	}
+
+	// edicts, each one is a free flag, a bitmask of non-zero fields in
+	// schema order and then the values of those fields
+	maskbytes = (numfields + 7) >> 3;
+	SV_SaveBinary_WriteLong(&sb, prog->num_edicts);
+	for (i = 0;i < prog->num_edicts;i++)
+	{
+		ent = PRVM_EDICT_NUM(i);
+		SV_SaveBinary_WriteByte(&sb, ent->free);
+		if (ent->free)
+			continue;
+		// the buffer may move while writing values, so remember an offset
+		SV_SaveBinary_Reserve(&sb, maskbytes);
+		maskofs = sb.cursize;
+		memset(SZ_GetSpace(&sb, maskbytes), 0, maskbytes);
+		for (k = 0;k < numfields;k++)
+		{
+			d = &prog->fielddefs[savedfields[k]];
+			type = d->type & ~DEF_SAVEGLOBAL;
+			if (SV_SaveBinary_ValueIsZero(type, (prvm_eval_t *)(ent->fields.fp + d->ofs)))
+				continue;
+			sb.data[maskofs + (k >> 3)] |= 1 << (k & 7);
+			SV_SaveBinary_WriteValue(prog, &sb, type, (prvm_eval_t *)(ent->fields.fp + d->ofs));
+		}
+	}
+	Mem_Free(savedfields);
+
+	// string buffers, terminated by -1
+	numbuffers = (int)Mem_ExpandableArray_IndexRange(&prog->stringbuffersarray);
+	for (i = 0;i < numbuffers;i++)
+	{
+		stringbuffer = (prvm_stringbuffer_t *)Mem_ExpandableArray_RecordAtIndex(&prog->stringbuffersarray, i);
+		if (!stringbuffer || !(stringbuffer->flags & STRINGBUFFER_SAVED))
+			continue;
+		SV_SaveBinary_WriteLong(&sb, i);
+		SV_SaveBinary_WriteLong(&sb, stringbuffer->flags & STRINGBUFFER_QCFLAGS);
+		for (k = 0;k < stringbuffer->num_strings;k++)
+		{
+			if (!stringbuffer->strings[k])
+				continue;
+			SV_SaveBinary_WriteLong(&sb, k);
+			SV_SaveBinary_WriteString(&sb, stringbuffer->strings[k]);
+		}
+		SV_SaveBinary_WriteLong(&sb, -1);
+	}
+	SV_SaveBinary_WriteLong(&sb, -1);
+
+	if (compress)
+		deflated = FS_Deflate(sb.data, sb.cursize, &deflatedsize, -1, tempmempool);
+
+	memset(header, 0, sizeof(header));
+	memcpy(header, SAVEGAME_BINARY_MAGIC, sizeof(SAVEGAME_BINARY_MAGIC));
+	memcpy(header + SAVEGAME_BINARY_MAGICSIZE, comment, sizeof(comment));
+	StoreLittleLong(header + SAVEGAME_BINARY_FIELDSOFS, SAVEGAME_BINARY_VERSION);
+	StoreLittleLong(header + SAVEGAME_BINARY_FIELDSOFS + 4, deflated ? SAVEGAME_BINARY_FLAG_DEFLATED : 0);
+	StoreLittleLong(header + SAVEGAME_BINARY_FIELDSOFS + 8, sizeof(prvm_vec_t));
+	StoreLittleLong(header + SAVEGAME_BINARY_FIELDSOFS + 12, sb.cursize);
+
+	f = FS_OpenRealFile(name, "wb", false);
+	if (!f)
+	{
+		Con_Print(CON_ERROR "ERROR: couldn't open.\n");
+	}
+	else
+	{
+		FS_Write(f, header, sizeof(header));
+		if (deflated)
+			FS_Write(f, deflated, deflatedsize);
+		else
+			FS_Write(f, sb.data, sb.cursize);
+		FS_Close(f);
+#ifdef __EMSCRIPTEN__
+		js_syncFS(false);
+#endif
+		Con_Print("done.\n");
+	}
+
+	if (deflated)
+		Mem_Free(deflated);
+	Mem_Free(sb.data);
+}
+
+/*
+===============
+SV_Loadgame_Binary
+
+Counterpart of SV_Savegame_Binary_to, returns false if the server could
+not be started from the savegame
+===============
+*/
+static qbool SV_Loadgame_Binary(prvm_prog_t *prog, unsigned char *filedata, fs_offset_t filesize)
+{
+	sizebuf_t sb;
+	unsigned char *payload;
+	unsigned char *inflated = NULL;
+	size_t payloadsize;
+	int version, flags, vecsize;
+	int i, k, numfields, numedicts, maskbytes, maskofs, type;
+	unsigned char *fieldtypes;
+	mdef_t **fielddefs;
+	mdef_t *def;
+	const char *s;
+	char mapname[MAX_QPATH];
+	double time;
+	float spawn_parms[NUM_SPAWN_PARMS];
+	prvm_edict_t *ent;
+	prvm_stringbuffer_t *stringbuffer;
+
+	version = BuffLittleLong(filedata + SAVEGAME_BINARY_FIELDSOFS);
+	flags = BuffLittleLong(filedata + SAVEGAME_BINARY_FIELDSOFS + 4);
+	vecsize = BuffLittleLong(filedata + SAVEGAME_BINARY_FIELDSOFS + 8);
+	payloadsize = (unsigned int)BuffLittleLong(filedata + SAVEGAME_BINARY_FIELDSOFS + 12);
+	if (version != SAVEGAME_BINARY_VERSION)
+	{
+		Con_Printf(CON_ERROR "Binary savegame is version %i, not %i\n", version, SAVEGAME_BINARY_VERSION);
+		return false;
+	}
+	if (vecsize != 4 && vecsize != 8)
+	{
+		Con_Printf(CON_ERROR "Binary savegame has unsupported value size %i\n", vecsize);
+		return false;
+	}
+
+	payload = filedata + SAVEGAME_BINARY_HEADERSIZE;
+	if (flags & SAVEGAME_BINARY_FLAG_DEFLATED)
+	{
+		size_t inflatedsize;
+		inflated = FS_Inflate(payload, filesize - SAVEGAME_BINARY_HEADERSIZE, &inflatedsize, tempmempool);
+		if (!inflated || inflatedsize != payloadsize)
+		{
+			if (inflated)
+				Mem_Free(inflated);
+			Con_Print(CON_ERROR "Binary savegame could not be decompressed\n");
+			return false;
+		}
+		payload = inflated;
+	}
+	else if ((size_t)(filesize - SAVEGAME_BINARY_HEADERSIZE) < payloadsize)
+	{
+		Con_Print(CON_ERROR "Binary savegame is truncated\n");
+		return false;
+	}
+	MSG_InitReadBuffer(&sb, payload, (int)payloadsize);
+
+	for (i = 0;i < NUM_SPAWN_PARMS;i++)
+		spawn_parms[i] = SV_LoadBinary_ReadVec(&sb, vecsize);
+	current_skill = MSG_ReadLong(&sb);
+	Cvar_SetValueQuick(&skill, (float)current_skill);
+	dp_strlcpy(mapname, SV_LoadBinary_ReadString(&sb), sizeof(mapname));
+	time = SV_LoadBinary_ReadDouble(&sb);
+	if (sb.badread)
+	{
+		if (inflated)
+			Mem_Free(inflated);
+		Con_Print(CON_ERROR "Binary savegame is truncated\n");
+		return false;
+	}
+
+	if(developer_entityparsing.integer)
+		Con_Printf("SV_Loadgame_f: spawning server\n");
+
+	SV_SpawnServer (mapname);
+	if (!sv.active)
+	{
+		if (inflated)
+			Mem_Free(inflated);
+		Con_Printf(CON_ERROR "Couldn't load map \"%s\"\n", mapname);
+		return false;
+	}
+	sv.paused = true;		// pause until all clients connect
+	sv.loadgame = true;
+
+	// restore precaches before the edicts, so linking finds the right models
+	memset(sv.lightstyles[0], 0, sizeof(sv.lightstyles));
+	memset(sv.model_precache[0], 0, sizeof(sv.model_precache));
+	memset(sv.sound_precache[0], 0, sizeof(sv.sound_precache));
+	BufStr_Flush(prog);
+	while ((i = MSG_ReadLong(&sb)) >= 0 && !sb.badread)
+	{
+		s = SV_LoadBinary_ReadString(&sb);
+		if (i < MAX_LIGHTSTYLES)
+			dp_strlcpy(sv.lightstyles[i], s, sizeof(sv.lightstyles[i]));
+		else
+			Con_Printf(CON_WARN "unsupported lightstyle %i \"%s\"\n", i, s);
+	}
+	while ((i = MSG_ReadLong(&sb)) >= 0 && !sb.badread)
+	{
+		s = SV_LoadBinary_ReadString(&sb);
+		if (i < MAX_MODELS)
+		{
+			dp_strlcpy(sv.model_precache[i], s, sizeof(sv.model_precache[i]));
+			sv.models[i] = Mod_ForName (sv.model_precache[i], true, false, sv.model_precache[i][0] == '*' ? sv.worldname : NULL);
+		}
+		else
+			Con_Printf(CON_WARN "unsupported model %i \"%s\"\n", i, s);
+	}
+	while ((i = MSG_ReadLong(&sb)) >= 0 && !sb.badread)
+	{
+		s = SV_LoadBinary_ReadString(&sb);
+		if (i < MAX_SOUNDS)
+			dp_strlcpy(sv.sound_precache[i], s, sizeof(sv.sound_precache[i]));
+		else
+			Con_Printf(CON_WARN "unsupported sound %i \"%s\"\n", i, s);
+	}
+
+	if(developer_entityparsing.integer)
+		Con_Printf("SV_Loadgame_f: loading globals\n");
+
+	k = MSG_ReadLong(&sb);
+	for (i = 0;i < k && !sb.badread;i++)
+	{
+		s = SV_LoadBinary_ReadString(&sb);
+		type = MSG_ReadByte(&sb);
+		def = PRVM_ED_FindGlobal(prog, s);
+		if (!def)
+			Con_DPrintf("'%s' is not a global on %s\n", s, prog->name);
+		else if ((def->type & ~DEF_SAVEGLOBAL) != (unsigned int)type)
+		{
+			Con_DPrintf("'%s' changed type on %s\n", s, prog->name);
+			def = NULL;
+		}
+		SV_LoadBinary_ReadValue(prog, &sb, type, vecsize, NULL, def);
+	}
+
+	// restore the autocvar globals
+	Cvar_UpdateAllAutoCvars(prog->console_cmd->cvars);
+
+	// resolve the field schema against the current progs once
+	numfields = MSG_ReadLong(&sb);
+	if (numfields < 0 || numfields > sb.cursize - sb.readcount)
+	{
+		numfields = 0;
+		sb.badread = true;
+	}
+	fielddefs = (mdef_t **)Mem_Alloc(tempmempool, numfields * sizeof(*fielddefs) + 1);
+	fieldtypes = (unsigned char *)Mem_Alloc(tempmempool, numfields + 1);
+	for (i = 0;i < numfields && !sb.badread;i++)
+	{
+		s = SV_LoadBinary_ReadString(&sb);
+		fieldtypes[i] = MSG_ReadByte(&sb);
+		fielddefs[i] = PRVM_ED_FindField(prog, s);
+		if (!fielddefs[i])
+			Con_DPrintf("%s: '%s' is not a field\n", prog->name, s);
+		else if ((fielddefs[i]->type & ~DEF_SAVEGLOBAL) != fieldtypes[i])
+		{
+			Con_DPrintf("%s: '%s' changed type\n", prog->name, s);
+			fielddefs[i] = NULL;
+		}
+	}
+	maskbytes = (numfields + 7) >> 3;
+
+	// unlink all entities
+	World_UnlinkAll(&sv.world);
+
+	numedicts = MSG_ReadLong(&sb);
+	if (numedicts > MAX_EDICTS)
+	{
+		Mem_Free(fielddefs);
+		Mem_Free(fieldtypes);
+		if (inflated)
+			Mem_Free(inflated);
+		Host_Error("%s: too many edicts in save file (reached MAX_EDICTS %i)", __func__, MAX_EDICTS);
+	}
+	for (i = 0;i < numedicts && !sb.badread;i++)
+	{
+		while (i >= prog->max_edicts)
+			PRVM_MEM_IncreaseEdicts(prog);
+		ent = PRVM_EDICT_NUM(i);
+		memset(ent->fields.fp, 0, prog->entityfields * sizeof(prvm_vec_t));
+		if (MSG_ReadByte(&sb))
+		{
+			ent->free = true;
+			ent->freetime = host.realtime;
+			continue;
+		}
+		ent->free = false;
+
+		if (developer_entityparsing.integer)
+			Con_Printf("SV_Loadgame_f: loading edict %d\n", i);
+
+		maskofs = sb.readcount;
+		sb.readcount += maskbytes;
+		if (sb.readcount > sb.cursize)
+		{
+			sb.badread = true;
+			break;
+		}
+		for (k = 0;k < numfields;k++)
+			if (sb.data[maskofs + (k >> 3)] & (1 << (k & 7)))
+				SV_LoadBinary_ReadValue(prog, &sb, fieldtypes[k], vecsize, ent, fielddefs[k]);
+
+		// link it into the bsp tree
+		if (!ent->free)
+			SV_LinkEdict(ent);
+	}
+	prog->num_edicts = max(i, 1);
+	Mem_Free(fielddefs);
+	Mem_Free(fieldtypes);
+
+	// string buffers
+	while ((i = MSG_ReadLong(&sb)) >= 0 && !sb.badread)
+	{
+		k = STRINGBUFFER_SAVED | MSG_ReadLong(&sb);
+		stringbuffer = BufStr_FindCreateReplace(prog, i, k, "string");
+		if (!stringbuffer)
+			Con_Printf(CON_ERROR "failed to create stringbuffer %i\n", i);
+		while ((k = MSG_ReadLong(&sb)) >= 0 && !sb.badread)
+		{
+			s = SV_LoadBinary_ReadString(&sb);
+			if (stringbuffer)
+				BufStr_Set(prog, stringbuffer, k, s);
+		}
+	}
+
+	if (sb.badread)
+		Con_Print(CON_WARN "Binary savegame is truncated or corrupt, the game state may be incomplete\n");
+
+	sv.time = time;
+	for (i = 0;i < NUM_SPAWN_PARMS;i++)
+		svs.clients[0].spawn_parms[i] = spawn_parms[i];
+
+	if (inflated)
+		Mem_Free(inflated);
+	return true;
+}
+
 /*
 ===============
 SV_Savegame_f
@@ -229,7 +931,39 @@ void SV_Savegame_f(cmd_state_t *cmd)
 	dp_strlcpy (name, Cmd_Argv(cmd, 1), sizeof (name));
 	FS_DefaultExtension (name, ".sav", sizeof (name));
 
-	SV_Savegame_to(prog, name);
+	if (sv_save_binary.integer)
+		SV_Savegame_Binary_to(prog, name, sv_save_binary.integer >= 2);
+	else
+		SV_Savegame_to(prog, name);
+}
+
+/*
+===============
+SV_Loadgame_Finish
+
+Common tail of text and binary savegame loading
+===============
+*/
+static void SV_Loadgame_Finish(prvm_prog_t *prog)
+{
+	int i, numbuffers;
+	prvm_stringbuffer_t *stringbuffer;
+
+	// remove all temporary flagged string buffers (ones created with BufStr_FindCreateReplace)
+	numbuffers = (int)Mem_ExpandableArray_IndexRange(&prog->stringbuffersarray);
+	for (i = 0; i < numbuffers; i++)
+	{
+		if ( (stringbuffer = (prvm_stringbuffer_t *)Mem_ExpandableArray_RecordAtIndex(&prog->stringbuffersarray, i)) )
+			if (stringbuffer->flags & STRINGBUFFER_TEMP)
+				BufStr_Del(prog, stringbuffer);
+	}
+
+	if(developer_entityparsing.integer)
+		Con_Printf("SV_Loadgame_f: finished\n");
+
+	// make sure we're connected to loopback
+	if(sv.active && host.hook.ConnectLocal)
+		host.hook.ConnectLocal();
 }
 
 /*
@@ -248,11 +982,12 @@ void SV_Loadgame_f(cmd_state_t *cmd)
 	const char *t;
 	char *text;
 	prvm_edict_t *ent;
-	int i, k, numbuffers;
+	int i, k;
 	int entnum;
 	int version;
 	float spawn_parms[NUM_SPAWN_PARMS];
 	prvm_stringbuffer_t *stringbuffer;
+	fs_offset_t filesize;
 
 	if (Cmd_Argc(cmd) != 2)
 	{
@@ -273,13 +1008,21 @@ void SV_Loadgame_f(cmd_state_t *cmd)
 
 	cls.demonum = -1;		// stop demo loop in case this fails
 
-	t = text = (char *)FS_LoadFile (filename, tempmempool, false, NULL);
+	t = text = (char *)FS_LoadFile (filename, tempmempool, false, &filesize);
 	if (!text)
 	{
 		Con_Print(CON_ERROR "ERROR: couldn't open.\n");
 		return;
 	}
 
+	if (filesize >= SAVEGAME_BINARY_HEADERSIZE && !memcmp(text, SAVEGAME_BINARY_MAGIC, SAVEGAME_BINARY_MAGICSIZE))
+	{
+		if (SV_Loadgame_Binary(prog, (unsigned char *)text, filesize))
+			SV_Loadgame_Finish(prog);
+		Mem_Free(text);
+		return;
+	}
+
 	if(developer_entityparsing.integer)
 		Con_Printf("SV_Loadgame_f: loading version\n");
 
@@ -555,19 +1298,5 @@ void SV_Loadgame_f(cmd_state_t *cmd)
 	}
 	Mem_Free(text);
 
-	// remove all temporary flagged string buffers (ones created with BufStr_FindCreateReplace)
-	numbuffers = (int)Mem_ExpandableArray_IndexRange(&prog->stringbuffersarray);
-	for (i = 0; i < numbuffers; i++)
-	{
-		if ( (stringbuffer = (prvm_stringbuffer_t *)Mem_ExpandableArray_RecordAtIndex(&prog->stringbuffersarray, i)) )
-			if (stringbuffer->flags & STRINGBUFFER_TEMP)
-				BufStr_Del(prog, stringbuffer);
-	}
-
-	if(developer_entityparsing.integer)
-		Con_Printf("SV_Loadgame_f: finished\n");
-
-	// make sure we're connected to loopback
-	if(sv.active && host.hook.ConnectLocal)
-		host.hook.ConnectLocal();
+	SV_Loadgame_Finish(prog);
 }
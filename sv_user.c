@@ -989,8 +989,9 @@ void SV_ReadClientMessage(void)
 	char *s, *p, *q;
 	size_t slen;
 
-	if(sv_autodemo_perclient.integer >= 2)
+	if(sv_autodemo_perclient.integer >= 2 && host_client->netconnection)
 		SV_WriteDemoMessage(host_client, &(host_client->netconnection->message), true);
+	SV_Record_ClientMessage(host_client, &sv_message);
 
 	//MSG_BeginReading ();
 	sv_numreadmoves = 0;
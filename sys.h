@@ -141,6 +141,26 @@ qbool Sys_HaveSSE2(void);
 #define Sys_HaveSSE2() false
 #endif
 
+// AVX2 code is compiled per function, so only 64bit builds that can use
+// intrinsics get it
+#if defined(SSE2_PRESENT) && (defined(__x86_64__) || defined(_WIN64)) && !defined(__TINYC__) && !defined(NO_AVX2)
+# define AVX2_POSSIBLE
+#endif
+
+#ifdef AVX2_POSSIBLE
+// runtime detection of AVX2 and FMA (both are required) including OS support
+qbool Sys_HaveAVX2(void);
+// the rest of the engine is built without AVX, so functions using it are
+// compiled for it one by one and only called after Sys_HaveAVX2 said so
+# if defined(__GNUC__) || defined(__clang__)
+#  define AVX2_FUNCTION __attribute__((target("avx2,fma")))
+# else
+#  define AVX2_FUNCTION
+# endif
+#else
+#define Sys_HaveAVX2() false
+#endif
+
 typedef struct sys_s
 {
 	int argc;
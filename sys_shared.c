@@ -898,6 +898,41 @@ qbool Sys_HaveSSE2(void)
 }
 #endif
 
+#ifdef AVX2_POSSIBLE
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+qbool Sys_HaveAVX2(void)
+{
+	// COMMANDLINEOPTION: AVX2: -noavx2 disables AVX2 support and detection
+	if(Sys_CheckParm("-nosse") || Sys_CheckParm("-noavx2"))
+		return false;
+#if defined(__GNUC__) || defined(__clang__)
+	// this also checks that the OS saves the AVX registers
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#elif defined(_MSC_VER)
+	{
+		int regs[4];
+		__cpuid(regs, 0);
+		if (regs[0] < 7)
+			return false;
+		__cpuid(regs, 1);
+		// FMA is 1<<12, OSXSAVE is 1<<27, AVX is 1<<28
+		if ((regs[2] & 0x18001000) != 0x18001000)
+			return false;
+		// the OS has to save the YMM registers
+		if ((_xgetbv(0) & 6) != 6)
+			return false;
+		__cpuidex(regs, 7, 0);
+		return (regs[1] & (1 << 5)) != 0; // AVX2
+	}
+#else
+	return false;
+#endif
+}
+#endif
+
 /// called to set process priority for dedicated servers
 #if defined(__linux__)
 #include <sys/resource.h>
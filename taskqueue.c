@@ -141,6 +141,11 @@ qbool TaskQueue_IsDone(taskqueue_task_t *t)
 	return !!t->done;
 }
 
+int TaskQueue_NumThreads(void)
+{
+	return taskqueue_state.numthreads;
+}
+
 static void TaskQueue_DistributeTasks(void)
 {
 	Thread_AtomicLock(&taskqueue_state.command_lock);
@@ -32,6 +32,9 @@ void TaskQueue_Yield(taskqueue_task_t *t);
 // polls for status of task and returns the result, does not cause tasks to be executed (see TaskQueue_WaitForTaskDone for that)
 qbool TaskQueue_IsDone(taskqueue_task_t *t);
 
+// number of worker threads currently running, 0 if the tasks run on the calling thread
+int TaskQueue_NumThreads(void);
+
 // triggers execution of queued tasks, and waits for the specified task to be done
 void TaskQueue_WaitForTaskDone(taskqueue_task_t *t);
 
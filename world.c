@@ -71,6 +71,12 @@ void World_End(world_t *world)
 #ifdef USEODE
 	World_Physics_End(world);
 #endif
+	// the area tree nodes go away with the prog mempool
+	world->areatree_nodes = NULL;
+	world->areatree_maxnodes = 0;
+	world->areatree_root = -1;
+	world->areatree_freelist = -1;
+	world->areatree_numleafs = 0;
 }
 
 //============================================================================
@@ -104,6 +110,8 @@ ENTITY AREA CHECKING
 void World_PrintAreaStats(world_t *world, const char *worldname)
 {
 	Con_Printf("%s areagrid check stats: %d calls %d nodes (%f per call) %d entities (%f per call)\n", worldname, world->areagrid_stats_calls, world->areagrid_stats_nodechecks, (double) world->areagrid_stats_nodechecks / (double) world->areagrid_stats_calls, world->areagrid_stats_entitychecks, (double) world->areagrid_stats_entitychecks / (double) world->areagrid_stats_calls);
+	if (world->areatree)
+		Con_Printf("%s area tree: %d entities linked, height %d, %d nodes allocated\n", worldname, world->areatree_numleafs, world->areatree_root >= 0 ? world->areatree_nodes[world->areatree_root].height : 0, world->areatree_maxnodes);
 	world->areagrid_stats_calls = 0;
 	world->areagrid_stats_nodechecks = 0;
 	world->areagrid_stats_entitychecks = 0;
@@ -115,10 +123,14 @@ World_SetSize
 
 ===============
 */
-void World_SetSize(world_t *world, const char *filename, const vec3_t mins, const vec3_t maxs, prvm_prog_t *prog)
+void World_SetSize(world_t *world, const char *filename, const vec3_t mins, const vec3_t maxs, prvm_prog_t *prog, qbool usetree)
 {
 	int i;
 
+	// area tree nodes are allocated on first link, from the prog mempool
+	if (world->areatree_nodes && world->prog == prog && prog->loaded)
+		Mem_Free(world->areatree_nodes);
+
 	dp_strlcpy(world->filename, filename, sizeof(world->filename));
 	VectorCopy(mins, world->mins);
 	VectorCopy(maxs, world->maxs);
@@ -146,6 +158,12 @@ void World_SetSize(world_t *world, const char *filename, const vec3_t mins, cons
 	World_ClearLink(&world->areagrid_outside);
 	for (i = 0;i < AREA_GRIDNODES;i++)
 		World_ClearLink(&world->areagrid[i]);
+	world->areatree = usetree;
+	world->areatree_nodes = NULL;
+	world->areatree_maxnodes = 0;
+	world->areatree_root = -1;
+	world->areatree_freelist = -1;
+	world->areatree_numleafs = 0;
 	if (developer_extra.integer)
 		Con_DPrintf("areagrid settings: divisions %ix%ix1 : box %f %f %f : %f %f %f size %f %f %f grid %f %f %f (mingrid %f)\n", AREA_GRID, AREA_GRID, world->areagrid_mins[0], world->areagrid_mins[1], world->areagrid_mins[2], world->areagrid_maxs[0], world->areagrid_maxs[1], world->areagrid_maxs[2], world->areagrid_size[0], world->areagrid_size[1], world->areagrid_size[2], 1.0f / world->areagrid_scale[0], 1.0f / world->areagrid_scale[1], 1.0f / world->areagrid_scale[2], sv_areagrid_mingridsize.value);
 }
@@ -168,14 +186,347 @@ void World_UnlinkAll(world_t *world)
 	for (i = 0, grid = world->areagrid;i < AREA_GRIDNODES;i++, grid++)
 		while (grid->list.next != &grid->list)
 			World_UnlinkEdict(PRVM_EDICT_NUM(List_Entry(grid->list.next, link_t, list)->entitynumber));
+	// removing leafs only frees nodes, so walking the array is safe
+	for (i = 0;i < world->areatree_maxnodes;i++)
+		if (world->areatree_nodes[i].height == 0)
+			World_UnlinkEdict(PRVM_EDICT_NUM(world->areatree_nodes[i].entitynumber));
+}
+
+/*
+===============================================================================
+
+AREA TREE
+
+Dynamic bounding box tree, leafs are inserted next to the sibling that grows
+the least in surface area and the tree is kept balanced with rotations.
+Leaf boxes are padded by AREA_TREE_MARGIN so entities moving a little stay
+in their leaf.
+===============================================================================
+*/
+
+static float World_AreaTree_Area(const vec3_t mins, const vec3_t maxs)
+{
+	float x = maxs[0] - mins[0], y = maxs[1] - mins[1], z = maxs[2] - mins[2];
+	return x * y + y * z + z * x;
+}
+
+static float World_AreaTree_UnionArea(const areatree_node_t *a, const areatree_node_t *b)
+{
+	vec3_t mins, maxs;
+	mins[0] = min(a->mins[0], b->mins[0]);
+	mins[1] = min(a->mins[1], b->mins[1]);
+	mins[2] = min(a->mins[2], b->mins[2]);
+	maxs[0] = max(a->maxs[0], b->maxs[0]);
+	maxs[1] = max(a->maxs[1], b->maxs[1]);
+	maxs[2] = max(a->maxs[2], b->maxs[2]);
+	return World_AreaTree_Area(mins, maxs);
+}
+
+/// recalculates box and height of an inner node from its children
+static void World_AreaTree_Refit(areatree_node_t *nodes, int index)
+{
+	areatree_node_t *node = nodes + index;
+	const areatree_node_t *a = nodes + node->children[0];
+	const areatree_node_t *b = nodes + node->children[1];
+	node->mins[0] = min(a->mins[0], b->mins[0]);
+	node->mins[1] = min(a->mins[1], b->mins[1]);
+	node->mins[2] = min(a->mins[2], b->mins[2]);
+	node->maxs[0] = max(a->maxs[0], b->maxs[0]);
+	node->maxs[1] = max(a->maxs[1], b->maxs[1]);
+	node->maxs[2] = max(a->maxs[2], b->maxs[2]);
+	node->height = 1 + max(a->height, b->height);
+}
+
+static int World_AreaTree_AllocNode(world_t *world)
+{
+	areatree_node_t *node;
+	int i, index;
+
+	if (world->areatree_freelist < 0)
+	{
+		int oldmax = world->areatree_maxnodes;
+		world->areatree_maxnodes = max(oldmax * 2, 256);
+		world->areatree_nodes = (areatree_node_t *)Mem_Realloc(world->prog->progs_mempool, world->areatree_nodes, world->areatree_maxnodes * sizeof(areatree_node_t));
+		for (i = world->areatree_maxnodes - 1;i >= oldmax;i--)
+		{
+			world->areatree_nodes[i].height = -1;
+			world->areatree_nodes[i].parent = world->areatree_freelist;
+			world->areatree_freelist = i;
+		}
+	}
+	index = world->areatree_freelist;
+	node = world->areatree_nodes + index;
+	world->areatree_freelist = node->parent;
+	node->parent = -1;
+	node->children[0] = node->children[1] = -1;
+	node->height = 0;
+	node->entitynumber = 0;
+	return index;
+}
+
+static void World_AreaTree_FreeNode(world_t *world, int index)
+{
+	world->areatree_nodes[index].height = -1;
+	world->areatree_nodes[index].parent = world->areatree_freelist;
+	world->areatree_freelist = index;
+}
+
+static void World_AreaTree_ReplaceChild(world_t *world, int parent, int oldchild, int newchild)
+{
+	if (parent < 0)
+		world->areatree_root = newchild;
+	else if (world->areatree_nodes[parent].children[0] == oldchild)
+		world->areatree_nodes[parent].children[0] = newchild;
+	else
+		world->areatree_nodes[parent].children[1] = newchild;
 }
 
 /*
 ===============
+World_AreaTree_Balance
 
+Rotates the taller grandchild up if the children of node a differ in height
+by more than one, returns the node now in the place of a
 ===============
 */
-void World_UnlinkEdict(prvm_edict_t *ent)
+static int World_AreaTree_Balance(world_t *world, int ia)
+{
+	areatree_node_t *nodes = world->areatree_nodes;
+	areatree_node_t *a = nodes + ia;
+	int ib, ic, iup, ilow, imove, balance;
+	areatree_node_t *up;
+
+	if (a->height < 2)
+		return ia;
+
+	ib = a->children[0];
+	ic = a->children[1];
+	balance = nodes[ic].height - nodes[ib].height;
+	if (balance >= -1 && balance <= 1)
+		return ia;
+
+	// iup is the taller child which becomes the parent of a, ilow stays below a
+	iup = balance > 1 ? ic : ib;
+	ilow = balance > 1 ? ib : ic;
+	up = nodes + iup;
+
+	// swap a and up
+	up->parent = a->parent;
+	World_AreaTree_ReplaceChild(world, a->parent, ia, iup);
+	a->parent = iup;
+
+	// of the grandchildren the taller one stays under up, the other moves to a
+	if (nodes[up->children[0]].height > nodes[up->children[1]].height)
+	{
+		imove = up->children[1];
+		up->children[1] = ia;
+	}
+	else
+	{
+		imove = up->children[0];
+		up->children[0] = ia;
+	}
+	a->children[0] = ilow;
+	a->children[1] = imove;
+	nodes[imove].parent = ia;
+	World_AreaTree_Refit(nodes, ia);
+	World_AreaTree_Refit(nodes, iup);
+	return iup;
+}
+
+/// walks from index to the root, rebalancing and refitting each node
+static void World_AreaTree_FixUpwards(world_t *world, int index)
+{
+	while (index >= 0)
+	{
+		index = World_AreaTree_Balance(world, index);
+		World_AreaTree_Refit(world->areatree_nodes, index);
+		index = world->areatree_nodes[index].parent;
+	}
+}
+
+static void World_AreaTree_InsertLeaf(world_t *world, int leaf)
+{
+	areatree_node_t *nodes;
+	int index, sibling, oldparent, newparent, child, i;
+	float area, combinedarea, cost, inheritance, childcost[2];
+
+	world->areatree_numleafs++;
+	if (world->areatree_root < 0)
+	{
+		world->areatree_root = leaf;
+		world->areatree_nodes[leaf].parent = -1;
+		return;
+	}
+
+	// find the sibling whose box grows the least when adding the leaf
+	nodes = world->areatree_nodes;
+	index = world->areatree_root;
+	while (nodes[index].height > 0)
+	{
+		area = World_AreaTree_Area(nodes[index].mins, nodes[index].maxs);
+		combinedarea = World_AreaTree_UnionArea(nodes + index, nodes + leaf);
+		// cost of making a new parent for this node and the leaf
+		cost = 2.0f * combinedarea;
+		// minimum cost of pushing the leaf further down the tree
+		inheritance = 2.0f * (combinedarea - area);
+		for (i = 0;i < 2;i++)
+		{
+			child = nodes[index].children[i];
+			childcost[i] = World_AreaTree_UnionArea(nodes + child, nodes + leaf) + inheritance;
+			if (nodes[child].height > 0)
+				childcost[i] -= World_AreaTree_Area(nodes[child].mins, nodes[child].maxs);
+		}
+		if (cost < childcost[0] && cost < childcost[1])
+			break;
+		index = nodes[index].children[childcost[1] < childcost[0]];
+	}
+	sibling = index;
+
+	// create a new parent for the sibling and the leaf (this may move nodes)
+	newparent = World_AreaTree_AllocNode(world);
+	nodes = world->areatree_nodes;
+	oldparent = nodes[sibling].parent;
+	nodes[newparent].parent = oldparent;
+	nodes[newparent].children[0] = sibling;
+	nodes[newparent].children[1] = leaf;
+	World_AreaTree_ReplaceChild(world, oldparent, sibling, newparent);
+	nodes[sibling].parent = newparent;
+	nodes[leaf].parent = newparent;
+
+	World_AreaTree_FixUpwards(world, newparent);
+}
+
+static void World_AreaTree_RemoveLeaf(world_t *world, int leaf)
+{
+	areatree_node_t *nodes = world->areatree_nodes;
+	int parent, grandparent, sibling;
+
+	world->areatree_numleafs--;
+	if (leaf == world->areatree_root)
+	{
+		world->areatree_root = -1;
+		return;
+	}
+
+	parent = nodes[leaf].parent;
+	grandparent = nodes[parent].parent;
+	sibling = nodes[parent].children[0] == leaf ? nodes[parent].children[1] : nodes[parent].children[0];
+
+	// the sibling takes the place of the parent
+	World_AreaTree_ReplaceChild(world, grandparent, parent, sibling);
+	nodes[sibling].parent = grandparent;
+	World_AreaTree_FreeNode(world, parent);
+	World_AreaTree_FixUpwards(world, grandparent);
+}
+
+// false if the leaf the entity remembers is not its own anymore, as the tree
+// may have been thrown away since (World_SetSize, World_End)
+static qbool World_AreaTree_IsLeafOf(world_t *world, int leaf, int entitynumber)
+{
+	return world->areatree_nodes && leaf >= 0 && leaf < world->areatree_maxnodes && world->areatree_nodes[leaf].height == 0 && world->areatree_nodes[leaf].entitynumber == entitynumber;
+}
+
+static void World_UnlinkEdict_AreaTree(prvm_edict_t *ent)
+{
+	world_t *world = ent->priv.server->areatree_world;
+	int leaf = ent->priv.server->areatree_leaf;
+
+	ent->priv.server->areatree_world = NULL;
+	if (!World_AreaTree_IsLeafOf(world, leaf, (int)(ent - world->prog->edicts)))
+		return;
+	World_AreaTree_RemoveLeaf(world, leaf);
+	World_AreaTree_FreeNode(world, leaf);
+}
+
+static void World_LinkEdict_AreaTree(world_t *world, prvm_edict_t *ent)
+{
+	prvm_prog_t *prog = world->prog;
+	areatree_node_t *node;
+	int leaf, entitynumber = PRVM_NUM_FOR_EDICT(ent);
+
+	if (entitynumber <= 0 || entitynumber >= prog->max_edicts || PRVM_EDICT_NUM(entitynumber) != ent)
+	{
+		Con_Printf ("World_LinkEdict_AreaTree: invalid edict %p (edicts is %p, edict compared to prog->edicts is %i)\n", (void *)ent, (void *)prog->edicts, entitynumber);
+		return;
+	}
+
+	if (ent->priv.server->areatree_world == world && World_AreaTree_IsLeafOf(world, ent->priv.server->areatree_leaf, entitynumber))
+	{
+		// nothing to do if the padded leaf box still contains the entity
+		node = world->areatree_nodes + ent->priv.server->areatree_leaf;
+		if (node->mins[0] <= ent->priv.server->areamins[0] && node->maxs[0] >= ent->priv.server->areamaxs[0]
+		 && node->mins[1] <= ent->priv.server->areamins[1] && node->maxs[1] >= ent->priv.server->areamaxs[1]
+		 && node->mins[2] <= ent->priv.server->areamins[2] && node->maxs[2] >= ent->priv.server->areamaxs[2])
+			return;
+	}
+	if (ent->priv.server->areatree_world)
+		World_UnlinkEdict_AreaTree(ent);
+
+	leaf = World_AreaTree_AllocNode(world);
+	node = world->areatree_nodes + leaf;
+	node->entitynumber = entitynumber;
+	node->mins[0] = ent->priv.server->areamins[0] - AREA_TREE_MARGIN;
+	node->mins[1] = ent->priv.server->areamins[1] - AREA_TREE_MARGIN;
+	node->mins[2] = ent->priv.server->areamins[2] - AREA_TREE_MARGIN;
+	node->maxs[0] = ent->priv.server->areamaxs[0] + AREA_TREE_MARGIN;
+	node->maxs[1] = ent->priv.server->areamaxs[1] + AREA_TREE_MARGIN;
+	node->maxs[2] = ent->priv.server->areamaxs[2] + AREA_TREE_MARGIN;
+	World_AreaTree_InsertLeaf(world, leaf);
+	ent->priv.server->areatree_world = world;
+	ent->priv.server->areatree_leaf = leaf;
+}
+
+static int World_EntitiesInBox_AreaTree(world_t *world, const vec3_t mins, const vec3_t maxs, int maxlist, prvm_edict_t **list)
+{
+	prvm_prog_t *prog = world->prog;
+	const areatree_node_t *nodes = world->areatree_nodes;
+	const areatree_node_t *node;
+	prvm_edict_t *ent;
+	int stack[256];
+	int stackpos, numlist = 0;
+
+	world->areagrid_stats_calls++;
+	if (world->areatree_root < 0)
+		return 0;
+	stack[0] = world->areatree_root;
+	stackpos = 1;
+	while (stackpos > 0)
+	{
+		node = nodes + stack[--stackpos];
+		world->areagrid_stats_nodechecks++;
+		if (!BoxesOverlap(mins, maxs, node->mins, node->maxs))
+			continue;
+		if (node->height > 0)
+		{
+			// a balanced tree never gets close to this deep
+			if (stackpos + 2 > (int)(sizeof(stack) / sizeof(stack[0])))
+			{
+				Con_Printf("World_EntitiesInBox: area tree too deep\n");
+				break;
+			}
+			stack[stackpos++] = node->children[1];
+			stack[stackpos++] = node->children[0];
+			continue;
+		}
+		world->areagrid_stats_entitychecks++;
+		ent = PRVM_EDICT_NUM(node->entitynumber);
+		if (!ent->free && BoxesOverlap(mins, maxs, ent->priv.server->areamins, ent->priv.server->areamaxs))
+		{
+			if (numlist < maxlist)
+				list[numlist] = ent;
+			numlist++;
+		}
+	}
+	return numlist;
+}
+
+/*
+===============
+
+===============
+*/
+static void World_UnlinkEdict_AreaGrid(prvm_edict_t *ent)
 {
 	int i;
 	for (i = 0;i < ENTITYGRIDAREAS;i++)
@@ -185,6 +536,13 @@ void World_UnlinkEdict(prvm_edict_t *ent)
 	}
 }
 
+void World_UnlinkEdict(prvm_edict_t *ent)
+{
+	World_UnlinkEdict_AreaGrid(ent);
+	if (ent->priv.server->areatree_world)
+		World_UnlinkEdict_AreaTree(ent);
+}
+
 int World_EntitiesInBox(world_t *world, const vec3_t requestmins, const vec3_t requestmaxs, int maxlist, prvm_edict_t **list)
 {
 	prvm_prog_t *prog = world->prog;
@@ -199,6 +557,9 @@ int World_EntitiesInBox(world_t *world, const vec3_t requestmins, const vec3_t r
 	if (prog == NULL || prog->num_edicts < 1)
 		return 0;
 
+	if (world->areatree)
+		return World_EntitiesInBox_AreaTree(world, requestmins, requestmaxs, maxlist, list);
+
 	// LadyHavoc: discovered this actually causes its own bugs (dm6 teleporters being too close to info_teleport_destination)
 	//VectorSet(paddedmins, requestmins[0] - 1.0f, requestmins[1] - 1.0f, requestmins[2] - 1.0f);
 	//VectorSet(paddedmaxs, requestmaxs[0] + 1.0f, requestmaxs[1] + 1.0f, requestmaxs[2] + 1.0f);
@@ -320,25 +681,26 @@ World_LinkEdict
 void World_LinkEdict(world_t *world, prvm_edict_t *ent, const vec3_t mins, const vec3_t maxs, qbool link_solid_not)
 {
 	prvm_prog_t *prog = world->prog;
-	// unlink from old position first
+	// unlink from old position first (area tree leafs are updated in place)
 	if (ent->priv.server->areagrid[0].list.prev)
-		World_UnlinkEdict(ent);
+		World_UnlinkEdict_AreaGrid(ent);
 
 	// some games don't want SOLID_NOT entities linked
-	if (!link_solid_not && PRVM_serveredictfloat(ent, solid) == SOLID_NOT)
-		return;
-
 	// don't add the world
-	if (ent == prog->edicts)
-		return;
-
 	// don't add free entities
-	if (ent->free)
+	if ((!link_solid_not && PRVM_serveredictfloat(ent, solid) == SOLID_NOT) || ent == prog->edicts || ent->free)
+	{
+		if (ent->priv.server->areatree_world)
+			World_UnlinkEdict_AreaTree(ent);
 		return;
+	}
 
 	VectorCopy(mins, ent->priv.server->areamins);
 	VectorCopy(maxs, ent->priv.server->areamaxs);
-	World_LinkEdict_AreaGrid(world, ent);
+	if (world->areatree)
+		World_LinkEdict_AreaTree(world, ent);
+	else
+		World_LinkEdict_AreaGrid(world, ent);
 }
 
 
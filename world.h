@@ -33,6 +33,20 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #define AREA_GRID 128
 #define AREA_GRIDNODES (AREA_GRID * AREA_GRID)
+/// leaf boxes of the area tree are padded by this much so small moves don't
+/// need to touch the tree
+#define AREA_TREE_MARGIN 8
+
+/// node of the dynamic bounding box tree that can replace the areagrid
+typedef struct areatree_node_s
+{
+	vec3_t mins, maxs; ///< padded entity box for leaves, union of children otherwise
+	int parent; ///< parent node, or next free node when unused
+	int children[2]; ///< -1 for leaves
+	int height; ///< 0 for leaves, -1 for unused nodes
+	int entitynumber; ///< for leaves
+}
+areatree_node_t;
 
 typedef struct link_s
 {
@@ -85,6 +99,15 @@ typedef struct world_s
 	vec3_t areagrid_size;
 	int areagrid_marknumber;
 
+	// dynamic bounding box tree used instead of the grid if areatree is set,
+	// it handles huge maps and big entities without an outside list
+	qbool areatree;
+	areatree_node_t *areatree_nodes; ///< allocated from the prog mempool
+	int areatree_maxnodes;
+	int areatree_root;
+	int areatree_freelist;
+	int areatree_numleafs;
+
 	// if the QC uses a physics engine, the data for it is here
 	world_physics_t physics;
 }
@@ -101,7 +124,8 @@ void World_Init(void);
 void World_Shutdown(void);
 
 /// called after the world model has been loaded, before linking any entities
-void World_SetSize(world_t *world, const char *filename, const vec3_t mins, const vec3_t maxs, struct prvm_prog_s *prog);
+/// usetree selects the dynamic bounding box tree instead of the areagrid
+void World_SetSize(world_t *world, const char *filename, const vec3_t mins, const vec3_t maxs, struct prvm_prog_s *prog, qbool usetree);
 /// unlinks all entities (used before reallocation of edicts)
 void World_UnlinkAll(world_t *world);
 